@@ -0,0 +1,564 @@
+#include "AsciiFormat.h"
+#include "ThreadSplit.h"
+
+/**
+  * AsciiFormat
+  * Copyright 2016, ShotSpotter
+  */
+
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Most characters a sample or time takes, sign and exponent included */
+#define ASCII_MAX_FIELD 32
+
+/** Threads to split across, zero for one per core */
+static std::atomic<unsigned int> asciiThreads( 0 );
+
+/** Fewest bytes per parsing thread, and rows per writing batch */
+static std::atomic<size_t> asciiChunkBytes( ASCII_CHUNK_BYTES );
+static std::atomic<unsigned long long> asciiWriteRows( ASCII_WRITE_ROWS );
+
+static inline bool
+isSep( const char &c )
+{
+  return c == ' ' || c == '\t' || c == ',' || c == '\r';
+}
+
+static inline const char*
+skipSeps( const char* p, const char* end )
+{
+  while( p < end && isSep( *p ) )
+    p++;
+  return p;
+}
+
+/** Can rows of this format be written and read? */
+static inline bool
+asciiStorable( const NumberFormats &fmt, const unsigned int &size )
+{
+  if( fmt == NUM_INT )
+    return size >= 2 && size <= 4;
+  return (fmt == NUM_FLT && size == sizeof(float)) || ((fmt == NUM_DBL || fmt == NUM_TIME) && size == sizeof(double));
+}
+
+// Writing
+
+/** Microseconds since the epoch as seconds, always six places */
+static inline char*
+putTime( char* p, int64_t us )
+{
+  if( us < 0 ) {
+    *p++ = '-';
+    us = -us;
+  }
+  p = std::to_chars( p, p + ASCII_MAX_FIELD, us / 1000000 ).ptr;
+  *p++ = '.';
+  int64_t frac = us % 1000000;
+  for( int i = 5; i >= 0; i-- ) {
+    p[i] = '0' + frac % 10;
+    frac /= 10;
+  }
+  return p + 6;
+}
+
+static inline char*
+putSample( char* p, const char* src, const NumberFormats &fmt, const unsigned int &size )
+{
+  char* end = p + ASCII_MAX_FIELD;
+  if( fmt == NUM_INT ) {
+    int32_t v;
+    if( size == 2 ) {
+      int16_t s;
+      memcpy( &s, src, 2 );
+      v = s;
+    } else if( size == 3 ) {
+      const uint8_t* b = (const uint8_t*)src;
+      v = (int32_t)(((b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16) ^ 0x800000u) - 0x800000u);
+    } else
+      memcpy( &v, src, 4 );
+    return std::to_chars( p, end, v ).ptr;
+  }
+  if( size == sizeof(float) ) {
+    float f;
+    memcpy( &f, src, sizeof(f) );
+    return std::to_chars( p, end, f ).ptr;
+  }
+  double d;
+  memcpy( &d, src, sizeof(d) );
+  return std::to_chars( p, end, d ).ptr;
+}
+
+/** Format rows beg up to beg + num of view into buf, returning its length */
+static size_t
+formatRows( const DataView &view, const unsigned long long &beg, const unsigned long long &num,
+            const bool &timeCol, const int64_t &utcUs, std::vector<char> &buf )
+{
+  buf.resize( num * ((view.getCols() + timeCol) * (ASCII_MAX_FIELD + 1) + 1) );
+  char* p = &buf[0];
+  NumberFormats fmt = view.getNumFmt();
+  unsigned int size = view.getEltSize();
+  double rate = view.getSampleRate();
+  for( unsigned long long r = beg; r < beg + num; r++ ) {
+    if( timeCol ) {
+      p = putTime( p, utcUs + (rate > 0.0 ? llround( r * 1e6 / rate ) : 0) );
+      *p++ = ' ';
+    }
+    for( unsigned int c = 0; c < view.getCols(); c++ ) {
+      if( c )
+        *p++ = ' ';
+      p = putSample( p, view.getElt( r, c ), fmt, size );
+    }
+    *p++ = '\n';
+  }
+  return p - &buf[0];
+}
+
+bool
+asciiWrite( FILE* fid, const DataView &view, const bool &timeCol )
+{
+  if( !asciiStorable( view.getNumFmt(), view.getEltSize() ) ) {
+    std::cerr << "asciiWrite() no sample type of size " << view.getEltSize() << " format " << view.getNumFmt() << "!" << &std::endl;
+    return false;
+  }
+
+  time_t sec;
+  long usec;
+  view.getUTC().get( sec, usec );
+  int64_t utcUs = (int64_t)sec * 1000000 + usec;
+
+  // Threads take a batch each, their text goes out in order
+  unsigned long long numRows = view.getRows();
+  unsigned long long batch = asciiWriteRows.load( std::memory_order_relaxed );
+  unsigned int numThreads = threadsFor( numRows, batch, asciiThreads.load( std::memory_order_relaxed ) );
+  std::vector<std::vector<char>> bufs( numThreads );
+  std::vector<size_t> lens( numThreads );
+  for( unsigned long long round = 0; round < numRows; round += numThreads * batch ) {
+    runThreads( numThreads, [&]( unsigned int t ) {
+      unsigned long long beg = round + t * batch;
+      unsigned long long num = beg >= numRows ? 0 : numRows - beg < batch ? numRows - beg : batch;
+      lens[t] = num ? formatRows( view, beg, num, timeCol, utcUs, bufs[t] ) : 0;
+    } );
+    for( unsigned int t = 0; t < numThreads; t++ ) {
+      if( lens[t] && fwrite( &bufs[t][0], 1, lens[t], fid ) != lens[t] ) {
+        std::cerr << "asciiWrite() short write of rows!" << &std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Reading
+
+/** Lines from p up to end, the last needn't end in a newline */
+static unsigned long long
+countLines( const char* p, const char* end )
+{
+  if( p == end )
+    return 0;
+  unsigned long long num = end[-1] != '\n';
+ #ifdef __SSE2__
+  const __m128i nl = _mm_set1_epi8( '\n' );
+  for( ; p + 16 <= end; p += 16 )
+    num += __builtin_popcount( _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_loadu_si128( (const __m128i*)p ), nl ) ) );
+ #endif // __SSE2__
+  for( ; p < end; p++ )
+    num += *p == '\n';
+  return num;
+}
+
+bool
+asciiScan( const char* text, const size_t &numBytes, unsigned long long &maxRows, unsigned int &numFields )
+{
+  numFields = 0;
+  const char* end = text + numBytes;
+  maxRows = countLines( text, end );
+  for( const char* p = text; p < end && !numFields; ) {
+    const char* eol = (const char*)memchr( p, '\n', end - p );
+    if( !eol )
+      eol = end;
+    const char* q = skipSeps( p, eol );
+    if( q < eol && *q != '#' ) {
+      while( q < eol ) {
+        numFields++;
+        while( q < eol && !isSep( *q ) )
+          q++;
+        q = skipSeps( q, eol );
+      }
+    }
+    p = eol + 1;
+  }
+  return numFields != 0;
+}
+
+/** Seconds since the epoch, to the microsecond, later places dropped */
+static inline const char*
+parseTime( const char* p, const char* end, int64_t &us )
+{
+  bool neg = p < end && *p == '-';
+  if( neg )
+    p++;
+  uint64_t sec;
+  std::from_chars_result res = std::from_chars( p, end, sec );
+  if( res.ec != std::errc() )
+    return NULL;
+  p = res.ptr;
+  int64_t frac = 0;
+  int places = 0;
+  if( p < end && *p == '.' ) {
+    for( p++; p < end && *p >= '0' && *p <= '9'; p++ ) {
+      if( places < 6 ) {
+        frac = frac * 10 + (*p - '0');
+        places++;
+      }
+    }
+  }
+  for( ; places < 6; places++ )
+    frac *= 10;
+  us = (int64_t)sec * 1000000 + frac;
+  if( neg )
+    us = -us;
+  return p;
+}
+
+static inline const char*
+parseSample( const char* p, const char* end, const NumberFormats &fmt, const unsigned int &size, char* dst )
+{
+  std::from_chars_result res;
+  if( fmt == NUM_INT ) {
+    int32_t v;
+    res = std::from_chars( p, end, v );
+    if( res.ec != std::errc() )
+      return NULL;
+    if( size < 4 ) {
+      int32_t lim = 1 << (8 * size - 1);
+      if( v < -lim || v >= lim )
+        return NULL;
+    }
+    dst[0] = (char)v;
+    dst[1] = (char)(v >> 8);
+    if( size > 2 ) dst[2] = (char)(v >> 16);
+    if( size > 3 ) dst[3] = (char)(v >> 24);
+  } else if( size == sizeof(float) ) {
+    float f;
+    res = std::from_chars( p, end, f );
+    memcpy( dst, &f, sizeof(f) );
+  } else {
+    double d;
+    res = std::from_chars( p, end, d );
+    memcpy( dst, &d, sizeof(d) );
+  }
+  return res.ec == std::errc() ? res.ptr : NULL;
+}
+
+/**
+ * Parse the lines from beg up to end into dst and times.
+ * @return the offset of the malformed line, or end - beg if none
+ */
+static size_t
+parseChunk( const char* beg, const char* end, const NumberFormats &fmt, const unsigned int &size,
+            const unsigned int &numCols, char* dst, int64_t* times, unsigned long long &numRows )
+{
+  // No hunting for line ends, fields stop at newlines by themselves
+  size_t rowBytes = numCols * size;
+  numRows = 0;
+  for( const char* p = beg; p < end; ) {
+    const char* q = skipSeps( p, end );
+    if( q == end || *q == '\n' || *q == '#' ) {
+      const char* eol = q < end ? (const char*)memchr( q, '\n', end - q ) : NULL;
+      p = eol ? eol + 1 : end;
+      continue;
+    }
+
+    if( times && !(q = parseTime( q, end, times[numRows] )) )
+      return p - beg;
+    char* row = dst + numRows * rowBytes;
+    for( unsigned int c = 0; c < numCols; c++ ) {
+      // Fields end at a separator, "12abc" is no sample
+      if( (times || c) && (q == end || !isSep( *q )) )
+        return p - beg;
+      q = skipSeps( q, end );
+      if( q == end || *q == '\n' || !(q = parseSample( q, end, fmt, size, row + c * size )) )
+        return p - beg;
+    }
+    q = skipSeps( q, end );
+    if( q < end && *q != '\n' )
+      return p - beg;
+    numRows++;
+    p = q < end ? q + 1 : end;
+  }
+  return end - beg;
+}
+
+/**
+ * Split text into newline-aligned chunks, one per thread, so no line is
+ * split, and count the lines before each.  Those place a chunk's rows,
+ * blank lines and comments leave gaps to close afterwards.
+ * @return number of chunks
+ */
+static unsigned int
+splitChunks( const char* text, const size_t &numBytes, std::vector<const char*> &bounds,
+             std::vector<unsigned long long> &firstLine )
+{
+  const char* end = text + numBytes;
+  unsigned int numChunks = threadsFor( numBytes, asciiChunkBytes.load( std::memory_order_relaxed ), asciiThreads.load( std::memory_order_relaxed ) );
+  bounds.assign( numChunks + 1, end );
+  bounds[0] = text;
+  for( unsigned int t = 1; t < numChunks; t++ ) {
+    const char* at = text + numBytes / numChunks * t;
+    if( at < bounds[t - 1] )
+      at = bounds[t - 1];
+    const char* eol = (const char*)memchr( at, '\n', end - at );
+    bounds[t] = eol ? eol + 1 : end;
+  }
+
+  firstLine.assign( numChunks + 1, 0 );
+  runThreads( numChunks, [&]( unsigned int t ) { firstLine[t + 1] = countLines( bounds[t], bounds[t + 1] ); } );
+  for( unsigned int t = 0; t < numChunks; t++ )
+    firstLine[t + 1] += firstLine[t];
+  return numChunks;
+}
+
+/** Report the first malformed line, if any */
+static bool
+chunksParsed( const char* caller, const char* text, const std::vector<const char*> &bounds, const std::vector<size_t> &badAt )
+{
+  for( size_t t = 0; t < badAt.size(); t++ ) {
+    if( bounds[t] + badAt[t] != bounds[t + 1] ) {
+      std::cerr << caller << "() malformed line at byte " << bounds[t] - text + badAt[t] << "!" << &std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+asciiParse( const char* text, const size_t &numBytes, const NumberFormats &fmt, const unsigned int &size,
+            const unsigned int &numCols, char* dst, int64_t* times, unsigned long long &numRows )
+{
+  numRows = 0;
+  if( !asciiStorable( fmt, size ) || !numCols ) {
+    std::cerr << "asciiParse() no sample type of size " << size << " format " << fmt << "!" << &std::endl;
+    return false;
+  }
+
+  std::vector<const char*> bounds;
+  std::vector<unsigned long long> firstLine;
+  unsigned int numChunks = splitChunks( text, numBytes, bounds, firstLine );
+  std::vector<unsigned long long> parsed( numChunks, 0 );
+  std::vector<size_t> badAt( numChunks, 0 );
+  size_t rowBytes = numCols * size;
+  runThreads( numChunks, [&]( unsigned int t ) {
+    badAt[t] = parseChunk( bounds[t], bounds[t + 1], fmt, size, numCols, dst + firstLine[t] * rowBytes,
+                           times ? times + firstLine[t] : NULL, parsed[t] );
+  } );
+  if( !chunksParsed( "asciiParse", text, bounds, badAt ) )
+    return false;
+
+  // Close the gaps
+  for( unsigned int t = 0; t < numChunks; t++ ) {
+    if( numRows != firstLine[t] ) {
+      memmove( dst + numRows * rowBytes, dst + firstLine[t] * rowBytes, parsed[t] * rowBytes );
+      if( times )
+        memmove( times + numRows, times + firstLine[t], parsed[t] * sizeof(int64_t) );
+    }
+    numRows += parsed[t];
+  }
+  return true;
+}
+
+/**
+ * Parse the lines from beg up to end into columns, from row firstRow.
+ * @return the offset of the malformed line, or end - beg if none
+ */
+static size_t
+parseColumnChunk( const char* beg, const char* end, const unsigned int &numFields, const bool* keep,
+                  double* const* dst, const unsigned long long &firstRow, unsigned long long &numRows )
+{
+  numRows = 0;
+  for( const char* p = beg; p < end; ) {
+    const char* q = skipSeps( p, end );
+    if( q == end || *q == '\n' || *q == '#' ) {
+      const char* eol = q < end ? (const char*)memchr( q, '\n', end - q ) : NULL;
+      p = eol ? eol + 1 : end;
+      continue;
+    }
+
+    unsigned long long row = firstRow + numRows;
+    for( unsigned int f = 0, k = 0; f < numFields; f++ ) {
+      if( f && (q == end || !isSep( *q )) )
+        return p - beg;
+      q = skipSeps( q, end );
+      if( q == end || *q == '\n' )
+        return p - beg;
+      if( keep[f] ) {
+        std::from_chars_result res = std::from_chars( q, end, dst[k++][row] );
+        if( res.ec != std::errc() )
+          return p - beg;
+        q = res.ptr;
+      } else {
+        while( q < end && !isSep( *q ) && *q != '\n' )
+          q++;
+      }
+    }
+
+    // Fields past the last are not wanted, as with scanf()
+    const char* eol = q < end ? (const char*)memchr( q, '\n', end - q ) : NULL;
+    numRows++;
+    p = eol ? eol + 1 : end;
+  }
+  return end - beg;
+}
+
+bool
+asciiParseColumns( const char* text, const size_t &numBytes, const unsigned int &numFields, const bool* keep,
+                   double* const* dst, unsigned long long &numRows )
+{
+  numRows = 0;
+  unsigned int numKept = 0;
+  for( unsigned int f = 0; f < numFields; f++ )
+    numKept += keep[f];
+
+  std::vector<const char*> bounds;
+  std::vector<unsigned long long> firstLine;
+  unsigned int numChunks = splitChunks( text, numBytes, bounds, firstLine );
+  std::vector<unsigned long long> parsed( numChunks, 0 );
+  std::vector<size_t> badAt( numChunks, 0 );
+  runThreads( numChunks, [&]( unsigned int t ) {
+    badAt[t] = parseColumnChunk( bounds[t], bounds[t + 1], numFields, keep, dst, firstLine[t], parsed[t] );
+  } );
+  if( !chunksParsed( "asciiParseColumns", text, bounds, badAt ) )
+    return false;
+
+  for( unsigned int t = 0; t < numChunks; t++ ) {
+    if( numRows != firstLine[t] ) {
+      for( unsigned int k = 0; k < numKept; k++ )
+        memmove( dst[k] + numRows, dst[k] + firstLine[t], parsed[t] * sizeof(double) );
+    }
+    numRows += parsed[t];
+  }
+  return true;
+}
+
+void
+setAsciiThreads( const unsigned int &numThreads )
+{
+  asciiThreads.store( numThreads, std::memory_order_relaxed );
+}
+
+void
+setAsciiChunkBytes( const size_t &numBytes )
+{
+  asciiChunkBytes.store( numBytes ? numBytes : ASCII_CHUNK_BYTES, std::memory_order_relaxed );
+}
+
+void
+setAsciiWriteRows( const unsigned long long &numRows )
+{
+  asciiWriteRows.store( numRows ? numRows : ASCII_WRITE_ROWS, std::memory_order_relaxed );
+}
+
+bool
+testAscii()
+{
+  // Shorts with times, round trip through text, with a comment and a blank line
+  const unsigned long long numRows = 1000;
+  std::vector<int16_t> rows( 2 * numRows ), back( 2 * numRows );
+  for( size_t i = 0; i < rows.size(); i++ )
+    rows[i] = (int16_t)(i * 7919);
+  DataView view( (const char*)&rows[0], numRows, 2, 2, NUM_INT, TimeObj( 1234567890, 250000 ), 100.0 );
+
+  FILE* fid = tmpfile();
+  if( !fid )
+    return DRATS;
+  fputs( "# time a b\n\n", fid );
+  bool ok = asciiWrite( fid, view, true );
+  std::vector<char> text( ftello( fid ) );
+  rewind( fid );
+  ok = ok && fread( &text[0], text.size(), 1, fid ) == 1;
+  fclose( fid );
+
+  unsigned long long maxRows, got;
+  unsigned int numFields;
+  std::vector<int64_t> times( numRows + 2 );
+  std::vector<char> dst( (numRows + 2) * 4 );
+  ok = ok && asciiScan( &text[0], text.size(), maxRows, numFields ) && maxRows == numRows + 2 && numFields == 3 &&
+       asciiParse( &text[0], text.size(), NUM_INT, 2, 2, &dst[0], &times[0], got ) && got == numRows &&
+       !memcmp( &dst[0], &rows[0], numRows * 4 ) && times[0] == 1234567890250000LL && times[999] == 1234567900240000LL;
+  if( !ok )
+    return DRATS;
+
+  // Split small, the batches and chunks of four threads come out in order,
+  // neither a multiple of the rows
+  setAsciiThreads( 4 );
+  setAsciiChunkBytes( 1000 );
+  setAsciiWriteRows( 37 );
+  fid = tmpfile();
+  ok = fid && asciiWrite( fid, view, true );
+  std::vector<char> split( fid ? ftello( fid ) : 0 );
+  if( fid ) {
+    rewind( fid );
+    ok = ok && fread( &split[0], split.size(), 1, fid ) == 1;
+    fclose( fid );
+  }
+  std::fill( dst.begin(), dst.end(), 0 );
+  std::fill( times.begin(), times.end(), 0 );
+  ok = ok && split.size() + 12 == text.size() && !memcmp( &split[0], &text[12], split.size() ) &&
+       asciiParse( &text[0], text.size(), NUM_INT, 2, 2, &dst[0], &times[0], got ) && got == numRows &&
+       !memcmp( &dst[0], &rows[0], numRows * 4 ) && times[0] == 1234567890250000LL && times[999] == 1234567900240000LL;
+  setAsciiThreads( 0 );
+  setAsciiChunkBytes( 0 );
+  setAsciiWriteRows( 0 );
+  if( !ok )
+    return DRATS;
+
+  // Doubles come back to the bit, commas and tabs separate, junk is refused
+  const char dbls[] = "0.1, -2.5e-300\n3\tnan\n";
+  double d[4];
+  if( !asciiParse( dbls, sizeof(dbls) - 1, NUM_DBL, 8, 2, (char*)d, NULL, got ) || got != 2 ||
+      d[0] != 0.1 || d[1] != -2.5e-300 || d[2] != 3.0 || !isnan( d[3] ) )
+    return DRATS;
+  const char bad[] = "1 2\n3 4x\n";
+  if( asciiParse( bad, sizeof(bad) - 1, NUM_DBL, 8, 2, (char*)d, NULL, got ) )
+    return DRATS;
+  const char wide[] = "40000\n";
+  if( asciiParse( wide, sizeof(wide) - 1, NUM_INT, 2, 1, (char*)d, NULL, got ) )
+    return DRATS;
+
+  // Columns, the skipped field unconverted, the extra one ignored
+  const char cols[] = "1.5\tjunk\t-2\textra\n\n3 x 4";
+  const bool keep[3] = { true, false, true };
+  double c0[3], c1[3];
+  double* dsts[2] = { c0, c1 };
+  if( !asciiParseColumns( cols, sizeof(cols) - 1, 3, keep, dsts, got ) || got != 2 ||
+      c0[0] != 1.5 || c1[0] != -2.0 || c0[1] != 3.0 || c1[1] != 4.0 )
+    return DRATS;
+
+  // Columns split across four threads, with comments and blank lines in
+  // the chunks, close up to the rows of one
+  std::string lines;
+  char line[64];
+  for( int r = 0; r < 2000; r++ ) {
+    if( r % 97 == 0 )
+      lines += "# comment\n\n";
+    snprintf( line, sizeof(line), "%d junk %g\n", r, r * -0.5 );
+    lines += line;
+  }
+  std::vector<double> k0( 2100 ), k1( 2100 );
+  double* kdsts[2] = { &k0[0], &k1[0] };
+  setAsciiThreads( 4 );
+  setAsciiChunkBytes( 512 );
+  ok = asciiParseColumns( lines.data(), lines.size(), 3, keep, kdsts, got ) && got == 2000;
+  setAsciiThreads( 0 );
+  setAsciiChunkBytes( 0 );
+  for( int r = 0; ok && r < 2000; r++ )
+    ok = k0[r] == r && k1[r] == r * -0.5;
+  return ok ? VOILA : DRATS;
+}
@@ -0,0 +1,105 @@
+#ifndef __ASCIIFORMAT_H__
+#define __ASCIIFORMAT_H__
+
+/**
+  * ASCII format, FORMAT_ASCII
+  * Copyright 2016, ShotSpotter
+  *
+  * One row per line, samples separated by spaces, tabs or commas:
+  *
+  *   [time] sample sample ...
+  *
+  * The optional time is seconds since the epoch to the microsecond,
+  * 1234567890.250000.  Integers are written as such, floats and doubles
+  * in the shortest form that reads back to the same bits.  Blank lines
+  * and lines starting with '#' are skipped on read.
+  *
+  * Conversion is std::to_chars and std::from_chars, no locale, no stdio
+  * per sample.  Big files are split at newlines into chunks handled on
+  * their own threads, and written out, or concatenated, in order.
+  */
+
+#include "libCore/libCore.h"
+#include "DataView.h"
+
+#include <stdint.h>
+
+/** Fewest bytes of text worth a parsing thread of their own, by default */
+#define ASCII_CHUNK_BYTES (4 << 20)
+
+/** Rows formatted per thread at a time by the writer, by default */
+#define ASCII_WRITE_ROWS 16384
+
+/**
+ * Write rows as text.
+ * @param fid The open file
+ * @param view rows to write, either layout, NUM_INT of 2, 3 or 4 bytes, float or double
+ * @param timeCol lead each row with its time, from the view's start and sample rate
+ * @return true if successful
+ */
+bool asciiWrite( FILE* fid, const DataView &view, const bool &timeCol = false );
+
+/**
+ * Size up text before parsing it.
+ * @param text the text
+ * @param numBytes bytes of text
+ * @param maxRows most rows it can hold, its lines
+ * @param numFields fields on the first line that isn't blank or a comment
+ * @return false if there are no such lines
+ */
+bool asciiScan( const char* text, const size_t &numBytes, unsigned long long &maxRows, unsigned int &numFields );
+
+/**
+ * Parse text into rows.
+ * @param text the text
+ * @param numBytes bytes of text
+ * @param fmt number format of the samples
+ * @param size element size of the samples in bytes
+ * @param numCols samples per line, not counting the time
+ * @param dst room for asciiScan()'s maxRows rows, interleaved
+ * @param times room for maxRows microseconds since the epoch, NULL if lines have no time
+ * @param numRows rows parsed
+ * @return false if a line is malformed, nothing parsed is kept
+ */
+bool asciiParse( const char* text, const size_t &numBytes, const NumberFormats &fmt, const unsigned int &size,
+                 const unsigned int &numCols, char* dst, int64_t* times, unsigned long long &numRows );
+
+/**
+ * Parse text into columns of doubles, the fields not kept are stepped over
+ * without conversion, and any past numFields ignored.
+ * @param text the text
+ * @param numBytes bytes of text
+ * @param numFields fields wanted from each line
+ * @param keep numFields flags, true for the fields to convert
+ * @param dst a column of room for asciiScan()'s maxRows doubles per field kept
+ * @param numRows rows parsed
+ * @return false if a line is malformed, nothing parsed is kept
+ */
+bool asciiParseColumns( const char* text, const size_t &numBytes, const unsigned int &numFields, const bool* keep,
+                        double* const* dst, unsigned long long &numRows );
+
+/**
+ * Set the number of threads big files are split across.
+ * @param numThreads threads wanted, zero for one per core
+ */
+void setAsciiThreads( const unsigned int &numThreads );
+
+/**
+ * Set the fewest bytes of text worth a parsing thread of their own.
+ * @param numBytes bytes per thread, zero for ASCII_CHUNK_BYTES
+ */
+void setAsciiChunkBytes( const size_t &numBytes );
+
+/**
+ * Set the rows formatted per thread at a time by the writer.
+ * @param numRows rows per batch, zero for ASCII_WRITE_ROWS
+ */
+void setAsciiWriteRows( const unsigned long long &numRows );
+
+/**
+ * Run the regression test for ASCII rows.  Return 0 if good.
+ * @return bool
+ */
+bool testAscii();
+
+#endif // __ASCIIFORMAT_H__
@@ -0,0 +1,362 @@
+#include "DataAllocator.h"
+
+/**
+  * class DataAllocator
+  * Copyright 2016, ShotSpotter
+  */
+
+static inline size_t
+roundUp( const size_t &numBytes )
+{
+  return (numBytes + DATA_ALIGN - 1) & ~size_t(DATA_ALIGN - 1);
+}
+
+DataAllocator*
+DataAllocator::getDefault()
+{
+  static AlignedAllocator dflt;
+  return &dflt;
+}
+
+
+//
+// AlignedAllocator
+//
+
+void*
+AlignedAllocator::allocate( size_t numBytes )
+{
+  void* ptr = NULL;
+  if( posix_memalign( &ptr, DATA_ALIGN, numBytes ? numBytes : 1 ) )
+    return NULL;
+  return ptr;
+}
+
+void*
+AlignedAllocator::reallocate( void* ptr, size_t numBytes )
+{
+  if( !ptr )
+    return allocate( numBytes );
+
+  // realloc() usually grows in place, but only promises malloc() alignment
+  void* moved = realloc( ptr, numBytes ? numBytes : 1 );
+  if( !moved || !((size_t)moved % DATA_ALIGN) )
+    return moved;
+
+  void* aligned = allocate( numBytes );
+  if( !aligned ) // Correct beats aligned
+    return moved;
+  memcpy( aligned, moved, numBytes );
+  free( moved );
+  return aligned;
+}
+
+
+//
+// PoolAllocator
+//
+
+#define POOL_MAGIC 0x6c6f6f5044535044ULL
+#define POOL_NO_CLASS ((uint64_t)-1)
+
+/** Lives in the DATA_ALIGN bytes ahead of each pooled buffer */
+struct PoolTag
+{
+  uint64_t magic;
+  uint64_t cls;
+  uint64_t classBytes;
+};
+
+static inline PoolTag*
+poolTag( void* ptr )
+{
+  return (PoolTag*)((char*)ptr - DATA_ALIGN);
+}
+
+PoolAllocator::PoolAllocator( const size_t &maxPool, const size_t &maxRetain )
+{
+  maxPooled = maxPool;
+  maxRetained = maxRetain;
+  retained = 0;
+  hits = 0;
+  misses = 0;
+  size_t classBytes;
+  freeLists.resize( sizeClass( maxPooled, classBytes ) + 1 );
+}
+
+PoolAllocator::~PoolAllocator()
+{
+  release();
+}
+
+size_t
+PoolAllocator::sizeClass( size_t numBytes, size_t &classBytes )
+{
+  if( numBytes <= DATA_ALIGN ) {
+    classBytes = DATA_ALIGN;
+    return 0;
+  }
+
+  // 2^k < numBytes <= 2^(k+1), split into four steps of 2^(k-2)
+  size_t k = 8 * sizeof(unsigned long long) - 1 - __builtin_clzll( numBytes - 1 );
+  size_t step = size_t(1) << (k - 2);
+  size_t sub = (numBytes - (size_t(1) << k) + step - 1) / step;
+  classBytes = (size_t(1) << k) + sub * step;
+  return 1 + (k - 6) * 4 + (sub - 1);
+}
+
+void*
+PoolAllocator::allocate( size_t numBytes )
+{
+  size_t classBytes;
+  uint64_t cls = POOL_NO_CLASS;
+  if( numBytes <= maxPooled ) {
+    cls = sizeClass( numBytes, classBytes );
+    std::lock_guard<std::mutex> guard( lock );
+    std::vector<void*> &fl = freeLists[cls];
+    if( !fl.empty() ) {
+      void* ptr = fl.back();
+      fl.pop_back();
+      retained -= classBytes;
+      hits++;
+      return ptr;
+    }
+    misses++;
+  } else
+    classBytes = roundUp( numBytes );
+
+  void* base = NULL;
+  if( posix_memalign( &base, DATA_ALIGN, classBytes + DATA_ALIGN ) )
+    return NULL;
+  void* ptr = (char*)base + DATA_ALIGN;
+  PoolTag* tag = poolTag( ptr );
+  tag->magic = POOL_MAGIC;
+  tag->cls = cls;
+  tag->classBytes = classBytes;
+  return ptr;
+}
+
+void*
+PoolAllocator::reallocate( void* ptr, size_t numBytes )
+{
+  if( !ptr )
+    return allocate( numBytes );
+
+  PoolTag* tag = poolTag( ptr );
+  if( numBytes <= tag->classBytes )
+    return ptr;
+
+  void* moved = allocate( numBytes );
+  if( !moved )
+    return NULL;
+  memcpy( moved, ptr, tag->classBytes );
+  deallocate( ptr );
+  return moved;
+}
+
+void
+PoolAllocator::deallocate( void* ptr )
+{
+  if( !ptr )
+    return;
+
+  PoolTag* tag = poolTag( ptr );
+  if( tag->magic != POOL_MAGIC ) {
+    std::cerr << "PoolAllocator::deallocate() of a foreign buffer, leaking it!" << &std::endl;
+    return;
+  }
+
+  if( tag->cls != POOL_NO_CLASS ) {
+    std::lock_guard<std::mutex> guard( lock );
+    if( retained + tag->classBytes <= maxRetained ) {
+      freeLists[tag->cls].push_back( ptr );
+      retained += tag->classBytes;
+      return;
+    }
+  }
+
+  tag->magic = 0;
+  free( tag );
+}
+
+void
+PoolAllocator::release()
+{
+  std::lock_guard<std::mutex> guard( lock );
+  for( size_t cls = 0; cls < freeLists.size(); cls++ ) {
+    for( size_t b = 0; b < freeLists[cls].size(); b++ )
+      free( poolTag( freeLists[cls][b] ) );
+    freeLists[cls].clear();
+  }
+  retained = 0;
+}
+
+bool
+PoolAllocator::testClass()
+{
+  PoolAllocator pool;
+
+  // Class boundaries
+  size_t classBytes;
+  if( pool.sizeClass( 64, classBytes ) != 0 || classBytes != 64 ) return DRATS;
+  if( pool.sizeClass( 65, classBytes ) != 1 || classBytes != 80 ) return DRATS;
+  if( pool.sizeClass( 128, classBytes ) != 4 || classBytes != 128 ) return DRATS;
+  if( pool.sizeClass( 129, classBytes ) != 5 || classBytes != 160 ) return DRATS;
+
+  // Same shape recycles
+  void* a = pool.allocate( 40000 );
+  if( !a || (size_t)a % DATA_ALIGN ) return DRATS;
+  pool.deallocate( a );
+  void* b = pool.allocate( 39000 );
+  if( a != b || pool.getHits() != 1 ) return DRATS;
+
+  // Growth within the class stays put, beyond it keeps contents
+  memset( b, 7, 39000 );
+  if( pool.reallocate( b, 40900 ) != b ) return DRATS;
+  char* c = (char*)pool.reallocate( b, 100000 );
+  if( !c || c[38999] != 7 ) return DRATS;
+  pool.deallocate( c );
+
+  return VOILA;
+}
+
+
+//
+// ArenaAllocator
+//
+
+ArenaAllocator::ArenaAllocator( const size_t &numBytes )
+{
+  slabBytes = roundUp( numBytes );
+  fill = 0;
+  used = 0;
+  last = NULL;
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+  reset();
+}
+
+void*
+ArenaAllocator::allocate( size_t numBytes )
+{
+  size_t need = roundUp( numBytes ) + DATA_ALIGN;
+
+  std::lock_guard<std::mutex> guard( lock );
+  if( slabs.empty() || fill + need > slabSizes.back() ) {
+    size_t newBytes = need > slabBytes ? need : slabBytes;
+    void* slab = NULL;
+    if( posix_memalign( &slab, DATA_ALIGN, newBytes ) )
+      return NULL;
+    slabs.push_back( (char*)slab );
+    slabSizes.push_back( newBytes );
+    fill = 0;
+  }
+
+  // Header holds the size, for reallocate()
+  char* ptr = slabs.back() + fill + DATA_ALIGN;
+  *(size_t*)(ptr - DATA_ALIGN) = numBytes;
+  fill += need;
+  used += need;
+  last = ptr;
+  return ptr;
+}
+
+void*
+ArenaAllocator::reallocate( void* ptr, size_t numBytes )
+{
+  if( !ptr )
+    return allocate( numBytes );
+
+  size_t oldBytes = *(size_t*)((char*)ptr - DATA_ALIGN);
+  {
+    std::lock_guard<std::mutex> guard( lock );
+    if( ptr == last ) {
+      size_t start = (char*)ptr - slabs.back();
+      size_t newFill = start + roundUp( numBytes );
+      if( newFill <= slabSizes.back() ) {
+        used = used - fill + newFill;
+        fill = newFill;
+        *(size_t*)(last - DATA_ALIGN) = numBytes;
+        return ptr;
+      }
+    }
+  }
+
+  void* moved = allocate( numBytes );
+  if( !moved )
+    return NULL;
+  memcpy( moved, ptr, oldBytes < numBytes ? oldBytes : numBytes );
+  return moved;
+}
+
+void
+ArenaAllocator::deallocate( void* ptr )
+{
+  std::lock_guard<std::mutex> guard( lock );
+  if( ptr && ptr == last ) {
+    size_t start = last - DATA_ALIGN - slabs.back();
+    used -= fill - start;
+    fill = start;
+    last = NULL;
+  }
+}
+
+void
+ArenaAllocator::reset()
+{
+  std::lock_guard<std::mutex> guard( lock );
+  for( size_t s = 0; s < slabs.size(); s++ )
+    free( slabs[s] );
+  slabs.clear();
+  slabSizes.clear();
+  fill = 0;
+  used = 0;
+  last = NULL;
+}
+
+bool
+ArenaAllocator::testClass()
+{
+  ArenaAllocator arena( 4096 );
+
+  // Bumped along one slab, each aligned after its header
+  char* a = (char*)arena.allocate( 10 );
+  char* b = (char*)arena.allocate( 100 );
+  if( !a || !b || (size_t)a % DATA_ALIGN || (size_t)b % DATA_ALIGN ) return DRATS;
+  if( b - a != (ptrdiff_t)( roundUp( 10 ) + DATA_ALIGN ) ) return DRATS;
+  if( arena.getBytesUsed() != roundUp( 10 ) + roundUp( 100 ) + 2 * DATA_ALIGN ) return DRATS;
+  for( int i = 0; i < 10; i++ )
+    a[i] = (char)i;
+  memset( b, 7, 100 );
+
+  // The last grows in place, another is copied
+  size_t before = arena.getBytesUsed();
+  if( arena.reallocate( b, 300 ) != b || arena.getBytesUsed() != before + roundUp( 300 ) - roundUp( 100 ) ) return DRATS;
+  if( b[99] != 7 ) return DRATS;
+  memset( b + 100, 8, 200 );
+  char* c = (char*)arena.reallocate( a, 50 );
+  if( !c || c == a || c <= b || (size_t)c % DATA_ALIGN || memcmp( c, a, 10 ) ) return DRATS;
+
+  // Only the last is given back, and handed out again
+  before = arena.getBytesUsed();
+  arena.deallocate( b );
+  if( arena.getBytesUsed() != before ) return DRATS;
+  arena.deallocate( c );
+  if( arena.getBytesUsed() != before - roundUp( 50 ) - DATA_ALIGN || arena.allocate( 20 ) != c ) return DRATS;
+  if( b[299] != 8 ) return DRATS;
+
+  // Bigger than a slab gets its own, past a full slab a new one
+  char* big = (char*)arena.allocate( 10000 );
+  if( !big || (size_t)big % DATA_ALIGN ) return DRATS;
+  memset( big, 1, 10000 );
+  char* d = (char*)arena.allocate( 4000 );
+  if( !d || (size_t)d % DATA_ALIGN || arena.reallocate( d, 8000 ) == d ) return DRATS;
+
+  // All back at once
+  arena.reset();
+  if( arena.getBytesUsed() || !arena.allocate( 10 ) || arena.getBytesUsed() != roundUp( 10 ) + DATA_ALIGN ) return DRATS;
+
+  return VOILA;
+}
@@ -0,0 +1,244 @@
+#ifndef __DATAALLOCATOR_H__
+#define __DATAALLOCATOR_H__
+
+/**
+  * class DataAllocator
+  * Copyright 2016, ShotSpotter
+  */
+
+#include "libCore/libCore.h"
+
+#include <mutex>
+
+/** Alignment of every sample buffer, one cache line, enough for any SIMD load */
+#define DATA_ALIGN 64
+
+/**
+  * class DataAllocator
+  * Source of DataCommon sample buffers.  Every buffer handed out is
+  * DATA_ALIGN aligned.  The default is AlignedAllocator, whose buffers may
+  * also be released with free(), so code that setData()s a malloc()'d buffer
+  * keeps working.  Pools and arenas are for jobs that churn through many
+  * same-shaped objects; set them with DataCommon::setAllocator() before the
+  * buffer is created.  Implementations must be thread safe.
+  */
+class DataAllocator
+{
+public:
+
+  /**
+   * Empty Destructor
+   */
+  virtual ~DataAllocator() {}
+
+  /**
+   * @return an aligned buffer of at least numBytes, NULL on failure
+   * @param numBytes size wanted
+   */
+  virtual void* allocate( size_t numBytes ) = 0;
+
+  /**
+   * Like realloc(), contents are kept up to the smaller size, and on failure
+   * NULL is returned and ptr is untouched.
+   * @return the resized buffer, possibly ptr itself
+   * @param ptr buffer from this allocator, or NULL
+   * @param numBytes size wanted
+   */
+  virtual void* reallocate( void* ptr, size_t numBytes ) = 0;
+
+  /**
+   * Return a buffer.
+   * @param ptr buffer from this allocator, or NULL
+   */
+  virtual void deallocate( void* ptr ) = 0;
+
+  /**
+   * The process wide AlignedAllocator.
+   * @return the default allocator
+   */
+  static DataAllocator* getDefault();
+
+};
+
+
+/**
+  * class AlignedAllocator
+  * posix_memalign() backed, stateless.
+  */
+class AlignedAllocator : public DataAllocator
+{
+public:
+
+  void* allocate( size_t numBytes );
+
+  void* reallocate( void* ptr, size_t numBytes );
+
+  void deallocate( void* ptr ) { free( ptr ); }
+
+};
+
+
+/**
+  * class PoolAllocator
+  * Size class pool.  Requests are rounded up to one of four classes per
+  * power of two, and returned buffers are kept on per-class free lists for
+  * the next request of that class, so objects of the same shape recycle
+  * each other's buffers.  A DATA_ALIGN header in front of each buffer
+  * records its class.  Requests above maxPooled bytes, and returns beyond
+  * maxRetained cached bytes, go straight to the system.
+  */
+class PoolAllocator : public DataAllocator
+{
+public:
+
+  /**
+   * Constructor
+   * @param maxPooled Largest request served from the pool, in bytes
+   * @param maxRetained Most bytes kept on the free lists
+   */
+  PoolAllocator( const size_t &maxPooled = 64 << 20, const size_t &maxRetained = 256 << 20 );
+
+  /**
+   * Destructor, frees the free lists.  Buffers still out must not outlive it.
+   */
+  ~PoolAllocator();
+
+  void* allocate( size_t numBytes );
+
+  void* reallocate( void* ptr, size_t numBytes );
+
+  void deallocate( void* ptr );
+
+  /**
+   * Free every cached buffer.
+   */
+  void release();
+
+  /**
+   * @return bytes sitting on the free lists
+   */
+  size_t getRetainedBytes() const { return retained; }
+
+  /**
+   * @return number of allocations served from the free lists
+   */
+  unsigned long long getHits() const { return hits; }
+
+  /**
+   * @return number of allocations that went to the system
+   */
+  unsigned long long getMisses() const { return misses; }
+
+  /**
+   * Run the regression test for this class.  Return 0 if good.
+   * @return bool
+   */
+  static bool testClass();
+
+protected:
+
+  /** Largest pooled request */
+  size_t maxPooled;
+
+  /** Cap on free list bytes */
+  size_t maxRetained;
+
+  /** Free list bytes */
+  size_t retained;
+
+  /** Served from free lists */
+  unsigned long long hits;
+
+  /** Served by the system */
+  unsigned long long misses;
+
+  /** One free list per size class */
+  std::vector< std::vector<void*> > freeLists;
+
+  std::mutex lock;
+
+  /**
+   * Size class of a request.
+   * @param numBytes request size
+   * @param classBytes size of the class
+   * @return class index
+   */
+  static size_t sizeClass( size_t numBytes, size_t &classBytes );
+
+};
+
+
+/**
+  * class ArenaAllocator
+  * Per-job bump allocator.  Buffers are carved out of large slabs and
+  * deallocate() is free, reset() then returns everything at once.  Every
+  * object using the arena must be cleared or destroyed before reset().
+  */
+class ArenaAllocator : public DataAllocator
+{
+public:
+
+  /**
+   * Constructor
+   * @param slabBytes Size of each slab, larger requests get their own
+   */
+  ArenaAllocator( const size_t &slabBytes = 16 << 20 );
+
+  /**
+   * Destructor, frees all slabs.
+   */
+  ~ArenaAllocator();
+
+  void* allocate( size_t numBytes );
+
+  /**
+   * The most recent buffer grows in place while its slab has room.
+   */
+  void* reallocate( void* ptr, size_t numBytes );
+
+  /**
+   * Only the most recent buffer is actually given back.
+   */
+  void deallocate( void* ptr );
+
+  /**
+   * Free every buffer handed out.
+   */
+  void reset();
+
+  /**
+   * @return bytes handed out since the last reset()
+   */
+  size_t getBytesUsed() const { return used; }
+
+  /**
+   * Run the regression test for this class.  Return 0 if good.
+   * @return bool
+   */
+  static bool testClass();
+
+protected:
+
+  /** Slab size */
+  size_t slabBytes;
+
+  /** All slabs, the last one is current */
+  std::vector<char*> slabs;
+
+  /** Size of each slab */
+  std::vector<size_t> slabSizes;
+
+  /** Fill of the current slab */
+  size_t fill;
+
+  /** Bytes handed out */
+  size_t used;
+
+  /** The most recent buffer */
+  char* last;
+
+  std::mutex lock;
+
+};
+
+#endif // __DATAALLOCATOR_H__
@@ -0,0 +1,279 @@
+#include "DataChunkReader.h"
+#include "TimeData.h"
+#include "DiscData.h"
+#include "EventData.h"
+
+/**
+  * class DataChunkReader
+  * Copyright 2016, ShotSpotter
+  */
+
+// Constructors/Destructors
+//  
+
+DataChunkReader::DataChunkReader( DataCommon &proxyObj, const size_t &numRows ) : proxy( proxyObj )
+{
+  fid = NULL;
+  buffer = NULL;
+  bufferBytes = 0;
+  chunkRows = numRows ? numRows : DEFAULT_CHUNK_ROWS;
+  rowsRead = 0;
+  rowLimit = 0;
+}
+
+DataChunkReader::~DataChunkReader()
+{
+  close();
+  if( buffer )
+    DataAllocator::getDefault()->deallocate( buffer );
+}
+
+//  
+// Methods
+//  
+
+bool
+DataChunkReader::open( const char* fileName )
+{
+  close();
+
+  fid = fopen( fileName, "r" );
+  if( !fid ) {
+    std::cerr << "File: " << fileName << " was not opened!" << &std::endl;
+    return false;
+  }
+
+  // Only a header's count bounds the rows, not one the proxy was left with
+  unsigned long long heldRows = proxy.getRows();
+  proxy.setRows( 0 );
+  if( !proxy.readHeader( fid ) ) {
+    std::cerr << "DataChunkReader::open() could not read header of: " << fileName << &std::endl;
+    proxy.setRows( heldRows );
+    close();
+    return false;
+  }
+  rowLimit = proxy.getRows();
+  if( !rowLimit )
+    proxy.setRows( heldRows );
+
+  size_t numBytes = proxy.getRowSize() * chunkRows;
+  if( !numBytes ) {
+    std::cerr << "DataChunkReader::open() proxy has empty rows!" << &std::endl;
+    close();
+    return false;
+  }
+
+  if( numBytes > bufferBytes ) {
+    char* tmpr = (char*)DataAllocator::getDefault()->reallocate( buffer, numBytes );
+    if( !tmpr ) {
+      std::cerr << "DataChunkReader::open() could not allocate " << numBytes << " bytes!" << &std::endl;
+      close();
+      return false;
+    }
+    buffer = tmpr;
+    bufferBytes = numBytes;
+  }
+
+  posix_fadvise( fileno(fid), 0, 0, POSIX_FADV_SEQUENTIAL );
+  rowsRead = 0;
+
+  return true;
+}
+
+bool
+DataChunkReader::next( DataChunk &chunk )
+{
+  chunk.rows = 0;
+  if( !fid ) 
+    return false;
+  if( proxy.getCodec() != NATIVE_CODEC_RAW )
+    return nextBlock( chunk );
+
+  size_t rowBytes = proxy.getRowSize();
+  size_t wantRows = chunkRows;
+  if( rowLimit ) {
+    if( rowsRead >= rowLimit ) 
+      return false;
+    if( rowLimit - rowsRead < wantRows )
+      wantRows = rowLimit - rowsRead;
+  }
+  size_t numRows = fread( buffer, rowBytes, wantRows, fid );
+  if( !numRows ) {
+    if( ferror(fid) )
+      std::cerr << "DataChunkReader::next() read failed after " << rowsRead << " rows!" << &std::endl;
+    return false;
+  }
+
+  chunk.data = buffer;
+  chunk.rows = numRows;
+  chunk.firstRow = rowsRead;
+  proxy.getRowTime( buffer, rowsRead, chunk.start );
+
+  rowsRead += numRows;
+
+  return true;
+}
+
+bool
+DataChunkReader::nextBlock( DataChunk &chunk )
+{
+  // Coded files are native, so the header gave the rows
+  if( rowsRead >= rowLimit )
+    return false;
+
+  DeltaBlockHeader bh;
+  if( fread( &bh, sizeof(DeltaBlockHeader), 1, fid ) != 1 ) {
+    std::cerr << "DataChunkReader::next() block read failed after " << rowsRead << " rows!" << &std::endl;
+    return false;
+  }
+  if( bh.rows > rowLimit - rowsRead || bh.bytes > deltaEncodeBound( bh.rows, proxy.getCols() ) ) {
+    std::cerr << "DataChunkReader::next() block after " << rowsRead << " rows is malformed!" << &std::endl;
+    return false;
+  }
+  coded.resize( sizeof(DeltaBlockHeader) + bh.bytes );
+  memcpy( &coded[0], &bh, sizeof(DeltaBlockHeader) );
+  if( bh.bytes && fread( &coded[sizeof(DeltaBlockHeader)], bh.bytes, 1, fid ) != 1 ) {
+    std::cerr << "DataChunkReader::next() block read failed after " << rowsRead << " rows!" << &std::endl;
+    return false;
+  }
+
+  size_t numBytes = bh.rows * proxy.getRowSize();
+  if( numBytes > bufferBytes ) {
+    char* tmpr = (char*)DataAllocator::getDefault()->reallocate( buffer, numBytes );
+    if( !tmpr ) {
+      std::cerr << "DataChunkReader::next() could not allocate " << numBytes << " bytes!" << &std::endl;
+      return false;
+    }
+    buffer = tmpr;
+    bufferBytes = numBytes;
+  }
+
+  unsigned long long numRows = 0;
+  if( !deltaDecode( &coded[0], coded.size(), proxy.getCols(), proxy.getEltSize(), buffer, numRows ) || !numRows )
+    return false;
+
+  chunk.data = buffer;
+  chunk.rows = numRows;
+  chunk.firstRow = rowsRead;
+  proxy.getRowTime( buffer, rowsRead, chunk.start );
+
+  rowsRead += numRows;
+
+  return true;
+}
+
+void
+DataChunkReader::close()
+{
+  if( fid )
+    fclose( fid );
+  fid = NULL;
+}
+
+/** Stream fileName 300 rows at a time, datenum first, and match rows */
+static bool
+streamsRows( DataCommon &proxy, const char* fileName, const std::vector<double> &rows )
+{
+  unsigned long long numRows = rows.size() / 3;
+  DataChunkReader rdr( proxy, 300 );
+  bool ok = rdr.open( fileName );
+  DataChunk chunk;
+  unsigned long long seen = 0;
+  while( ok && rdr.next( chunk ) ) {
+    TimeObj want;
+    want.setDatenum( rows[seen * 3] );
+    ok = chunk.firstRow == seen && chunk.start == want && chunk.rows == std::min( 300ULL, numRows - seen ) &&
+         !memcmp( chunk.data, &rows[seen * 3], chunk.rows * 3 * sizeof(double) );
+    seen += chunk.rows;
+  }
+  return ok && seen == numRows && rdr.getRowsRead() == numRows && !rdr.next( chunk );
+}
+
+/** Rows timed by their datenum, DiscData's binary rows and EventData's native ones */
+static bool
+testDatenumRows()
+{
+  // Datenum, duration and tag, in chunks that don't divide the rows
+  const unsigned long long numRows = 1000;
+  std::vector<double> rows( numRows * 3 );
+  for( unsigned long long r = 0; r < numRows; r++ ) {
+    rows[r * 3] = 734000.0 + r / 1440.0;
+    rows[r * 3 + 1] = 0.5 / 86400.0;
+    rows[r * 3 + 2] = (double)r;
+  }
+
+  char fileName[] = "/tmp/DataChunkReaderXXXXXX";
+  int fd = mkstemp( fileName );
+  if( fd < 0 ) return DRATS;
+  ::close( fd );
+
+  // A labels file, written out as binary rows
+  FILE* fid = fopen( fileName, "w" );
+  bool ok = fid && fputs( "LABELS = time\tdur\ttag\n", fid ) >= 0;
+  for( unsigned long long r = 0; ok && r < numRows; r++ )
+    ok = fprintf( fid, "%.17g\t%.17g\t%.17g\n", rows[r * 3], rows[r * 3 + 1], rows[r * 3 + 2] ) > 0;
+  if( fid )
+    fclose( fid );
+  DiscData dd, discProxy;
+  ok = ok && !dd.read( fileName, FORMAT_LABELS ) && dd.getRows() == numRows && !dd.writeBinaryFile( fileName ) &&
+       streamsRows( discProxy, fileName, rows ) && discProxy.getCols() == 3;
+
+  // Events in a native file
+  EventData ev( 19990101, 19990102 ), eventProxy( 19990101, 19990102 );
+  ev.setCols( 3 );
+  eventProxy.setCols( 3 );
+  ok = ok && ev.materialize( DataView( (const char*)&rows[0], numRows, 3, sizeof(double), NUM_DBL, TimeObj() ) ) &&
+       ev.writeFile( fileName ) && streamsRows( eventProxy, fileName, rows );
+
+  unlink( fileName );
+  return ok ? VOILA : DRATS;
+}
+
+bool
+DataChunkReader::testClass()
+{
+  // Two channels of ints at 100 Hz, a little over two native blocks
+  const unsigned long long numRows = 2 * DEFAULT_NATIVE_BLOCK_ROWS + 1000;
+  std::vector<int32_t> samps( numRows * 2 );
+  for( size_t i = 0; i < samps.size(); i++ )
+    samps[i] = (int32_t)( i % 1000 ) - 500;
+  TimeObj t0( (time_t)1300000000, 0 );
+  TimeData td;
+  if( !td.materialize( DataView( (const char*)&samps[0], numRows, 2, sizeof(int32_t), NUM_INT, t0, 100.0 ) ) ) return DRATS;
+
+  char fileName[] = "/tmp/DataChunkReaderXXXXXX";
+  int fd = mkstemp( fileName );
+  if( fd < 0 ) return DRATS;
+  ::close( fd );
+
+  bool ok = true;
+  for( int pass = 0; ok && pass < 3; pass++ ) {
+    // Bare rows, then raw and delta coded native files
+    td.setCodec( pass == 2 ? NATIVE_CODEC_DELTA : NATIVE_CODEC_RAW );
+    ok = td.writeFile( fileName, pass ? FORMAT_NATIVE : FORMAT_BINARY );
+
+    // Rows left in the proxy don't cut a bare file short
+    TimeData proxy( t0 );
+    proxy.setCols( 2 );
+    proxy.setSampleRate( 100.0 );
+    proxy.setRows( 10 );
+    DataChunkReader rdr( proxy, 30000 );
+    ok = ok && rdr.open( fileName );
+
+    // Coded chunks are the blocks, others chunkRows, short only at the end
+    unsigned long long wantChunk = pass == 2 ? DEFAULT_NATIVE_BLOCK_ROWS : 30000;
+    DataChunk chunk;
+    unsigned long long seen = 0;
+    while( ok && rdr.next( chunk ) ) {
+      ok = chunk.firstRow == seen && chunk.start == t0 + TimeObj( seen / 100.0 ) &&
+           chunk.rows == std::min( wantChunk, numRows - seen ) &&
+           !memcmp( chunk.data, &samps[seen * 2], chunk.rows * 2 * sizeof(int32_t) );
+      seen += chunk.rows;
+    }
+    ok = ok && seen == numRows && rdr.getRowsRead() == numRows && !rdr.next( chunk ) && !chunk.rows;
+  }
+
+  unlink( fileName );
+  if( !ok ) return DRATS;
+  return testDatenumRows();
+}
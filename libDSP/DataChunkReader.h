@@ -0,0 +1,142 @@
+#ifndef __DATACHUNKREADER_H__
+#define __DATACHUNKREADER_H__
+
+/**
+  * class DataChunkReader
+  * Copyright 2016, ShotSpotter
+  */
+
+#include "DataCommon.h"
+
+#define DEFAULT_CHUNK_ROWS 65536
+
+/**
+  * struct DataChunk
+  * One block of rows handed out by DataChunkReader.  The rows live in the
+  * reader's buffer and are overwritten by the next call to next().
+  */
+struct DataChunk
+{
+  /** The rows of this chunk, row major, owned by the reader */
+  char* data;
+
+  /** Number of rows in this chunk, short only at end of file */
+  unsigned long long rows;
+
+  /** Index of the first row of this chunk within the file */
+  unsigned long long firstRow;
+
+  /** Time of the first row of this chunk */
+  TimeObj start;
+};
+
+
+/**
+  * class DataChunkReader
+  * Streams a file through a fixed size buffer, so a scan of any length uses
+  * constant memory.  The proxy object supplies the row shape (size, cols) and
+  * the row times, via DataCommon::readHeader() and DataCommon::getRowTime(),
+  * but is never loaded.  Coded native files are decoded a block at a time,
+  * so their chunks are the file's blocks, whatever chunkRows is.
+  *
+  *   TimeData proxy( startUTC );
+  *   DataChunkReader rdr( proxy );
+  *   DataChunk chunk;
+  *   if( rdr.open( fileName ) )
+  *     while( rdr.next( chunk ) )
+  *       crunch( chunk.data, chunk.rows, chunk.start );
+  */
+class DataChunkReader
+{
+public:
+
+  /**
+   * Constructor
+   * @param proxy Unloaded object describing the file's rows.
+   * @param chunkRows Number of rows per chunk.
+   */
+  DataChunkReader( DataCommon &proxy, const size_t &chunkRows = DEFAULT_CHUNK_ROWS );
+
+  /**
+   * Destructor, closes the file and frees the buffer.
+   */
+  virtual ~DataChunkReader();
+
+  /**
+   * Open a file and read its header, if any, into the proxy.  A header that
+   * sets the proxy's rows, as native files do, bounds the rows read; bare
+   * rows are read to the end of file, whatever rows the proxy held.
+   * @param fileName Name of file to stream.
+   * @return true if the file is ready to read.
+   */
+  bool open( const char* fileName );
+
+  /**
+   * Read the next chunk into the reusable buffer.
+   * @param chunk Filled in with the new rows.
+   * @return true if any rows were read, false at end of file or on error.
+   */
+  bool next( DataChunk &chunk );
+
+  /**
+   * Close the file.  The buffer is kept for the next open().
+   */
+  void close();
+
+  /**
+   * @return true if a file is open.
+   */
+  bool isOpen() const { return fid != NULL; }
+
+  /**
+   * @return the number of rows per chunk.
+   */
+  size_t getChunkRows() const { return chunkRows; }
+
+  /**
+   * @return the number of rows read since open().
+   */
+  unsigned long long getRowsRead() const { return rowsRead; }
+
+  /**
+   * Run the regression test for this class.  Return 0 if good.
+   * @return bool
+   */
+  static bool testClass();
+
+protected:
+
+  /** Describes the rows, and receives the header */
+  DataCommon &proxy;
+
+  /** The open file */
+  FILE* fid;
+
+  /** Reusable chunk buffer */
+  char* buffer;
+
+  /** Size of buffer in bytes */
+  size_t bufferBytes;
+
+  /** Rows per chunk */
+  size_t chunkRows;
+
+  /** Rows handed out so far */
+  unsigned long long rowsRead;
+
+  /** Rows in the file as given by its header, zero if unknown */
+  unsigned long long rowLimit;
+
+  /** The block being decoded, for coded files */
+  std::vector<char> coded;
+
+  /**
+   * Read and decode the next block of a coded file.
+   * @param chunk Filled in with the new rows.
+   * @return true if any rows were read, false at end of file or on error.
+   */
+  bool nextBlock( DataChunk &chunk );
+
+};
+
+#endif // __DATACHUNKREADER_H__
@@ -1,4 +1,5 @@
 #include "DataCommon.h"
+#include "Transpose.h"
 
 /**
   * class DataCommon
@@ -23,19 +24,31 @@ DataCommon::DataCommon( const TimeObj &startUTC )
 
 DataCommon::DataCommon( const DataCommon &src, const bool &skipData )
 {
+  initAttributes();
+  type        = src.type;
+  alloc       = src.alloc;
+  interleaved = src.interleaved;
   utc         = src.utc;
   timeOffset  = src.timeOffset;
   timeEnd     = src.timeEnd;
   cols        = src.cols;
   size        = src.size;
+  numFmt      = src.numFmt;
+  codec       = src.codec;
   meta        = src.meta;
 }
 
+DataCommon::DataCommon( DataCommon &&src ) noexcept
+{
+  initAttributes();
+  swapCommon( src );
+}
+
 DataCommon::~DataCommon() 
 {
   if( data != NULL ) {
    	//std::cout << "Deleting non-NULL DataCommon object!" << &endl;
-   	free( data );
+   	freeData();
   } 
 }
 
@@ -57,12 +70,9 @@ DataCommon::pedigreeCheck( const DataCommon& she ) const
 bool
 DataCommon::dataDiff( const DataCommon& she ) const 
 {  
-  size_t bytes = size * rows * cols;
-  int result = memcmp( data, she.data, bytes );
-  if( result )
-    return true;
-  else
-    return false;
+  // Sample by sample, so the layouts needn't match
+  DiffReport report;
+  return dataDiff( she, exactTolerance(), report );
 }
  
 
@@ -88,6 +98,37 @@ DataCommon::diff( const DataCommon& she ) const
 }
 
 
+bool
+DataCommon::dataDiff( const DataCommon& she, const DiffTolerance &tol, DiffReport &report ) const
+{
+  report = DiffReport();
+  if( size != she.size || numFmt != she.numFmt || cols != she.cols || rows != she.rows ) {
+    std::cerr << "DataCommon::dataDiff() sizes, formats or shapes differ!" << &std::endl;
+    return true;
+  }
+
+  // Row by row, whatever the layouts
+  std::vector<char> mine, hers;
+  const char* a = rows ? fileRows( 0, rows, mine ) : NULL;
+  const char* b = rows ? she.fileRows( 0, rows, hers ) : NULL;
+  if( !diffSamples( a, b, numFmt, size, rows * cols, tol, report ) )
+    return true;
+  return report.mismatches != 0;
+}
+
+
+bool
+DataCommon::diff( const DataCommon& she, const DiffTolerance &tol, DiffReport &report ) const
+{
+  if( pedigreeCheck( she ) == false ) {
+    report = DiffReport();
+    return true;
+  }
+
+  return dataDiff( she, tol, report );
+}
+
+
 
 void
 DataCommon::initAttributes() 
@@ -97,13 +138,47 @@ DataCommon::initAttributes()
   // network, staNum, chNum all empty.
   //fprintf(stderr,"DC const\n");
   data = NULL;
+  mapped = false;
+  mapSkip = 0;
+  dataBytes = 0;
+  share = NULL;
+  alloc = DataAllocator::getDefault();
   size = 4; // Default
+  numFmt = NUM_INT;
+  codec = NATIVE_CODEC_RAW;
   cols = 1;
   rows = 0;
   interleaved = true;
   // valueType, valueUnit, axisLabel all empty.
 }
 
+void
+DataCommon::swapCommon( DataCommon &other ) noexcept
+{
+  std::swap( type, other.type );
+  std::swap( utc, other.utc );
+  std::swap( timeOffset, other.timeOffset );
+  std::swap( timeEnd, other.timeEnd );
+  std::swap( data, other.data );
+  std::swap( mapped, other.mapped );
+  std::swap( mapSkip, other.mapSkip );
+  std::swap( dataBytes, other.dataBytes );
+  std::swap( alloc, other.alloc );
+  DataShare* sh = share.load( std::memory_order_relaxed );
+  share.store( other.share.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+  other.share.store( sh, std::memory_order_relaxed );
+  std::swap( interleaved, other.interleaved );
+  std::swap( size, other.size );
+  std::swap( numFmt, other.numFmt );
+  std::swap( codec, other.codec );
+  std::swap( cols, other.cols );
+  std::swap( rows, other.rows );
+  meta.swap( other.meta );
+ #ifdef KEEP_HISTORY
+  history.swap( other.history );
+ #endif // KEEP_HISTORY
+}
+
 void
 DataCommon::display( std::ostream &outr ) const
 {
@@ -130,7 +205,12 @@ DataCommon::reset()
 {
   clear();
 
+  // What the object is, and where its buffers come from, outlive the reset
+  DataAllocator* keep = alloc;
+  ObjTypes keepType = type;
   initAttributes();
+  alloc = keep;
+  type = keepType;
 
   utc = TimeObj(0.0);
   timeOffset = TimeObj(0.0);
@@ -152,9 +232,9 @@ DataCommon::setMetaItem( const size_t idx, const std::string &meta_item )
     std::cerr << idx << " seems like a LOT of meta data items, are you sure?" << &std::endl;
 
   size_t numItems = meta.size();
-  if( idx > numItems ) {
+  if( idx >= numItems ) {
     std::cerr << "Re-sizing meta data to add you string." << &std::endl;
-    meta.resize(idx);
+    meta.resize(idx+1);
   }
   meta[idx] = meta_item;
 }
@@ -163,7 +243,7 @@ bool
 DataCommon::getMetaItem( const size_t idx, std::string &meta_item ) const 
 { 
   size_t numItems = meta.size();
-  if( idx > numItems ) {
+  if( idx >= numItems ) {
     std::cerr << idx << ": your specified index is out of range." << std::endl;
     return false;
   }
@@ -174,28 +254,869 @@ DataCommon::getMetaItem( const size_t idx, std::string &meta_item ) const
 
 
 bool 
-DataCommon::write( FILE* fid ) const { return false; }
+DataCommon::write( FILE* fid, const int &format ) const 
+{
+  switch( format ) {
+    case FORMAT_NATIVE :
+      return writeNative( fid );
+    case FORMAT_BINARY : {
+      std::vector<char> scratch;
+      for( unsigned long long beg = 0; beg < rows; beg += DEFAULT_NATIVE_BLOCK_ROWS ) {
+        unsigned long long num = rows - beg < DEFAULT_NATIVE_BLOCK_ROWS ? rows - beg : DEFAULT_NATIVE_BLOCK_ROWS;
+        if( fwrite( fileRows( beg, num, scratch ), getRowSize(), num, fid ) != num ) {
+          std::cerr << "DataCommon::write() short write of rows!" << &std::endl;
+          return false;
+        }
+      }
+      return true;
+    }
+    default :
+      std::cerr << "DataCommon::write() format " << format << " not supported!" << &std::endl;
+      return false;
+  }
+}
+
+
+bool
+DataCommon::writeFile( const char* fileName, const int &format ) const
+{
+  FILE* fid = fopen( fileName, "w" );
+  if( !fid ) {
+    std::cerr << "File: " << fileName << " was not opened for write!" << &std::endl;
+    return false;
+  }
+
+  bool status = write( fid, format );
+  if( fclose( fid ) ) {
+    std::cerr << "File: " << fileName << " close failed!" << &std::endl;
+    status = false;
+  }
+  return status;
+}
+
+
+void
+DataCommon::fillNativeHeader( NativeHeader &hdr ) const
+{
+  time_t sec; long usec;
+
+  hdr.objType = type;
+  utc.get( sec, usec );
+  hdr.utcSec = sec;
+  hdr.utcUsec = usec;
+  timeOffset.get( sec, usec );
+  hdr.offsetSec = sec;
+  hdr.offsetUsec = usec;
+  hdr.size = size;
+  hdr.numFmt = numFmt;
+  hdr.cols = cols;
+  hdr.rows = rows;
+  hdr.flags = NATIVE_FLAG_INTERLEAVED; // Planar data is interleaved on the way out
+  hdr.codec = codec;
+}
+
+
+bool
+DataCommon::useNativeHeader( const NativeHeader &hdr )
+{
+  utc.set( hdr.utcSec, hdr.utcUsec );
+  timeOffset.set( hdr.offsetSec, hdr.offsetUsec );
+  size = hdr.size;
+  numFmt = (NumberFormats)hdr.numFmt;
+  cols = hdr.cols;
+  rows = hdr.rows;
+  if( !(hdr.flags & NATIVE_FLAG_INTERLEAVED) ) {
+    std::cerr << "DataCommon::useNativeHeader() planar files are not supported!" << &std::endl;
+    return false;
+  }
+  interleaved = true;
+  codec = (NativeCodecs)hdr.codec;
+  if( codec == NATIVE_CODEC_DELTA && !deltaCodable( numFmt, size ) ) {
+    std::cerr << "DataCommon::useNativeHeader() samples can't be delta coded!" << &std::endl;
+    return false;
+  }
+  return true;
+}
+
+
+bool
+DataCommon::writeNative( FILE* fid ) const
+{
+  NativeHeader hdr;
+  nativeHeaderInit( hdr );
+  fillNativeHeader( hdr );
+  hdr.blockRows = DEFAULT_NATIVE_BLOCK_ROWS;
+  hdr.numBlocks = (rows + hdr.blockRows - 1) / hdr.blockRows;
+  if( hdr.codec == NATIVE_CODEC_DELTA && !deltaCodable( numFmt, size ) ) {
+    std::cerr << "DataCommon::writeNative() samples can't be delta coded, writing them raw." << &std::endl;
+    hdr.codec = NATIVE_CODEC_RAW;
+  }
+
+  off_t base = ftello( fid );
+  if( base < 0 ) {
+    std::cerr << "DataCommon::writeNative() needs a seekable file!" << &std::endl;
+    return false;
+  }
+
+  // Placeholder, patched once the offsets are known
+  if( fwrite( &hdr, sizeof(NativeHeader), 1, fid ) != 1 ) {
+    std::cerr << "DataCommon::writeNative() header write failed!" << &std::endl;
+    return false;
+  }
+
+  std::vector<NativeBlockEntry> index( hdr.numBlocks );
+  std::vector<char> scratch, coded;
+  if( hdr.codec == NATIVE_CODEC_DELTA )
+    coded.resize( deltaEncodeBound( hdr.blockRows, cols ) );
+  size_t rowBytes = getRowSize();
+  for( uint64_t blk = 0; blk < hdr.numBlocks; blk++ ) {
+    uint64_t firstRow = blk * hdr.blockRows;
+    uint64_t numRows = rows - firstRow < hdr.blockRows ? rows - firstRow : hdr.blockRows;
+    const char* row = fileRows( firstRow, numRows, scratch );
+    TimeObj tt;
+    getRowTime( row, firstRow, tt );
+
+    index[blk].startUsec = nativeTimeKey( tt );
+    index[blk].firstRow = firstRow;
+    index[blk].offset = ftello( fid ) - base;
+    index[blk].bytes = numRows * rowBytes;
+    if( hdr.codec == NATIVE_CODEC_DELTA ) {
+      index[blk].bytes = deltaEncode( row, numRows, cols, size, &coded[0] );
+      row = &coded[0];
+      if( !index[blk].bytes ) 
+        return false;
+    }
+    if( fwrite( row, index[blk].bytes, 1, fid ) != 1 ) {
+      std::cerr << "DataCommon::writeNative() block write failed!" << &std::endl;
+      return false;
+    }
+  }
+
+  // Pad out the last block
+  static const char pad[NATIVE_ALIGN] = { 0 };
+  size_t tail = (ftello( fid ) - base) % NATIVE_ALIGN;
+  if( tail && fwrite( pad, NATIVE_ALIGN - tail, 1, fid ) != 1 ) {
+    std::cerr << "DataCommon::writeNative() pad write failed!" << &std::endl;
+    return false;
+  }
+
+  hdr.metaOffset = ftello( fid ) - base;
+  uint32_t numMeta = meta.size();
+  bool ok = fwrite( &numMeta, sizeof(uint32_t), 1, fid ) == 1;
+  for( size_t m = 0; ok && m < meta.size(); m++ ) {
+    uint32_t len = meta[m].length();
+    ok = fwrite( &len, sizeof(uint32_t), 1, fid ) == 1 &&
+         ( !len || fwrite( meta[m].data(), len, 1, fid ) == 1 );
+  }
+
+  hdr.indexOffset = ftello( fid ) - base;
+  if( ok && hdr.numBlocks )
+    ok = fwrite( &index[0], sizeof(NativeBlockEntry), hdr.numBlocks, fid ) == hdr.numBlocks;
+  if( !ok ) {
+    std::cerr << "DataCommon::writeNative() meta or index write failed!" << &std::endl;
+    return false;
+  }
+
+  off_t end = ftello( fid );
+  if( fseeko( fid, base, SEEK_SET ) ||
+      fwrite( &hdr, sizeof(NativeHeader), 1, fid ) != 1 ||
+      fseeko( fid, end, SEEK_SET ) ) {
+    std::cerr << "DataCommon::writeNative() header patch failed!" << &std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+NativeBlockEntry*
+DataCommon::readNativeIndex( FILE* fid, NativeHeader &hdr )
+{
+  // Offsets on disk are from the header, make them absolute
+  off_t base = ftello( fid );
+  if( base < 0 || fread( &hdr, sizeof(NativeHeader), 1, fid ) != 1 ) {
+    std::cerr << "Could not read native header!" << &std::endl;
+    return NULL;
+  }
+  if( !nativeHeaderCheck( hdr ) || !useNativeHeader( hdr ) )
+    return NULL;
+  hdr.metaOffset += base;
+  hdr.indexOffset += base;
+
+  if( fseeko( fid, hdr.metaOffset, SEEK_SET ) ) {
+    std::cerr << "Could not seek to native meta strings!" << &std::endl;
+    return NULL;
+  }
+  uint32_t numMeta = 0;
+  if( fread( &numMeta, sizeof(uint32_t), 1, fid ) != 1 ) {
+    std::cerr << "Could not read native meta strings!" << &std::endl;
+    return NULL;
+  }
+  meta.resize( numMeta );
+  for( uint32_t m = 0; m < numMeta; m++ ) {
+    uint32_t len = 0;
+    if( fread( &len, sizeof(uint32_t), 1, fid ) != 1 ) {
+      std::cerr << "Could not read native meta strings!" << &std::endl;
+      return NULL;
+    }
+    meta[m].resize( len );
+    if( len && fread( &meta[m][0], len, 1, fid ) != 1 ) {
+      std::cerr << "Could not read native meta strings!" << &std::endl;
+      return NULL;
+    }
+  }
+
+  NativeBlockEntry* index = (NativeBlockEntry*)malloc( (hdr.numBlocks ? hdr.numBlocks : 1) * sizeof(NativeBlockEntry) );
+  if( !index ) {
+    std::cerr << "Could not allocate native block index!" << &std::endl;
+    return NULL;
+  }
+  if( hdr.numBlocks && 
+      ( fseeko( fid, hdr.indexOffset, SEEK_SET ) ||
+        fread( index, sizeof(NativeBlockEntry), hdr.numBlocks, fid ) != hdr.numBlocks ) ) {
+    std::cerr << "Could not read native block index!" << &std::endl;
+    free( index );
+    return NULL;
+  }
+  for( uint64_t blk = 0; blk < hdr.numBlocks; blk++ )
+    index[blk].offset += base;
+
+  return index;
+}
+
+
+bool
+DataCommon::readNativeBlocks( FILE* fid, const NativeHeader &hdr, const NativeBlockEntry* index, 
+                              const uint64_t &begBlk, const uint64_t &finBlk, char* dst ) const
+{
+  std::vector<char> coded;
+  for( uint64_t blk = begBlk; blk <= finBlk; blk++ ) {
+    char* into = dst;
+    if( hdr.codec != NATIVE_CODEC_RAW ) {
+      coded.resize( index[blk].bytes );
+      into = &coded[0];
+    }
+    if( !index[blk].bytes ||
+        fseeko( fid, index[blk].offset, SEEK_SET ) ||
+        fread( into, index[blk].bytes, 1, fid ) != 1 ) {
+      std::cerr << "Could not read native block " << blk << "!" << &std::endl;
+      return false;
+    }
+    if( hdr.codec == NATIVE_CODEC_RAW ) {
+      dst += index[blk].bytes;
+      continue;
+    }
+
+    // The block must hold just the rows the index says it does
+    unsigned long long numRows = 0;
+    uint64_t wantRows = blk + 1 < hdr.numBlocks ? index[blk+1].firstRow - index[blk].firstRow 
+                                                : hdr.rows - index[blk].firstRow;
+    DeltaBlockHeader bh;
+    bh.rows = 0;
+    if( index[blk].bytes >= sizeof(DeltaBlockHeader) )
+      memcpy( &bh, into, sizeof(DeltaBlockHeader) );
+    if( bh.rows != wantRows || !deltaDecode( into, index[blk].bytes, cols, size, dst, numRows ) ) {
+      std::cerr << "Could not decode native block " << blk << "!" << &std::endl;
+      return false;
+    }
+    dst += numRows * getRowSize();
+  }
+  return true;
+}
+
+
+bool
+DataCommon::readHeader( FILE* fid )
+{
+  char magic[NATIVE_MAGIC_BYTES];
+  off_t base = ftello( fid );
+  size_t got = fread( magic, 1, NATIVE_MAGIC_BYTES, fid );
+  if( got != NATIVE_MAGIC_BYTES || memcmp( magic, NATIVE_MAGIC, NATIVE_MAGIC_BYTES ) ) {
+    // Bare rows
+    codec = NATIVE_CODEC_RAW;
+    return !fseeko( fid, base, SEEK_SET );
+  }
+
+  NativeHeader hdr;
+  if( fseeko( fid, base, SEEK_SET ) || 
+      fread( &hdr, sizeof(NativeHeader), 1, fid ) != 1 ) {
+    std::cerr << "Could not read native header!" << &std::endl;
+    return false;
+  }
+  return nativeHeaderCheck( hdr ) && useNativeHeader( hdr );
+}
+
+
+size_t
+DataCommon::readNative( FILE* fid )
+{
+  if( data ) {
+    std::cerr << "Attempt to load data without clear()ing first was shot down!" << &std::endl;
+    return 0;
+  }
+
+  NativeHeader hdr;
+  NativeBlockEntry* index = readNativeIndex( fid, hdr );
+  if( !index ) {
+    rows = 0;
+    return 0;
+  }
+
+  size_t numBytes = getRowSize() * hdr.rows;
+  if( !allocData( numBytes ) ) {
+    std::cerr << "Could not allocate memory to load " << numBytes << " of data!" << &std::endl;
+    free( index );
+    rows = 0;
+    return 0;
+  }
+
+  if( hdr.numBlocks && !readNativeBlocks( fid, hdr, index, 0, hdr.numBlocks - 1, data ) ) {
+    free( index );
+    clear();
+    return 0;
+  }
+
+  free( index );
+  rows = hdr.rows;
+  return rows;
+}
+
+
+size_t
+DataCommon::readNative( const char* fileName )
+{
+  FILE* fid = fopen( fileName, "r" );
+  if( !fid ) {
+    std::cerr << "File: " << fileName << " was not opened!" << &std::endl;
+    return 0;
+  }
+
+  size_t numRowsRead = readNative( fid );
+  fclose( fid );
+
+  return numRowsRead;
+}
+
+
+size_t
+DataCommon::readNative( const char* fileName, const TimeObj &begT, const TimeObj &finT )
+{
+  if( data ) {
+    std::cerr << "Attempt to load data without clear()ing first was shot down!" << &std::endl;
+    return 0;
+  }
+  if( finT < begT ) {
+    std::cerr << "DataCommon::readNative() finT before begT!" << &std::endl;
+    return 0;
+  }
+
+  FILE* fid = fopen( fileName, "r" );
+  if( !fid ) {
+    std::cerr << "File: " << fileName << " was not opened!" << &std::endl;
+    return 0;
+  }
+
+  NativeHeader hdr;
+  NativeBlockEntry* index = readNativeIndex( fid, hdr );
+  rows = 0;
+  if( !index || !hdr.numBlocks ) {
+    if( index ) free( index );
+    fclose( fid );
+    return 0;
+  }
+
+  uint64_t begBlk = nativeFindBlock( hdr, index, nativeTimeKey( begT ) );
+  uint64_t finBlk = nativeFindBlock( hdr, index, nativeTimeKey( finT ) );
+  if( finBlk < begBlk ) // Out of order rows, fall back on covering both
+    std::swap( begBlk, finBlk );
+  uint64_t firstRow = index[begBlk].firstRow;
+  uint64_t lastRow = finBlk + 1 < hdr.numBlocks ? index[finBlk+1].firstRow : hdr.rows;
+  size_t rowBytes = getRowSize();
+
+  if( !allocData( (lastRow - firstRow) * rowBytes ) ) {
+    std::cerr << "Could not allocate memory to load " << (lastRow - firstRow) * rowBytes << " of data!" << &std::endl;
+    free( index );
+    fclose( fid );
+    return 0;
+  }
+  bool ok = readNativeBlocks( fid, hdr, index, begBlk, finBlk, data );
+  free( index );
+  fclose( fid );
+  if( !ok ) {
+    clear();
+    return 0;
+  }
+
+  // Shave the covering blocks down to begT through finT
+  TimeObj tt;
+  uint64_t beg = firstRow, fin = lastRow;
+  while( beg < fin ) {
+    getRowTime( data + (beg - firstRow) * rowBytes, beg, tt );
+    if( tt >= begT ) break;
+    beg++;
+  }
+  while( fin > beg ) {
+    getRowTime( data + (fin - 1 - firstRow) * rowBytes, fin - 1, tt );
+    if( tt <= finT ) break;
+    fin--;
+  }
+  if( beg == fin ) {
+    clear();
+    return 0;
+  }
+
+  getRowTime( data + (beg - firstRow) * rowBytes, beg, tt );
+  if( beg > firstRow )
+    memmove( data, data + (beg - firstRow) * rowBytes, (fin - beg) * rowBytes );
+  rows = fin - beg;
+  shrinkToFit();
+  utc = tt;
+
+  return rows;
+}
 
 
 void 
 DataCommon::clear()
 {
   if( data )
-    free( data );
+    freeData();
+  rows = 0;
+  interleaved = true;
+}
+
+
+void
+DataCommon::freeData()
+{
+  DataShare* sh = share.exchange( NULL, std::memory_order_relaxed );
+  if( sh ) {
+    if( sh->refs.fetch_sub( 1, std::memory_order_acq_rel ) != 1 ) {
+      // Others still hold it
+      data = NULL;
+      dataBytes = 0;
+      mapped = false;
+      mapSkip = 0;
+      return;
+    }
+    delete sh;
+  }
+
+  if( mapped ) {
+    if( munmap( data - mapSkip, dataBytes + mapSkip ) )
+      std::cerr << "DataCommon::freeData() munmap() failed: " << strerror(errno) << &std::endl;
+    mapped = false;
+    mapSkip = 0;
+  } else
+    alloc->deallocate( data );
+  data = NULL;
+  dataBytes = 0;
+}
+
+
+bool
+DataCommon::allocData( size_t numBytes )
+{
+  data = (char*)alloc->allocate( numBytes );
+  dataBytes = data ? numBytes : 0;
+  return data != NULL;
+}
+
+
+void
+DataCommon::shareData( const DataCommon &src )
+{
+  if( data )
+    freeData();
+  rows = src.rows;
+  if( !src.data )
+    return;
+
+  DataShare* sh = src.share.load( std::memory_order_acquire );
+  if( !sh ) {
+    // First copy of src, race any other copier to attach the count
+    DataShare* fresh = new DataShare;
+    fresh->refs.store( 1, std::memory_order_relaxed );
+    if( src.share.compare_exchange_strong( sh, fresh, std::memory_order_acq_rel ) )
+      sh = fresh;
+    else
+      delete fresh;
+  }
+  sh->refs.fetch_add( 1, std::memory_order_relaxed );
+
+  share.store( sh, std::memory_order_relaxed );
+  data      = src.data;
+  mapped    = src.mapped;
+  mapSkip   = src.mapSkip;
+  dataBytes = src.dataBytes;
+  alloc     = src.alloc;
+}
+
+
+bool
+DataCommon::makeUnique( const bool &keep )
+{
+  if( !data || isUnique() )
+    return true;
+
+  // Keep the capacity, appenders are the usual writers
+  size_t numBytes = getByteSize();
+  if( dataBytes > numBytes && !mapped )
+    numBytes = dataBytes;
+  char* copy = (char*)alloc->allocate( numBytes );
+  if( !copy ) {
+    std::cerr << "DataCommon::makeUnique() could not allocate " << numBytes << " bytes!" << &std::endl;
+    return false;
+  }
+  if( keep )
+    memcpy( copy, data, getByteSize() );
+
+  freeData();
+  data = copy;
+  dataBytes = numBytes;
+  return true;
+}
+
+
+bool
+DataCommon::setData( char* new_var )
+{
+  // The caller takes over the old buffer, as ever, which it can't while others hold it
+  if( !isUnique() ) {
+    std::cerr << "DataCommon::setData() buffer is shared, makeUnique() first!" << &std::endl;
+    return false;
+  }
+  delete share.exchange( NULL, std::memory_order_relaxed );
+
+  // Nor can a mapping be freed as a buffer, so it is unmapped here
+  if( mapped )
+    freeData();
+  data = new_var;
+  dataBytes = 0;
+  return true;
+}
+
+
+bool
+DataCommon::resizeData( size_t numBytes )
+{
+  if( !data )
+    return allocData( numBytes );
+
+  if( !mapped && isUnique() ) {
+    char* tmpr = (char*)alloc->reallocate( data, numBytes );
+    if( !tmpr ) 
+      return false;
+    data = tmpr;
+    dataBytes = numBytes;
+    return true;
+  }
+
+  // Mappings can't be realloc()'d, nor shared buffers, so migrate to the allocator.
+  size_t have = dataBytes ? dataBytes : getByteSize();
+  char* heap = (char*)alloc->allocate( numBytes );
+  if( !heap ) 
+    return false;
+  memcpy( heap, data, numBytes < have ? numBytes : have );
+  freeData();
+  data = heap;
+  dataBytes = numBytes;
+
+  return true;
+}
+
+
+char*
+DataCommon::release( size_t *numBytes )
+{
+  // A mapping can't be handed out, nor a shared buffer, so copy it to the allocator first.
+  if( !makeUnique() || (mapped && !resizeData( getByteSize() )) ) {
+    std::cerr << "DataCommon::release() could not copy mapped or shared data!" << &std::endl;
+    return NULL;
+  }
+  delete share.exchange( NULL, std::memory_order_relaxed );
+
+  char* buf = data;
+  if( numBytes ) 
+    *numBytes = dataBytes ? dataBytes : getByteSize();
   data = NULL;
+  dataBytes = 0;
   rows = 0;
+  return buf;
+}
+
+
+void
+DataCommon::adopt( char* buf, const unsigned long long &numRows, DataAllocator* owner, const size_t &numBytes )
+{
+  if( data )
+    freeData();
+  if( owner )
+    alloc = owner;
+
+  data = buf;
+  rows = buf ? numRows : 0;
+  dataBytes = numBytes > getByteSize() ? numBytes : getByteSize();
+  if( !buf ) 
+    dataBytes = 0;
+}
+
+
+bool
+DataCommon::reserve( const unsigned long long &numRows )
+{
+  if( !interleaved && cols > 1 && rows ) {
+    std::cerr << "DataCommon::reserve() planar rows can't grow in place, interleave first!" << &std::endl;
+    return false;
+  }
+  if( !makeUnique() )
+    return false;
+  if( numRows <= getCapacity() )
+    return true;
+
+  if( !resizeData( numRows * getRowSize() ) ) {
+    std::cerr << "DataCommon::reserve() could not make room for " << numRows << " rows!" << &std::endl;
+    return false;
+  }
+  return true;
+}
+
+
+bool
+DataCommon::growCapacity( const unsigned long long &minRows )
+{
+  // Room in a shared buffer is someone else's room too
+  if( !makeUnique() )
+    return false;
+  unsigned long long cap = getCapacity();
+  if( minRows <= cap )
+    return true;
+
+  // Doubling keeps a run of appends to amortized constant time per row
+  unsigned long long newCap = cap * 2;
+  if( newCap < minRows ) 
+    newCap = minRows;
+  if( newCap < 64 )
+    newCap = 64;
+  return reserve( newCap );
+}
+
+
+bool
+DataCommon::shrinkToFit()
+{
+  size_t numBytes = getByteSize();
+  if( !data || mapped || dataBytes <= numBytes || !isUnique() )
+    return true;
+  if( !numBytes ) {
+    freeData();
+    return true;
+  }
+  return resizeData( numBytes );
+}
+
+
+bool
+DataCommon::setAllocator( DataAllocator* new_alloc )
+{
+  if( !new_alloc )
+    new_alloc = DataAllocator::getDefault();
+  if( new_alloc == alloc )
+    return true;
+
+  if( data && !mapped ) {
+    // Capacity reserved comes along, the rows are all that need copying
+    size_t numBytes = dataBytes > getByteSize() ? dataBytes : getByteSize();
+    char* moved = (char*)new_alloc->allocate( numBytes );
+    if( !moved ) {
+      std::cerr << "DataCommon::setAllocator() could not allocate " << numBytes << " bytes!" << &std::endl;
+      return false;
+    }
+    memcpy( moved, data, getByteSize() );
+    freeData();
+    data = moved;
+    dataBytes = numBytes;
+  }
+
+  alloc = new_alloc;
+  return true;
 }
 
 
 void 
 DataCommon::zero()
 {
-  if( !data ) return;
+  if( !data || !makeUnique( false ) ) return;
   
   size_t numBytes = getByteSize();
   memset( data, 0, numBytes );
 }
 
+bool
+DataCommon::trim( const TimeObj &begT, const TimeObj &finT ) const
+{
+  DataView view;
+  return slice( begT, finT, view );
+}
+
+
+bool
+DataCommon::materialize( const DataView &view )
+{
+  // Copy before freeing, the view may point into data
+  size_t numBytes = view.getByteSize();
+  char* buf = NULL;
+  if( numBytes ) {
+    buf = (char*)alloc->allocate( numBytes );
+    if( !buf ) {
+      std::cerr << "DataCommon::materialize() could not allocate " << numBytes << " bytes!" << &std::endl;
+      return false;
+    }
+    view.copyTo( buf );
+  }
+
+  if( data )
+    freeData();
+  data = buf;
+  dataBytes = numBytes;
+  size = view.getEltSize();
+  numFmt = view.getNumFmt();
+  cols = view.getCols();
+  rows = view.getRows();
+  interleaved = true;
+  utc = view.getUTC();
+  setTimeEnd();
+  return true;
+}
+
+
+bool
+DataCommon::relayout( const bool &toRows )
+{
+  if( interleaved == toRows )
+    return true;
+  if( !data || !rows || cols < 2 ) {
+    interleaved = toRows;
+    return true;
+  }
+
+  // Out of place, so a shared buffer is simply left to the others
+  size_t numBytes = getByteSize();
+  char* buf = (char*)alloc->allocate( numBytes );
+  if( !buf ) {
+    std::cerr << "DataCommon::relayout() could not allocate " << numBytes << " bytes!" << &std::endl;
+    return false;
+  }
+  if( toRows )
+    transposeBlocked( data, rows * size, buf, getRowSize(), cols, rows, size );
+  else
+    transposeBlocked( data, getRowSize(), buf, rows * size, rows, cols, size );
+
+  freeData();
+  data = buf;
+  dataBytes = numBytes;
+  interleaved = toRows;
+  return true;
+}
+
+
+const char*
+DataCommon::fileRows( const unsigned long long &firstRow, const unsigned long long &numRows,
+                      std::vector<char> &scratch ) const
+{
+  if( interleaved || cols < 2 )
+    return data + firstRow * getRowSize();
+
+  if( scratch.size() < numRows * getRowSize() )
+    scratch.resize( numRows * getRowSize() );
+  getView().subView( firstRow, numRows ).copyTo( &scratch[0] );
+  return &scratch[0];
+}
+
+
+bool
+DataCommon::getVals( double **vals ) const
+{
+  size_t numVals = rows * cols;
+  bool mine = !*vals;
+  if( mine && !(*vals = (double*)DataAllocator::getDefault()->allocate( numVals * sizeof(double) )) ) {
+    std::cerr << "DataCommon::getVals() could not allocate " << numVals << " doubles!" << &std::endl;
+    return false;
+  }
+  if( !samplesToDouble( data, numFmt, size, *vals, numVals ) ) {
+    if( mine ) {
+      free( *vals );
+      *vals = NULL;
+    }
+    return false;
+  }
+  return true;
+}
+
+
+bool
+DataCommon::getVals( float **vals ) const
+{
+  size_t numVals = rows * cols;
+  bool mine = !*vals;
+  if( mine && !(*vals = (float*)DataAllocator::getDefault()->allocate( numVals * sizeof(float) )) ) {
+    std::cerr << "DataCommon::getVals() could not allocate " << numVals << " floats!" << &std::endl;
+    return false;
+  }
+  if( !samplesToFloat( data, numFmt, size, *vals, numVals ) ) {
+    if( mine ) {
+      free( *vals );
+      *vals = NULL;
+    }
+    return false;
+  }
+  return true;
+}
+
+
+bool
+DataCommon::prepareVals( const size_t &numVals )
+{
+  if( !cols || numVals % cols ) {
+    std::cerr << "DataCommon::setVals() " << numVals << " samples don't fill " << cols << " columns!" << &std::endl;
+    return false;
+  }
+
+  // Old contents are about to be overwritten, so don't copy them
+  unsigned long long numRows = numVals / cols;
+  if( !makeUnique( false ) )
+    return false;
+  if( !data || numRows > getCapacity() ) {
+    if( !resizeData( numVals * size ) ) {
+      std::cerr << "DataCommon::setVals() could not make room for " << numRows << " rows!" << &std::endl;
+      return false;
+    }
+  }
+  rows = numRows;
+  return true;
+}
+
+
+bool
+DataCommon::setVals( const double *vals, const size_t &numVals )
+{
+  if( !prepareVals( numVals ) || !samplesFromDouble( vals, numVals, data, numFmt, size ) )
+    return false;
+  setTimeEnd();
+  return true;
+}
+
+
+bool
+DataCommon::setVals( const float *vals, const size_t &numVals )
+{
+  if( !prepareVals( numVals ) || !samplesFromFloat( vals, numVals, data, numFmt, size ) )
+    return false;
+  setTimeEnd();
+  return true;
+}
+
+
 bool
 DataCommon::createDataBuffer() 
 {
@@ -203,8 +1124,7 @@ DataCommon::createDataBuffer()
     clear();
   }
   size_t numBytes = cols * size * rows;
-  data = (char*)malloc( numBytes );
-  if( !data ) {
+  if( !allocData( numBytes ) ) {
     std::cerr << "Could not create data buffer DataCommon::createDataBuffer() is aborting!!" << &std::endl;
     return false;
   } else 
@@ -216,20 +1136,20 @@ DataCommon::load( FILE* fid )
 {
   if( data == NULL ) {
     size_t numBytes = cols * size * DEFAULT_NUMBER_OF_ROWS;
-    data = (char*)malloc( numBytes );
-    if( !data ) {
+    if( !allocData( numBytes ) ) {
       std::cerr << "Could not allocate memory to load " << numBytes << " of data!" << &std::endl;
       return 0;
     } else
       rows = DEFAULT_NUMBER_OF_ROWS;
-  }
+  } else if( !makeUnique( false ) )
+    return 0;
 
   // Try to read whole rows
   size_t rowBytes = getRowSize();
   size_t numRowsRead = fread( data, rowBytes, DEFAULT_NUMBER_OF_ROWS, fid );
   if( !numRowsRead ) {
     std::cerr << "Could not load any rows from file!" << &std::endl;
-    free(data);
+    freeData();
     return 0;
   }
   //std::cout << "Loaded sample 1: " << ((int*)data)[0] << &endl;
@@ -239,7 +1159,7 @@ DataCommon::load( FILE* fid )
   int errCode = ferror(fid);
   if( errCode ) {
     std::cerr << "Could not load from file due to error!" << &std::endl;
-    free(data);
+    freeData();
     return 0;
   }
 
@@ -249,24 +1169,21 @@ DataCommon::load( FILE* fid )
     // Resize needed.
     if( !feof(fid) ) {
       std::cerr << "Less rows loaded than requested, " << numRowsRead << " .vs. " << rows << ", but end of file not reached!" << &std::endl;
-      free(data);
+      freeData();
       return 0;
     }
 
     size_t numBytesRead = rowBytes * numRowsRead;
-    char* tmpr = (char*)realloc( data, numBytesRead );
-    if( tmpr == NULL ) {
+    if( !resizeData( numBytesRead ) ) {
       std::cerr << "Resize of array failed after load!!" << &std::endl;
-      free(data);
+      freeData();
       return 0;
     }
 
-    //std::cout << "Realloc'ed from: " << (void*)data << " to " << (void*)tmpr << &endl;
-    data = tmpr;
-
   } // else done.
 
   rows = numRowsRead;
+  interleaved = true;
 
   return numRowsRead;
 }
@@ -298,3 +1215,122 @@ DataCommon::load( const char* fileName, unsigned long long max_rows )
   return numRowsRead;
 }
 
+
+size_t
+DataCommon::loadMapped( const char* fileName )
+{
+  if( data ) {
+    std::cerr << "Attempt to load data without clear()ing first was shot down!" << &std::endl;
+    return 0;
+  }
+  return mapFile( fileName, 0, 0 );
+}
+
+
+size_t
+DataCommon::mapFile( const char* fileName, const off_t &offset, const size_t &numBytes )
+{
+  int fd = open( fileName, O_RDONLY );
+  if( fd < 0 ) {
+    std::cerr << "File: " << fileName << " was not opened!" << &std::endl;
+    return 0;
+  }
+
+  struct stat st;
+  if( fstat( fd, &st ) ) {
+    std::cerr << "Could not stat: " << fileName << "!" << &std::endl;
+    close( fd );
+    return 0;
+  }
+
+  size_t haveBytes = st.st_size > offset ? st.st_size - offset : 0;
+  if( numBytes && numBytes < haveBytes )
+    haveBytes = numBytes;
+  size_t rowBytes = getRowSize();
+  size_t numRows = rowBytes ? haveBytes / rowBytes : 0;
+  if( !numRows ) {
+    std::cerr << "Could not map any rows from file: " << fileName << "!" << &std::endl;
+    close( fd );
+    return 0;
+  }
+  if( numRows * rowBytes != haveBytes )
+    std::cerr << "File: " << fileName << " ends in a partial row, it was dropped." << &std::endl;
+
+  // Private mapping, so mutators like zero() touch page copies and not the file.
+  // Mapped from the top, the offset need not fall on a page.
+  void* addr = mmap( NULL, offset + haveBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+  close( fd ); // The mapping holds its own reference
+  if( addr == MAP_FAILED ) {
+    std::cerr << "Could not mmap() " << fileName << ": " << strerror(errno) << &std::endl;
+    return 0;
+  }
+  madvise( addr, offset + haveBytes, MADV_SEQUENTIAL );
+
+  data = (char*)addr + offset;
+  mapped = true;
+  mapSkip = offset;
+  dataBytes = haveBytes;
+  rows = numRows;
+  interleaved = true;
+
+  return numRows;
+}
+
+
+// Regression tests
+
+/** Rows and nothing else, DataCommon itself can't be made */
+class DiffTestData : public DataCommon
+{
+public:
+  bool load() { return false; }
+  bool write( char* fileName ) const { return false; }
+  bool setTimeEnd() { return true; }
+  bool isEmpty() const { return !rows; }
+};
+
+bool
+DataCommon::testClass()
+{
+  // Three columns of doubles, then a copy off by 1e-6 at one sample and by
+  // 2 ulps at a later one
+  const unsigned long long numRows = 100;
+  const unsigned int numCols = 3;
+  std::vector<double> vals( numRows * numCols ), off;
+  for( size_t i = 0; i < vals.size(); i++ )
+    vals[i] = 1.0 + i * 0.25;
+  off = vals;
+  off[40] += 1e-6;
+  off[250] = nextafter( nextafter( off[250], 1e9 ), 1e9 );
+
+  DiffTestData a, b, c, d;
+  TimeObj t0( (time_t)1300000000, 0 );
+  DataView view( (const char*)&vals[0], numRows, numCols, sizeof(double), NUM_DBL, t0 );
+  DataView offView( (const char*)&off[0], numRows, numCols, sizeof(double), NUM_DBL, t0 );
+  if( !a.materialize( view ) || !b.materialize( view ) || !b.toPlanar() ) return DRATS;
+  if( !c.materialize( offView ) || !d.materialize( offView ) || !d.toPlanar() ) return DRATS;
+
+  // The same rows in either layout are the same
+  DiffReport report;
+  if( a.diff( b ) || a.dataDiff( b ) || b.diff( a ) || a.diff( b, exactTolerance(), report ) || report.compared != vals.size() ) return DRATS;
+  if( !a.diff( c ) || !b.dataDiff( d ) ) return DRATS;
+
+  // Either layout reports the same, whatever the tolerance
+  DiffTolerance abs = { 1e-8, 0 }, ulps = { 0.0, 4 }, loose = { 1e-5, 0 };
+  const DiffTolerance tols[] = { exactTolerance(), abs, ulps, loose };
+  const unsigned long long wantMismatches[] = { 2, 1, 1, 0 };
+  for( int t = 0; t < 4; t++ ) {
+    DiffReport mixed;
+    bool differ = a.diff( c, tols[t], report );
+    if( differ != ( wantMismatches[t] != 0 ) || report.mismatches != wantMismatches[t] ) return DRATS;
+    if( report.mismatches && ( report.firstMismatch != 40 || fabs( report.maxAbsErr - 1e-6 ) > 1e-12 ) ) return DRATS;
+    if( b.diff( d, tols[t], mixed ) != differ || mixed.mismatches != report.mismatches || mixed.firstMismatch != report.firstMismatch ) return DRATS;
+  }
+
+  // Shapes that don't match aren't compared
+  DiffTestData e;
+  if( !e.materialize( DataView( (const char*)&vals[0], numRows - 1, numCols, sizeof(double), NUM_DBL, t0 ) ) ) return DRATS;
+  if( !a.diff( e ) || !a.diff( e, exactTolerance(), report ) || report.compared ) return DRATS;
+
+  return VOILA;
+}
@@ -7,6 +7,17 @@
   */
 
 #include "libCore/libCore.h"
+#include "NativeFormat.h"
+#include "DataAllocator.h"
+#include "TypedView.h"
+#include "SampleConvert.h"
+#include "DataDiff.h"
+#include "DeltaCodec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 #define DEFAULT_NUMBER_OF_ROWS 10000000
 
@@ -16,6 +27,7 @@ enum ObjTypes {
   FREQUENCY_DATA,
   FREQUENCY_TIME_DATA,
   EVENT_DATA,
+  DISCRETE_DATA,
   numObjTypes
 };
 
@@ -28,6 +40,17 @@ enum metaData {
 };
 
 
+/**
+  * struct DataShare
+  * Reference count of a data buffer held by more than one object.  Made on
+  * the first copy, and freed along with the buffer by the last holder.
+  */
+struct DataShare
+{
+  std::atomic<unsigned long> refs;
+};
+
+
 /**
   * class DataCommon
   * Core processing base class.  Contains data identifiers, labels, and times.
@@ -55,11 +78,33 @@ protected:
   /** Data Pointer */
   char* data;
 
-  /** col major if true */
+  /** True if data points at an mmap()'d file rather than a malloc()'d buffer */
+  bool mapped;
+
+  /** Bytes mapped ahead of data, a header say, unmapped along with it */
+  size_t mapSkip;
+
+  /** Bytes allocated, or mapped, at data.  Zero if unknown (see setData()) */
+  size_t dataBytes;
+
+  /** Source of data when not mapped */
+  DataAllocator* alloc;
+
+  /** Holders of data, NULL until the first copy.  Mutators call makeUnique() */
+  mutable std::atomic<DataShare*> share;
+
+  /** Rows of samples one after another if true, else planar, each column
+      one after another.  Files always hold interleaved rows */
   bool interleaved;
     
   /** Element size in bytes */
   unsigned int size;
+
+  /** Number format of the elements, with size it picks the sample type */
+  NumberFormats numFmt;
+
+  /** Block coding of native files written, and of the last one read */
+  NativeCodecs codec;
   
   /** Number of columns */
   unsigned int cols;
@@ -87,12 +132,23 @@ public:
   DataCommon( const TimeObj &startUTC );
 
   /**
-   * Copy Constructor
+   * Copy Constructor.  Heirs share src's buffer, see shareData().
    * @param src Object to be copied.
    * @param skipData (optional) Skip copy of the data, for speed
    */
   DataCommon( const DataCommon &src, const bool &skipData = false );
 
+  /**
+   * Move Constructor, takes the buffer and leaves src empty.
+   * @param src Object to be moved from.
+   */
+  DataCommon( DataCommon &&src ) noexcept;
+
+  /**
+   * No slicing assignment, heirs assign by copy and swap.
+   */
+  DataCommon& operator=( const DataCommon &src ) = delete;
+
   /**
    * Destructor
    */
@@ -134,6 +190,60 @@ public:
    */
   virtual size_t load( FILE* fid );
 
+  /**
+   * Zero-copy load.  The file is mmap()'d privately, rows is sized from its
+   * length, and data points straight at the mapping.  Pages are faulted in on
+   * first touch, so read-only analyses never copy the file.  Writes land in
+   * private copies of the touched pages and never reach the file.
+   * @return size_t Number of rows mapped, zero on failure
+   * @param  fileName Name of file to map
+   */
+  virtual size_t loadMapped( const char* fileName );
+
+  /**
+   * Read whatever header precedes the rows of a file, updating cols etc.
+   * Raw row files have none, native files set all attributes, rows and
+   * codec.  Used by streaming readers.
+   * @return bool True if the header was understood
+   * @param fid The open file, left positioned at the first row, or the
+   * first block if coded
+   */
+  virtual bool readHeader( FILE* fid );
+
+  /**
+   * Load a whole FORMAT_NATIVE file, attributes, meta and all.
+   * @return size_t Number of rows loaded, zero on failure
+   * @param fid The open file, positioned at the header
+   */
+  size_t readNative( FILE* fid );
+
+  /**
+   * Load a whole FORMAT_NATIVE file, attributes, meta and all.
+   * @return size_t Number of rows loaded, zero on failure
+   * @param fileName Name of file to read
+   */
+  size_t readNative( const char* fileName );
+
+  /**
+   * Load only the rows from begT through finT of a FORMAT_NATIVE file.
+   * The block index takes the reader straight to the first block needed,
+   * so the cost is independent of the length of the file.  utc becomes the
+   * time of the first row loaded.
+   * @return size_t Number of rows loaded, zero if none or on failure
+   * @param fileName Name of file to read
+   * @param begT First time wanted
+   * @param finT Last time wanted
+   */
+  size_t readNative( const char* fileName, const TimeObj &begT, const TimeObj &finT );
+
+  /**
+   * Time of a row, used to stamp streamed chunks.  The default is utc.
+   * @param row Pointer to the row
+   * @param rowIdx Index of the row from the start of the file
+   * @param tt The time of the row
+   */
+  virtual void getRowTime( const char* row, const unsigned long long &rowIdx, TimeObj &tt ) const { tt = utc; }
+
   /**
    * @return bool
    * @param  fileName
@@ -143,8 +253,17 @@ public:
   /**
    * @return bool True is write was successful
    * @param fid The open file ID
+   * @param format FORMAT_NATIVE for the indexed container, FORMAT_BINARY for bare
+   * rows, heirs may take others
+   */
+  virtual bool write( FILE* fid, const int &format = FORMAT_NATIVE ) const;
+
+  /**
+   * @return bool True is write was successful
+   * @param fileName Name or Path of file to write
+   * @param format FORMAT_NATIVE for the indexed container, FORMAT_BINARY for bare rows
    */
-  bool write (FILE* fid ) const;
+  bool writeFile( const char* fileName, const int &format = FORMAT_NATIVE ) const;
 
   /**
    * Free all data associated with this object.
@@ -152,7 +271,7 @@ public:
   virtual void clear();
 
   /**
-   * Free all data associated with this object.
+   * Zero all samples.  A shared buffer is swapped for a fresh private one.
    */
   virtual void zero();
 
@@ -162,6 +281,30 @@ public:
    */
   void reset();
 
+  /**
+   * Is data an mmap()'d view of a file?
+   * @return true if data came from loadMapped()
+   */
+  bool isMapped() const { return mapped; }
+
+  /**
+   * Is data held by this object alone?
+   * @return true if no other object shares data
+   */
+  bool isUnique() const {
+    DataShare* sh = share.load( std::memory_order_relaxed );
+    return !sh || sh->refs.load( std::memory_order_acquire ) == 1;
+  }
+
+  /**
+   * Copy on write.  If data is shared, give this object a private copy so
+   * that writes don't show through the other holders.  Every mutator calls
+   * this before touching data.
+   * @param keep (optional) false if the contents are about to be overwritten
+   * @return true if data may now be written
+   */
+  bool makeUnique( const bool &keep = true );
+
   /**
    * @return unsigned int The number of columns
    */
@@ -195,6 +338,31 @@ public:
    */
   bool diff( const DataCommon& she ) const;
 
+  /**
+   * Compare samples within a tolerance, reporting where and by how much
+   * they differ.  Sizes, formats and shapes must match, layouts needn't.
+   * @param she object to compare with
+   * @param tol what still counts as a match
+   * @param report what was found, sample indices run row by row
+   * @return true if they are different
+   */
+  bool dataDiff( const DataCommon& she, const DiffTolerance &tol, DiffReport &report ) const;
+
+  /**
+   * As diff(), within a tolerance.
+   * @param she object to compare with
+   * @param tol what still counts as a match
+   * @param report what was found, empty if the pedigrees differ
+   * @return true if they are different
+   */
+  bool diff( const DataCommon& she, const DiffTolerance &tol, DiffReport &report ) const;
+
+  /**
+   * Run the regression test for this class.  Return 0 if good.
+   * @return bool
+   */
+  static bool testClass();
+
 
   /**
    * Extract reduced portion of data from the first sample at or after begT and before finT
@@ -202,7 +370,58 @@ public:
    * @param  begT
    * @param  finT
    */
-  virtual bool trim( const TimeObj &begT, const TimeObj &finT ) const { return false; }
+  virtual bool trim( const TimeObj &begT, const TimeObj &finT ) const;
+
+  /**
+   * Zero-copy trim.  View the rows from the first at or after begT up to,
+   * not including, the first at or after finT.  The base has no row times.
+   * @param begT beginning time of slice window.
+   * @param finT ending time of slice window.
+   * @param view the rows found, empty if none.
+   * @return true if any rows were found
+   */
+  virtual bool slice( const TimeObj &begT, const TimeObj &finT, DataView &view ) const { view = DataView(); return false; }
+
+  /**
+   * View all rows.
+   * @return a view of data, valid until this object is written to
+   */
+  virtual DataView getView() const { return layoutView(); }
+
+  /**
+   * View one column.  Contiguous when planar, so filters and FFTs can run
+   * on it in place; strided when interleaved.
+   * @param col Column wanted
+   * @return the column's view, empty if col is out of range
+   */
+  DataView getChannel( const unsigned int &col ) const { return getView().column( col ); }
+
+  /**
+   * @return true if rows are interleaved, false if planar
+   */
+  bool isInterleaved() const { return interleaved; }
+
+  /**
+   * Rearrange data planar, each column a contiguous run of rows.  A shared
+   * buffer is left to its other holders.  Appending and reserving need
+   * interleaved data.
+   * @return true if successful, data is untouched otherwise
+   */
+  bool toPlanar() { return relayout( false ); }
+
+  /**
+   * Rearrange data back to interleaved rows.
+   * @return true if successful, data is untouched otherwise
+   */
+  bool toInterleaved() { return relayout( true ); }
+
+  /**
+   * Replace the contents with a packed copy of a view's rows, taking its
+   * shape and start time.  The view may be of this very object.
+   * @param view rows to copy
+   * @return true if successful
+   */
+  virtual bool materialize( const DataView &view );
 
   /**
    * Data trimmer, fully expounded.  Using a pair of functions allows base classes more flexibilty.
@@ -314,37 +533,118 @@ public:
   const TimeObj& getTimeEnd() const { return timeEnd; }
 
   /**
-   * Set the value of data
-   * @param new_var the new value of data
+   * Set the value of data.  The caller takes over the old buffer, so it
+   * must not be shared, see makeUnique(); a mapped one is unmapped.
+   * @param new_var the new value of data, from getAllocator() (or malloc()
+   * while that is the default).  Its capacity is taken to be rows.
+   * @return false, leaving data as is, if the buffer is shared
    */
-  void setData( char* new_var ) { data = new_var; }
+  bool setData( char* new_var );
 
   /**
-   * Get the value of data
+   * Hand the buffer out.  The object is left empty, and the caller owns the
+   * buffer, which came from getAllocator() (a mapped or shared buffer is
+   * first copied there).
+   * @param numBytes (optional) receives the size of the buffer.
+   * @return the buffer, NULL if there was none.
+   */
+  char* release( size_t *numBytes = NULL );
+
+  /**
+   * Take over a buffer of numRows rows, freeing any current data.
+   * @param buf the buffer to own
+   * @param numRows rows in buf
+   * @param owner allocator buf came from, NULL means getAllocator()
+   * @param numBytes (optional) size of buf if larger than numRows rows
+   */
+  void adopt( char* buf, const unsigned long long &numRows, DataAllocator* owner = NULL, const size_t &numBytes = 0 );
+
+  /**
+   * Get the number of rows that fit in data without reallocation.
+   * @return capacity in rows, never less than rows
+   */
+  unsigned long long getCapacity() const {
+    size_t rowBytes = getRowSize();
+    unsigned long long cap = rowBytes ? dataBytes / rowBytes : 0;
+    return cap > rows ? cap : rows;
+  }
+
+  /**
+   * Make room for numRows rows, so that later appends don't reallocate.
+   * Rows and contents are unchanged.
+   * @param numRows Capacity wanted in rows
+   * @return true if successful
+   */
+  bool reserve( const unsigned long long &numRows );
+
+  /**
+   * Give back any capacity beyond rows.
+   * @return true if successful
+   */
+  bool shrinkToFit();
+
+  /**
+   * Set the source of data.  Any existing (unmapped) data is moved over,
+   * capacity and all.
+   * @param new_alloc allocator to use from now on, NULL for the default
+   * @return true if successful
+   */
+  bool setAllocator( DataAllocator* new_alloc );
+
+  /**
+   * Get the source of data
+   * @return the allocator
+   */
+  DataAllocator* getAllocator() const { return alloc; }
+
+  /**
+   * Get the value of data, for reading.  It may be shared with other objects
+   * or mapped from a file, so writers use getWritableData().
    * @return the value of data
    */
-  char* getData() const { return data; }
+  const char* getData() const { return data; }
+
+  /**
+   * Get the value of data, for writing.  Makes a private copy if shared.
+   * @return the value of data, NULL if the copy failed
+   */
+  char* getWritableData() { return makeUnique() ? data : NULL; }
 
   /**
-   * Get the value of data
-   * @param vals the pointer to allocate and write into.
+   * Get the value of data, converted to double.  All rows * cols samples
+   * are written in storage order, row by row if interleaved, column by
+   * column if planar.
+   * @param vals the pointer to write into.  If NULL a buffer is allocated,
+   * which is DATA_ALIGN aligned and released with free().
    * @return true if successful.
    */
-  virtual bool getVals( double **vals ) const { 
-    std::cerr << "Bogus call to DataCommon base getVals() method" << &std::endl;
-    return false; 
-  }
+  virtual bool getVals( double **vals ) const;
+
+  /**
+   * Get the value of data, converted to float.
+   * @param vals the pointer to write into, allocated as above if NULL.
+   * @return true if successful.
+   */
+  virtual bool getVals( float **vals ) const;
 
   /**
-   * Get the value of data
+   * Set the value of data from doubles.  Integer samples are rounded and
+   * saturated.  Rows follows numVals, and a shared buffer is made private.
+   * vals are in storage order, as for getVals().
+   * Overrides must makeUnique() first.
    * @param vals the buffer to write from.
-   * @param numVals the number of samples in val.
+   * @param numVals the number of samples in val, a multiple of cols.
    * @return true if successful.
    */
-  virtual bool setVals( double *vals, const size_t &numVals ) { 
-    std::cerr << "Bogus call to DataCommon base setVals() method" << &std::endl;
-    return false; 
-  }
+  virtual bool setVals( const double *vals, const size_t &numVals );
+
+  /**
+   * Set the value of data from floats, as above.
+   * @param vals the buffer to write from.
+   * @param numVals the number of samples in val, a multiple of cols.
+   * @return true if successful.
+   */
+  virtual bool setVals( const float *vals, const size_t &numVals );
 
   /**
    * Set the value of cols
@@ -358,6 +658,54 @@ public:
    */
   inline unsigned int getEltSize() const { return size; }
 
+  /**
+   * Set the number format of the elements
+   * @param new_fmt NUM_INT, NUM_FLT or NUM_DBL
+   */
+  void setNumFmt( const NumberFormats new_fmt ) { numFmt = new_fmt; }
+
+  /**
+   * Get the number format of the elements
+   * @return the number format
+   */
+  inline NumberFormats getNumFmt() const { return numFmt; }
+
+  /**
+   * Set the block coding of native files written.  Codecs that don't suit
+   * the samples fall back to raw blocks.
+   * @param new_codec NATIVE_CODEC_RAW or NATIVE_CODEC_DELTA
+   */
+  void setCodec( const NativeCodecs new_codec ) { codec = new_codec; }
+
+  /**
+   * Get the block coding of native files
+   * @return the codec
+   */
+  inline NativeCodecs getCodec() const { return codec; }
+
+  /**
+   * Typed read access, checked against the runtime size and format.
+   * @param tv view of all samples, valid until this object is written to
+   * @return true if T is the sample type
+   */
+  template<typename T>
+  bool getTyped( TypedView<const T> &tv ) const { return typedView( getView(), tv ); }
+
+  /**
+   * Typed write access, checked against the runtime size and format.
+   * A shared buffer is first made private.
+   * @param tv view of all samples
+   * @return true if T is the sample type
+   */
+  template<typename T>
+  bool getWritableTyped( TypedView<T> &tv ) {
+    TypedView<const T> ctv;
+    if( !typedView( getView(), ctv ) || !makeUnique() )
+      return false;
+    tv = TypedView<T>( (T*)data, rows, cols, ctv.getStride(), ctv.getColStride() );
+    return true;
+  }
+
   /**
    * Set the value of cols
    * @param new_var the new value of cols
@@ -446,11 +794,133 @@ protected:
    */
   bool readFinish (FILE* inFid, bool compressed ) { return false; }
 
+  /**
+   * Map rows of a file, as loadMapped() does, from offset on.  data must be NULL.
+   * @param fileName Name of file to map
+   * @param offset bytes ahead of the first row
+   * @param numBytes bytes of rows, zero for all up to the end of file
+   * @return size_t Number of rows mapped, zero on failure
+   */
+  size_t mapFile( const char* fileName, const off_t &offset, const size_t &numBytes );
+
+  /**
+   * Release data, be it malloc()'d or mmap()'d, and NULL it.  A shared
+   * buffer is only dropped, the last holder frees it.
+   */
+  void freeData();
+
+  /**
+   * Hold src's buffer too, in O(1), in place of any current data.  rows
+   * follows src.  Used by the copy constructors of heirs.
+   * @param src object whose buffer to share
+   */
+  void shareData( const DataCommon &src );
+
+  /**
+   * Allocate data, which must be NULL, and note its size.
+   * @param numBytes Size of the buffer
+   * @return true if successful
+   */
+  bool allocData( size_t numBytes );
+
+  /**
+   * Resize data, keeping its contents, and note its size.  A mapped or
+   * shared buffer is copied into a fresh one from the allocator and dropped.
+   * @param numBytes New size of the buffer
+   * @return true if successful, data is untouched otherwise
+   */
+  bool resizeData( size_t numBytes );
+
+  /**
+   * Grow the capacity geometrically to at least minRows, for appenders.
+   * @param minRows Rows that must fit
+   * @return true if successful
+   */
+  bool growCapacity( const unsigned long long &minRows );
+
+  /**
+   * Make data hold numVals samples ready to be overwritten, for setVals().
+   * @param numVals number of samples, a multiple of cols
+   * @return true if successful
+   */
+  bool prepareVals( const size_t &numVals );
+
+  /**
+   * View all rows as laid out, interleaved or planar.
+   * @param rate (optional) Rows per second, zero if irregular
+   * @return a view of data
+   */
+  DataView layoutView( const double &rate = 0.0 ) const {
+    if( interleaved || cols < 2 )
+      return DataView( data, rows, cols, size, numFmt, utc, rate );
+    return DataView( data, rows, cols, size, numFmt, utc, rate, size, rows * size );
+  }
+
+  /**
+   * Transpose data into a fresh buffer laid out as asked.
+   * @param toRows true for interleaved, false for planar
+   * @return true if successful
+   */
+  bool relayout( const bool &toRows );
+
+  /**
+   * Rows as they go to file, interleaved.  Planar data is transposed into
+   * scratch.
+   * @param firstRow first row wanted
+   * @param numRows rows wanted, in range
+   * @param scratch room for the transposed rows, grown as needed
+   * @return the first of numRows interleaved rows
+   */
+  const char* fileRows( const unsigned long long &firstRow, const unsigned long long &numRows,
+                        std::vector<char> &scratch ) const;
+
   /**
    * Default initailizer
    */
   void initAttributes();
 
+  /**
+   * Exchange every DataCommon attribute, buffer included, with other.
+   * Heirs wrap this in a swap() of their own type.
+   * @param other object to exchange with
+   */
+  void swapCommon( DataCommon &other ) noexcept;
+
+  /**
+   * Fill in a native header from this object.  Heirs add their own fields.
+   * @param hdr header to fill, already initialized
+   */
+  virtual void fillNativeHeader( NativeHeader &hdr ) const;
+
+  /**
+   * Take attributes from a native header.  Heirs take their own fields.
+   * @param hdr header read from file, already checked
+   * @return true if the header suits this object
+   */
+  virtual bool useNativeHeader( const NativeHeader &hdr );
+
+  /**
+   * Write the container, called by write( fid, FORMAT_NATIVE ).
+   * @return bool True is write was successful
+   * @param fid The open file ID, must be seekable
+   */
+  bool writeNative( FILE* fid ) const;
+
+  /**
+   * Read header, meta strings and block index of a native file.
+   * @return the index, malloc()'d, NULL on failure
+   * @param fid The open file
+   * @param hdr The header read
+   */
+  NativeBlockEntry* readNativeIndex( FILE* fid, NativeHeader &hdr );
+
+  /**
+   * Read blocks begBlk through finBlk into dst.
+   * @return true if all were read
+   */
+  bool readNativeBlocks( FILE* fid, const NativeHeader &hdr, const NativeBlockEntry* index, 
+                         const uint64_t &begBlk, const uint64_t &finBlk, char* dst ) const;
+
 public:
 
   /**
@@ -483,7 +953,7 @@ public:
    * Sort object for increasing t
    * @return bool true if sort succeeds.
    */
-  bool sort() { return false; }
+  virtual bool sort() { return false; }
 
   /**
    * Check object for correct sort
@@ -0,0 +1,271 @@
+#include "DataDiff.h"
+#include "SampleConvert.h"
+#include "ThreadSplit.h"
+
+/**
+  * DataDiff
+  * Copyright 2016, ShotSpotter
+  */
+
+#include <math.h>
+#include <atomic>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Samples per bitwise check, and per pass through the staging buffers */
+#define DIFF_BLOCK 4096
+
+/** Fewest samples worth a thread of their own, by default */
+#define DIFF_THREAD_SAMPS (4ULL << 20)
+
+/** Threads to split across, zero for one per core */
+static std::atomic<unsigned int> diffThreads( 0 );
+
+/** Fewest samples worth a thread of their own */
+static std::atomic<size_t> diffThreadSamps( DIFF_THREAD_SAMPS );
+
+/** Distance in ulps, counting -0 and +0 as one */
+static inline uint64_t
+ulpDistance( const double &x, const double &y )
+{
+  int64_t ix, iy;
+  memcpy( &ix, &x, sizeof(ix) );
+  memcpy( &iy, &y, sizeof(iy) );
+  // Sign magnitude to two's complement, so the order follows the values
+  if( ix < 0 ) ix = INT64_MIN - ix;
+  if( iy < 0 ) iy = INT64_MIN - iy;
+  return ix > iy ? (uint64_t)ix - (uint64_t)iy : (uint64_t)iy - (uint64_t)ix;
+}
+
+static inline uint64_t
+ulpDistance( const float &x, const float &y )
+{
+  int32_t ix, iy;
+  memcpy( &ix, &x, sizeof(ix) );
+  memcpy( &iy, &y, sizeof(iy) );
+  if( ix < 0 ) ix = INT32_MIN - ix;
+  if( iy < 0 ) iy = INT32_MIN - iy;
+  return ix > iy ? (int64_t)ix - iy : (int64_t)iy - ix;
+}
+
+/**
+ * The absolute test, two lanes at a time.  Lanes failing it, NaN included,
+ * are few and go on to the ulp test.
+ * @return number of failing indices written to fails
+ */
+static size_t
+absPass( const double* a, const double* b, const size_t &n, const double &tol, double &maxErr, uint32_t* fails )
+{
+  size_t i = 0, numFails = 0;
+ #ifdef __SSE2__
+  const __m128d signBit = _mm_set1_pd( -0.0 );
+  const __m128d vtol = _mm_set1_pd( tol );
+  __m128d vmax = _mm_set1_pd( maxErr );
+  for( ; i + 2 <= n; i += 2 ) {
+    __m128d d = _mm_andnot_pd( signBit, _mm_sub_pd( _mm_loadu_pd( a + i ), _mm_loadu_pd( b + i ) ) );
+    vmax = _mm_max_pd( d, vmax ); // A NaN d leaves vmax be
+    int ok = _mm_movemask_pd( _mm_cmple_pd( d, vtol ) );
+    if( ok != 3 ) {
+      if( !(ok & 1) ) fails[numFails++] = i;
+      if( !(ok & 2) ) fails[numFails++] = i + 1;
+    }
+  }
+  double lanes[2];
+  _mm_storeu_pd( lanes, vmax );
+  maxErr = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+ #endif // __SSE2__
+  for( ; i < n; i++ ) {
+    double d = fabs( a[i] - b[i] );
+    if( d > maxErr ) maxErr = d;
+    if( !(d <= tol) ) fails[numFails++] = i;
+  }
+  return numFails;
+}
+
+/** One thread's share, samples beg up to end */
+static void
+diffRange( const char* a, const char* b, const NumberFormats &fmt, const unsigned int &size,
+           const size_t &beg, const size_t &end, const DiffTolerance &tol, DiffReport &report )
+{
+  report = DiffReport();
+  report.compared = end - beg;
+
+  bool isDbl = size == sizeof(double) && fmt != NUM_INT;
+  bool isFlt = fmt == NUM_FLT && size == sizeof(float);
+  std::vector<double> stageA( isDbl ? 0 : DIFF_BLOCK ), stageB( isDbl ? 0 : DIFF_BLOCK );
+  std::vector<uint32_t> fails( DIFF_BLOCK );
+
+  for( size_t blk = beg; blk < end; blk += DIFF_BLOCK ) {
+    size_t n = end - blk < DIFF_BLOCK ? end - blk : DIFF_BLOCK;
+    const char* pa = a + blk * size;
+    const char* pb = b + blk * size;
+    if( !memcmp( pa, pb, n * size ) )
+      continue;
+
+    const double *xa = (const double*)pa, *xb = (const double*)pb;
+    if( !isDbl ) {
+      samplesToDouble( pa, fmt, size, &stageA[0], n );
+      samplesToDouble( pb, fmt, size, &stageB[0], n );
+      xa = &stageA[0];
+      xb = &stageB[0];
+    }
+
+    size_t numFails = absPass( xa, xb, n, tol.absTol, report.maxAbsErr, &fails[0] );
+    for( size_t k = 0; k < numFails; k++ ) {
+      size_t idx = fails[k];
+      bool nan = isnan( xa[idx] ) || isnan( xb[idx] );
+      uint64_t ulps;
+      if( nan )
+        ulps = isnan( xa[idx] ) && isnan( xb[idx] ) ? 0 : UINT64_MAX;
+      else if( xa[idx] == xb[idx] )
+        ulps = 0;
+      else if( isFlt )
+        ulps = ulpDistance( (float)xa[idx], (float)xb[idx] );
+      else if( isDbl )
+        ulps = ulpDistance( xa[idx], xb[idx] );
+      else
+        ulps = (uint64_t)fabs( xa[idx] - xb[idx] ); // Integers step by one
+
+      if( ulps > report.maxUlpErr )
+        report.maxUlpErr = ulps;
+      if( ulps <= tol.maxUlps )
+        continue;
+      if( !report.mismatches )
+        report.firstMismatch = blk + idx;
+      report.mismatches++;
+      if( nan )
+        report.maxAbsErr = INFINITY;
+    }
+  }
+}
+
+bool
+diffSamples( const char* a, const char* b, const NumberFormats &fmt, const unsigned int &size,
+             const size_t &numSamps, const DiffTolerance &tol, DiffReport &report )
+{
+  report = DiffReport();
+  double probe;
+  if( !samplesToDouble( a, fmt, size, &probe, 0 ) ) {
+    std::cerr << "diffSamples() no sample type of size " << size << " format " << fmt << "!" << &std::endl;
+    return false;
+  }
+
+  unsigned int numThreads = threadsFor( numSamps, diffThreadSamps.load( std::memory_order_relaxed ), diffThreads.load( std::memory_order_relaxed ) );
+
+  // Whole blocks per thread, so block boundaries match a single thread's
+  size_t per = (numSamps + numThreads - 1) / numThreads;
+  per = (per + DIFF_BLOCK - 1) / DIFF_BLOCK * DIFF_BLOCK;
+
+  std::vector<DiffReport> parts( numThreads );
+  runThreads( numThreads, [&]( unsigned int t ) {
+    size_t beg = t * per < numSamps ? t * per : numSamps;
+    size_t end = beg + per < numSamps ? beg + per : numSamps;
+    diffRange( a, b, fmt, size, beg, end, tol, parts[t] );
+  } );
+
+  // Parts are in sample order, so the first to mismatch has the first mismatch
+  for( unsigned int t = 0; t < numThreads; t++ ) {
+    if( parts[t].mismatches && !report.mismatches )
+      report.firstMismatch = parts[t].firstMismatch;
+    report.compared += parts[t].compared;
+    report.mismatches += parts[t].mismatches;
+    if( parts[t].maxAbsErr > report.maxAbsErr )
+      report.maxAbsErr = parts[t].maxAbsErr;
+    if( parts[t].maxUlpErr > report.maxUlpErr )
+      report.maxUlpErr = parts[t].maxUlpErr;
+  }
+  return true;
+}
+
+void
+setDiffThreads( const unsigned int &numThreads )
+{
+  diffThreads.store( numThreads, std::memory_order_relaxed );
+}
+
+void
+setDiffThreadSamps( const size_t &numSamps )
+{
+  diffThreadSamps.store( numSamps ? numSamps : DIFF_THREAD_SAMPS, std::memory_order_relaxed );
+}
+
+bool
+testDataDiff()
+{
+  const size_t n = 3 * DIFF_BLOCK + 17;
+  std::vector<double> a( n ), b( n );
+  for( size_t i = 0; i < n; i++ )
+    a[i] = b[i] = sin( i * 0.01 ) * 1000.0;
+  DiffReport rep;
+
+  // Equal, then a few ulps off in the last block
+  DiffTolerance tol = exactTolerance();
+  if( !diffSamples( (const char*)&a[0], (const char*)&b[0], NUM_DBL, 8, n, tol, rep ) ||
+      rep.mismatches || rep.compared != n || rep.maxAbsErr != 0.0 )
+    return DRATS;
+  b[n - 5] = nextafter( nextafter( a[n - 5], 1e9 ), 1e9 );
+  b[n - 3] = -b[n - 3];
+  diffSamples( (const char*)&a[0], (const char*)&b[0], NUM_DBL, 8, n, tol, rep );
+  if( rep.mismatches != 2 || rep.firstMismatch != n - 5 || rep.maxAbsErr != fabs( 2.0 * a[n - 3] ) )
+    return DRATS;
+  tol.maxUlps = 2;
+  diffSamples( (const char*)&a[0], (const char*)&b[0], NUM_DBL, 8, n, tol, rep );
+  if( rep.mismatches != 1 || rep.firstMismatch != n - 3 )
+    return DRATS;
+  tol.absTol = fabs( 2.0 * a[n - 3] );
+  diffSamples( (const char*)&a[0], (const char*)&b[0], NUM_DBL, 8, n, tol, rep );
+  if( rep.mismatches || rep.maxUlpErr )
+    return DRATS;
+
+  // NaN matches only NaN, -0 matches +0
+  b[7] = NAN;
+  diffSamples( (const char*)&a[0], (const char*)&b[0], NUM_DBL, 8, n, tol, rep );
+  if( rep.mismatches != 1 || rep.firstMismatch != 7 || !isinf( rep.maxAbsErr ) )
+    return DRATS;
+  a[7] = NAN;
+  a[9] = 0.0;
+  b[9] = -0.0;
+  diffSamples( (const char*)&a[0], (const char*)&b[0], NUM_DBL, 8, n, exactTolerance(), rep );
+  if( rep.mismatches != 2 || rep.firstMismatch != n - 5 )
+    return DRATS;
+
+  // Split across threads, whole blocks each and one with none, the report
+  // is the one of a single thread.  The ulp off is a mismatch only when exact
+  b[DIFF_BLOCK + 5] += 1.0;
+  b[2 * DIFF_BLOCK] = nextafter( a[2 * DIFF_BLOCK], 1e9 );
+  DiffTolerance tols[2] = { exactTolerance(), exactTolerance() };
+  tols[1].maxUlps = 1;
+  for( int t = 0; t < 2; t++ ) {
+    DiffReport one, split;
+    diffSamples( (const char*)&a[0], (const char*)&b[0], NUM_DBL, 8, n, tols[t], one );
+    setDiffThreads( 4 );
+    setDiffThreadSamps( DIFF_BLOCK );
+    bool ok = diffSamples( (const char*)&a[0], (const char*)&b[0], NUM_DBL, 8, n, tols[t], split );
+    setDiffThreads( 0 );
+    setDiffThreadSamps( 0 );
+    if( !ok || split.compared != one.compared || split.mismatches != one.mismatches || split.firstMismatch != one.firstMismatch ||
+        split.maxAbsErr != one.maxAbsErr || split.maxUlpErr != one.maxUlpErr || one.mismatches != 4ULL - t )
+      return DRATS;
+  }
+
+  // Integers count steps as ulps
+  std::vector<int16_t> ia( n, 100 ), ib( n, 100 );
+  ib[DIFF_BLOCK + 1] = 103;
+  tol.absTol = 0.0;
+  tol.maxUlps = 2;
+  diffSamples( (const char*)&ia[0], (const char*)&ib[0], NUM_INT, 2, n, tol, rep );
+  if( rep.mismatches != 1 || rep.firstMismatch != DIFF_BLOCK + 1 || rep.maxUlpErr != 3 || rep.maxAbsErr != 3.0 )
+    return DRATS;
+
+  // Floats in their own ulps
+  std::vector<float> fa( n, 1.0f ), fb( n, 1.0f );
+  fb[0] = nextafterf( 1.0f, 2.0f );
+  tol.maxUlps = 1;
+  diffSamples( (const char*)&fa[0], (const char*)&fb[0], NUM_FLT, 4, n, tol, rep );
+  if( rep.mismatches || rep.maxUlpErr != 1 )
+    return DRATS;
+
+  return VOILA;
+}
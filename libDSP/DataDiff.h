@@ -0,0 +1,88 @@
+#ifndef __DATADIFF_H__
+#define __DATADIFF_H__
+
+/**
+  * DataDiff
+  * Copyright 2016, ShotSpotter
+  */
+
+#include "libCore/libCore.h"
+
+/**
+  * Typed sample comparison for regression runs.  Two samples match if
+  * they are within absTol of each other, or within maxUlps units in the
+  * last place of their stored float or double type.  Integer samples
+  * count a step of one as their ulp.  NaN matches only NaN.
+  */
+struct DiffTolerance
+{
+  /** Largest absolute difference that still matches */
+  double absTol;
+
+  /** Largest difference in ulps that still matches */
+  uint64_t maxUlps;
+};
+
+/**
+  * What a comparison found.  Sample indices run in the order the samples
+  * were handed over, row by row for DataCommon.
+  */
+struct DiffReport
+{
+  /** Samples compared */
+  unsigned long long compared;
+
+  /** Samples that did not match */
+  unsigned long long mismatches;
+
+  /** Index of the first sample that did not match, valid if mismatches */
+  unsigned long long firstMismatch;
+
+  /** Largest absolute difference of any sample, infinite if a NaN mismatched */
+  double maxAbsErr;
+
+  /** Largest difference in ulps of any sample not within absTol */
+  uint64_t maxUlpErr;
+};
+
+/**
+ * Tolerance of exact equality, bar -0 equals +0 and NaN equals NaN.
+ * @return the tolerance
+ */
+inline DiffTolerance exactTolerance() { DiffTolerance tol = { 0.0, 0 }; return tol; }
+
+/**
+ * Compare two runs of stored samples.  Runs of bitwise equal samples are
+ * skipped at memory speed, the rest are compared in SIMD registers, and
+ * runs of more than a few million samples are split across threads.
+ * @param a numSamps stored samples
+ * @param b numSamps stored samples, same format as a
+ * @param fmt number format of both
+ * @param size element size of both in bytes
+ * @param numSamps number of samples
+ * @param tol what still counts as a match
+ * @param report what was found
+ * @return false if fmt and size are not a stored format
+ */
+bool diffSamples( const char* a, const char* b, const NumberFormats &fmt, const unsigned int &size,
+                  const size_t &numSamps, const DiffTolerance &tol, DiffReport &report );
+
+/**
+ * Set the number of threads big comparisons are split across.
+ * @param numThreads threads wanted, zero for one per core
+ */
+void setDiffThreads( const unsigned int &numThreads );
+
+/**
+ * Set the fewest samples worth a comparison thread of their own.
+ * @param numSamps samples per thread, zero for the default
+ */
+void setDiffThreadSamps( const size_t &numSamps );
+
+/**
+ * Run the regression test for the comparisons.  Return 0 if good.
+ * @return bool
+ */
+bool testDataDiff();
+
+#endif // __DATADIFF_H__
@@ -0,0 +1,170 @@
+#include "DataView.h"
+#include "Transpose.h"
+#include "TimeData.h"
+#include "EventData.h"
+
+/**
+  * class DataView
+  * Copyright 2016, ShotSpotter
+  */
+
+DataView::DataView()
+{
+  data = NULL;
+  rows = 0;
+  cols = 1;
+  size = 4;
+  numFmt = NUM_INT;
+  stride = size;
+  colStride = size;
+  sampleRate = 0.0;
+}
+
+DataView::DataView( const char* ptr, const unsigned long long &numRows, const unsigned int &numCols,
+                    const unsigned int &eltSize, const NumberFormats &fmt, const TimeObj &start, const double &rate,
+                    const size_t &rowStride, const size_t &columnStride )
+{
+  data = ptr;
+  rows = ptr ? numRows : 0;
+  cols = numCols;
+  size = eltSize;
+  numFmt = fmt;
+  stride = rowStride ? rowStride : getRowSize();
+  colStride = columnStride && cols > 1 ? columnStride : size;
+  utc = start;
+  sampleRate = rate;
+}
+
+
+DataView
+DataView::subView( const unsigned long long &firstRow, const unsigned long long &numRows ) const
+{
+  unsigned long long beg = firstRow < rows ? firstRow : rows;
+  unsigned long long num = numRows < rows - beg ? numRows : rows - beg;
+
+  TimeObj start( utc );
+  if( sampleRate > 0.0 && beg )
+    start = utc + TimeObj( beg / sampleRate );
+
+  return DataView( num ? getRow( beg ) : NULL, num, cols, size, numFmt, start, sampleRate, stride, colStride );
+}
+
+
+DataView
+DataView::column( const unsigned int &col ) const
+{
+  if( col >= cols )
+    return DataView( NULL, 0, 1, size, numFmt, utc, sampleRate );
+  return DataView( data ? data + col * colStride : NULL, rows, 1, size, numFmt, utc, sampleRate, stride );
+}
+
+
+void
+DataView::copyTo( char* dst ) const
+{
+  if( !rows )
+    return;
+
+  if( isContiguous() ) {
+    memcpy( dst, data, getByteSize() );
+    return;
+  }
+
+  size_t rowBytes = getRowSize();
+  if( colStride == size ) {
+    for( unsigned long long r = 0; r < rows; r++ )
+      memcpy( dst + r * rowBytes, data + r * stride, rowBytes );
+    return;
+  }
+
+  // Planar, columns are the rows of the source
+  if( stride == size ) {
+    transposeBlocked( data, colStride, dst, rowBytes, cols, rows, size );
+    return;
+  }
+
+  for( unsigned long long r = 0; r < rows; r++ )
+    for( unsigned int c = 0; c < cols; c++ )
+      memcpy( dst + r * rowBytes + c * size, getElt( r, c ), size );
+}
+
+
+bool
+DataView::testClass()
+{
+  // Ten rows of three columns at 100 Hz, interleaved and planar, and
+  // interleaved with a spare element after each row
+  const unsigned long long numRows = 10;
+  const unsigned int numCols = 3;
+  std::vector<int16_t> rowMajor( numRows * numCols ), planar( rowMajor.size() ), padded( numRows * 4 );
+  for( unsigned long long r = 0; r < numRows; r++ )
+    for( unsigned int c = 0; c < numCols; c++ ) {
+      int16_t v = (int16_t)( 100 * c + r );
+      rowMajor[r * numCols + c] = planar[c * numRows + r] = padded[r * 4 + c] = v;
+    }
+  TimeObj t0( (time_t)1300000000, 0 );
+  const size_t sz = sizeof(int16_t);
+  DataView rv( (const char*)&rowMajor[0], numRows, numCols, sz, NUM_INT, t0, 100.0 );
+  DataView pv( (const char*)&planar[0], numRows, numCols, sz, NUM_INT, t0, 100.0, sz, numRows * sz );
+  DataView sv( (const char*)&padded[0], numRows, numCols, sz, NUM_INT, t0, 100.0, 4 * sz );
+  if( !rv.isContiguous() || rv.isPlanar() || !pv.isPlanar() || pv.isContiguous() || sv.isContiguous() || sv.isPlanar() ) return DRATS;
+  if( rv.getRowSize() != numCols * sz || sv.getByteSize() != rowMajor.size() * sz || sv.getStride() != 4 * sz ) return DRATS;
+
+  // Every layout reads the same, and copies out the same packed rows
+  const DataView* views[] = { &rv, &pv, &sv };
+  for( int v = 0; v < 3; v++ ) {
+    const DataView &dv = *views[v];
+    for( unsigned long long r = 0; r < numRows; r++ )
+      for( unsigned int c = 0; c < numCols; c++ )
+        if( *(const int16_t*)dv.getElt( r, c ) != rowMajor[r * numCols + c] ) return DRATS;
+    std::vector<int16_t> out( rowMajor.size() );
+    dv.copyTo( (char*)&out[0] );
+    if( out != rowMajor ) return DRATS;
+
+    // A run of rows starts later, clipped to what there is
+    DataView sub = dv.subView( 4, 3 );
+    if( sub.getRows() != 3 || sub.getUTC() != t0 + TimeObj( 4 / 100.0 ) || sub.getStride() != dv.getStride() ) return DRATS;
+    out.assign( 3 * numCols, 0 );
+    sub.copyTo( (char*)&out[0] );
+    if( memcmp( &out[0], &rowMajor[4 * numCols], 3 * numCols * sz ) ) return DRATS;
+    if( dv.subView( 8, 10 ).getRows() != 2 || !dv.subView( 20, 1 ).isEmpty() ) return DRATS;
+
+    // A column keeps the stride, contiguous only out of planar rows
+    DataView col = dv.column( 2 );
+    if( col.getCols() != 1 || col.getStride() != dv.getStride() || col.isContiguous() != ( v == 1 ) ) return DRATS;
+    for( unsigned long long r = 0; r < numRows; r++ )
+      if( *(const int16_t*)col.getRow( r ) != (int16_t)( 200 + r ) ) return DRATS;
+    if( !dv.column( numCols ).isEmpty() ) return DRATS;
+  }
+
+  // Irregular rows keep their start time
+  DataView ev( (const char*)&rowMajor[0], numRows, numCols, sz, NUM_INT, t0 );
+  if( ev.subView( 5, 2 ).getUTC() != t0 ) return DRATS;
+
+  // Samples in the window, in place, in either layout
+  TimeData td;
+  if( !td.materialize( rv ) ) return DRATS;
+  DataView slice;
+  if( !td.slice( t0 + TimeObj( 0.025 ), t0 + TimeObj( 0.065 ), slice ) || slice.getRows() != 4 ) return DRATS;
+  if( slice.getData() != td.getData() + 3 * rv.getRowSize() || slice.getUTC() != t0 + TimeObj( 3 / 100.0 ) ) return DRATS;
+  if( !td.toPlanar() || !td.slice( t0 + TimeObj( 0.025 ), t0 + TimeObj( 0.065 ), slice ) || !slice.isPlanar() ) return DRATS;
+  std::vector<int16_t> out( 4 * numCols );
+  slice.copyTo( (char*)&out[0] );
+  if( memcmp( &out[0], &rowMajor[3 * numCols], out.size() * sz ) ) return DRATS;
+  if( td.slice( t0 + TimeObj( 1.0 ), t0 + TimeObj( 2.0 ), slice ) || !slice.isEmpty() ) return DRATS;
+
+  // Events starting in the window, timed by the first found
+  std::vector<double> evs( 5 * 2 );
+  for( int e = 0; e < 5; e++ ) {
+    evs[e * 2] = ( t0 + TimeObj( (double)e ) ).getDatenum();
+    evs[e * 2 + 1] = 0.5;
+  }
+  EventData ed( 19990101, 19990102 );
+  ed.setCols( 2 );
+  if( !ed.materialize( DataView( (const char*)&evs[0], 5, 2, sizeof(double), NUM_DBL, t0 ) ) ) return DRATS;
+  if( !ed.slice( t0 + TimeObj( 1.5 ), t0 + TimeObj( 3.5 ), slice ) || slice.getRows() != 2 ) return DRATS;
+  if( slice.getData() != ed.getData() + 2 * ed.getRowSize() || fabs( ( slice.getUTC() - ( t0 + TimeObj( 2.0 ) ) ).get() ) > 1e-4 ) return DRATS;
+  if( ed.slice( t0 + TimeObj( 5.5 ), t0 + TimeObj( 9.0 ), slice ) || !slice.isEmpty() ) return DRATS;
+
+  return VOILA;
+}
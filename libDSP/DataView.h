@@ -0,0 +1,195 @@
+#ifndef __DATAVIEW_H__
+#define __DATAVIEW_H__
+
+/**
+  * class DataView
+  * Copyright 2016, ShotSpotter
+  */
+
+#include "libCore/libCore.h"
+
+/**
+  * class DataView
+  * Non-owning window onto the rows of a DataCommon heir.  It is only a
+  * pointer, a shape and a start time, so slicing thousands of short
+  * windows out of a long record copies nothing.  Rows are stride bytes
+  * apart and columns colStride bytes apart, which lets a view pick single
+  * columns out of wider rows and describe planar data, where each column
+  * is a contiguous run and rows are one element apart.
+  * A view is valid while its owner is neither destroyed nor written to;
+  * copy it into an owner with DataCommon::materialize() to keep it longer.
+  */
+class DataView
+{
+public:
+
+  /**
+   * Empty Constructor
+   */
+  DataView();
+
+  /**
+   * Full Constructor
+   * @param ptr First row
+   * @param numRows Number of rows
+   * @param numCols Number of columns
+   * @param eltSize Element size in bytes
+   * @param fmt Number format of the elements
+   * @param start Time of the first row
+   * @param rate (optional) Rows per second, zero if irregular (events)
+   * @param rowStride (optional) Bytes from one row to the next, zero for packed
+   * @param columnStride (optional) Bytes from one column to the next, zero for eltSize
+   */
+  DataView( const char* ptr, const unsigned long long &numRows, const unsigned int &numCols,
+            const unsigned int &eltSize, const NumberFormats &fmt, const TimeObj &start, const double &rate = 0.0,
+            const size_t &rowStride = 0, const size_t &columnStride = 0 );
+
+  /**
+   * Get the first row
+   * @return pointer to the first row
+   */
+  const char* getData() const { return data; }
+
+  /**
+   * Get a row
+   * @param idx Index of the row
+   * @return pointer to the row
+   */
+  const char* getRow( const unsigned long long &idx ) const { return data + idx * stride; }
+
+  /**
+   * Get an element
+   * @param row Index of the row
+   * @param col Index of the column
+   * @return pointer to the element
+   */
+  const char* getElt( const unsigned long long &row, const unsigned int &col ) const
+  { return data + row * stride + col * colStride; }
+
+  /**
+   * @return the number of rows
+   */
+  unsigned long long getRows() const { return rows; }
+
+  /**
+   * @return the number of columns
+   */
+  unsigned int getCols() const { return cols; }
+
+  /**
+   * @return the element size in bytes
+   */
+  unsigned int getEltSize() const { return size; }
+
+  /**
+   * @return the number format of the elements
+   */
+  NumberFormats getNumFmt() const { return numFmt; }
+
+  /**
+   * @return bytes from one row to the next
+   */
+  size_t getStride() const { return stride; }
+
+  /**
+   * @return bytes from one column to the next
+   */
+  size_t getColStride() const { return colStride; }
+
+  /**
+   * @return bytes of data in each row
+   */
+  size_t getRowSize() const { return size * cols; }
+
+  /**
+   * @return bytes of data in the view, not counting any gaps between rows
+   */
+  size_t getByteSize() const { return getRowSize() * rows; }
+
+  /**
+   * @return the time of the first row
+   */
+  const TimeObj& getUTC() const { return utc; }
+
+  /**
+   * @return rows per second, zero if irregular
+   */
+  double getSampleRate() const { return sampleRate; }
+
+  /**
+   * @return true if there are no rows
+   */
+  bool isEmpty() const { return !rows; }
+
+  /**
+   * @return true if rows follow each other with no gaps, interleaved
+   */
+  bool isContiguous() const { return stride == getRowSize() && colStride == size; }
+
+  /**
+   * @return true if each column is a contiguous run of elements
+   */
+  bool isPlanar() const { return stride == size; }
+
+  /**
+   * Narrow to a run of rows.  For regular views the start time moves with
+   * the first row, irregular views keep theirs.
+   * @param firstRow Index of the first row wanted, clipped to rows
+   * @param numRows Rows wanted, clipped to what is left
+   * @return the narrower view
+   */
+  DataView subView( const unsigned long long &firstRow, const unsigned long long &numRows ) const;
+
+  /**
+   * Narrow to one column, the stride is kept.  Contiguous if the view is planar.
+   * @param col Column wanted
+   * @return the single column view, empty if col is out of range
+   */
+  DataView column( const unsigned int &col ) const;
+
+  /**
+   * Copy the rows out packed and interleaved, dropping any gaps between
+   * them.  Planar views are transposed on the way.
+   * @param dst Buffer of at least getByteSize() bytes
+   */
+  void copyTo( char* dst ) const;
+
+  /**
+   * Run the regression test for this class, with the slices TimeData and
+   * EventData make.  Return 0 if good.
+   * @return bool
+   */
+  static bool testClass();
+
+private:
+
+  /** First row */
+  const char* data;
+
+  /** Number of rows */
+  unsigned long long rows;
+
+  /** Number of columns */
+  unsigned int cols;
+
+  /** Element size in bytes */
+  unsigned int size;
+
+  /** Number format of the elements */
+  NumberFormats numFmt;
+
+  /** Bytes from one row to the next */
+  size_t stride;
+
+  /** Bytes from one column to the next */
+  size_t colStride;
+
+  /** Time of the first row */
+  TimeObj utc;
+
+  /** Rows per second, zero if irregular */
+  double sampleRate;
+
+};
+
+#endif // __DATAVIEW_H__
@@ -0,0 +1,309 @@
+#include "DeltaCodec.h"
+#include "NativeFormat.h"
+
+/**
+  * DeltaCodec
+  * Copyright 2016, ShotSpotter
+  */
+
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Frame header, predictor order in the top two bits */
+#define DELTA_ORDER_SHIFT 6
+#define DELTA_WIDTH_MASK 0x3f
+
+static inline uint32_t zigzag( const uint32_t &u ) { return (u << 1) ^ (0u - (u >> 31)); }
+static inline uint32_t unzigzag( const uint32_t &z ) { return (z >> 1) ^ (0u - (z & 1)); }
+
+/**
+ * Pack DELTA_FRAME values of width bits, lane j of four taking values
+ * j, j+4, j+8 ..., into 4 * width words.
+ */
+static void
+pack128( const uint32_t* in, const unsigned int &width, char* out )
+{
+  if( !width )
+    return;
+ #ifdef __SSE2__
+  __m128i acc = _mm_setzero_si128();
+  unsigned int bits = 0;
+  for( int i = 0; i < DELTA_FRAME / 4; i++ ) {
+    __m128i v = _mm_loadu_si128( (const __m128i*)(in + 4 * i) );
+    acc = _mm_or_si128( acc, _mm_sll_epi32( v, _mm_cvtsi32_si128( bits ) ) );
+    bits += width;
+    if( bits >= 32 ) {
+      _mm_storeu_si128( (__m128i*)out, acc );
+      out += 16;
+      bits -= 32;
+      acc = bits ? _mm_srl_epi32( v, _mm_cvtsi32_si128( width - bits ) ) : _mm_setzero_si128();
+    }
+  }
+ #else
+  for( int lane = 0; lane < 4; lane++ ) {
+    uint64_t acc = 0;
+    unsigned int bits = 0, word = 0;
+    for( int i = 0; i < DELTA_FRAME / 4; i++ ) {
+      acc |= (uint64_t)in[4 * i + lane] << bits;
+      bits += width;
+      if( bits >= 32 ) {
+        uint32_t w = (uint32_t)acc;
+        memcpy( out + 16 * word++ + 4 * lane, &w, 4 );
+        acc >>= 32;
+        bits -= 32;
+      }
+    }
+  }
+ #endif // __SSE2__
+}
+
+/** Inverse of pack128() */
+static void
+unpack128( const char* in, const unsigned int &width, uint32_t* out )
+{
+  if( !width ) {
+    memset( out, 0, DELTA_FRAME * sizeof(uint32_t) );
+    return;
+  }
+ #ifdef __SSE2__
+  const __m128i mask = _mm_set1_epi32( width == 32 ? 0xffffffffu : (1u << width) - 1 );
+  __m128i cur = _mm_loadu_si128( (const __m128i*)in );
+  in += 16;
+  unsigned int bits = 0;
+  for( int i = 0; i < DELTA_FRAME / 4; i++ ) {
+    __m128i v = _mm_srl_epi32( cur, _mm_cvtsi32_si128( bits ) );
+    bits += width;
+    if( bits >= 32 ) {
+      bits -= 32;
+      // Never read past the frame, its last value ends on a word
+      if( bits || i + 1 < DELTA_FRAME / 4 ) {
+        cur = _mm_loadu_si128( (const __m128i*)in );
+        in += 16;
+      }
+      if( bits )
+        v = _mm_or_si128( v, _mm_sll_epi32( cur, _mm_cvtsi32_si128( width - bits ) ) );
+    }
+    _mm_storeu_si128( (__m128i*)(out + 4 * i), _mm_and_si128( v, mask ) );
+  }
+ #else
+  uint64_t mask = width == 32 ? 0xffffffffull : (1ull << width) - 1;
+  for( int lane = 0; lane < 4; lane++ ) {
+    uint64_t acc = 0;
+    unsigned int bits = 0, word = 0;
+    for( int i = 0; i < DELTA_FRAME / 4; i++ ) {
+      if( bits < width ) {
+        uint32_t w;
+        memcpy( &w, in + 16 * word++ + 4 * lane, 4 );
+        acc |= (uint64_t)w << bits;
+        bits += 32;
+      }
+      out[4 * i + lane] = (uint32_t)(acc & mask);
+      acc >>= width;
+      bits -= width;
+    }
+  }
+ #endif // __SSE2__
+}
+
+/** Up to DELTA_FRAME samples of one column, widened */
+static void
+loadColumn( const char* src, const size_t &rowBytes, const unsigned int &size, const unsigned int &num, uint32_t* x )
+{
+  for( unsigned int i = 0; i < num; i++, src += rowBytes ) {
+    if( size == 2 ) {
+      int16_t v;
+      memcpy( &v, src, 2 );
+      x[i] = (uint32_t)(int32_t)v;
+    } else if( size == 3 ) {
+      const uint8_t* b = (const uint8_t*)src;
+      uint32_t v = b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16;
+      x[i] = (v ^ 0x800000u) - 0x800000u; // Sign extend
+    } else
+      memcpy( &x[i], src, 4 );
+  }
+}
+
+/** Inverse of loadColumn(), values are known to fit */
+static void
+storeColumn( const uint32_t* x, const unsigned int &num, const size_t &rowBytes, const unsigned int &size, char* dst )
+{
+  for( unsigned int i = 0; i < num; i++, dst += rowBytes ) {
+    if( size == 2 ) {
+      int16_t v = (int16_t)x[i];
+      memcpy( dst, &v, 2 );
+    } else if( size == 3 ) {
+      dst[0] = (char)x[i];
+      dst[1] = (char)(x[i] >> 8);
+      dst[2] = (char)(x[i] >> 16);
+    } else
+      memcpy( dst, &x[i], 4 );
+  }
+}
+
+size_t
+deltaEncodeBound( const unsigned long long &numRows, const unsigned int &numCols )
+{
+  size_t frames = (numRows + DELTA_FRAME - 1) / DELTA_FRAME * numCols;
+  return sizeof(DeltaBlockHeader) + frames * (1 + 4 * DELTA_FRAME) + NATIVE_ALIGN;
+}
+
+size_t
+deltaEncode( const char* src, const unsigned long long &numRows, const unsigned int &numCols,
+             const unsigned int &size, char* dst )
+{
+  if( size < 2 || size > 4 || numRows > UINT32_MAX ) {
+    std::cerr << "deltaEncode() can't code " << numRows << " rows of size " << size << "!" << &std::endl;
+    return 0;
+  }
+
+  size_t rowBytes = numCols * size;
+  char* out = dst + sizeof(DeltaBlockHeader);
+  uint32_t x[DELTA_FRAME];
+  uint32_t res[3][DELTA_FRAME];
+
+  for( unsigned int c = 0; c < numCols; c++ ) {
+    uint32_t h1 = 0, h2 = 0; // The two samples before the frame
+    for( unsigned long long s = 0; s < numRows; s += DELTA_FRAME ) {
+      unsigned int num = numRows - s < DELTA_FRAME ? numRows - s : DELTA_FRAME;
+      loadColumn( src + s * rowBytes + c * size, rowBytes, size, num, x );
+
+      // Residuals of each order, wrapping, so any int32 comes back exactly
+      uint32_t ors[3] = { 0, 0, 0 };
+      uint32_t p1 = h1, p2 = h2;
+      for( unsigned int i = 0; i < num; i++ ) {
+        uint32_t u = x[i];
+        res[0][i] = zigzag( u );
+        res[1][i] = zigzag( u - p1 );
+        res[2][i] = zigzag( u - 2 * p1 + p2 );
+        ors[0] |= res[0][i];
+        ors[1] |= res[1][i];
+        ors[2] |= res[2][i];
+        p2 = p1;
+        p1 = u;
+      }
+      h1 = p1;
+      h2 = p2;
+
+      unsigned int order = 0, width = 33;
+      for( unsigned int o = 0; o < 3; o++ ) {
+        unsigned int w = ors[o] ? 32 - __builtin_clz( ors[o] ) : 0;
+        if( w < width ) {
+          width = w;
+          order = o;
+        }
+      }
+      for( unsigned int i = num; i < DELTA_FRAME; i++ )
+        res[order][i] = 0;
+
+      *out++ = (char)(order << DELTA_ORDER_SHIFT | width);
+      pack128( res[order], width, out );
+      out += 16 * width;
+    }
+  }
+
+  // Pad, so the next block is aligned too
+  size_t total = out - dst;
+  size_t padded = (total + NATIVE_ALIGN - 1) / NATIVE_ALIGN * NATIVE_ALIGN;
+  memset( out, 0, padded - total );
+
+  DeltaBlockHeader bh;
+  bh.bytes = padded - sizeof(DeltaBlockHeader);
+  bh.rows = numRows;
+  bh.spare = 0;
+  memcpy( dst, &bh, sizeof(DeltaBlockHeader) );
+  return padded;
+}
+
+bool
+deltaDecode( const char* src, const size_t &srcBytes, const unsigned int &numCols,
+             const unsigned int &size, char* dst, unsigned long long &numRows )
+{
+  numRows = 0;
+  DeltaBlockHeader bh;
+  if( srcBytes < sizeof(DeltaBlockHeader) || size < 2 || size > 4 ) {
+    std::cerr << "deltaDecode() block is malformed!" << &std::endl;
+    return false;
+  }
+  memcpy( &bh, src, sizeof(DeltaBlockHeader) );
+  if( bh.bytes > srcBytes - sizeof(DeltaBlockHeader) ) {
+    std::cerr << "deltaDecode() block is truncated!" << &std::endl;
+    return false;
+  }
+
+  const char* in = src + sizeof(DeltaBlockHeader);
+  const char* end = in + bh.bytes;
+  size_t rowBytes = numCols * size;
+  uint32_t res[DELTA_FRAME], x[DELTA_FRAME];
+
+  for( unsigned int c = 0; c < numCols; c++ ) {
+    uint32_t h1 = 0, h2 = 0;
+    for( unsigned long long s = 0; s < bh.rows; s += DELTA_FRAME ) {
+      unsigned int num = bh.rows - s < DELTA_FRAME ? bh.rows - s : DELTA_FRAME;
+      if( in >= end ) {
+        std::cerr << "deltaDecode() block is truncated!" << &std::endl;
+        return false;
+      }
+      unsigned int order = (uint8_t)*in >> DELTA_ORDER_SHIFT;
+      unsigned int width = (uint8_t)*in & DELTA_WIDTH_MASK;
+      in++;
+      if( order > 2 || width > 32 || (size_t)(end - in) < 16 * width ) {
+        std::cerr << "deltaDecode() frame is malformed!" << &std::endl;
+        return false;
+      }
+      unpack128( in, width, res );
+      in += 16 * width;
+
+      uint32_t p1 = h1, p2 = h2;
+      for( unsigned int i = 0; i < num; i++ ) {
+        uint32_t u = unzigzag( res[i] );
+        if( order == 1 )
+          u += p1;
+        else if( order == 2 )
+          u += 2 * p1 - p2;
+        x[i] = u;
+        p2 = p1;
+        p1 = u;
+      }
+      h1 = p1;
+      h2 = p2;
+      storeColumn( x, num, rowBytes, size, dst + s * rowBytes + c * size );
+    }
+  }
+
+  numRows = bh.rows;
+  return true;
+}
+
+bool
+testDeltaCodec()
+{
+  // A slow sine with noise and a glitch, in every size, odd lengths
+  const unsigned long long numRows = 3 * DELTA_FRAME + 41;
+  const unsigned int numCols = 3;
+  for( unsigned int size = 2; size <= 4; size++ ) {
+    std::vector<char> rows( numRows * numCols * size ), back( rows.size() );
+    std::vector<char> coded( deltaEncodeBound( numRows, numCols ) );
+    uint32_t full = size == 4 ? 0xffffffffu : (1u << (8 * size)) - 1;
+    for( unsigned long long r = 0; r < numRows; r++ ) {
+      for( unsigned int c = 0; c < numCols; c++ ) {
+        uint32_t v = (uint32_t)(int32_t)(1000.0 * sin( r * 0.01 * (c + 1) )) + (r * 7919 % 13);
+        if( c == 2 && r == 200 ) v = full; // Largest step there is
+        if( c == 1 ) v = r % 2 ? 0x80000000u : 0x7fffffffu;
+        memcpy( &rows[(r * numCols + c) * size], &v, size );
+      }
+    }
+
+    size_t bytes = deltaEncode( &rows[0], numRows, numCols, size, &coded[0] );
+    unsigned long long got = 0;
+    if( !bytes || bytes % NATIVE_ALIGN || bytes > coded.size() )
+      return DRATS;
+    if( !deltaDecode( &coded[0], bytes, numCols, size, &back[0], got ) || got != numRows || rows != back )
+      return DRATS;
+    if( deltaDecode( &coded[0], bytes / 2, numCols, size, &back[0], got ) )
+      return DRATS;
+  }
+  return VOILA;
+}
@@ -0,0 +1,88 @@
+#ifndef __DELTACODEC_H__
+#define __DELTACODEC_H__
+
+/**
+  * DeltaCodec
+  * Copyright 2016, ShotSpotter
+  */
+
+#include "libCore/libCore.h"
+
+/**
+  * Lossless codec for blocks of integer rows, NATIVE_CODEC_DELTA.  Each
+  * column is coded on its own in frames of DELTA_FRAME samples.  A frame
+  * is predicted from its past by zero, first or second differences,
+  * whichever leaves the smallest residuals, and the zigzagged residuals
+  * are bit packed at the width of the largest, four lanes at a time:
+  *
+  *   DeltaBlockHeader   payload bytes and rows
+  *   for each column, for each frame:
+  *     uint8            predictor order << 6 | bit width
+  *     16 * width bytes residuals
+  *   padding            to a multiple of NATIVE_ALIGN
+  *
+  * Prediction starts over in every block, so any block decodes alone.
+  */
+
+/** Samples per frame, the unit of bit packing */
+#define DELTA_FRAME 128
+
+/**
+  * struct DeltaBlockHeader
+  * Front of every coded block, so blocks can be streamed without an index.
+  */
+struct DeltaBlockHeader
+{
+  uint64_t bytes;       /** Payload bytes following, padding included */
+  uint32_t rows;        /** Rows coded */
+  uint32_t spare;
+};
+
+/**
+ * Can the codec take samples of this format?
+ * @param fmt number format
+ * @param size element size in bytes
+ * @return true for NUM_INT of 2, 3 or 4 bytes
+ */
+inline bool deltaCodable( const NumberFormats &fmt, const unsigned int &size ) { return fmt == NUM_INT && size >= 2 && size <= 4; }
+
+/**
+ * Most bytes numRows rows can code to.
+ * @param numRows number of rows
+ * @param numCols number of columns
+ * @return bytes to allow for deltaEncode()
+ */
+size_t deltaEncodeBound( const unsigned long long &numRows, const unsigned int &numCols );
+
+/**
+ * Code a block of interleaved rows.
+ * @param src first row
+ * @param numRows number of rows, less than 2^32
+ * @param numCols number of columns
+ * @param size element size in bytes, see deltaCodable()
+ * @param dst at least deltaEncodeBound() bytes
+ * @return bytes written, header included, zero on failure
+ */
+size_t deltaEncode( const char* src, const unsigned long long &numRows, const unsigned int &numCols,
+                    const unsigned int &size, char* dst );
+
+/**
+ * Decode a block back to interleaved rows.
+ * @param src the coded block, header included
+ * @param srcBytes bytes available at src
+ * @param numCols number of columns
+ * @param size element size in bytes
+ * @param dst room for the block's rows
+ * @param numRows rows decoded
+ * @return false if the block is malformed
+ */
+bool deltaDecode( const char* src, const size_t &srcBytes, const unsigned int &numCols,
+                  const unsigned int &size, char* dst, unsigned long long &numRows );
+
+/**
+ * Run the regression test for the codec.  Return 0 if good.
+ * @return bool
+ */
+bool testDeltaCodec();
+
+#endif // __DELTACODEC_H__
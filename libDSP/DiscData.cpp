@@ -3,6 +3,11 @@
 */
 
 #include "DiscData.h"
+#include "AsciiFormat.h"
+
+#include <memory>
+#include <unistd.h>
+#include <sys/stat.h>
 
 bool
 DiscData::read( char *newFileName, int newFormat, char *formatStr ) 
@@ -14,9 +19,8 @@ DiscData::read( char *newFileName, int newFormat, char *formatStr )
 
 
    /* Ready read */
-    bool compressed = false;
     int format = newFormat;
-    FILE *inFid = DataCommon::readStart( newFileName, &format, &compressed );
+    FILE *inFid = fopen( newFileName, "r" );
     if( !inFid ) { SSTWARN( "File Open Failed!!!" ) return DRATS; }
 
 
@@ -36,7 +40,7 @@ DiscData::read( char *newFileName, int newFormat, char *formatStr )
 
 
    /* Close file */    
-    if( !DataCommon::readFinish( inFid, compressed ) ) SSTERR("File Close Failed!!!")
+    if( fclose( inFid ) ) SSTERR("File Close Failed!!!")
 
     return status;
 }
@@ -46,15 +50,11 @@ bool
 DiscData::readLabelsFile( FILE *inFid, char *fileName, char *formatStr ) 
 {
     char line[DISCRETE_DATA_MAX_LINE_LENGTH];
-    char fmtStr[512];
-    
-    char* dividers[DISCRETE_DATA_MAX_COLUMNS];
     int charCounter = 9;
-    unsigned int labelCounter = 1;
 
     
    /* Keep us honest */
-    if( labels || rows || cols || colTypes != 0 ) {
+    if( labels || rows || colTypes != 0 ) {
         SSTERR( "USAGE!!! Must remake object first or leak memory!!!!" );
     }
     
@@ -72,116 +72,112 @@ DiscData::readLabelsFile( FILE *inFid, char *fileName, char *formatStr )
         return DRATS;
     }
 
-    dividers[0] = line + charCounter - 1;
-    //fprintf( stderr, "%s\n", dividers[0] );  
-    while( line[charCounter] != '\n' ) {
-        if( line[charCounter] == '\t' ) {
-            dividers[labelCounter] = line + charCounter;
-            labelCounter++;
-        }
+   /* Tab divided, from the blank after '=' to the end of line */
+    std::vector<char*> dividers( 1, line + charCounter - 1 );
+    while( line[charCounter] && line[charCounter] != '\n' && line[charCounter] != '\r' ) {
+        if( line[charCounter] == '\t' ) dividers.push_back( line + charCounter );
         charCounter++;
     }
-    line[charCounter] = '\t';
+    dividers.push_back( line + charCounter );
+    unsigned int labelCounter = dividers.size() - 1;
     
 
    /* Discover labels, take all */
     unsigned int ith, labelLength=0;
     char *labelsTmp = (char*)malloc( DISCRETE_DATA_LABEL_LENGTH * labelCounter );
-    if( !labelsTmp ) SSTERR( "Malloc for labelTmp FAILED!!!!" );
-    for( ith = 0; ith < labelCounter-1; ith++ ) {
+    if( !labelsTmp ) { SSTWARN( "Malloc for labelTmp FAILED!!!!" ); return DRATS; }
+    for( ith = 0; ith < labelCounter; ith++ ) {
         labelLength = dividers[ith+1] - dividers[ith] - 1;
-        strncpy( labelsTmp+ith*DISCRETE_DATA_LABEL_LENGTH, dividers[ith]+1, labelLength );
+        if( labelLength >= DISCRETE_DATA_LABEL_LENGTH ) labelLength = DISCRETE_DATA_LABEL_LENGTH - 1;
+        memcpy( labelsTmp+ith*DISCRETE_DATA_LABEL_LENGTH, dividers[ith]+1, labelLength );
         labelsTmp[ith*DISCRETE_DATA_LABEL_LENGTH+labelLength] = '\0';
-        //fprintf( stderr, "label# = %d, labelLength = %d, label = |%s|\n", ith+1, labelLength, labelsTmp+ith*DISCRETE_DATA_LABEL_LENGTH );
     }
-    strncpy( labelsTmp+ith*DISCRETE_DATA_LABEL_LENGTH, dividers[ith]+1, (line+charCounter)-dividers[labelCounter-1]-1 );
-    labelsTmp[ith*DISCRETE_DATA_LABEL_LENGTH+labelLength] = '\0';
-    //fprintf( stderr, "label# = %d, labelLength = %d, label = |%s|\n", ith+1, labelLength, labelsTmp+ith*DISCRETE_DATA_LABEL_LENGTH );
 
 
    /* Parse and store labels, set up for read */
+    std::vector<bool> wanted;
     if( !formatStr ) {
     
-        fmtStr[0] = '\0';
-        for( ith = 0; ith < labelCounter; ith++ ) strcat( fmtStr, "%lf" );
+        wanted.assign( labelCounter, true );
         labels = labelsTmp;
         cols = labelCounter;
 
     } else {
     
-       /* sscanf string supplied, select labels */
-        int formatCharCounter = 0;
-        unsigned int formatCounter = 0;
-        int labelIndices[DISCRETE_DATA_MAX_COLUMNS];
-        labelCounter = 0;
-        while( formatStr[formatCharCounter] != '\0' ) {
+       /* scanf() style string supplied, select labels, %*lf columns are skipped */
+        std::vector<unsigned int> labelIndices;
+        for( int formatCharCounter = 0; formatStr[formatCharCounter] != '\0'; formatCharCounter++ ) {
             if( formatStr[formatCharCounter] == '%' ) {
-                if( formatStr[formatCharCounter+1] != '*' ) {
-                    labelIndices[labelCounter] = formatCounter;
-                    labelCounter++;
-                }
-                formatCounter++;
+                if( formatStr[formatCharCounter+1] != '*' ) labelIndices.push_back( wanted.size() );
+                wanted.push_back( formatStr[formatCharCounter+1] != '*' );
             }
-            formatCharCounter++;
         }
         
-        if( formatCounter < labelCounter ) SSTERR("FUPDUCK format");
-        //fprintf( stderr, "labelCounter = %d\n", labelCounter );
+        if( wanted.size() > labelCounter ) {
+            sprintf( errNote, "Format |%s| has more columns than file |%s| has labels!!!!", formatStr, fileName );
+            SSTWARN(errNote);
+            free( labelsTmp );
+            return DRATS;
+        }
         
-        labels = (char*)malloc( DISCRETE_DATA_LABEL_LENGTH * labelCounter );
-        if( !labels ) SSTERR( "Malloc for labels FAILED!!!!" );
-        cols = labelCounter;
+        labels = (char*)malloc( DISCRETE_DATA_LABEL_LENGTH * labelIndices.size() + 1 );
+        if( !labels ) { SSTWARN( "Malloc for labels FAILED!!!!" ); free( labelsTmp ); return DRATS; }
+        cols = labelIndices.size();
 
-        for( ith = 0; ith < labelCounter; ith++ ) {
+        for( ith = 0; ith < cols; ith++ ) {
             strcpy( labels+ith*DISCRETE_DATA_LABEL_LENGTH, labelsTmp+labelIndices[ith]*DISCRETE_DATA_LABEL_LENGTH );
-            //fprintf( stderr, "label# %d = %s = %s\n", ith, labels+ith*DISCRETE_DATA_LABEL_LENGTH, getLabel( ith ) );
         }
         
-        strcpy( fmtStr, formatStr );
         free( labelsTmp );
     } 
     
     
-   /* Now it's time to read !!!! */
-    {
-#if 0
-        double *a, *dataTmp;
-       // double b[DISCRETE_DATA_MAX_COLUMNS];
-        
-        dataTmp = (double*)malloc( labelCounter*sizeof(double)*DISCRETE_DATA_ROW_PAGE );
-        if( !dataTmp ) {
-            SSTERR("Malloc for data FAILED!!!!" );
-        }
-        
-        int linesRead = 0;
-        while( fgets( line, DISCRETE_DATA_MAX_LINE_LENGTH, inFid ) == line ) {
-            
-           // int numItemsRead = 0;
-            
-            a = dataTmp + labelCounter * linesRead;
-            
-            linesRead++;
-
-           /* Crude, but faster than stdarg! */
-            if( numItemsRead = sscanf( line, fmtStr, a, a+1, a+2, a+3, a+3, a+4, a+5, a+6, a+7, a+8, a+9, a+10, a+11, a+12, a+13, a+14, a+15, a+16, a+17, a+18, a+19, a+20, a+21, a+22, a+23, a+24, a+25, a+26, a+27, a+28, a+29, a+30, a+31 ) != labelCounter ) {
-                sprintf( errNote, "Choked on scan of line# %d.  Only %d out of %d items read!!\n", linesRead, numItemsRead, labelCounter );
-                SSTWARN( errNote );
-                return DRATS;
-            }
-             //fprintf( stderr, "time = %lf ma4 = %lf ma5 = %lf\n", a[0], a[1], a[2] ); 
-        }
-        
-       /* Huge very important assignments */
-        data = (char*)realloc( dataTmp, linesRead * cols * sizeof(double) );
-        rows = linesRead;
-        
-        for( ith = 0; ith < rows; ith++ ) {
-            a = ((double*)data + cols * ith);
-            //fprintf( stderr, "%s = %lf %s = %lf %s = %lf\n", getLabel(0), a[0], getLabel(1), a[1], getLabel(2), a[2] );
-        }
-#endif
+   /* Now it's time to read !!!!  The rows are mapped, cut into chunks for
+      threads, and parsed straight into one segment per column */
+    off_t dataOff = ftello( inFid );
+    struct stat st;
+    if( dataOff < 0 || fstat( fileno( inFid ), &st ) ) {
+        sprintf( errNote, "Problem finding rows of file |%s|!!!!", fileName );
+        SSTWARN(errNote);
+        return DRATS;
     }
-    
+    if( st.st_size <= dataOff || !cols ) return VOILA; /* Labels only */
+
+    char *text = (char*)mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno( inFid ), 0 );
+    if( text == MAP_FAILED ) {
+        sprintf( errNote, "Could not mmap() file |%s|: %s", fileName, strerror(errno) );
+        SSTWARN(errNote);
+        return DRATS;
+    }
+    madvise( text, st.st_size, MADV_SEQUENTIAL );
+
+    unsigned long long maxRows = 0, numRows = 0;
+    unsigned int lineFields;
+    asciiScan( text + dataOff, st.st_size - dataOff, maxRows, lineFields );
+
+    std::unique_ptr<bool[]> keep( new bool[wanted.size()] );
+    for( ith = 0; ith < wanted.size(); ith++ ) keep[ith] = wanted[ith];
+    std::vector<double*> columns( cols );
+    bool ok = !maxRows || allocData( cols * maxRows * sizeof(double) );
+    for( ith = 0; ok && ith < cols; ith++ ) columns[ith] = (double*)data + ith * maxRows;
+    ok = ok && (!maxRows || asciiParseColumns( text + dataOff, st.st_size - dataOff, wanted.size(), keep.get(), &columns[0], numRows ));
+    munmap( text, st.st_size );
+
+    if( !ok ) {
+        sprintf( errNote, "Choked on scan of rows of file |%s|!!!!", fileName );
+        SSTWARN( errNote );
+        if( data ) freeData();
+        return DRATS;
+    }
+
+   /* Close up the columns, blank and comment lines were counted as rows */
+    if( numRows < maxRows ) {
+        for( ith = 1; ith < cols; ith++ ) memmove( (double*)data + ith * numRows, columns[ith], numRows * sizeof(double) );
+        if( !numRows ) freeData();
+        else resizeData( cols * numRows * sizeof(double) );
+    }
+    rows = numRows;
+    interleaved = cols < 2;
  
     return VOILA;
 }
@@ -189,20 +185,23 @@ DiscData::readLabelsFile( FILE *inFid, char *fileName, char *formatStr )
 bool 
 DiscData::append( const DiscData &me ) 
 {
-    char *dataTmp;
-    
     if( !data ) { /* Start from scratch */
     
-        if( cols || rows || labels ) SSTERR("USAGE!!!");
-        
-        cols = me.cols;
-    
-        labels = (char*)malloc( cols*DISCRETE_DATA_LABEL_LENGTH );
-        if( !labels ) SSTERR("DiscData::append() malloc() FAILED!!!");
-        memcpy( labels, me.labels, cols*DISCRETE_DATA_LABEL_LENGTH);
+        if( rows ) { SSTWARN("USAGE!!! DiscData::append() rows without data"); return DRATS; }
 
-        dataTmp = (char*)malloc( cols*(rows+me.rows)*sizeof(double) );
-        if( !dataTmp ) SSTERR("DiscData::append() malloc() FAILED!!!");
+        if( labels ) { /* Columns, no rows yet, as read from an empty file */
+            if( me.cols != cols ) {
+                SSTWARN( "DiscData::append() column mismatch" );
+                return DRATS;
+            }
+        } else {
+            cols = me.cols;
+            labels = (char*)malloc( cols*DISCRETE_DATA_LABEL_LENGTH );
+            if( !labels ) { SSTWARN("DiscData::append() malloc() FAILED!!!"); return DRATS; }
+            memcpy( labels, me.labels, cols*DISCRETE_DATA_LABEL_LENGTH);
+        }
+
+        if( !allocData( cols*(rows+me.rows)*sizeof(double) ) ) { SSTERR("DiscData::append() malloc() FAILED!!!"); return DRATS; }
         
     } else { /* Add to existing */
 
@@ -222,14 +221,13 @@ DiscData::append( const DiscData &me )
             }
         }
 
-        dataTmp = (char*)realloc( data, cols*(rows+me.rows)*sizeof(double) );
-        if( !dataTmp ) SSTERR("DiscData::append() realloc() FAILED!!!");
+       /* Rows grow only when interleaved */
+        if( !toInterleaved() || !growCapacity( rows+me.rows ) ) { SSTERR("DiscData::append() realloc() FAILED!!!"); return DRATS; }
 
     }
-
-    data = dataTmp;
     
-    memcpy( data+cols*(rows)*sizeof(double), me.data, cols*(me.rows)*sizeof(double));
+    std::vector<char> scratch;
+    if( me.rows ) memcpy( data+cols*(rows)*sizeof(double), me.fileRows( 0, me.rows, scratch ), cols*(me.rows)*sizeof(double));
     
     rows += me.rows;
     
@@ -240,7 +238,7 @@ DiscData::append( const DiscData &me )
 // XXX Clark  Fast for now, needs abstraction with DataCommon yet
 
 bool
-DiscData::readBinaryFile( char *fileName ) 
+DiscData::readBinaryFile( char *fileName, const std::vector<std::string> &columns ) 
 {
     remakeInst();
     
@@ -252,22 +250,162 @@ DiscData::readBinaryFile( char *fileName )
         return DRATS;
     }
 
-    if( fread( &cols, sizeof(unsigned int), 1, inFid ) != 1 ) SSTERR("cols read failed!!!");
-    if( fread( &rows, sizeof(unsigned long long), 1, inFid ) != 1 ) SSTERR("rows read failed!!!");
-    
-    labels = (char*)malloc( DISCRETE_DATA_LABEL_LENGTH * cols );
-    if( !labels ) SSTERR( "Malloc for labels FAILED!!!!" );
-    if( fread( labels, DISCRETE_DATA_LABEL_LENGTH, cols, inFid ) != cols ) SSTERR("labels read failed!!!");
+   /* Columnar files say so, row files start straight in on cols */
+    char magic[DISC_COLUMN_MAGIC_BYTES];
+    bool columnar = fread( magic, DISC_COLUMN_MAGIC_BYTES, 1, inFid ) == 1 && !memcmp( magic, DISC_COLUMN_MAGIC, DISC_COLUMN_MAGIC_BYTES );
+    rewind( inFid );
+    if( columnar ) {
+        bool status = readColumnFile( inFid, fileName, columns );
+        fclose( inFid );
+        return status;
+    }
+
+    if( !readHeader( inFid ) ) { fclose( inFid ); return DRATS; }
     
-    data = (char*)malloc( cols*rows*sizeof(double) );
-    if( !data ) SSTERR("DiscData::append() malloc() FAILED!!!");
-    if( fread( data, sizeof(double), cols*rows, inFid ) != cols*rows ) SSTERR("data read failed!!!");
+    if( rows && !allocData( cols*rows*sizeof(double) ) ) {
+        SSTWARN("DiscData::readBinaryFile() malloc() FAILED!!!");
+        fclose( inFid );
+        remakeInst();
+        return DRATS;
+    }
+    if( rows && fread( data, sizeof(double), cols*rows, inFid ) != cols*rows ) {
+        sprintf( errNote, "File \"%s\" is short of its %llu rows!!!", fileName, rows );
+        SSTWARN( errNote );
+        fclose( inFid );
+        remakeInst();
+        return DRATS;
+    }
     
     fclose( inFid );
     
+   /* Rows hold every column, so read them all and keep the ones asked for */
+    if( !columns.empty() && !pickColumns( columns ) ) return DRATS;
+
     return VOILA;
 }
 
+bool
+DiscData::pickColumns( const std::vector<std::string> &columns )
+{
+    std::vector<unsigned int> picks;
+    for( size_t lth = 0; lth < columns.size(); lth++ ) {
+        unsigned int ith = 0;
+        while( ith < cols && columns[lth] != getLabel( ith ) ) ith++;
+        if( ith == cols ) {
+            sprintf( errNote, "DiscData has no column |%s|!!!", columns[lth].c_str() );
+            SSTWARN( errNote );
+            return false;
+        }
+        picks.push_back( ith );
+    }
+
+    char *picked = (char*)malloc( DISCRETE_DATA_LABEL_LENGTH * picks.size() );
+    char *buf = rows ? (char*)alloc->allocate( picks.size() * rows * sizeof(double) ) : NULL;
+    if( !picked || (rows && !buf) ) { SSTWARN( "DiscData::pickColumns() malloc() FAILED!!!" ); free( picked ); if( buf ) alloc->deallocate( buf ); return false; }
+
+    DataView view = getView();
+    for( size_t lth = 0; lth < picks.size(); lth++ ) {
+        memcpy( picked + lth * DISCRETE_DATA_LABEL_LENGTH, getLabel( picks[lth] ), DISCRETE_DATA_LABEL_LENGTH );
+        if( rows ) view.column( picks[lth] ).copyTo( buf + lth * rows * sizeof(double) );
+    }
+
+    free( labels );
+    labels = picked;
+    cols = picks.size();
+    interleaved = cols < 2;
+    adopt( buf, rows, NULL, cols * rows * sizeof(double) );
+    return true;
+}
+
+bool
+DiscData::readColumnFile( FILE *inFid, char *fileName, const std::vector<std::string> &columns )
+{
+    DiscColumnHeader hdr;
+    struct stat st;
+    if( fread( &hdr, sizeof(DiscColumnHeader), 1, inFid ) != 1 || fstat( fileno( inFid ), &st ) ||
+        hdr.rows > hdr.capacity || hdr.segBytes < hdr.capacity * sizeof(double) || hdr.segBytes % DISC_COLUMN_ALIGN ||
+        hdr.dataOffset % DISC_COLUMN_ALIGN || hdr.dataOffset < sizeof(DiscColumnHeader) + (uint64_t)hdr.cols * DISCRETE_DATA_LABEL_LENGTH ||
+        (uint64_t)st.st_size < hdr.dataOffset + hdr.cols * hdr.segBytes ) {
+        sprintf( errNote, "Columnar header of \"%s\" is malformed!!!", fileName );
+        SSTWARN( errNote );
+        return DRATS;
+    }
+
+    labels = (char*)malloc( DISCRETE_DATA_LABEL_LENGTH * hdr.cols + 1 );
+    if( !labels ) { SSTWARN( "Malloc for labels FAILED!!!!" ); return DRATS; }
+    if( fread( labels, DISCRETE_DATA_LABEL_LENGTH, hdr.cols, inFid ) != hdr.cols ) { SSTWARN("labels read failed!!!"); return DRATS; }
+    cols = hdr.cols;
+
+   /* Which segments, by label */
+    std::vector<unsigned int> picks;
+    for( size_t lth = 0; lth < columns.size(); lth++ ) {
+        unsigned int ith = 0;
+        while( ith < cols && columns[lth] != getLabel( ith ) ) ith++;
+        if( ith == cols ) {
+            sprintf( errNote, "File \"%s\" has no column |%s|!!!", fileName, columns[lth].c_str() );
+            SSTWARN( errNote );
+            return DRATS;
+        }
+        picks.push_back( ith );
+    }
+    if( columns.empty() ) for( unsigned int ith = 0; ith < cols; ith++ ) picks.push_back( ith );
+
+    char *picked = (char*)malloc( DISCRETE_DATA_LABEL_LENGTH * picks.size() + 1 );
+    if( !picked ) { SSTWARN( "Malloc for labels FAILED!!!!" ); return DRATS; }
+    for( size_t lth = 0; lth < picks.size(); lth++ ) memcpy( picked + lth * DISCRETE_DATA_LABEL_LENGTH, getLabel( picks[lth] ), DISCRETE_DATA_LABEL_LENGTH );
+    free( labels );
+    labels = picked;
+    cols = picks.size();
+    if( !hdr.rows || !cols ) return VOILA;
+
+   /* One column is used in place */
+    size_t colBytes = hdr.rows * sizeof(double);
+    if( cols == 1 ) return mapFile( fileName, hdr.dataOffset + picks[0] * hdr.segBytes, colBytes ) == hdr.rows ? VOILA : DRATS;
+
+   /* More are gathered, each segment mapped on its own so only its pages are read */
+    if( !allocData( cols * colBytes ) ) { SSTWARN( "DiscData::readColumnFile() malloc() FAILED!!!" ); return DRATS; }
+    for( size_t lth = 0; lth < picks.size(); lth++ ) {
+        off_t segOff = hdr.dataOffset + picks[lth] * hdr.segBytes;
+        char *dst = data + lth * colBytes;
+        void *seg = mmap( NULL, colBytes, PROT_READ, MAP_PRIVATE, fileno( inFid ), segOff );
+        if( seg != MAP_FAILED ) {
+            madvise( seg, colBytes, MADV_SEQUENTIAL );
+            memcpy( dst, seg, colBytes );
+            munmap( seg, colBytes );
+        } else if( pread( fileno( inFid ), dst, colBytes, segOff ) != (ssize_t)colBytes ) { /* Pages bigger than the alignment */
+            sprintf( errNote, "Column |%s| of \"%s\" could not be read!!!", getLabel( lth ), fileName );
+            SSTWARN( errNote );
+            freeData();
+            return DRATS;
+        }
+    }
+    rows = hdr.rows;
+    interleaved = false;
+
+    return VOILA;
+}
+
+bool
+DiscData::readHeader( FILE *inFid ) 
+{
+    if( labels ) { free( labels ); labels = NULL; }
+
+   /* Columnar files have no rows to stream */
+    char magic[DISC_COLUMN_MAGIC_BYTES];
+    off_t base = ftello( inFid );
+    if( fread( magic, DISC_COLUMN_MAGIC_BYTES, 1, inFid ) == 1 && !memcmp( magic, DISC_COLUMN_MAGIC, DISC_COLUMN_MAGIC_BYTES ) ) { SSTWARN("columnar files can't be read by row!!!"); return false; }
+    if( fseeko( inFid, base, SEEK_SET ) ) { SSTWARN("header rewind failed!!!"); return false; }
+
+    if( fread( &cols, sizeof(unsigned int), 1, inFid ) != 1 ) { SSTWARN("cols read failed!!!"); return false; }
+    if( fread( &rows, sizeof(unsigned long long), 1, inFid ) != 1 ) { SSTWARN("rows read failed!!!"); return false; }
+    
+    labels = (char*)malloc( DISCRETE_DATA_LABEL_LENGTH * cols );
+    if( !labels ) { SSTWARN( "Malloc for labels FAILED!!!!" ); return false; }
+    if( fread( labels, DISCRETE_DATA_LABEL_LENGTH, cols, inFid ) != cols ) { SSTWARN("labels read failed!!!"); return false; }
+
+    return true;
+}
+
 bool
 DiscData::writeBinaryFile( char *fileName ) const
 {
@@ -284,7 +422,7 @@ DiscData::writeBinaryFile( char *fileName ) const
     
     if( fwrite( labels, DISCRETE_DATA_LABEL_LENGTH, cols, outFid ) != cols ) SSTERR("labels write failed!!!");
     
-    if( fwrite( data, sizeof(double), size_t(cols*rows), outFid ) != cols*rows ) SSTERR("data write failed!!!");
+    if( !DataCommon::write( outFid, FORMAT_BINARY ) ) SSTERR("data write failed!!!");
     
     fclose( outFid );
     
@@ -294,36 +432,264 @@ DiscData::writeBinaryFile( char *fileName ) const
 
 
 bool
-DiscData::testClass()
+DiscData::writeColumnFile( char *fileName, unsigned long long capacity ) const
 {
-   // Declaration Tests
-    DiscData          dd1, dd2, c, d;
-    
-    //dd1.read( "20060716.CMN.605.01.fb", FORMAT_LABELS );
-    //dd2.read( "20060717.CMN.605.01.fb", FORMAT_LABELS );
- #if 0   
-    
-    dd1.read( "20060716.CMN.605.01.fb", FORMAT_LABELS, "%lf%*lf%*lf%*lf%lf%lf" );
-    dd2.read( "20060717.CMN.605.01.fb", FORMAT_LABELS, "%lf%*lf%*lf%*lf%lf%lf" );
+    if( capacity < rows ) capacity = rows;
 
-    fprintf( stderr, "dd1 Before append: cols = %u, rows = %llu\n", dd1.getCols(), dd1.getRows() );
-    fprintf( stderr, "dd2 Before append: cols = %u, rows = %llu\n", dd2.getCols(), dd2.getRows() );
+    DiscColumnHeader hdr;
+    memset( &hdr, 0, sizeof(DiscColumnHeader) );
+    memcpy( hdr.magic, DISC_COLUMN_MAGIC, DISC_COLUMN_MAGIC_BYTES );
+    hdr.cols = cols;
+    hdr.rows = rows;
+    hdr.capacity = capacity;
+    hdr.dataOffset = (sizeof(DiscColumnHeader) + cols * DISCRETE_DATA_LABEL_LENGTH + DISC_COLUMN_ALIGN - 1) / DISC_COLUMN_ALIGN * DISC_COLUMN_ALIGN;
+    hdr.segBytes = (capacity * sizeof(double) + DISC_COLUMN_ALIGN - 1) / DISC_COLUMN_ALIGN * DISC_COLUMN_ALIGN;
 
-    dd1.append( dd2 );
+   /* Open file */    
+    FILE *outFid = fopen( fileName, "w" );
+    if( !outFid ) {
+        sprintf( errNote, "File \"%s\" could not be opened!!!\n", fileName );
+        SSTWARN( errNote );
+        return DRATS;
+    }
 
-    fprintf( stderr, "dd1 After append: cols = %u, rows = %llu\n", dd1.getCols(), dd1.getRows() );
+    bool status = VOILA;
+    if( fwrite( &hdr, sizeof(DiscColumnHeader), 1, outFid ) != 1 ) status = DRATS;
+    if( cols && fwrite( labels, DISCRETE_DATA_LABEL_LENGTH, cols, outFid ) != cols ) status = DRATS;
+
+   /* Each column contiguous, the slack after it left a hole */
+    std::vector<char> scratch( rows * sizeof(double) );
+    DataView view = getView();
+    for( unsigned int ith = 0; status == VOILA && rows && ith < cols; ith++ ) {
+        view.column( ith ).copyTo( &scratch[0] );
+        if( fseeko( outFid, hdr.dataOffset + ith * hdr.segBytes, SEEK_SET ) ||
+            fwrite( &scratch[0], sizeof(double), rows, outFid ) != rows ) status = DRATS;
+    }
+    if( fflush( outFid ) || ftruncate( fileno( outFid ), hdr.dataOffset + cols * hdr.segBytes ) ) status = DRATS;
+    if( fclose( outFid ) ) status = DRATS;
 
-    fprintf( stderr, "c Before append: cols = %u, rows = %llu\n", c.getCols(), c.getRows() );
-    c.append( dd1 );
-    fprintf( stderr, "c After append: cols = %u, rows = %llu\n", c.getCols(), c.getRows() );
-    
-    c.writeBinaryFile( "test.out" );
-    d.readBinaryFile( "test.out" );
+    if( status == DRATS ) {
+        sprintf( errNote, "Columnar write of \"%s\" failed!!!", fileName );
+        SSTWARN( errNote );
+    }
+    return status;
+}
+
+bool
+DiscData::appendColumnFile( char *fileName ) const
+{
+    FILE *ioFid = fopen( fileName, "r+" );
+    if( !ioFid ) {
+        sprintf( errNote, "File \"%s\" could not be opened!!!\n", fileName );
+        SSTWARN( errNote );
+        return DRATS;
+    }
+
+    DiscColumnHeader hdr;
+    std::vector<char> fileLabels;
+    bool ok = fread( &hdr, sizeof(DiscColumnHeader), 1, ioFid ) == 1 && !memcmp( hdr.magic, DISC_COLUMN_MAGIC, DISC_COLUMN_MAGIC_BYTES );
+    if( ok && hdr.cols != cols ) {
+        SSTWARN( "DiscData::appendColumnFile() column mismatch" );
+        ok = false;
+    }
+    if( ok ) {
+        fileLabels.resize( cols * DISCRETE_DATA_LABEL_LENGTH + 1 );
+        ok = !cols || fread( &fileLabels[0], DISCRETE_DATA_LABEL_LENGTH, cols, ioFid ) == cols;
+    }
+    if( !ok ) {
+        sprintf( errNote, "File \"%s\" is not a columnar file to append to!!!", fileName );
+        SSTWARN( errNote );
+        fclose( ioFid );
+        return DRATS;
+    }
+    for( unsigned int lth = 0; lth < cols; lth++ ) {
+        if( strcmp( getLabel( lth ), &fileLabels[lth * DISCRETE_DATA_LABEL_LENGTH] ) ) {
+            sprintf( errNote, "Column Labels differ: %s vice %s", &fileLabels[lth * DISCRETE_DATA_LABEL_LENGTH], getLabel( lth ) );
+            SSTWARN( errNote );
+        }
+    }
 
-    if( c.diff( d ) ) { fprintf( stderr, "READ WRITE Broke\n" ); return DRATS; }
-#endif
+   /* Out of room, lay it out again, twice as roomy, and swap it in */
+    if( hdr.rows + rows > hdr.capacity ) {
+        fclose( ioFid );
+        DiscData all;
+        std::string tmpName = std::string( fileName ) + ".tmp";
+        if( all.readBinaryFile( fileName ) || all.append( *this ) ||
+            all.writeColumnFile( (char*)tmpName.c_str(), 2 * all.getRows() ) || rename( tmpName.c_str(), fileName ) ) {
+            sprintf( errNote, "Columnar append to \"%s\" failed!!!", fileName );
+            SSTWARN( errNote );
+            unlink( tmpName.c_str() );
+            return DRATS;
+        }
+        return VOILA;
+    }
+
+   /* Into the slack of each column, the header last so a failure loses nothing */
+    std::vector<char> scratch( rows * sizeof(double) );
+    DataView view = getView();
+    for( unsigned int ith = 0; ok && rows && ith < cols; ith++ ) {
+        view.column( ith ).copyTo( &scratch[0] );
+        ok = !fseeko( ioFid, hdr.dataOffset + ith * hdr.segBytes + hdr.rows * sizeof(double), SEEK_SET ) &&
+             fwrite( &scratch[0], sizeof(double), rows, ioFid ) == rows;
+    }
+    hdr.rows += rows;
+    ok = ok && !fflush( ioFid ) && !fseeko( ioFid, 0, SEEK_SET ) && fwrite( &hdr, sizeof(DiscColumnHeader), 1, ioFid ) == 1;
+    if( fclose( ioFid ) ) ok = false;
+
+    if( !ok ) {
+        sprintf( errNote, "Columnar append to \"%s\" failed!!!", fileName );
+        SSTWARN( errNote );
+        return DRATS;
+    }
     return VOILA;
 }
 
 
+/* Test file of the given text, its name into fileName */
+static bool
+writeTestFile( char *fileName, const char *text )
+{
+    strcpy( fileName, "/tmp/DiscDataXXXXXX" );
+    int fd = mkstemp( fileName );
+    if( fd < 0 ) return false;
+    FILE *outFid = fdopen( fd, "w" );
+    if( !outFid ) { close( fd ); unlink( fileName ); return false; }
+    bool ok = fputs( text, outFid ) >= 0;
+    if( fclose( outFid ) ) ok = false;
+    if( !ok ) unlink( fileName );
+    return ok;
+}
+
+/* Does column ith hold these, row by row? */
+static bool
+columnIs( const DiscData &dd, unsigned int ith, const char *label, const double *want )
+{
+    if( strcmp( dd.getLabel( ith ), label ) ) return false;
+    DataView view = dd.getView();
+    for( unsigned long long row = 0; row < dd.getRows(); row++ )
+        if( *(const double*)view.getElt( row, ith ) != want[row] ) return false;
+    return true;
+}
+
+/* Rows and capacity from the header of a columnar file */
+static bool
+columnHeader( const char *fileName, DiscColumnHeader &hdr )
+{
+    FILE *inFid = fopen( fileName, "r" );
+    if( !inFid ) return false;
+    bool ok = fread( &hdr, sizeof(DiscColumnHeader), 1, inFid ) == 1;
+    fclose( inFid );
+    return ok;
+}
 
+/* Columnar round trip, projections, and appends in place and laid out again */
+static bool
+testColumnFile( const DiscData &dd, const double *times, const double *xs, const double *zs )
+{
+    char colName[32];
+    if( !writeTestFile( colName, "" ) ) return DRATS;
+    std::string tmpName = std::string( colName ) + ".tmp";
+    unsigned long long numRows = dd.getRows();
+    std::vector<double> times3, zs3;
+    for( int rep = 0; rep < 3; rep++ ) {
+        times3.insert( times3.end(), times, times + numRows );
+        zs3.insert( zs3.end(), zs, zs + numRows );
+    }
+
+    DiscData d;
+    DiscColumnHeader hdr;
+    std::vector<std::string> zt, x;
+    zt.push_back( "z" );
+    zt.push_back( "time" );
+    x.push_back( "x" );
+    bool status = VOILA;
+    if( dd.writeColumnFile( colName, 2 * numRows ) || d.readBinaryFile( colName ) || dd.diff( d ) ) status = DRATS;
+
+   /* Only the columns named, in that order, one of them in place */
+    if( !status && ( d.readBinaryFile( colName, zt ) || d.getCols() != 2 || d.getRows() != numRows ||
+                     !columnIs( d, 0, "z", zs ) || !columnIs( d, 1, "time", times ) ) ) status = DRATS;
+    if( !status && ( d.readBinaryFile( colName, x ) || d.getCols() != 1 || !d.isMapped() || !columnIs( d, 0, "x", xs ) ) ) status = DRATS;
+    x[0] = "w";
+    if( !status && !d.readBinaryFile( colName, x ) ) status = DRATS;
+
+   /* Into the slack, then past it, twice the room */
+    if( !status && ( dd.appendColumnFile( colName ) || !columnHeader( colName, hdr ) ||
+                     hdr.rows != 2 * numRows || hdr.capacity != 2 * numRows ) ) status = DRATS;
+    if( !status && ( dd.appendColumnFile( colName ) || !columnHeader( colName, hdr ) ||
+                     hdr.rows != 3 * numRows || hdr.capacity != 6 * numRows || !access( tmpName.c_str(), F_OK ) ) ) status = DRATS;
+    if( !status && ( d.readBinaryFile( colName, zt ) || d.getRows() != 3 * numRows ||
+                     !columnIs( d, 0, "z", &zs3[0] ) || !columnIs( d, 1, "time", &times3[0] ) ) ) status = DRATS;
+
+    unlink( colName );
+    return status;
+}
+
+bool
+DiscData::testClass()
+{
+   /* CR at the end of the labels, blank and comment lines between rows */
+    const char *text =
+        "LABELS = time\tx\ty\tz\r\n"
+        "1.0\t10.0\t20.0\t30.0\n"
+        "\n"
+        "# a comment\n"
+        "2.0\t11.0\t21.0\t31.0\n"
+        "   \n"
+        "3.0\t12.0\t22.0\t32.0\n";
+    const double times[] = { 1.0, 2.0, 3.0 }, xs[] = { 10.0, 11.0, 12.0 }, zs[] = { 30.0, 31.0, 32.0 };
+    char fileName[32], binName[32];
+    if( !writeTestFile( fileName, text ) ) return DRATS;
+
+    DiscData dd, d;
+    bool status = VOILA;
+    if( dd.read( fileName, FORMAT_LABELS ) || dd.getCols() != 4 || dd.getRows() != 3 ) status = DRATS;
+    if( !status && ( !columnIs( dd, 0, "time", times ) || !columnIs( dd, 1, "x", xs ) || !columnIs( dd, 3, "z", zs ) ) ) status = DRATS;
+
+   /* Round trip through the binary layout */
+    if( !status && writeTestFile( binName, "" ) ) {
+        if( dd.writeBinaryFile( binName ) || d.readBinaryFile( binName ) || dd.diff( d ) ) status = DRATS;
+
+       /* Short of its last row, it is refused, not half read */
+        struct stat st;
+        if( !status && ( stat( binName, &st ) || truncate( binName, st.st_size - sizeof(double) ) ||
+                         !d.readBinaryFile( binName ) || d.getRows() || d.getData() ) ) status = DRATS;
+        unlink( binName );
+    }
+
+   /* Labels and no rows, a columnar file of them is laid out again to take some */
+    DiscData none;
+    if( !status && writeTestFile( binName, "LABELS = time\tx\ty\tz\n" ) ) {
+        if( none.read( binName, FORMAT_LABELS ) || none.getRows() || none.getCols() != 4 ||
+            none.writeColumnFile( binName ) || dd.appendColumnFile( binName ) || d.readBinaryFile( binName ) || dd.diff( d ) ) status = DRATS;
+        unlink( binName );
+    }
+
+   /* Columns picked from a row file too */
+    std::vector<std::string> zt;
+    zt.push_back( "z" );
+    zt.push_back( "time" );
+    if( !status && writeTestFile( binName, "" ) ) {
+        if( dd.writeBinaryFile( binName ) || d.readBinaryFile( binName, zt ) || d.getCols() != 2 || d.getRows() != 3 ||
+            !columnIs( d, 0, "z", zs ) || !columnIs( d, 1, "time", times ) ) status = DRATS;
+        unlink( binName );
+    }
+    if( !status && testColumnFile( dd, times, xs, zs ) ) status = DRATS;
+
+   /* %*lf columns are skipped, labels and all */
+    char pickTwo[] = "%lf%*lf%*lf%lf", pickOne[] = "%lf%*lf", tooMany[] = "%lf%lf%lf%lf%lf";
+    if( !status && ( dd.read( fileName, FORMAT_LABELS, pickTwo ) || dd.getCols() != 2 || dd.getRows() != 3 ||
+                     !columnIs( dd, 0, "time", times ) || !columnIs( dd, 1, "z", zs ) ) ) status = DRATS;
+    if( !status && ( dd.read( fileName, FORMAT_LABELS, pickOne ) || dd.getCols() != 1 || !columnIs( dd, 0, "time", times ) ) ) status = DRATS;
+    if( !status && !dd.read( fileName, FORMAT_LABELS, tooMany ) ) status = DRATS;
+    unlink( fileName );
+
+   /* A malformed row, or one short, throws out the lot */
+    const char *bad[] = { "LABELS = a\tb\n1.0\t2.0\n3.0\toops\n", "LABELS = a\tb\n1.0\t2.0\n3.0\n" };
+    for( int ith = 0; !status && ith < 2; ith++ ) {
+        if( !writeTestFile( fileName, bad[ith] ) ) return DRATS;
+        if( !dd.read( fileName, FORMAT_LABELS ) || dd.getRows() ) status = DRATS;
+        unlink( fileName );
+    }
+
+    return status;
+}
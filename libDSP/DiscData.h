@@ -5,17 +5,37 @@
 
 /* Scheme minimizes number of mallocs */
 #define DISCRETE_DATA_LABEL_LENGTH 64
-#define DISCRETE_DATA_MAX_COLUMNS 32 /* Hardcoded to sscanf */
 #define DISCRETE_DATA_MAX_LINE_LENGTH 4096
 
 #define DISCRETE_DATA_ROW_PAGE 1024
 
+/* Columnar binary files:
+     DiscColumnHeader
+     labels, cols * DISCRETE_DATA_LABEL_LENGTH
+     one segment per column, capacity rows, each on its own DISC_COLUMN_ALIGN boundary
+   Segments are mapped one by one, so reading a few columns never touches the
+   pages of the others, and rows are appended into the slack of each in place. */
+#define DISC_COLUMN_MAGIC "DISCCOL1"
+#define DISC_COLUMN_MAGIC_BYTES 8
+#define DISC_COLUMN_ALIGN 4096
+
+struct DiscColumnHeader
+{
+    char magic[DISC_COLUMN_MAGIC_BYTES];
+    uint32_t cols;
+    uint32_t spare;
+    uint64_t rows;          /* Rows in every column */
+    uint64_t capacity;      /* Rows each segment has room for */
+    uint64_t dataOffset;    /* First segment */
+    uint64_t segBytes;      /* From one segment to the next */
+};
+
 class DiscData : public DataCommon
 {
 
 public:
 
-    DiscData() : DataCommon( DISCRETE_DATA ) { makeInst(); }
+    DiscData() { makeInst(); }
    ~DiscData() { remakeInst(); }
 
     void makeInst();
@@ -31,23 +51,52 @@ public:
     
     bool append( const DiscData &me );
 
+    bool load() { SSTWARN("Attempt to load data for abstract DiscData class shot down!"); return false; }
+
     bool read( char *fileName, int format, char *formatStr = NULL );
     bool write( char *fileName, int format, char *formatStr = NULL ) { return DRATS; }
+    bool write( char *fileName ) const { return writeBinaryFile( fileName ) == VOILA; }
 
+   /* Columns are read planar, formatStr picks them scanf() style, %lf to keep, %*lf to skip */
     bool readLabelsFile( FILE *inFid, char *fileName, char *formatStr = NULL );
     
-    bool readBinaryFile( char *fileName );
+   /* Either binary layout.  Names columns to read only those, in that order, all if empty */
+    bool readBinaryFile( char *fileName, const std::vector<std::string> &columns = std::vector<std::string>() );
     bool writeBinaryFile( char *fileName ) const;
+
+   /* Columnar layout, room for capacity rows in each column, at least rows */
+    bool writeColumnFile( char *fileName, unsigned long long capacity = 0 ) const;
+
+   /* Rows onto the end of a columnar file with the same columns.  Written into
+      the slack of each column, the file is only laid out again, with twice the
+      room, when that runs out. */
+    bool appendColumnFile( char *fileName ) const;
+
+   /* Binary file header, cols, rows & labels.  Returns true if read, for DataChunkReader */
+    bool readHeader( FILE *inFid );
+
+   /* Col 1 is datenum */
+    void getRowTime( const char *row, const unsigned long long &rowIdx, TimeObj &tt ) const { tt.setDatenum( ((const double*)row)[0] ); }
+
+    bool setTimeEnd() { return false; }
+    bool isEmpty() const { return !rows; }
     
     bool diff( const DiscData &she ) const;
     
     static bool testClass();
+
+protected:
+    bool readColumnFile( FILE *inFid, char *fileName, const std::vector<std::string> &columns );
+    bool pickColumns( const std::vector<std::string> &columns );
 };
 
 inline
 void 
 DiscData::makeInst() 
 {   
+    type = DISCRETE_DATA;
+    size = sizeof(double);
+    numFmt = NUM_DBL;
     labels = NULL;
     colTypes = NULL;
 }
@@ -56,9 +105,10 @@ inline
 void 
 DiscData::remakeInst() 
 {
-    DataCommon::remakeInst();
     if( labels ) { free( labels ); labels = NULL; }
     if( colTypes ) { free( colTypes ); colTypes = NULL; }
+    DataCommon::reset();
+    makeInst();
 }
 
 
@@ -84,7 +134,8 @@ DiscData::diff( const DiscData &she ) const {
         }
     }
     
-    if( memcmp( data, she.data, rows*cols*sizeof(double) ) ) return DRATS;
+    std::vector<char> mine, hers;
+    if( rows && memcmp( fileRows( 0, rows, mine ), she.fileRows( 0, rows, hers ), rows*cols*sizeof(double) ) ) return DRATS;
     
     return VOILA;
 }
@@ -0,0 +1,259 @@
+#include "EventColumns.h"
+#include "RowSort.h"
+
+#include <math.h>
+#include <algorithm>
+
+/**
+  * class EventColumns
+  * Copyright 2016, ShotSpotter
+  */
+
+/** Events checked between looks at the running result */
+#define EVENT_COLUMNS_CHECK_BLOCK 4096
+
+
+// Constructors/Destructors
+//
+
+EventColumns::EventColumns()
+  : numCols( 2 )
+{
+}
+
+EventColumns::~EventColumns()
+{
+}
+
+
+// Methods
+//
+
+bool
+EventColumns::fromRows( const EventData &events )
+{
+  return fromRows( events.getView() );
+}
+
+bool
+EventColumns::fromRows( const DataView &events )
+{
+  clear();
+  if( events.getNumFmt() != NUM_DBL || events.getEltSize() != sizeof(double) || events.getCols() < 2 ) {
+    std::cerr << "EventColumns::fromRows() needs datenum and duration columns of doubles!" << &std::endl;
+    return false;
+  }
+
+  size_t numRows = events.getRows();
+  unsigned int cols = events.getCols();
+  std::vector<int64_t> keys( numRows );
+  DataView dns = events.column( 0 );
+  for( size_t r = 0; r < numRows; r++ ) {
+    double dn;
+    memcpy( &dn, dns.getRow( r ), sizeof(dn) );
+    if( !isfinite( dn ) ) {
+      std::cerr << "EventColumns::fromRows() no time for row " << r << "!" << &std::endl;
+      return false;
+    }
+    keys[r] = nativeDatenumKey( dn );
+  }
+
+  payload.resize( numRows * (cols - 1) );
+  for( unsigned int c = 1; c < cols; c++ ) {
+    DataView col = events.column( c );
+    double* out = numRows ? &payload[(c - 1) * numRows] : NULL;
+    if( col.getStride() == sizeof(double) )
+      memcpy( out, col.getData(), numRows * sizeof(double) );
+    else
+      for( size_t r = 0; r < numRows; r++ )
+        memcpy( out + r, col.getRow( r ), sizeof(double) );
+  }
+  times.swap( keys );
+  numCols = cols;
+  return true;
+}
+
+bool
+EventColumns::toRows( EventData &events ) const
+{
+  size_t numRows = times.size();
+  events.clear();
+  events.setCols( numCols );
+  events.setEltSize( sizeof(double) );
+  events.setNumFmt( NUM_DBL );
+  if( !numRows )
+    return true;
+
+  size_t numBytes = numRows * numCols * sizeof(double);
+  double* buf = (double*)events.getAllocator()->allocate( numBytes );
+  if( !buf ) {
+    std::cerr << "EventColumns::toRows() could not allocate " << numBytes << " bytes!" << &std::endl;
+    return false;
+  }
+  for( size_t r = 0; r < numRows; r++ ) {
+    double* row = buf + r * numCols;
+    row[0] = nativeKeyDatenum( times[r] );
+    for( unsigned int c = 1; c < numCols; c++ )
+      row[c] = payload[(c - 1) * numRows + r];
+  }
+  events.adopt( (char*)buf, numRows, NULL, numBytes );
+  events.setUTC( getTime( 0 ) );
+  return true;
+}
+
+void
+EventColumns::clear()
+{
+  times.clear();
+  payload.clear();
+}
+
+const double*
+EventColumns::getColumn( const unsigned int &col ) const
+{
+  if( !col || col >= numCols || times.empty() )
+    return NULL;
+  return &payload[(col - 1) * times.size()];
+}
+
+DataView
+EventColumns::getPayload() const
+{
+  size_t numRows = times.size();
+  return DataView( numRows ? (const char*)&payload[0] : NULL, numRows, numCols - 1, sizeof(double), NUM_DBL,
+                   numRows ? getTime( 0 ) : TimeObj(), 0.0, sizeof(double), numRows * sizeof(double) );
+}
+
+bool
+EventColumns::sort()
+{
+  size_t numRows = times.size();
+  if( numRows < 2 || checkSort() )
+    return true;
+
+  // The times alone are sorted, then each column gathered in their order
+  std::vector<uint64_t> order;
+  std::vector<int64_t> keys( numRows );
+  sortOrder( &times[0], numRows, order, &keys[0] );
+  std::vector<double> cols( payload.size() );
+  gatherRows( getPayload(), &order[0], (char*)&cols[0] );
+  times.swap( keys );
+  payload.swap( cols );
+  return true;
+}
+
+bool
+EventColumns::checkSort() const
+{
+  return isSorted( getTimes(), times.size() );
+}
+
+bool
+EventColumns::checkOverlap() const
+{
+  // Out of order counts as overlap, as for findOverlap()
+  size_t numRows = times.size();
+  const double* durs = getColumn( 1 );
+  size_t r = 1;
+  while( r < numRows ) {
+    size_t stop = std::min( numRows, r + EVENT_COLUMNS_CHECK_BLOCK );
+    bool over = false;
+    for( ; r < stop; r++ ) {
+      int64_t gap = times[r] - times[r - 1];
+      over |= ( gap < 0 ) | ( (double)gap < durs[r - 1] * 1e6 );
+    }
+    if( over )
+      return false;
+  }
+  return true;
+}
+
+size_t
+EventColumns::findRow( const int64_t &key, const bool &after ) const
+{
+  size_t len = times.size();
+  if( !len )
+    return 0;
+
+  // The comparison picks the half, no branch to mispredict
+  const int64_t* base = &times[0];
+  while( len > 1 ) {
+    size_t half = len / 2;
+    base = ( after ? base[half - 1] <= key : base[half - 1] < key ) ? base + half : base;
+    len -= half;
+  }
+  return ( base - &times[0] ) + ( after ? *base <= key : *base < key );
+}
+
+bool
+EventColumns::slice( const TimeObj &begT, const TimeObj &finT, size_t &first, size_t &numRows ) const
+{
+  first = lowerBound( begT );
+  size_t last = lowerBound( finT );
+  numRows = last > first ? last - first : 0;
+  return numRows > 0;
+}
+
+bool
+EventColumns::trim( const TimeObj &begT, const TimeObj &endT, EventColumns &out ) const
+{
+  out.clear();
+  out.numCols = numCols;
+  size_t first = lowerBound( begT ), last = upperBound( endT );
+  if( last <= first )
+    return false;
+
+  size_t numRows = times.size(), numFound = last - first;
+  out.times.assign( times.begin() + first, times.begin() + last );
+  out.payload.resize( numFound * (numCols - 1) );
+  for( unsigned int c = 1; c < numCols; c++ )
+    memcpy( &out.payload[(c - 1) * numFound], &payload[(c - 1) * numRows + first], numFound * sizeof(double) );
+  return true;
+}
+
+bool
+EventColumns::testClass()
+{
+  // Three columns, out of order, two at the same time
+  const double day = 738000.0, sec = 1.0 / SECS_PER_DAY;
+  const double in[] = { day + 30 * sec,  1.0, 1.0,
+                        day + 10 * sec,  5.0, 2.0,
+                        day,             2.0, 3.0,
+                        day + 10 * sec,  0.5, 4.0,
+                        day + 32 * sec,  1.0, 5.0 };
+  const double order[] = { 3.0, 2.0, 4.0, 1.0, 5.0 };
+  const size_t numRows = sizeof(in) / sizeof(in[0]) / 3;
+  EventData rows( 19990101, 19990102 );
+  rows.setCols( 3 );
+  if( !rows.materialize( DataView( (const char*)in, numRows, 3, sizeof(double), NUM_DBL, TimeObj() ) ) ) return DRATS;
+
+  EventColumns ec;
+  if( !ec.fromRows( rows ) || ec.getRows() != numRows || ec.getCols() != 3 || ec.checkSort() ) return DRATS;
+  if( ec.getColumn( 0 ) || !ec.getColumn( 2 ) || ec.getColumn( 2 )[4] != 5.0 ) return DRATS;
+  if( !ec.sort() || !ec.checkSort() ) return DRATS;
+  for( size_t r = 0; r < numRows; r++ )
+    if( ec.getColumn( 2 )[r] != order[r] ) return DRATS;
+
+  // Events at 10 s overlap each other, then none do.  Times are looked up
+  // between events, a datenum is only good to 10 us
+  if( ec.checkOverlap() ) return DRATS;
+  TimeObj t0;
+  t0.setDatenum( day );
+  EventColumns part;
+  if( !ec.trim( t0 + TimeObj( 11.0 ), t0 + TimeObj( 32.5 ), part ) || part.getRows() != 2 || !part.checkOverlap() ) return DRATS;
+  if( llabs( part.getTimes()[0] - nativeTimeKey( t0 + TimeObj( 30.0 ) ) ) > 10 || part.getColumn( 2 )[1] != 5.0 ) return DRATS;
+
+  size_t first, num;
+  if( !ec.slice( t0 + TimeObj( 9.5 ), t0 + TimeObj( 29.5 ), first, num ) || first != 1 || num != 2 ) return DRATS;
+  if( ec.lowerBound( t0 - TimeObj( 0.5 ) ) != 0 || ec.upperBound( t0 + TimeObj( 10.5 ) ) != 3 || ec.lowerBound( t0 + TimeObj( 33.0 ) ) != numRows ) return DRATS;
+  if( ec.slice( t0 + TimeObj( 40.0 ), t0 + TimeObj( 50.0 ), first, num ) ) return DRATS;
+
+  // Back to rows, sorted, the datenums as close as a datenum can be
+  EventData back( 19990101, 19990102 );
+  if( !ec.toRows( back ) || back.getRows() != numRows || back.getCols() != 3 || !back.checkSort() ) return DRATS;
+  const double* got = (const double*)back.getData();
+  for( size_t r = 0; r < numRows; r++ )
+    if( got[r * 3 + 2] != order[r] || fabs( got[r * 3] - in[( (size_t)order[r] - 1 ) * 3] ) * SECS_PER_DAY > 1e-5 ) return DRATS;
+
+  return VOILA;
+}
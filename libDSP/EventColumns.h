@@ -0,0 +1,179 @@
+#ifndef __EVENTCOLUMNS_H__
+#define __EVENTCOLUMNS_H__
+
+/**
+  * class EventColumns
+  * Copyright 2016, ShotSpotter
+  *
+  * EventData laid out by column: the times as a packed column of
+  * microsecond keys, see nativeTimeKey(), the other columns, duration first,
+  * each packed doubles after it.  Scans of time touch nothing but times and
+  * compare integers, not datenums, so sort, search, trim and the overlap
+  * check run at the speed memory can deliver them.  Converts to and from
+  * the rows of an EventData, the datenum rounded to the nearest microsecond.
+  *
+  * Columns are numbered as in the EventData: 0 is the time, 1 the duration
+  * in seconds, then whatever else each event carries.
+  */
+
+#include "EventData.h"
+
+#include <stdint.h>
+
+class EventColumns
+{
+public:
+
+  // Constructors/Destructors
+  //
+
+  /**
+   * Empty Constructor, no events of two columns.
+   */
+  EventColumns();
+
+  /**
+   * Empty Destructor
+   */
+  virtual ~EventColumns();
+
+
+  // Methods
+  //
+
+  /**
+   * Take the events of a table, in the order they are in.
+   * @param events rows with the datenum in col 1 and seconds duration in col 2
+   * @return false if the rows are not events, leaving this empty
+   */
+  bool fromRows( const EventData &events );
+
+  /**
+   * As fromRows( const EventData& ), from a view of the rows.
+   * @param events rows of doubles, either layout
+   * @return false if the rows are not events, leaving this empty
+   */
+  bool fromRows( const DataView &events );
+
+  /**
+   * Put the events back as the interleaved rows of a table.
+   * @param events replaced with the events, datenums in col 1
+   * @return false if the rows could not be allocated
+   */
+  bool toRows( EventData &events ) const;
+
+  /**
+   * Drop every event, keeping the columns.
+   */
+  void clear();
+
+  /**
+   * @return number of events
+   */
+  size_t getRows() const { return times.size(); }
+
+  /**
+   * @return number of columns, the time's among them
+   */
+  unsigned int getCols() const { return numCols; }
+
+  /**
+   * @return the time keys, packed
+   */
+  const int64_t* getTimes() const { return times.empty() ? NULL : &times[0]; }
+
+  /**
+   * Packed doubles of a column after the time, the duration is column 1.
+   * @param col column, from 1
+   * @return the column, NULL for col 0 or past the last
+   */
+  const double* getColumn( const unsigned int &col ) const;
+
+  /**
+   * The columns after the time, as a planar view.
+   * @return view of getCols() - 1 columns
+   */
+  DataView getPayload() const;
+
+  /**
+   * Time of an event.
+   * @param row the event
+   * @return its start
+   */
+  TimeObj getTime( const size_t &row ) const { return nativeKeyTime( times[row] ); }
+
+  /**
+   * Sort the events for increasing time, keeping the order of events at
+   * the same time.  See RowSort.h.
+   * @return bool true if sort succeeds.
+   */
+  bool sort();
+
+  /**
+   * Check the times never decrease.
+   * @return bool true if check passes.
+   */
+  bool checkSort() const;
+
+  /**
+   * Check that no event starts before an earlier one ends.  Events must be
+   * sorted, see findOverlap().
+   * @return bool true if check passes.
+   */
+  bool checkOverlap() const;
+
+  /**
+   * Index of the first event at or after a time.  Events must be sorted.
+   * @param tt time sought
+   * @return index of the event, getRows() if there is none
+   */
+  size_t lowerBound( const TimeObj &tt ) const { return findRow( nativeTimeKey( tt ), false ); }
+
+  /**
+   * Index of the first event after a time, as lowerBound().
+   * @param tt time sought
+   * @return index of the event, getRows() if there is none
+   */
+  size_t upperBound( const TimeObj &tt ) const { return findRow( nativeTimeKey( tt ), true ); }
+
+  /**
+   * Events starting in a window, as EventData::slice().  Events must be sorted.
+   * @param begT beginning time of the window.
+   * @param finT ending time of the window, not included.
+   * @param first index of the first event found
+   * @param numRows number of events found
+   * @return true if any events were found
+   */
+  bool slice( const TimeObj &begT, const TimeObj &finT, size_t &first, size_t &numRows ) const;
+
+  /**
+   * Copy of the events starting in a window, as EventData::trim().
+   * @param begT beginning time of the window.
+   * @param endT ending time of the window, included.
+   * @param out replaced with the events found
+   * @return true if trim produced at least one event
+   */
+  bool trim( const TimeObj &begT, const TimeObj &endT, EventColumns &out ) const;
+
+  /**
+   * Run the regression test for this class.  Return 0 if good.
+   * @return bool
+   */
+  static bool testClass();
+
+private:
+
+  /**
+   * Branchless binary search of the times.
+   * @param key time key sought
+   * @param after true for the first event after key, false for at or after it
+   */
+  size_t findRow( const int64_t &key, const bool &after ) const;
+
+  unsigned int numCols;
+  std::vector<int64_t> times;     /** Time keys, one per event */
+  std::vector<double> payload;    /** Columns after the time, one after another */
+
+};
+
+#endif // __EVENTCOLUMNS_H__
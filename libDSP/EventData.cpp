@@ -1,4 +1,6 @@
 #include "EventData.h"
+#include "RowSort.h"
+#include "EventFlatten.h"
 
 /**
   * class EventData
@@ -70,6 +72,47 @@ EventData::EventData( const TimeObj &startT, const TimeObj &endT )
 EventData::EventData( const EventData &src, const bool &skipData ) : DataCommon( src, skipData )
 {
   initAttributes();
+
+  if( skipData || !src.data ) return;
+
+  // O(1), the rows are copied on the first write to either object
+  shareData( src );
+}
+
+EventData::EventData( EventData &&src ) noexcept : DataCommon( std::move( src ) )
+{
+  labels = src.labels;
+  colTypes = src.colTypes;
+  src.labels = NULL;
+  src.colTypes = NULL;
+}
+
+EventData&
+EventData::operator=( const EventData &src )
+{
+  if( this != &src ) {
+    EventData tmp( src );
+    swap( tmp );
+  }
+  return *this;
+}
+
+EventData&
+EventData::operator=( EventData &&src ) noexcept
+{
+  if( this != &src ) {
+    EventData tmp( std::move( src ) );
+    swap( tmp );
+  }
+  return *this;
+}
+
+void
+EventData::swap( EventData &other ) noexcept
+{
+  swapCommon( other );
+  std::swap( labels, other.labels );
+  std::swap( colTypes, other.colTypes );
 }
 
 
@@ -77,6 +120,9 @@ EventData::~EventData() { }
 
 void EventData::initAttributes ( ) 
 {
+  type = EVENT_DATA;
+  size = sizeof(double);
+  numFmt = NUM_DBL;
   labels = NULL;
   colTypes = NULL;
 }
@@ -84,13 +130,22 @@ void EventData::initAttributes ( )
 bool 
 EventData::setTimeEnd()
 {
-  if( !rows ) {
-  	std::cerr << "EventData::setTimeEnd(), no rows, doing nothing!" << &std::endl;
-  	return false;
-  }
-  
-  std::cerr << "EventData::setTimeEnd(), not implemented!" << &std::endl;
-  return false;
+  timeEnd = utc;
+  if( !rows || numFmt != NUM_DBL || size != sizeof(double) )
+    return false;
+
+  // The end of the last event, the rows being sorted
+  DataView all = getView();
+  double dn, dur = 0.0;
+  memcpy( &dn, all.getElt( rows - 1, 0 ), sizeof(dn) );
+  if( cols > 1 )
+    memcpy( &dur, all.getElt( rows - 1, 1 ), sizeof(dur) );
+  if( !isfinite( dn ) )
+    return false;
+  timeEnd.setDatenum( dn );
+  if( isfinite( dur ) && dur > 0.0 )
+    timeEnd += TimeObj( dur );
+  return true;
 }
 
 bool 
@@ -122,12 +177,119 @@ EventData::display( std::ostream &outr ) const
     outr << " ColumnTypes : NA" << &std::endl;
 }
 
+unsigned long long
+EventData::findRow( const double &dn, const bool &after ) const
+{
+  // Times are column 0, in either layout
+  DataView all = getView();
+  unsigned long long lo = 0, hi = rows;
+  while( lo < hi ) {
+    unsigned long long mid = lo + (hi - lo) / 2;
+    double curT = *(const double*)all.getRow( mid );
+    if( curT < dn || (after && curT == dn) )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+
+bool
+EventData::sort()
+{
+  if( rows < 2 || checkSort() )
+    return true;
+
+  DataView all = getView();
+  std::vector<uint64_t> order;
+  if( !sortOrder( all.column( 0 ), order ) )
+    return false;
+
+  size_t numBytes = rows * getRowSize();
+  char* buf = (char*)alloc->allocate( numBytes );
+  if( !buf ) {
+   std::cerr << "Allocation for sorted table failed!!!" << &std::endl;
+    return false;
+  }
+  gatherRows( all, &order[0], buf );
+  adopt( buf, rows, NULL, numBytes );
+  return true;
+}
+
+
+bool
+EventData::checkSort() const
+{
+  return isSorted( getView().column( 0 ) );
+}
+
+
+bool
+EventData::checkOverlap() const
+{
+  unsigned long long row;
+  return findOverlap( getView(), row ) && row == rows;
+}
+
+
+bool
+EventData::flatten()
+{
+  if( cols < 2 || numFmt != NUM_DBL || size != sizeof(double) ) {
+    std::cerr << "EventData::flatten() needs datenum and duration columns of doubles!" << &std::endl;
+    return false;
+  }
+  if( rows < 2 )
+    return true;
+  if( !sort() )
+    return false;
+
+  // The sweep runs along whole rows
+  bool planar = !interleaved;
+  if( planar && !toInterleaved() )
+    return false;
+  char* rowData = getWritableData();
+  if( !rowData )
+    return false;
+
+  EventFlattener flat( cols );
+  unsigned long long numRows = flat.push( rowData, rows );
+  numRows += flat.finish( rowData + numRows * getRowSize() );
+  rows = numRows;
+
+  if( planar && !toPlanar() )
+    return false;
+  setTimeEnd();
+  return true;
+}
+
+
+bool
+EventData::slice( const TimeObj &begT, const TimeObj &finT, DataView &view ) const
+{
+  view = DataView();
+  if( !rows )
+    return false;
+
+  unsigned long long begIdx = lowerBound( begT );
+  unsigned long long endIdx = lowerBound( finT );
+  if( endIdx <= begIdx )
+    return false;
+
+  DataView rowsFound = getView().subView( begIdx, endIdx - begIdx );
+  TimeObj start;
+  start.setDatenum( *(const double*)rowsFound.getData() );
+  view = DataView( rowsFound.getData(), rowsFound.getRows(), cols, size, numFmt, start, 0.0,
+                   rowsFound.getStride(), rowsFound.getColStride() );
+  return true;
+}
+
+
 bool
 EventData::trim( const TimeObj& begT, const TimeObj& endT, char **newDataHolder, size_t *numRows ) const
 {
-  int begIdx = 0, endIdx = 0;
-  int rowStep = size * cols;
-  //std::cout << "Row size=" << rowStep << " size=" << size << " cols=" << cols << &std::endl;
+  size_t rowStep = getRowSize();
 
   *numRows = 0;
   *newDataHolder = NULL;
@@ -137,50 +299,30 @@ EventData::trim( const TimeObj& begT, const TimeObj& endT, char **newDataHolder,
     return false;
   }
 
-  double begDn = begT.getDatenum();
-  double endDn = endT.getDatenum();
+  // endT is included, unlike slice()
+  unsigned long long begIdx = lowerBound( begT );
+  unsigned long long endIdx = upperBound( endT );
 
-  if( !checkSort() ) {
-   std::cerr << "Table sort check failed !!!" << &std::endl;
+  if( endIdx <= begIdx )
     return false;
-  }
+  size_t numRowsFound = endIdx - begIdx;
 
-  for( unsigned long long  ith = 0; ith < rows; ith++ ) 
-  {
-  	double curT = ((double*)data)[ith*cols];
-    if( !begIdx ) {
-      //std::cout << "begDn=" << begDn << " curT=" << curT << &std::endl;
-      if( begDn <= curT )
-      	begIdx = ith;
-    } else {
-      if( endDn < curT ) {
-        endIdx = ith - 1;
-        break;
-      }    
-    }
+  // A full checkSort() would make every trim linear.  The search always
+  // leaves the rows either side of the bounds in order, so it is the rows
+  // taken, copied anyway, that are checked
+  DataView found = getView().subView( begIdx, numRowsFound );
+  if( !isSorted( found.column( 0 ) ) ) {
+   std::cerr << "Table sort check failed !!!" << &std::endl;
+    return false;
   }
 
-  int numRowsFound = endIdx - begIdx + 1;
-  //std::cout << "Found segment from: " << begIdx << " -to- " << endIdx << " numRowsFound: " << numRowsFound << &std::endl;
-  TimeObj beg, fin;
-  std::string begStr, finStr;
-  beg.setDatenum(((double*)data)[begIdx*cols]);
-  fin.setDatenum(((double*)data)[endIdx*cols]);
-  //fprintf( stdout, "   covering datenum range: %lf -to- %lf\n", beg.getDatenum(), fin.getDatenum() );
-  beg.getSQLDatetimeFull( begStr );
-  fin.getSQLDatetimeFull( finStr );
-  //std::cout << "   covering time range: " << begStr << " -to- " << finStr << &std::endl;
-
-  char* mcer = (char*)malloc(numRowsFound*rowStep);
+  char* mcer = (char*)alloc->allocate(numRowsFound*rowStep);
   if( !mcer ) {
-   std::cerr << "malloc() for trimmed table failed!!!" << &std::endl;
+   std::cerr << "Allocation for trimmed table failed!!!" << &std::endl;
     return false;
   }
 
-  memcpy( mcer, data+begIdx*rowStep, numRowsFound*rowStep );
-
-  //fprintf( stdout, "   beginning time: %lf\n", ((double*)data+begIdx*cols)[0] );
-  //fprintf( stdout, "   after pulse time: %lf\n", ((double*)data+endIdx*cols)[0] );
+  found.copyTo( mcer );
 
   *newDataHolder = mcer;
   *numRows = numRowsFound;
@@ -190,4 +332,74 @@ EventData::trim( const TimeObj& begT, const TimeObj& endT, char **newDataHolder,
 
 
 bool 
-EventData::testClass ( )  { return false; }
+EventData::testClass ( )
+{
+  // Events at 0, 10, 10, 10, 20 and 30 s, the datenums straight from the
+  // times looked up, so ties are exact
+  TimeObj t0( (time_t)1300000000, 0 );
+  const double secs[] = { 0.0, 10.0, 10.0, 10.0, 20.0, 30.0 };
+  const size_t numEvents = sizeof(secs) / sizeof(secs[0]);
+  std::vector<double> evs( numEvents * 2 );
+  for( size_t e = 0; e < numEvents; e++ ) {
+    evs[e * 2] = ( t0 + TimeObj( secs[e] ) ).getDatenum();
+    evs[e * 2 + 1] = (double)e;
+  }
+  EventData ed( 19990101, 19990102 );
+  ed.setCols( 2 );
+  if( !ed.materialize( DataView( (const char*)&evs[0], numEvents, 2, sizeof(double), NUM_DBL, t0 ) ) ) return DRATS;
+
+  // Ends with the last event, 5 s long
+  if( fabs( ( ed.getTimeEnd() - ( t0 + TimeObj( 35.0 ) ) ).get() ) > 1e-4 ) return DRATS;
+
+  // Every event at a time is at or after the lower bound, before the upper
+  TimeObj t10 = t0 + TimeObj( 10.0 );
+  if( ed.lowerBound( t10 ) != 1 || ed.upperBound( t10 ) != 4 ) return DRATS;
+  if( ed.lowerBound( t10 + TimeObj( 0.5 ) ) != 4 || ed.upperBound( t10 - TimeObj( 0.5 ) ) != 1 ) return DRATS;
+  if( ed.lowerBound( t0 - TimeObj( 1.0 ) ) != 0 || ed.upperBound( t0 + TimeObj( 30.0 ) ) != numEvents ) return DRATS;
+
+  // slice() leaves the end out, trim() takes it
+  DataView view;
+  if( !ed.slice( t10, t0 + TimeObj( 20.0 ), view ) || view.getRows() != 3 || ed.slice( t10, t10, view ) ) return DRATS;
+  char* buf;
+  size_t numRows;
+  if( !ed.trim( t10, t0 + TimeObj( 20.0 ), &buf, &numRows ) || numRows != 4 ) return DRATS;
+  bool good = ((const double*)buf)[1] == 1.0 && ((const double*)buf)[7] == 4.0;
+  ed.getAllocator()->deallocate( buf );
+  if( !good ) return DRATS;
+
+  // Out of order among the rows taken is refused
+  std::swap( evs[4], evs[8] );
+  if( !ed.materialize( DataView( (const char*)&evs[0], numEvents, 2, sizeof(double), NUM_DBL, t0 ) ) ) return DRATS;
+  if( ed.trim( t0 + TimeObj( 5.0 ), t0 + TimeObj( 25.0 ), &buf, &numRows ) || buf || numRows ) return DRATS;
+
+  // Start, duration and a tag, out of order, the first two overlapping and
+  // the next two, sorted then flattened in either layout
+  const double unsorted[] = { 20.0, 5.0, 3.0,   0.0, 2.0, 1.0,   30.0, 1.0, 5.0,   1.0, 4.0, 2.0,   22.0, 1.0, 4.0 };
+  const double flatStarts[] = { 0.0, 20.0, 30.0 }, flatDurs[] = { 5.0, 5.0, 1.0 }, flatTags[] = { 1.0, 3.0, 5.0 };
+  std::vector<double> tab( unsorted, unsorted + 15 );
+  for( size_t e = 0; e < 5; e++ )
+    tab[e * 3] = ( t0 + TimeObj( unsorted[e * 3] ) ).getDatenum();
+  for( int planar = 0; planar < 2; planar++ ) {
+    EventData ev( 19990101, 19990102 );
+    ev.setCols( 3 );
+    if( !ev.materialize( DataView( (const char*)&tab[0], 5, 3, sizeof(double), NUM_DBL, t0 ) ) ) return DRATS;
+    if( planar && !ev.toPlanar() ) return DRATS;
+    if( ev.checkSort() || ev.checkFlatten() ) return DRATS;
+    if( !ev.sort() || !ev.checkSort() || ev.checkOverlap() || ev.getRows() != 5 ) return DRATS;
+    view = ev.getView();
+    for( unsigned long long r = 0; r < 5; r++ )
+      if( *(const double*)view.getElt( r, 2 ) != (double)( r + 1 ) ) return DRATS;
+
+    if( !ev.flatten() || !ev.checkFlatten() || !ev.checkOverlap() || ev.getRows() != 3 || ev.isInterleaved() == (bool)planar ) return DRATS;
+    view = ev.getView();
+    for( unsigned long long r = 0; r < 3; r++ ) {
+      TimeObj start;
+      start.setDatenum( *(const double*)view.getElt( r, 0 ) );
+      if( fabs( ( start - ( t0 + TimeObj( flatStarts[r] ) ) ).get() ) > 1e-4 ) return DRATS;
+      if( fabs( *(const double*)view.getElt( r, 1 ) - flatDurs[r] ) > 1e-4 || *(const double*)view.getElt( r, 2 ) != flatTags[r] ) return DRATS;
+    }
+    if( fabs( ( ev.getTimeEnd() - ( t0 + TimeObj( 31.0 ) ) ).get() ) > 1e-4 ) return DRATS;
+  }
+
+  return VOILA;
+}
@@ -45,12 +45,38 @@ public:
   EventData( const TimeObj &startT = TimeObj(), const TimeObj &endT = TimeObj() );
 
   /**
-   * Copy Constructor
+   * Copy Constructor.  The buffer is shared, not copied, until either
+   * object writes to it.
    * @param src Object to be copied.
-   * @param skipData (optional) Skip copy of the data, for speed
+   * @param skipData (optional) Skip the data altogether
    */
   EventData( const EventData &src, const bool &skipData = false );
 
+  /**
+   * Move Constructor, takes the buffer and leaves src empty.
+   * @param src Object to be moved from.
+   */
+  EventData( EventData &&src ) noexcept;
+
+  /**
+   * Copy Assignment.  As the copy constructor, the buffer is shared, not
+   * copied, until either object writes to it.
+   * @param src Object to be copied.
+   */
+  EventData& operator=( const EventData &src );
+
+  /**
+   * Move Assignment, takes the buffer and frees the old one.
+   * @param src Object to be moved from.
+   */
+  EventData& operator=( EventData &&src ) noexcept;
+
+  /**
+   * Exchange contents with other, no rows are copied.
+   * @param other Object to exchange with.
+   */
+  void swap( EventData &other ) noexcept;
+
   /**
    * Empty Destructor
    */
@@ -99,8 +125,8 @@ public:
   bool readLabelsFile (FILE* inFid, char* fileName, char* formatStr ) { return false; }
 
   /**
-   * Set the value of timeEnd
-   * Lack of arguments forces encapsulation.
+   * Set timeEnd to the end of the last event, its datenum plus duration,
+   * the rows being sorted.  utc if there are none.
    * @return true if the object is non-empty, i.e. it spans a finite amount of time.
    */
   bool setTimeEnd();
@@ -111,6 +137,29 @@ public:
    */
   bool isEmpty() const { return !rows; }
 
+  /**
+   * Time of a row, from its datenum in col 1.
+   * @param row Pointer to the row
+   * @param rowIdx Index of the row (unused)
+   * @param tt The time of the row
+   */
+  void getRowTime( const char* row, const unsigned long long &rowIdx, TimeObj &tt ) const { tt.setDatenum( ((const double*)row)[0] ); }
+
+  /**
+   * Index of the first event at or after a time, by binary search of the
+   * datenums in col 1, so the rows must be sorted, see checkSort().
+   * @param tt time sought
+   * @return index of the row, rows if there is none
+   */
+  unsigned long long lowerBound( const TimeObj &tt ) const { return findRow( tt.getDatenum(), false ); }
+
+  /**
+   * Index of the first event after a time, as lowerBound().
+   * @param tt time sought
+   * @return index of the row, rows if there is none
+   */
+  unsigned long long upperBound( const TimeObj &tt ) const { return findRow( tt.getDatenum(), true ); }
+
   /**
    * @return bool
    * @param  fileName
@@ -136,6 +185,14 @@ public:
 
 protected:
 
+  /**
+   * Binary search of the sorted datenums in col 1.
+   * @param dn datenum sought
+   * @param after true for the first row after dn, false for the first at or after it
+   * @return index of the row, rows if there is none
+   */
+  unsigned long long findRow( const double &dn, const bool &after ) const;
+
   /** Column labels */
   char* labels;
   
@@ -181,12 +238,25 @@ public:
    * Data trimmer
    * @param begT beginning time of slice window.
    * @param endT ending time of slice window.
-   * @param newData Pointer to trimmed pulse array.  NULL if none found.  Note:: This has been malloc()'d.
+   * @param newData Pointer to trimmed pulse array.  NULL if none found.  Note:: This came from getAllocator(), 
+   * so hand it to an object sharing that allocator, or give it back with getAllocator()->deallocate().
    * @param numRows number of rows found.
    * @return true if trim produced at least one event 
    */
   bool trim( const TimeObj& begT, const TimeObj& endT, char **newData, size_t *numRows ) const;
 
+  using DataCommon::trim;
+
+  /**
+   * Zero-copy trim.  Found by binary search of the datenums in col 1, so
+   * the rows must be sorted.
+   * @param begT beginning time of slice window.
+   * @param finT ending time of slice window, not included.
+   * @param view the events found, empty if none.
+   * @return true if any events were found
+   */
+  bool slice( const TimeObj &begT, const TimeObj &finT, DataView &view ) const;
+
   /**
    * Check object for consistency
    * @return bool true if check passes.
@@ -194,35 +264,39 @@ public:
   bool check() const { return false; }
 
   /**
-   * Sort object for increasing t.
+   * Sort whole rows for increasing t, the datenums in col 1, keeping the
+   * order of rows with the same datenum.  See RowSort.h.
    * @return bool true if sort succeeds.
    */
-  bool sort() { return false; }
+  bool sort();
 
   /**
-   * Check object for correct sort.
+   * Check object for correct sort, datenums in col 1 never decreasing.
+   * Millions of rows are checked on several threads.
    * @return bool true if check passes.
    */
-  bool checkSort() const { return false; }
+  bool checkSort() const;
 
   /**
    * Check object for overlapping events.  
    * NOTE: For this to work, col 1 must be datenum and col 2 must be seconds duration.
+   * One pass over rows already sorted, see findOverlap().
    * @return bool true if check passes.
    */
-  bool checkOverlap() const { return false; }
+  bool checkOverlap() const;
 
   /**
-   * Merges any overlapping events into one.
+   * Merges any overlapping events into one, in place, sorting first if need
+   * be.  See EventFlattener to flatten a file a chunk at a time.
    * @return bool true if flatten succeeds.
    */
-  bool flatten() { return false; }
+  bool flatten();
 
   /**
-   * Check object for overlapping events.
+   * Check object for correct sort and no overlapping events.
    * @return bool true if check passes.
    */
-  bool checkFlatten() const { return false; }
+  bool checkFlatten() const { return checkSort() && checkOverlap(); }
 
 
   /**
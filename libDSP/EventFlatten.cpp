@@ -0,0 +1,150 @@
+#include "EventFlatten.h"
+
+#include <math.h>
+
+/**
+  * EventFlatten
+  * Copyright 2016, ShotSpotter
+  */
+
+bool
+findOverlap( const DataView &events, unsigned long long &row )
+{
+  row = events.getRows();
+  if( events.getNumFmt() != NUM_DBL || events.getEltSize() != sizeof(double) || events.getCols() < 2 ) {
+    std::cerr << "findOverlap() needs datenum and duration columns of doubles!" << &std::endl;
+    return false;
+  }
+
+  // Until the first overlap, the latest end is that of the event before
+  double prevStart = 0.0, prevDur = 0.0;
+  for( unsigned long long r = 0; r < events.getRows(); r++ ) {
+    double start, dur;
+    memcpy( &start, events.getElt( r, 0 ), sizeof(double) );
+    memcpy( &dur, events.getElt( r, 1 ), sizeof(double) );
+    if( r ) {
+      if( start < prevStart ) {
+        std::cerr << "findOverlap() events out of order at row " << r << "!" << &std::endl;
+        row = events.getRows();
+        return false;
+      }
+      if( ( start - prevStart ) * SECS_PER_DAY < prevDur ) {
+        row = r;
+        return true;
+      }
+    }
+    prevStart = start;
+    prevDur = dur;
+  }
+  return true;
+}
+
+
+// Constructors/Destructors
+//
+
+EventFlattener::EventFlattener( const unsigned int &numCols )
+  : cols( numCols < 2 ? 2 : numCols ), held( cols ), spare( cols ), holding( false ), heldEnd( 0.0 ),
+    outOfOrder( 0 ), merged( 0 )
+{
+  if( numCols < 2 )
+    std::cerr << "EventFlattener() events need datenum and duration columns!" << &std::endl;
+}
+
+EventFlattener::~EventFlattener()
+{
+}
+
+
+// Methods
+//
+
+unsigned long long
+EventFlattener::push( char* rows, const unsigned long long &numRows )
+{
+  size_t rowBytes = cols * sizeof(double);
+  unsigned long long numDone = 0;
+  for( unsigned long long r = 0; r < numRows; r++ ) {
+    char* row = rows + r * rowBytes;
+    if( !holding ) {
+      memcpy( &held[0], row, rowBytes );
+      heldEnd = held[1];
+      holding = true;
+      continue;
+    }
+
+    double start, dur;
+    memcpy( &start, row, sizeof(double) );
+    memcpy( &dur, row + sizeof(double), sizeof(double) );
+    double past = ( start - held[0] ) * SECS_PER_DAY;
+    if( past < 0.0 )
+      outOfOrder++;
+    if( past < heldEnd ) {
+      if( past + dur > heldEnd )
+        heldEnd = past + dur;
+      held[1] = heldEnd;
+      merged++;
+      continue;
+    }
+
+    // Held is done, it may be written over this very row, so park the row first
+    memcpy( &spare[0], row, rowBytes );
+    memcpy( rows + numDone * rowBytes, &held[0], rowBytes );
+    numDone++;
+    held.swap( spare );
+    heldEnd = held[1];
+  }
+  return numDone;
+}
+
+unsigned long long
+EventFlattener::finish( char* row )
+{
+  if( !holding )
+    return 0;
+  memcpy( row, &held[0], cols * sizeof(double) );
+  holding = false;
+  return 1;
+}
+
+
+bool
+testEventFlatten()
+{
+  // Start, duration and a tag: 0-10 s and 5-20 s merge, 21-23 s stands
+  // alone, 30-31 s and 30.5-30.6 s merge, 40 s stands alone
+  const double day = 738000.0, sec = 1.0 / SECS_PER_DAY;
+  const double in[] = { day,             10.0, 1.0,
+                        day + 5 * sec,   15.0, 2.0,
+                        day + 21 * sec,   2.0, 3.0,
+                        day + 30 * sec,   1.0, 4.0,
+                        day + 30.5 * sec, 0.1, 5.0,
+                        day + 40 * sec,   1.0, 6.0 };
+  const double want[] = { 20.0, 1.0, 2.0, 3.0, 1.0, 4.0, 1.0, 6.0 };
+  const unsigned long long numRows = sizeof(in) / sizeof(in[0]) / 3;
+
+  unsigned long long row;
+  DataView view( (const char*)in, numRows, 3, sizeof(double), NUM_DBL, TimeObj() );
+  if( !findOverlap( view, row ) || row != 1 ) return DRATS;
+  if( !findOverlap( view.subView( 2, 2 ), row ) || row != 2 ) return DRATS;
+
+  // Every split into two chunks flattens the same
+  for( unsigned long long split = 0; split <= numRows; split++ ) {
+    std::vector<double> rows( in, in + numRows * 3 );
+    EventFlattener flat( 3 );
+    unsigned long long first = flat.push( (char*)&rows[0], split );
+    std::vector<double> out( rows.begin(), rows.begin() + first * 3 );
+    unsigned long long second = flat.push( (char*)&rows[0] + split * 3 * sizeof(double), numRows - split );
+    out.insert( out.end(), rows.begin() + split * 3, rows.begin() + ( split + second ) * 3 );
+    out.resize( out.size() + 3 );
+    if( flat.finish( (char*)&out[out.size() - 3] ) != 1 ) return DRATS;
+    if( out.size() != 4 * 3 || flat.getMerged() != 2 || flat.getOutOfOrder() ) return DRATS;
+    for( unsigned int e = 0; e < 4; e++ )
+      if( fabs( out[e * 3 + 1] - want[e * 2] ) > 1e-4 || out[e * 3 + 2] != want[e * 2 + 1] ) return DRATS;
+
+    DataView flatView( (const char*)&out[0], 4, 3, sizeof(double), NUM_DBL, TimeObj() );
+    if( !findOverlap( flatView, row ) || row != 4 ) return DRATS;
+  }
+
+  return VOILA;
+}
@@ -0,0 +1,99 @@
+#ifndef __EVENTFLATTEN_H__
+#define __EVENTFLATTEN_H__
+
+/**
+  * EventFlatten
+  * Copyright 2016, ShotSpotter
+  *
+  * Sweeps over events sorted by start, rows of doubles with the datenum
+  * in col 1 and the duration in seconds in col 2.  An event overlaps if it
+  * starts before every earlier one has ended; events that only touch don't.
+  * Ends are carried as seconds past a start rather than as datenums, which
+  * would round them to the 10 us a datenum can tell apart.
+  */
+
+#include "libCore/libCore.h"
+#include "DataView.h"
+
+/**
+ * Find the first event that overlaps an earlier one, in one pass.
+ * @param events rows sorted by datenum, either layout
+ * @param row the overlapping row, rows if there is none
+ * @return false if the rows are not events or not sorted
+ */
+bool findOverlap( const DataView &events, unsigned long long &row );
+
+
+/**
+  * class EventFlattener
+  * Merges overlapping events, in place, a chunk at a time, so a table of
+  * any length is flattened in constant memory.  A merged event keeps the
+  * other columns of its first event and takes a duration that runs to the
+  * last end of the events merged into it.  The last event of each chunk
+  * may yet grow, so it is held back until the next chunk, or finish().
+  *
+  *   EventFlattener flat( cols );
+  *   while( rdr.next( chunk ) )
+  *     emit( chunk.data, flat.push( chunk.data, chunk.rows ) );
+  *   emit( last, flat.finish( last ) );
+  */
+class EventFlattener
+{
+public:
+
+  /**
+   * Constructor
+   * @param numCols columns of doubles per row, at least 2
+   */
+  EventFlattener( const unsigned int &numCols );
+
+  /**
+   * Empty Destructor
+   */
+  virtual ~EventFlattener();
+
+  /**
+   * Merge the next rows.  Rows starting before the event held back are
+   * out of order, they are merged all the same and counted.
+   * @param rows packed rows, overwritten with the events finished
+   * @param numRows number of rows
+   * @return number of events finished, at the front of rows
+   */
+  unsigned long long push( char* rows, const unsigned long long &numRows );
+
+  /**
+   * Hand over the event held back, at the end of the rows.
+   * @param row room for a row
+   * @return 1 if a row was written, 0 if none was held
+   */
+  unsigned long long finish( char* row );
+
+  /**
+   * @return rows pushed starting before the event held back at the time
+   */
+  unsigned long long getOutOfOrder() const { return outOfOrder; }
+
+  /**
+   * @return rows merged into an earlier event since construction
+   */
+  unsigned long long getMerged() const { return merged; }
+
+private:
+
+  unsigned int cols;
+  std::vector<double> held;     /** The event that may still grow */
+  std::vector<double> spare;    /** Where a row waits while held is written out */
+  bool holding;
+  double heldEnd;               /** End of held, in seconds past its start */
+  unsigned long long outOfOrder;
+  unsigned long long merged;
+
+};
+
+/**
+ * Run the regression test for event flattening.  Return 0 if good.
+ * @return bool
+ */
+bool testEventFlatten();
+
+#endif // __EVENTFLATTEN_H__
@@ -0,0 +1,295 @@
+#include "EventIndex.h"
+#include "RowSort.h"
+#include "ThreadSplit.h"
+
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+
+/**
+  * class EventIndex
+  * Copyright 2016, ShotSpotter
+  */
+
+/** Subtrees at this level or below are scanned rather than walked */
+#define EVENT_INDEX_SCAN_LEVEL 3
+
+/** Threads to split across, zero for one per core */
+static std::atomic<unsigned int> queryThreads( 0 );
+
+
+// Constructors/Destructors
+//
+
+EventIndex::EventIndex()
+  : rootLevel( -1 )
+{
+}
+
+EventIndex::~EventIndex()
+{
+}
+
+
+// Methods
+//
+
+bool
+EventIndex::build( const EventData &events )
+{
+  return build( events.getView() );
+}
+
+bool
+EventIndex::build( const DataView &events )
+{
+  starts.clear();
+  ends.clear();
+  maxEnds.clear();
+  tableRows.clear();
+  rootLevel = -1;
+  if( events.getNumFmt() != NUM_DBL || events.getEltSize() != sizeof(double) || events.getCols() < 2 ) {
+    std::cerr << "EventIndex::build() needs datenum and duration columns of doubles!" << &std::endl;
+    return false;
+  }
+
+  std::vector<uint64_t> order;
+  if( !sortOrder( events.column( 0 ), order ) )
+    return false;
+
+  size_t numRows = order.size();
+  starts.reserve( numRows );
+  ends.reserve( numRows );
+  tableRows.reserve( numRows );
+  for( size_t r = 0; r < numRows; r++ ) {
+    double dn, dur;
+    memcpy( &dn, events.getElt( order[r], 0 ), sizeof(double) );
+    memcpy( &dur, events.getElt( order[r], 1 ), sizeof(double) );
+    if( !isfinite( dn ) || !isfinite( dur ) || dur < 0.0 )
+      continue;
+    int64_t key = nativeDatenumKey( dn );
+    starts.push_back( key );
+    ends.push_back( key + std::max<int64_t>( 1, llround( dur * 1e6 ) ) );
+    tableRows.push_back( order[r] );
+  }
+
+  // Node i sits at the level of its trailing ones, its children half a
+  // level's span either side.  The last subtree may be cut short by the
+  // end of the events, lastEnd carries its latest end up to its parents.
+  size_t n = starts.size();
+  maxEnds = ends;
+  if( !n )
+    return true;
+  size_t lastAt = 0;
+  int64_t lastEnd = 0;
+  for( size_t i = 0; i < n; i += 2 ) {
+    lastAt = i;
+    lastEnd = ends[i];
+  }
+  int level;
+  for( level = 1; ( (size_t)1 << level ) <= n; level++ ) {
+    size_t half = (size_t)1 << (level - 1), first = (half << 1) - 1, step = half << 2;
+    for( size_t i = first; i < n; i += step ) {
+      int64_t most = std::max( ends[i], maxEnds[i - half] );
+      maxEnds[i] = std::max( most, i + half < n ? maxEnds[i + half] : lastEnd );
+    }
+    lastAt = ( (lastAt >> level) & 1 ) ? lastAt - half : lastAt + half;
+    if( lastAt < n && maxEnds[lastAt] > lastEnd )
+      lastEnd = maxEnds[lastAt];
+  }
+  rootLevel = level - 1;
+  return true;
+}
+
+void
+EventIndex::query( const int64_t &beg, const int64_t &fin, std::vector<unsigned long long> &rows ) const
+{
+  if( rootLevel < 0 || beg >= fin )
+    return;
+
+  // In order, each node is taken twice, once to go left, once for itself
+  // and to go right.  A pending parent per level and the node in hand.
+  struct Node { size_t at; int level; bool leftDone; };
+  Node stack[66];
+  size_t n = starts.size();
+  int top = 0;
+  stack[top++] = { ( (size_t)1 << rootLevel ) - 1, rootLevel, false };
+  while( top ) {
+    Node nd = stack[--top];
+    if( nd.level <= EVENT_INDEX_SCAN_LEVEL ) {
+      size_t i = nd.at >> nd.level << nd.level;
+      size_t stop = std::min( n, i + ( (size_t)1 << (nd.level + 1) ) - 1 );
+      for( ; i < stop && starts[i] < fin; i++ )
+        if( ends[i] > beg )
+          rows.push_back( tableRows[i] );
+    }
+    else if( !nd.leftDone ) {
+      // Past the end, the left child may still hold events, so is taken
+      size_t left = nd.at - ( (size_t)1 << (nd.level - 1) );
+      stack[top++] = { nd.at, nd.level, true };
+      if( left >= n || maxEnds[left] > beg )
+        stack[top++] = { left, nd.level - 1, false };
+    }
+    else if( nd.at < n && starts[nd.at] < fin ) {
+      if( ends[nd.at] > beg )
+        rows.push_back( tableRows[nd.at] );
+      stack[top++] = { nd.at + ( (size_t)1 << (nd.level - 1) ), nd.level - 1, false };
+    }
+  }
+}
+
+size_t
+EventIndex::overlapping( const TimeObj &begT, const TimeObj &finT, std::vector<unsigned long long> &rows ) const
+{
+  size_t had = rows.size();
+  query( nativeTimeKey( begT ), nativeTimeKey( finT ), rows );
+  return rows.size() - had;
+}
+
+size_t
+EventIndex::activeAt( const TimeObj &tt, std::vector<unsigned long long> &rows ) const
+{
+  size_t had = rows.size();
+  int64_t key = nativeTimeKey( tt );
+  query( key, key + 1, rows );
+  return rows.size() - had;
+}
+
+size_t
+EventIndex::queryAll( const std::vector<int64_t> &begs, const std::vector<int64_t> &fins,
+                      std::vector<unsigned long long> &rows, std::vector<size_t> &firsts ) const
+{
+  size_t numQueries = begs.size();
+  firsts.assign( numQueries + 1, 0 );
+  rows.clear();
+  if( !numQueries )
+    return 0;
+
+  // Each thread gathers its own share, then they are laid end to end
+  unsigned int numThreads = threadsFor( numQueries, EVENT_INDEX_THREAD_QUERIES, queryThreads.load( std::memory_order_relaxed ) );
+  size_t per = (numQueries + numThreads - 1) / numThreads;
+  std::vector<std::vector<unsigned long long> > found( numThreads );
+  runThreads( numThreads, [&]( unsigned int t ) {
+    size_t beg = std::min( numQueries, t * per ), end = std::min( numQueries, beg + per );
+    for( size_t q = beg; q < end; q++ ) {
+      firsts[q] = found[t].size();
+      query( begs[q], fins[q], found[t] );
+    }
+  } );
+
+  std::vector<size_t> at( numThreads + 1, 0 );
+  for( unsigned int t = 0; t < numThreads; t++ )
+    at[t + 1] = at[t] + found[t].size();
+  rows.resize( at[numThreads] );
+  firsts[numQueries] = at[numThreads];
+  runThreads( numThreads, [&]( unsigned int t ) {
+    size_t beg = std::min( numQueries, t * per ), end = std::min( numQueries, beg + per );
+    for( size_t q = beg; q < end; q++ )
+      firsts[q] += at[t];
+    if( !found[t].empty() )
+      memcpy( &rows[at[t]], &found[t][0], found[t].size() * sizeof(unsigned long long) );
+  } );
+  return rows.size();
+}
+
+size_t
+EventIndex::overlapping( const std::vector<EventWindow> &windows, std::vector<unsigned long long> &rows,
+                         std::vector<size_t> &firsts ) const
+{
+  std::vector<int64_t> begs( windows.size() ), fins( windows.size() );
+  for( size_t w = 0; w < windows.size(); w++ ) {
+    begs[w] = nativeTimeKey( windows[w].begT );
+    fins[w] = nativeTimeKey( windows[w].finT );
+  }
+  return queryAll( begs, fins, rows, firsts );
+}
+
+size_t
+EventIndex::activeAt( const std::vector<TimeObj> &times, std::vector<unsigned long long> &rows,
+                      std::vector<size_t> &firsts ) const
+{
+  std::vector<int64_t> begs( times.size() ), fins( times.size() );
+  for( size_t q = 0; q < times.size(); q++ ) {
+    begs[q] = nativeTimeKey( times[q] );
+    fins[q] = begs[q] + 1;
+  }
+  return queryAll( begs, fins, rows, firsts );
+}
+
+void
+EventIndex::setQueryThreads( const unsigned int &numThreads )
+{
+  queryThreads.store( numThreads, std::memory_order_relaxed );
+}
+
+bool
+EventIndex::testClass()
+{
+  // Events a second apart or less, up to a minute long, out of order, some
+  // of no duration, one without a start
+  const size_t numRows = 5000;
+  const double dn0 = 738000.0;
+  std::vector<double> ev( numRows * 2 );
+  uint64_t lcg = 4321;
+  for( size_t r = 0; r < numRows; r++ ) {
+    lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+    ev[2 * r] = dn0 + (double)( (lcg >> 33) % (numRows * 1000) ) / 1000.0 / SECS_PER_DAY;
+    ev[2 * r + 1] = r % 7 ? (double)( (lcg >> 20) % 60000 ) / 1000.0 : 0.0;
+  }
+  ev[2 * 17] = NAN;
+
+  EventIndex idx;
+  EventData none( 19990101, 19990102 );
+  none.setCols( 2 );
+  if( !idx.build( none ) || idx.size() ) return DRATS;
+  std::vector<unsigned long long> found;
+  if( idx.activeAt( TimeObj(), found ) ) return DRATS;
+
+  DataView view( (const char*)&ev[0], numRows, 2, sizeof(double), NUM_DBL, TimeObj() );
+  if( !idx.build( view ) || idx.size() != numRows - 1 ) return DRATS;
+
+  // Every window and time the same as a scan, in order of start, empty
+  // windows find nothing
+  TimeObj t0;
+  t0.setDatenum( dn0 );
+  std::vector<EventWindow> windows;
+  std::vector<TimeObj> times;
+  for( size_t q = 0; q < 1000; q++ ) {
+    EventWindow win;
+    win.begT = t0 + TimeObj( (double)q * 5.3 ) - TimeObj( 100.0 );
+    win.finT = win.begT + TimeObj( (double)( q % 13 ) );
+    windows.push_back( win );
+    times.push_back( win.begT );
+  }
+  for( int pass = 0; pass < 2; pass++ ) {
+    std::vector<unsigned long long> rows;
+    std::vector<size_t> firsts;
+    if( pass )
+      idx.activeAt( times, rows, firsts );
+    else
+      idx.overlapping( windows, rows, firsts );
+    if( firsts.size() != windows.size() + 1 || firsts.back() != rows.size() ) return DRATS;
+    for( size_t q = 0; q < windows.size(); q++ ) {
+      int64_t beg = nativeTimeKey( windows[q].begT );
+      int64_t fin = pass ? beg + 1 : nativeTimeKey( windows[q].finT );
+      std::vector<unsigned long long> want;
+      for( size_t i = 0; i < idx.size(); i++ )
+        if( beg < fin && idx.starts[i] < fin && idx.ends[i] > beg )
+          want.push_back( idx.tableRows[i] );
+      if( want.size() != firsts[q + 1] - firsts[q] || !std::equal( want.begin(), want.end(), rows.begin() + firsts[q] ) )
+        return DRATS;
+      found.clear();
+      if( !pass && idx.overlapping( windows[q].begT, windows[q].finT, found ) != want.size() ) return DRATS;
+      if( pass && ( idx.activeAt( times[q], found ) != want.size() || found != want ) ) return DRATS;
+    }
+  }
+
+  // An event ending where a window begins isn't in it
+  double touch[] = { dn0, 10.0 };
+  if( !idx.build( DataView( (const char*)touch, 1, 2, sizeof(double), NUM_DBL, TimeObj() ) ) ) return DRATS;
+  found.clear();
+  if( idx.overlapping( t0 + TimeObj( 10.0 ), t0 + TimeObj( 20.0 ), found ) ||
+      idx.overlapping( t0 - TimeObj( 1.0 ), t0 + TimeObj( 0.5 ), found ) != 1 ) return DRATS;
+
+  return VOILA;
+}
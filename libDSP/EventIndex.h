@@ -0,0 +1,149 @@
+#ifndef __EVENTINDEX_H__
+#define __EVENTINDEX_H__
+
+/**
+  * class EventIndex
+  * Copyright 2016, ShotSpotter
+  *
+  * Answers which events of an EventData overlap a window, or are active at
+  * a time, without a scan of the table.  Events are held as flat arrays in
+  * order of start, each node of an implicit interval tree over them also
+  * keeping the latest end below it, so a query costs the log of the events
+  * plus the events found.  Once built, the index never changes, any number
+  * of threads may query it at once.
+  *
+  * Starts and ends are microsecond keys, see nativeTimeKey(), the datenum
+  * rounded to the nearest.  An event runs from its start up to, not
+  * including, its end, so events that only touch don't overlap, as for
+  * EventFlattener.  An event of no duration is taken to last a microsecond.
+  */
+
+#include "EventData.h"
+
+#include <stdint.h>
+
+/** Fewest queries worth a thread of their own */
+#define EVENT_INDEX_THREAD_QUERIES 256
+
+/**
+  * A window of time, from begT up to, not including, finT.
+  */
+struct EventWindow
+{
+  TimeObj begT;
+  TimeObj finT;
+};
+
+class EventIndex
+{
+public:
+
+  // Constructors/Destructors
+  //
+
+  /**
+   * Empty Constructor, an index of no events.
+   */
+  EventIndex();
+
+  /**
+   * Empty Destructor
+   */
+  virtual ~EventIndex();
+
+
+  // Methods
+  //
+
+  /**
+   * Index the events of a table, which need not be sorted.  Rows without a
+   * finite datenum are left out, as are negative durations.
+   * @param events rows with the datenum in col 1 and seconds duration in col 2
+   * @return false if the rows are not events, the index is left empty
+   */
+  bool build( const EventData &events );
+
+  /**
+   * As build( const EventData& ), from a view of the rows.
+   * @param events rows of doubles, either layout
+   * @return false if the rows are not events, the index is left empty
+   */
+  bool build( const DataView &events );
+
+  /**
+   * Events overlapping a window.
+   * @param begT beginning of the window
+   * @param finT end of the window, not included
+   * @param rows rows of the table indexed, appended in order of start
+   * @return number of rows found
+   */
+  size_t overlapping( const TimeObj &begT, const TimeObj &finT, std::vector<unsigned long long> &rows ) const;
+
+  /**
+   * Events active at a time, started at or before it and not yet ended.
+   * @param tt the time
+   * @param rows rows of the table indexed, appended in order of start
+   * @return number of rows found
+   */
+  size_t activeAt( const TimeObj &tt, std::vector<unsigned long long> &rows ) const;
+
+  /**
+   * Events overlapping each of many windows, split across threads.  Found
+   * for window w are rows[firsts[w]] up to rows[firsts[w + 1]].
+   * @param windows the windows
+   * @param rows rows of the table indexed, replaced
+   * @param firsts where each window's rows begin, one more than windows
+   * @return total rows found
+   */
+  size_t overlapping( const std::vector<EventWindow> &windows, std::vector<unsigned long long> &rows,
+                      std::vector<size_t> &firsts ) const;
+
+  /**
+   * Events active at each of many times, as for windows.
+   * @param times the times
+   * @param rows rows of the table indexed, replaced
+   * @param firsts where each time's rows begin, one more than times
+   * @return total rows found
+   */
+  size_t activeAt( const std::vector<TimeObj> &times, std::vector<unsigned long long> &rows,
+                   std::vector<size_t> &firsts ) const;
+
+  /**
+   * @return number of events indexed
+   */
+  size_t size() const { return starts.size(); }
+
+  /**
+   * Set the number of threads batches of queries are split across.
+   * @param numThreads threads wanted, zero for one per core
+   */
+  static void setQueryThreads( const unsigned int &numThreads );
+
+  /**
+   * Run the regression test for this class.  Return 0 if good.
+   * @return bool
+   */
+  static bool testClass();
+
+private:
+
+  /**
+   * Append the events that overlap keys beg up to fin.
+   */
+  void query( const int64_t &beg, const int64_t &fin, std::vector<unsigned long long> &rows ) const;
+
+  /**
+   * Run queries over keys, split across threads, gathering into rows and firsts.
+   */
+  size_t queryAll( const std::vector<int64_t> &begs, const std::vector<int64_t> &fins,
+                   std::vector<unsigned long long> &rows, std::vector<size_t> &firsts ) const;
+
+  std::vector<int64_t> starts;             /** Start keys, sorted */
+  std::vector<int64_t> ends;               /** End keys, by start */
+  std::vector<int64_t> maxEnds;            /** Latest end under each node */
+  std::vector<unsigned long long> tableRows; /** Row of the table, by start */
+  int rootLevel;                           /** Level of the root node, -1 if empty */
+
+};
+
+#endif // __EVENTINDEX_H__
@@ -0,0 +1,351 @@
+#include "EventMerge.h"
+#include "RowSort.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+/**
+  * EventMerge
+  * Copyright 2016, ShotSpotter
+  */
+
+/** Key of a table that is done, after that of any row */
+#define MERGE_DONE_KEY UINT64_MAX
+
+/** Key of a row, the datenum first in it, short of MERGE_DONE_KEY */
+static inline uint64_t
+rowKey( const char* row )
+{
+  double dn;
+  memcpy( &dn, row, sizeof(dn) );
+  uint64_t key = sortKey( dn );
+  return key == MERGE_DONE_KEY ? key - 1 : key;
+}
+
+
+// Constructors/Destructors
+//
+
+EventMerger::EventMerger( const std::vector<DataView> &tables, const bool &drop )
+  : cols( tables.empty() ? 2 : tables[0].getCols() ), dropDups( drop ), groupKey( 0 ),
+    chunkRows( DEFAULT_CHUNK_ROWS ), rowsMerged( 0 ), dropped( 0 ), outOfOrder( 0 )
+{
+  rowBytes = cols * sizeof(double);
+  bool fit = true;
+  for( size_t t = 0; t < tables.size(); t++ ) {
+    const DataView &tab = tables[t];
+    if( tab.getNumFmt() != NUM_DBL || tab.getEltSize() != sizeof(double) || tab.getCols() != cols || cols < 2 )
+      fit = false;
+  }
+  if( !fit )
+    std::cerr << "EventMerger() tables must be events of doubles, all with the same columns!" << &std::endl;
+
+  cursors.resize( tables.size() );
+  keys.resize( tables.size() );
+  for( size_t t = 0; t < tables.size(); t++ )
+    start( t, fit ? tables[t] : DataView() );
+  init();
+}
+
+EventMerger::EventMerger( const std::vector<DataChunkReader*> &rdrs, const unsigned int &numCols,
+                          const bool &drop, const size_t &numRows )
+  : readers( rdrs ), cols( numCols ), rowBytes( numCols * sizeof(double) ), dropDups( drop ), groupKey( 0 ),
+    chunkRows( numRows ? numRows : DEFAULT_CHUNK_ROWS ), rowsMerged( 0 ), dropped( 0 ), outOfOrder( 0 )
+{
+  if( numCols < 2 )
+    std::cerr << "EventMerger() events need datenum and duration columns!" << &std::endl;
+
+  // Each table starts with its first chunk
+  cursors.resize( readers.size() );
+  keys.resize( readers.size() );
+  for( size_t t = 0; t < readers.size(); t++ ) {
+    DataChunk chunk;
+    if( numCols < 2 || !readers[t] || !readers[t]->next( chunk ) )
+      start( t, DataView() );
+    else
+      start( t, DataView( chunk.data, chunk.rows, cols, sizeof(double), NUM_DBL, chunk.start ) );
+  }
+  init();
+}
+
+EventMerger::~EventMerger()
+{
+}
+
+
+// Methods
+//
+
+void
+EventMerger::start( const size_t &src, const DataView &view )
+{
+  Cursor &cur = cursors[src];
+  cur.view = view;
+  cur.row = 0;
+  cur.packed = view.getStride() == rowBytes && view.getColStride() == sizeof(double);
+  keys[src] = view.getRows() ? rowKey( view.getData() ) : MERGE_DONE_KEY;
+}
+
+void
+EventMerger::init()
+{
+  // Leaves past the tables are done from the start
+  leaves = 1;
+  while( leaves < cursors.size() )
+    leaves <<= 1;
+  cursors.resize( leaves );
+  keys.resize( leaves, MERGE_DONE_KEY );
+
+  // Winners of each game, bottom up, keeping the losers
+  std::vector<size_t> winners( 2 * leaves );
+  losers.assign( leaves, 0 );
+  for( size_t s = 0; s < leaves; s++ )
+    winners[leaves + s] = s;
+  for( size_t n = leaves - 1; n >= 1; n-- ) {
+    size_t a = winners[2 * n], b = winners[2 * n + 1];
+    winners[n] = beats( b, a ) ? b : a;
+    losers[n] = winners[n] == a ? b : a;
+  }
+  losers[0] = leaves > 1 ? winners[1] : 0;
+}
+
+void
+EventMerger::replay( size_t src )
+{
+  // Which way each game goes is a toss up, so no branch on it
+  for( size_t n = (leaves + src) / 2; n >= 1; n /= 2 ) {
+    size_t other = losers[n];
+    bool lost = beats( other, src );
+    losers[n] = lost ? src : other;
+    src = lost ? other : src;
+  }
+  losers[0] = src;
+}
+
+void
+EventMerger::advance( const size_t &src )
+{
+  Cursor &cur = cursors[src];
+  uint64_t last = keys[src];
+  if( ++cur.row < cur.view.getRows() )
+    keys[src] = rowKey( cur.view.getRow( cur.row ) );
+  else {
+    DataChunk chunk;
+    if( readers.empty() || !readers[src]->next( chunk ) )
+      start( src, DataView() );
+    else
+      start( src, DataView( chunk.data, chunk.rows, cols, sizeof(double), NUM_DBL, chunk.start ) );
+  }
+  if( keys[src] < last )
+    outOfOrder++;
+}
+
+bool
+EventMerger::isDuplicate( const char* row )
+{
+  uint64_t key = rowKey( row );
+  if( group.empty() || key != groupKey ) {
+    group.assign( row, row + rowBytes );
+    groupKey = key;
+    return false;
+  }
+  for( size_t at = 0; at < group.size(); at += rowBytes )
+    if( !memcmp( &group[at], row, rowBytes ) )
+      return true;
+  group.insert( group.end(), row, row + rowBytes );
+  return false;
+}
+
+unsigned long long
+EventMerger::merge( char* dst, const unsigned long long &numRows )
+{
+  unsigned long long numDone = 0;
+  while( numDone < numRows ) {
+    size_t src = losers[0];
+    if( keys[src] == MERGE_DONE_KEY )
+      break;
+
+    const Cursor &cur = cursors[src];
+    char* out = dst + numDone * rowBytes;
+    if( cur.packed )
+      memcpy( out, cur.view.getRow( cur.row ), rowBytes );
+    else
+      for( unsigned int c = 0; c < cols; c++ )
+        memcpy( out + c * sizeof(double), cur.view.getElt( cur.row, c ), sizeof(double) );
+    if( dropDups && isDuplicate( out ) )
+      dropped++;
+    else
+      numDone++;
+    advance( src );
+    replay( src );
+  }
+  rowsMerged += numDone;
+  return numDone;
+}
+
+bool
+EventMerger::next( DataChunk &chunk )
+{
+  buffer.resize( chunkRows * rowBytes );
+  chunk.data = &buffer[0];
+  chunk.firstRow = rowsMerged;
+  chunk.rows = merge( chunk.data, chunkRows );
+  if( !chunk.rows )
+    return false;
+  chunk.start.setDatenum( *(const double*)chunk.data );
+  return true;
+}
+
+
+unsigned long long
+mergeEvents( const std::vector<DataView> &tables, char* dst, const bool &dropDups )
+{
+  unsigned long long numRows = 0;
+  for( size_t t = 0; t < tables.size(); t++ )
+    numRows += tables[t].getRows();
+  EventMerger merger( tables, dropDups );
+  return merger.merge( dst, numRows );
+}
+
+bool
+mergeEvents( const std::vector<EventData> &tables, EventData &out, const bool &dropDups )
+{
+  unsigned int cols = tables.empty() ? 2 : tables[0].getCols();
+  unsigned long long numRows = 0;
+  std::vector<DataView> views( tables.size() );
+  for( size_t t = 0; t < tables.size(); t++ ) {
+    views[t] = tables[t].getView();
+    if( views[t].getNumFmt() != NUM_DBL || views[t].getEltSize() != sizeof(double) || views[t].getCols() != cols || cols < 2 ) {
+      std::cerr << "mergeEvents() tables must be events of doubles, all with the same columns!" << &std::endl;
+      return false;
+    }
+    if( !isSorted( views[t].column( 0 ) ) ) {
+      std::cerr << "mergeEvents() table " << t << " is not sorted!" << &std::endl;
+      return false;
+    }
+    numRows += views[t].getRows();
+  }
+
+  // Sized for every row, the merge writes each once
+  size_t numBytes = numRows * cols * sizeof(double);
+  char* buf = NULL;
+  if( numBytes && !( buf = (char*)out.getAllocator()->allocate( numBytes ) ) ) {
+    std::cerr << "mergeEvents() could not allocate " << numBytes << " bytes!" << &std::endl;
+    return false;
+  }
+  numRows = buf ? mergeEvents( views, buf, dropDups ) : 0;
+
+  out.clear();
+  out.setCols( cols );
+  out.setEltSize( sizeof(double) );
+  out.setNumFmt( NUM_DBL );
+  out.adopt( buf, numRows, NULL, numBytes );
+  if( numRows ) {
+    TimeObj start;
+    start.setDatenum( *(const double*)buf );
+    out.setUTC( start );
+  }
+  return true;
+}
+
+bool
+testEventMerge()
+{
+  // Datenum, duration and a tag of the table and row.  Ties at 2 and 5,
+  // a duplicate of a row of a at 5, and an empty table.
+  const double a[] = { 1.0, 0.5, 10.0,   2.0, 0.5, 11.0,   5.0, 1.0, 12.0,   9.0, 0.5, 13.0 };
+  const double b[] = { 2.0, 0.5, 20.0,   3.0, 0.5, 21.0,   5.0, 1.0, 12.0,   5.0, 1.0, 22.0 };
+  const double c[] = { 0.5, 0.5, 30.0,   5.0, 1.0, 31.0,  10.0, 0.5, 32.0 };
+  const double tagsAll[] = { 30.0, 10.0, 11.0, 20.0, 21.0, 12.0, 12.0, 22.0, 31.0, 13.0, 32.0 };
+  const double tagsDrop[] = { 30.0, 10.0, 11.0, 20.0, 21.0, 12.0, 22.0, 31.0, 13.0, 32.0 };
+  const size_t numRows = 11;
+
+  // Table b is planar, the merge copies whole rows all the same
+  std::vector<double> bPlanar( 12 );
+  for( size_t r = 0; r < 4; r++ )
+    for( size_t col = 0; col < 3; col++ )
+      bPlanar[col * 4 + r] = b[r * 3 + col];
+  std::vector<DataView> tables;
+  tables.push_back( DataView( (const char*)a, 4, 3, sizeof(double), NUM_DBL, TimeObj() ) );
+  tables.push_back( DataView( (const char*)&bPlanar[0], 4, 3, sizeof(double), NUM_DBL, TimeObj(), 0.0,
+                              sizeof(double), 4 * sizeof(double) ) );
+  tables.push_back( DataView( (const char*)c, 0, 3, sizeof(double), NUM_DBL, TimeObj() ) );
+  tables.push_back( DataView( (const char*)c, 3, 3, sizeof(double), NUM_DBL, TimeObj() ) );
+
+  for( int drop = 0; drop < 2; drop++ ) {
+    const double* tags = drop ? tagsDrop : tagsAll;
+    size_t want = drop ? numRows - 1 : numRows;
+    std::vector<double> out( numRows * 3 );
+    if( mergeEvents( tables, (char*)&out[0], drop ) != want ) return DRATS;
+    for( size_t r = 0; r < want; r++ )
+      if( out[r * 3 + 2] != tags[r] ) return DRATS;
+
+    // A few rows at a time comes out the same
+    EventMerger merger( tables, drop );
+    std::vector<double> part( numRows * 3 );
+    unsigned long long got = 0, num;
+    while( ( num = merger.merge( (char*)&part[got * 3], 3 ) ) )
+      got += num;
+    if( got != want || merger.getDropped() != (unsigned long long)drop || merger.getOutOfOrder() ) return DRATS;
+    if( memcmp( &part[0], &out[0], want * 3 * sizeof(double) ) ) return DRATS;
+  }
+
+  // Streamed from native files a few rows at a time, chunks that don't
+  // line up with the tables', the merge is the one made in memory
+  const double* srcs[] = { a, b, c };
+  const unsigned long long srcRows[] = { 4, 4, 3 };
+  char fileNames[3][32];
+  bool ok = true;
+  for( int t = 0; t < 3; t++ ) {
+    strcpy( fileNames[t], "/tmp/EventMergeXXXXXX" );
+    int fd = mkstemp( fileNames[t] );
+    if( fd < 0 ) return DRATS;
+    close( fd );
+    EventData ev( 19990101, 19990102 );
+    ev.setCols( 3 );
+    ok = ok && ev.materialize( DataView( (const char*)srcs[t], srcRows[t], 3, sizeof(double), NUM_DBL, TimeObj() ) ) &&
+         ev.writeFile( fileNames[t] );
+  }
+  for( int drop = 0; ok && drop < 2; drop++ ) {
+    size_t want = drop ? numRows - 1 : numRows;
+    std::vector<double> out( numRows * 3 );
+    ok = mergeEvents( tables, (char*)&out[0], drop ) == want;
+
+    std::vector<EventData> proxies( 3, EventData( 19990101, 19990102 ) );
+    std::vector<DataChunkReader*> readers;
+    for( int t = 0; t < 3; t++ ) {
+      proxies[t].setCols( 3 );
+      readers.push_back( new DataChunkReader( proxies[t], 3 ) );
+      ok = ok && readers[t]->open( fileNames[t] );
+    }
+    EventMerger merger( readers, 3, drop, 2 );
+    DataChunk chunk;
+    unsigned long long got = 0;
+    while( ok && merger.next( chunk ) ) {
+      ok = chunk.firstRow == got && chunk.rows <= 2 && got + chunk.rows <= want &&
+           !memcmp( chunk.data, &out[got * 3], chunk.rows * 3 * sizeof(double) );
+      got += chunk.rows;
+    }
+    ok = ok && got == want && merger.getDropped() == (unsigned long long)drop && !merger.getOutOfOrder();
+    for( int t = 0; t < 3; t++ )
+      delete readers[t];
+  }
+  for( int t = 0; t < 3; t++ )
+    unlink( fileNames[t] );
+  if( !ok ) return DRATS;
+
+  // Tables that don't match, or aren't sorted, are refused
+  std::vector<EventData> evs( 2, EventData( 19990101, 19990102 ) );
+  evs[0].setCols( 3 );
+  evs[1].setCols( 3 );
+  if( !evs[0].materialize( tables[0] ) || !evs[1].materialize( tables[3] ) ) return DRATS;
+  EventData merged( 19990101, 19990102 );
+  if( !mergeEvents( evs, merged ) || merged.getRows() != 7 || !merged.checkSort() ) return DRATS;
+  if( !evs[1].materialize( DataView( (const char*)c, 3, 2, sizeof(double), NUM_DBL, TimeObj() ) ) ) return DRATS;
+  if( mergeEvents( evs, merged ) ) return DRATS;
+  double unsorted[] = { 2.0, 1.0, 0.0,   1.0, 1.0, 0.0 };
+  if( !evs[1].materialize( DataView( (const char*)unsorted, 2, 3, sizeof(double), NUM_DBL, TimeObj() ) ) ) return DRATS;
+  if( mergeEvents( evs, merged ) ) return DRATS;
+
+  return VOILA;
+}
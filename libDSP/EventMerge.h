@@ -0,0 +1,182 @@
+#ifndef __EVENTMERGE_H__
+#define __EVENTMERGE_H__
+
+/**
+  * EventMerge
+  * Copyright 2016, ShotSpotter
+  *
+  * Merges tables of events, each sorted by datenum in col 1, into one that
+  * is, in a single pass and a single copy of each row.  The head of every
+  * table sits in a loser tree, so each row out costs log k comparisons of
+  * k tables, rather than concatenating them all and sorting again.  Rows at
+  * the same time keep the order of their tables, then their order within.
+  */
+
+#include "libCore/libCore.h"
+#include "DataView.h"
+#include "EventData.h"
+#include "DataChunkReader.h"
+
+#include <stdint.h>
+
+/**
+  * class EventMerger
+  * Hands out the merged rows a buffer at a time, from tables in memory or
+  * from files streamed through chunk readers, so any number of rows are
+  * merged in constant memory.  Exact duplicates, rows identical in every
+  * byte to one already out at the same time, may be dropped.
+  *
+  *   EventMerger merge( readers, cols );
+  *   DataChunk chunk;
+  *   while( merge.next( chunk ) )
+  *     crunch( chunk.data, chunk.rows );
+  */
+class EventMerger
+{
+public:
+
+  /**
+   * Constructor, merging tables in memory.
+   * @param tables sorted rows of doubles, each the same columns, either layout
+   * @param dropDups true to drop exact duplicates
+   */
+  EventMerger( const std::vector<DataView> &tables, const bool &dropDups = false );
+
+  /**
+   * Constructor, merging files.  The readers must be open, each file sorted,
+   * and are read from as rows are needed.
+   * @param readers open readers of files of events
+   * @param numCols columns of doubles in every file
+   * @param dropDups true to drop exact duplicates
+   * @param chunkRows rows handed out by next()
+   */
+  EventMerger( const std::vector<DataChunkReader*> &readers, const unsigned int &numCols,
+               const bool &dropDups = false, const size_t &chunkRows = DEFAULT_CHUNK_ROWS );
+
+  /**
+   * Empty Destructor
+   */
+  virtual ~EventMerger();
+
+  /**
+   * Merge the next rows into a buffer.
+   * @param dst room for numRows packed rows
+   * @param numRows most rows wanted
+   * @return number of rows merged, short only when every table is done
+   */
+  unsigned long long merge( char* dst, const unsigned long long &numRows );
+
+  /**
+   * Merge the next rows into the merger's own buffer, overwritten by the
+   * next call.
+   * @param chunk filled in with the rows
+   * @return true if any rows were merged
+   */
+  bool next( DataChunk &chunk );
+
+  /**
+   * @return bytes in each row
+   */
+  size_t getRowSize() const { return rowBytes; }
+
+  /**
+   * @return rows merged so far
+   */
+  unsigned long long getRowsMerged() const { return rowsMerged; }
+
+  /**
+   * @return exact duplicates dropped so far
+   */
+  unsigned long long getDropped() const { return dropped; }
+
+  /**
+   * @return rows read that started before the row read ahead of them from
+   * the same table, the output isn't sorted if there were any
+   */
+  unsigned long long getOutOfOrder() const { return outOfOrder; }
+
+private:
+
+  /** Where each table is up to */
+  struct Cursor
+  {
+    DataView view;               /** Rows on hand, a chunk for readers */
+    unsigned long long row;      /** Next row of view */
+    bool packed;                 /** Rows of view are packed doubles */
+  };
+
+  /**
+   * Make ready to merge, once the cursors are set up.
+   */
+  void init();
+
+  /**
+   * Point a table at its rows, setting its key, done if there are none.
+   */
+  void start( const size_t &src, const DataView &view );
+
+  /**
+   * Move a table on to its next row, reading another chunk if need be.
+   */
+  void advance( const size_t &src );
+
+  /**
+   * Does src come out before other?
+   */
+  bool beats( const size_t &src, const size_t &other ) const {
+    return ( keys[src] < keys[other] ) | ( ( keys[src] == keys[other] ) & ( src < other ) );
+  }
+
+  /**
+   * Play src up the tree from its leaf, after its row changed.
+   */
+  void replay( size_t src );
+
+  /**
+   * Drop a row identical to one already out at the same time?
+   */
+  bool isDuplicate( const char* row );
+
+  std::vector<Cursor> cursors;
+  std::vector<uint64_t> keys;             /** sortKey() of each table's next datenum, past any once done */
+  std::vector<DataChunkReader*> readers;  /** Empty for tables in memory */
+  std::vector<size_t> losers;             /** Loser at each node of the tree, the winner at 0 */
+  size_t leaves;                          /** Tables, rounded up to a power of two */
+  unsigned int cols;
+  size_t rowBytes;
+  bool dropDups;
+  std::vector<char> group;                /** Rows out at the time of the last */
+  uint64_t groupKey;
+  std::vector<char> buffer;               /** For next() */
+  size_t chunkRows;
+  unsigned long long rowsMerged;
+  unsigned long long dropped;
+  unsigned long long outOfOrder;
+
+};
+
+/**
+ * Merge sorted tables into a buffer.
+ * @param tables sorted rows of doubles, each the same columns, either layout
+ * @param dst room for every row of every table, packed
+ * @param dropDups true to drop exact duplicates
+ * @return rows merged into dst
+ */
+unsigned long long mergeEvents( const std::vector<DataView> &tables, char* dst, const bool &dropDups = false );
+
+/**
+ * Merge sorted tables into one.  Each table is checked to be sorted first.
+ * @param tables the events, datenum in col 1, each the same columns
+ * @param out replaced with the merged events, interleaved
+ * @param dropDups true to drop exact duplicates
+ * @return false if the tables don't match or aren't sorted, or on allocation
+ */
+bool mergeEvents( const std::vector<EventData> &tables, EventData &out, const bool &dropDups = false );
+
+/**
+ * Run the regression test for event merging.  Return 0 if good.
+ * @return bool
+ */
+bool testEventMerge();
+
+#endif // __EVENTMERGE_H__
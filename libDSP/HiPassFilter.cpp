@@ -83,7 +83,7 @@ bool HiPassFilter::apply( const TimeData& src, TimeData& result ) const
   std:cout << "numTaps = " << numTaps << " n = " << n << &endl;
   //for( int s = 0; s < numTaps; s++ ) printf( "%lf\n", taps[s] );
 
-  int* samps = (int*)result.getData();
+  int* samps = (int*)result.getWritableData();
   size_t sampleCount = result.getSampleCount();
   std::cout << "Filtering " << sampleCount << " samples of data." << &endl;
 
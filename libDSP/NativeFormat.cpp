@@ -0,0 +1,209 @@
+#include "NativeFormat.h"
+#include "TimeData.h"
+
+#include <math.h>
+#include <stddef.h>
+
+/**
+  * Native container format
+  * Copyright 2016, ShotSpotter
+  */
+
+static_assert( sizeof(NativeHeader) == NATIVE_HEADER_BYTES, "NativeHeader must stay a fixed size on disk" );
+
+void
+nativeHeaderInit( NativeHeader &hdr )
+{
+  memset( &hdr, 0, sizeof(NativeHeader) );
+  memcpy( hdr.magic, NATIVE_MAGIC, NATIVE_MAGIC_BYTES );
+  hdr.version = NATIVE_VERSION;
+}
+
+bool
+nativeHeaderCheck( const NativeHeader &hdr )
+{
+  if( memcmp( hdr.magic, NATIVE_MAGIC, NATIVE_MAGIC_BYTES ) ) {
+    std::cerr << "Not a native format file!" << &std::endl;
+    return false;
+  }
+  if( hdr.version > NATIVE_VERSION ) {
+    std::cerr << "Native format version " << hdr.version << " is newer than this code!" << &std::endl;
+    return false;
+  }
+  if( !hdr.size || !hdr.cols || !hdr.blockRows || hdr.numFmt >= numNumberFormats ) {
+    std::cerr << "Native format header is malformed!" << &std::endl;
+    return false;
+  }
+  if( hdr.codec >= numNativeCodecs ) {
+    std::cerr << "Native format codec " << hdr.codec << " is unknown!" << &std::endl;
+    return false;
+  }
+  if( hdr.numBlocks != (hdr.rows + hdr.blockRows - 1) / hdr.blockRows ) {
+    std::cerr << "Native format block count does not match row count!" << &std::endl;
+    return false;
+  }
+  return true;
+}
+
+int64_t
+nativeTimeKey( const TimeObj &tt )
+{
+  time_t sec; long usec;
+  tt.get( sec, usec );
+  return int64_t(sec) * 1000000 + usec;
+}
+
+TimeObj
+nativeKeyTime( const int64_t &key )
+{
+  int64_t sec = key / 1000000, usec = key % 1000000;
+  if( usec < 0 ) { sec--; usec += 1000000; }
+  return TimeObj( (time_t)sec, (long)usec );
+}
+
+/** Datenum of 1970/01/01, see TimeObj::setDatenum() */
+static const double epochDatenum = 719529.0;
+
+int64_t
+nativeDatenumKey( const double &dn )
+{
+  return llround( ( dn - epochDatenum ) * 86400e6 );
+}
+
+double
+nativeKeyDatenum( const int64_t &key )
+{
+  return epochDatenum + (double)key / 86400e6;
+}
+
+uint64_t
+nativeFindBlock( const NativeHeader &hdr, const NativeBlockEntry *index, const int64_t &key )
+{
+  if( hdr.numBlocks < 2 ) 
+    return 0;
+
+  if( hdr.sampleRate > 0.0 ) {
+    // Regular rows, so straight arithmetic
+    int64_t utcKey = hdr.utcSec * 1000000 + hdr.utcUsec;
+    if( key <= utcKey ) 
+      return 0;
+    uint64_t row = uint64_t( (key - utcKey) * hdr.sampleRate / 1000000.0 );
+    uint64_t blk = row / hdr.blockRows;
+    return blk < hdr.numBlocks ? blk : hdr.numBlocks - 1;
+  }
+
+  // Last block starting at or before key
+  uint64_t lo = 0, hi = hdr.numBlocks;
+  while( hi - lo > 1 ) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if( index[mid].startUsec <= key )
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/** Put bytes in a scratch file and load them as a native file */
+static size_t
+readNativeBytes( const std::vector<char> &bytes, TimeData &td )
+{
+  td.clear();
+  FILE* fid = tmpfile();
+  if( !fid )
+    return 0;
+  size_t numRows = 0;
+  if( fwrite( &bytes[0], bytes.size(), 1, fid ) == 1 && !fseeko( fid, 0, SEEK_SET ) )
+    numRows = td.readNative( fid );
+  fclose( fid );
+  return numRows;
+}
+
+/** Patch a header field of a native file's bytes */
+template<typename T>
+static void
+patchNative( std::vector<char> &bytes, const size_t &offset, const T &val )
+{
+  memcpy( &bytes[offset], &val, sizeof(T) );
+}
+
+bool
+testNative()
+{
+  // Two channels of ints at 100 Hz over three blocks, the last one short
+  const unsigned long long numRows = 2 * DEFAULT_NATIVE_BLOCK_ROWS + 1000;
+  std::vector<int32_t> samps( numRows * 2 );
+  for( size_t i = 0; i < samps.size(); i++ )
+    samps[i] = (int32_t)( 1000.0 * sin( i * 0.001 ) ) + (int32_t)( i % 7 );
+  TimeObj t0( (time_t)1300000000, 250000 );
+  TimeData td;
+  if( !td.materialize( DataView( (const char*)&samps[0], numRows, 2, sizeof(int32_t), NUM_INT, t0, 100.0 ) ) ) return DRATS;
+  std::vector<std::string> meta( 3 );
+  meta[0] = "counts";
+  meta[2] = "ch1 ch2";
+  td.setMeta( meta );
+
+  char fileName[] = "/tmp/NativeFormatXXXXXX";
+  int fd = mkstemp( fileName );
+  if( fd < 0 ) return DRATS;
+  close( fd );
+
+  std::vector<char> bytes[numNativeCodecs];
+  bool ok = true;
+  for( int codec = NATIVE_CODEC_RAW; ok && codec < numNativeCodecs; codec++ ) {
+    td.setCodec( (NativeCodecs)codec );
+    FILE* fid = tmpfile();
+    ok = fid && td.write( fid, FORMAT_NATIVE );
+    off_t numBytes = fid ? ftello( fid ) : 0;
+    bytes[codec].resize( numBytes > 0 ? numBytes : 1 );
+    ok = ok && numBytes > 0 && !fseeko( fid, 0, SEEK_SET ) && fread( &bytes[codec][0], numBytes, 1, fid ) == 1;
+    if( fid )
+      fclose( fid );
+
+    // The whole file, attributes and meta and all
+    TimeData back;
+    std::vector<std::string> backMeta;
+    ok = ok && readNativeBytes( bytes[codec], back ) == numRows && back.getCodec() == codec && back.getUTC() == t0 &&
+         back.getSampleRate() == 100.0 && back.getCols() == 2 && back.getEltSize() == sizeof(int32_t) &&
+         back.getNumFmt() == NUM_INT && !memcmp( back.getData(), &samps[0], samps.size() * sizeof(int32_t) );
+    back.getMeta( backMeta );
+    ok = ok && backMeta == meta;
+
+    // From the middle of the second block to the middle of the third
+    FILE* out = fopen( fileName, "w" );
+    ok = ok && out && fwrite( &bytes[codec][0], bytes[codec].size(), 1, out ) == 1;
+    if( out && fclose( out ) )
+      ok = false;
+    TimeData part;
+    unsigned long long first = DEFAULT_NATIVE_BLOCK_ROWS + 4465, last = 2 * DEFAULT_NATIVE_BLOCK_ROWS + 200;
+    ok = ok && part.readNative( fileName, t0 + TimeObj( ( first - 0.5 ) / 100.0 ), t0 + TimeObj( last / 100.0 ) ) == last - first + 1 &&
+         part.getUTC() == t0 + TimeObj( first / 100.0 ) &&
+         !memcmp( part.getData(), &samps[first * 2], ( last - first + 1 ) * 2 * sizeof(int32_t) );
+  }
+  unlink( fileName );
+  if( !ok || bytes[NATIVE_CODEC_DELTA].size() >= bytes[NATIVE_CODEC_RAW].size() ) return DRATS;
+
+  // Refused, and left empty: a short header, a bad magic, version or block
+  // count, an index cut short, a coded block not the size indexed
+  const std::vector<char> &raw = bytes[NATIVE_CODEC_RAW];
+  NativeHeader hdr;
+  memcpy( &hdr, &raw[0], sizeof(NativeHeader) );
+  std::vector<std::vector<char>> bad( 6, raw );
+  bad[0].resize( NATIVE_HEADER_BYTES / 2 );
+  bad[1][0] = 'X';
+  patchNative( bad[2], offsetof( NativeHeader, version ), (uint32_t)( NATIVE_VERSION + 1 ) );
+  patchNative( bad[3], offsetof( NativeHeader, numBlocks ), hdr.numBlocks + 1 );
+  bad[4].resize( raw.size() - sizeof(NativeBlockEntry) / 2 );
+  bad[5] = bytes[NATIVE_CODEC_DELTA];
+  memcpy( &hdr, &bad[5][0], sizeof(NativeHeader) );
+  NativeBlockEntry entry;
+  size_t at = hdr.indexOffset + sizeof(NativeBlockEntry);
+  memcpy( &entry, &bad[5][at], sizeof(NativeBlockEntry) );
+  patchNative( bad[5], at + offsetof( NativeBlockEntry, bytes ), entry.bytes - NATIVE_ALIGN );
+  for( size_t b = 0; b < bad.size(); b++ ) {
+    TimeData back;
+    if( readNativeBytes( bad[b], back ) || back.getRows() || back.getData() ) return DRATS;
+  }
+
+  return VOILA;
+}
@@ -0,0 +1,146 @@
+#ifndef __NATIVEFORMAT_H__
+#define __NATIVEFORMAT_H__
+
+/**
+  * Native container format
+  * Copyright 2016, ShotSpotter
+  *
+  * A self-describing binary file for DataCommon heirs, FORMAT_NATIVE:
+  *
+  *   NativeHeader       fixed NATIVE_HEADER_BYTES at offset 0
+  *   blocks             blockRows rows each, every block NATIVE_ALIGN aligned
+  *   meta strings       uint32 count, then uint32 length + chars for each
+  *   NativeBlockEntry[] block index, one per block, in row order
+  *
+  * The header points at the meta strings and the index, so a reader loads
+  * the index once and then seeks straight to the block holding any time.
+  * Raw blocks are contiguous, so the rows may also be streamed straight
+  * through from the end of the header.  Coded blocks each start with their
+  * own length, see DeltaCodec.h, so they stream too.  All values are host
+  * order.
+  */
+
+#include "libCore/libCore.h"
+
+#include <stdint.h>
+
+#define NATIVE_MAGIC "DSPNATV1"
+#define NATIVE_MAGIC_BYTES 8
+#define NATIVE_VERSION 1
+#define NATIVE_HEADER_BYTES 128
+#define NATIVE_ALIGN 64
+
+/** A multiple of NATIVE_ALIGN so that every block is aligned for any row size */
+#define DEFAULT_NATIVE_BLOCK_ROWS 65536
+
+/**
+  * struct NativeHeader
+  * Fixed size header at the front of every native file.
+  */
+struct NativeHeader
+{
+  char     magic[NATIVE_MAGIC_BYTES];
+  uint32_t version;
+  uint32_t objType;     /** ObjTypes of the writer */
+  int64_t  utcSec;      /** Start time */
+  int64_t  utcUsec;
+  int64_t  offsetSec;   /** Time offset */
+  int64_t  offsetUsec;
+  double   sampleRate;  /** Rows per second, zero if rows are not regular */
+  uint32_t size;        /** Element size in bytes */
+  uint32_t cols;
+  uint64_t rows;
+  uint64_t blockRows;   /** Rows per block, all but the last block are full */
+  uint64_t numBlocks;
+  uint64_t metaOffset;  /** File offset of the meta strings */
+  uint64_t indexOffset; /** File offset of the block index */
+  uint32_t codec;       /** NativeCodecs of the blocks */
+  uint32_t flags;       /** NativeFlags */
+  uint32_t numFmt;      /** NumberFormats of the elements, NUM_INT in older files */
+  char     spare[NATIVE_HEADER_BYTES - 116];
+};
+
+enum NativeFlags
+{
+  NATIVE_FLAG_INTERLEAVED = 1
+};
+
+enum NativeCodecs
+{
+  NATIVE_CODEC_RAW,     /** Rows as they are in memory */
+  NATIVE_CODEC_DELTA,   /** Integer rows, predicted and bit packed */
+  numNativeCodecs
+};
+
+/**
+  * struct NativeBlockEntry
+  * One block index entry.
+  */
+struct NativeBlockEntry
+{
+  int64_t  startUsec;   /** Time of first row, microseconds since the epoch */
+  uint64_t firstRow;
+  uint64_t offset;      /** File offset of the block */
+  uint64_t bytes;       /** Stored size of the block, coded if the file is */
+};
+
+/**
+ * Initialize a header with magic, version and zeroes.
+ * @param hdr header to initialize
+ */
+void nativeHeaderInit( NativeHeader &hdr );
+
+/**
+ * Check magic, version and shape of a header just read.
+ * @param hdr header to check
+ * @return true if it is a header this code can read
+ */
+bool nativeHeaderCheck( const NativeHeader &hdr );
+
+/**
+ * Time as the integer key used by the block index.
+ * @param tt time to convert
+ * @return microseconds since the epoch
+ */
+int64_t nativeTimeKey( const TimeObj &tt );
+
+/**
+ * Time from the integer key used by the block index.
+ * @param key microseconds since the epoch
+ * @return the time
+ */
+TimeObj nativeKeyTime( const int64_t &key );
+
+/**
+ * Datenum as a time key, to the nearest microsecond, without a TimeObj.
+ * @param dn Matlab datenum
+ * @return microseconds since the epoch
+ */
+int64_t nativeDatenumKey( const double &dn );
+
+/**
+ * Datenum from a time key.
+ * @param key microseconds since the epoch
+ * @return Matlab datenum
+ */
+double nativeKeyDatenum( const int64_t &key );
+
+/**
+ * Find the block holding the row at or just before time key.  Regularly
+ * sampled files are resolved arithmetically, others by binary search of the
+ * index.  Index times are assumed to be in row order.
+ * @param hdr header of the file
+ * @param index block index of the file
+ * @param key time as returned by nativeTimeKey()
+ * @return block number, clamped to the blocks present
+ */
+uint64_t nativeFindBlock( const NativeHeader &hdr, const NativeBlockEntry *index, const int64_t &key );
+
+/**
+ * Run the regression test for the native container, written and read
+ * through TimeData.  Return 0 if good.
+ * @return bool
+ */
+bool testNative();
+
+#endif // __NATIVEFORMAT_H__
@@ -0,0 +1,361 @@
+#include "RowSort.h"
+#include "ThreadSplit.h"
+
+/**
+  * RowSort
+  * Copyright 2016, ShotSpotter
+  */
+
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Rows checked between looks at the running result */
+#define SORT_CHECK_BLOCK 4096
+
+/** Rows ahead to prefetch when gathering */
+#define SORT_PREFETCH_ROWS 16
+
+/** Threads to split across, zero for one per core */
+static std::atomic<unsigned int> sortThreads( 0 );
+
+/** A key and the row it came from */
+struct KeyRow
+{
+  uint64_t key;
+  uint64_t row;
+};
+
+/**
+ * The stable order of numRows keys, keyOf( r ) the key of row r, by LSD
+ * radix sort split across threads.  The keys themselves, in order, go to
+ * sorted if it isn't NULL.
+ */
+template<typename K>
+static void
+radixOrder( const size_t &numRows, const K &keyOf, std::vector<uint64_t> &order, uint64_t* sorted = NULL )
+{
+  order.resize( numRows );
+  if( !numRows )
+    return;
+
+  // Same share of rows for each thread on every pass, so each scatters its own in order
+  unsigned int numThreads = threadsFor( numRows, SORT_THREAD_ROWS, sortThreads.load( std::memory_order_relaxed ) );
+  size_t per = (numRows + numThreads - 1) / numThreads;
+  std::vector<KeyRow> from( numRows ), to( numRows );
+  std::vector<uint64_t> ors( numThreads, 0 ), ands( numThreads, ~0ULL );
+  runThreads( numThreads, [&]( unsigned int t ) {
+    size_t beg = std::min( numRows, t * per ), end = std::min( numRows, beg + per );
+    uint64_t anyBits = 0, allBits = ~0ULL;
+    for( size_t r = beg; r < end; r++ ) {
+      from[r].key = keyOf( r );
+      from[r].row = r;
+      anyBits |= from[r].key;
+      allBits &= from[r].key;
+    }
+    ors[t] = anyBits;
+    ands[t] = allBits;
+  } );
+
+  // Bytes all keys share need no pass, datenums share most of theirs
+  uint64_t anyBits = 0, allBits = ~0ULL;
+  for( unsigned int t = 0; t < numThreads; t++ ) {
+    anyBits |= ors[t];
+    allBits &= ands[t];
+  }
+  uint64_t differ = anyBits ^ allBits;
+
+  std::vector<size_t> counts( numThreads * 256 );
+  for( unsigned int shift = 0; shift < 64; shift += 8 ) {
+    if( !( (differ >> shift) & 0xff ) )
+      continue;
+
+    runThreads( numThreads, [&]( unsigned int t ) {
+      size_t beg = std::min( numRows, t * per ), end = std::min( numRows, beg + per );
+      size_t* cnt = &counts[t * 256];
+      std::fill( cnt, cnt + 256, 0 );
+      for( size_t r = beg; r < end; r++ )
+        cnt[(from[r].key >> shift) & 0xff]++;
+    } );
+
+    // Digit by digit, then thread by thread, so the sort is stable
+    size_t pos = 0;
+    for( unsigned int d = 0; d < 256; d++ ) {
+      for( unsigned int t = 0; t < numThreads; t++ ) {
+        size_t num = counts[t * 256 + d];
+        counts[t * 256 + d] = pos;
+        pos += num;
+      }
+    }
+
+    runThreads( numThreads, [&]( unsigned int t ) {
+      size_t beg = std::min( numRows, t * per ), end = std::min( numRows, beg + per );
+      size_t* at = &counts[t * 256];
+      for( size_t r = beg; r < end; r++ )
+        to[at[(from[r].key >> shift) & 0xff]++] = from[r];
+    } );
+    from.swap( to );
+  }
+
+  runThreads( numThreads, [&]( unsigned int t ) {
+    size_t beg = std::min( numRows, t * per ), end = std::min( numRows, beg + per );
+    for( size_t r = beg; r < end; r++ )
+      order[r] = from[r].row;
+    if( sorted )
+      for( size_t r = beg; r < end; r++ )
+        sorted[r] = from[r].key;
+  } );
+}
+
+bool
+sortOrder( const DataView &keys, std::vector<uint64_t> &order )
+{
+  if( keys.getNumFmt() != NUM_DBL || keys.getEltSize() != sizeof(double) ) {
+    std::cerr << "sortOrder() sorts by a column of doubles!" << &std::endl;
+    return false;
+  }
+  radixOrder( keys.getRows(), [&]( const size_t &r ) {
+    double val;
+    memcpy( &val, keys.getRow( r ), sizeof(val) );
+    return sortKey( val );
+  }, order );
+  return true;
+}
+
+void
+sortOrder( const int64_t* keys, const size_t &numRows, std::vector<uint64_t> &order, int64_t* sorted )
+{
+  radixOrder( numRows, [&]( const size_t &r ) { return sortKey( keys[r] ); }, order, (uint64_t*)sorted );
+
+  // Back from keys to the integers
+  if( sorted )
+    for( size_t r = 0; r < numRows; r++ )
+      sorted[r] = (int64_t)( (uint64_t)sorted[r] ^ 0x8000000000000000ULL );
+}
+
+void
+gatherRows( const DataView &view, const uint64_t* order, char* dst )
+{
+  size_t numRows = view.getRows();
+  size_t rowBytes = view.getRowSize(), eltBytes = view.getEltSize();
+  bool planar = view.isPlanar() && view.getCols() > 1;
+
+  // Writes go out in order, the reads are prefetched ahead
+  unsigned int numThreads = threadsFor( numRows, SORT_THREAD_ROWS, sortThreads.load( std::memory_order_relaxed ) );
+  size_t per = (numRows + numThreads - 1) / numThreads;
+  runThreads( numThreads, [&]( unsigned int t ) {
+    size_t beg = std::min( numRows, t * per ), end = std::min( numRows, beg + per );
+    if( !planar && view.getStride() == rowBytes && view.getColStride() == eltBytes ) {
+      const char* src = view.getData();
+      for( size_t r = beg; r < end; r++ ) {
+        if( r + SORT_PREFETCH_ROWS < end )
+          __builtin_prefetch( src + order[r + SORT_PREFETCH_ROWS] * rowBytes );
+        memcpy( dst + r * rowBytes, src + order[r] * rowBytes, rowBytes );
+      }
+      return;
+    }
+    for( unsigned int c = 0; c < view.getCols(); c++ ) {
+      DataView col = view.column( c );
+      char* out = planar ? dst + c * numRows * eltBytes : dst + c * eltBytes;
+      size_t step = planar ? eltBytes : rowBytes;
+      for( size_t r = beg; r < end; r++ ) {
+        if( r + SORT_PREFETCH_ROWS < end )
+          __builtin_prefetch( col.getRow( order[r + SORT_PREFETCH_ROWS] ) );
+        memcpy( out + r * step, col.getRow( order[r] ), eltBytes );
+      }
+    }
+  } );
+}
+
+/**
+ * Any row from beg up to end less than the one before it?  Packed columns
+ * are compared two rows at a time, without a branch until the block ends.
+ */
+static bool
+anyDecrease( const char* col, const size_t &stride, size_t beg, const size_t &end )
+{
+  if( !beg )
+    beg = 1;
+  size_t i = beg;
+  bool down = false;
+  if( stride == sizeof(double) ) {
+    const double* val = (const double*)col;
+   #ifdef __SSE2__
+    while( i + 2 <= end ) {
+      size_t stop = std::min( end, i + SORT_CHECK_BLOCK );
+      __m128d acc = _mm_setzero_pd();
+      for( ; i + 2 <= stop; i += 2 )
+        acc = _mm_or_pd( acc, _mm_cmplt_pd( _mm_loadu_pd( val + i ), _mm_loadu_pd( val + i - 1 ) ) );
+      if( _mm_movemask_pd( acc ) )
+        return true;
+    }
+   #endif // __SSE2__
+    for( ; i < end; i++ )
+      down |= val[i] < val[i - 1];
+    return down;
+  }
+
+  double prev;
+  memcpy( &prev, col + (i - 1) * stride, sizeof(prev) );
+  while( i < end ) {
+    size_t stop = std::min( end, i + SORT_CHECK_BLOCK );
+    for( ; i < stop; i++ ) {
+      double cur;
+      memcpy( &cur, col + i * stride, sizeof(cur) );
+      down |= cur < prev;
+      prev = cur;
+    }
+    if( down )
+      return true;
+  }
+  return false;
+}
+
+bool
+isSorted( const DataView &keys )
+{
+  if( keys.getNumFmt() != NUM_DBL || keys.getEltSize() != sizeof(double) ) {
+    std::cerr << "isSorted() checks a column of doubles!" << &std::endl;
+    return false;
+  }
+  size_t numRows = keys.getRows();
+  if( numRows < 2 )
+    return true;
+
+  // Each share compares its first row with the last of the share before
+  unsigned int numThreads = threadsFor( numRows, SORT_THREAD_ROWS, sortThreads.load( std::memory_order_relaxed ) );
+  size_t per = (numRows + numThreads - 1) / numThreads;
+  std::atomic<bool> down( false );
+  runThreads( numThreads, [&]( unsigned int t ) {
+    size_t beg = std::min( numRows, t * per ), end = std::min( numRows, beg + per );
+    if( beg < end && anyDecrease( keys.getData(), keys.getStride(), beg, end ) )
+      down.store( true, std::memory_order_relaxed );
+  } );
+  return !down.load();
+}
+
+/**
+ * Any key from beg up to end less than the one before it?  Two at a time,
+ * a < b exactly when a - b is negative but didn't overflow, or overflowed
+ * and isn't.
+ */
+static bool
+anyDecrease( const int64_t* val, size_t beg, const size_t &end )
+{
+  if( !beg )
+    beg = 1;
+  size_t i = beg;
+  bool down = false;
+ #ifdef __SSE2__
+  while( i + 2 <= end ) {
+    size_t stop = std::min( end, i + SORT_CHECK_BLOCK );
+    __m128i acc = _mm_setzero_si128();
+    for( ; i + 2 <= stop; i += 2 ) {
+      __m128i cur = _mm_loadu_si128( (const __m128i*)( val + i ) );
+      __m128i prev = _mm_loadu_si128( (const __m128i*)( val + i - 1 ) );
+      __m128i diff = _mm_sub_epi64( cur, prev );
+      __m128i over = _mm_and_si128( _mm_xor_si128( cur, prev ), _mm_xor_si128( cur, diff ) );
+      acc = _mm_or_si128( acc, _mm_xor_si128( diff, over ) );
+    }
+    if( _mm_movemask_pd( _mm_castsi128_pd( acc ) ) )
+      return true;
+  }
+ #endif // __SSE2__
+  for( ; i < end; i++ )
+    down |= val[i] < val[i - 1];
+  return down;
+}
+
+bool
+isSorted( const int64_t* keys, const size_t &numRows )
+{
+  if( numRows < 2 )
+    return true;
+
+  unsigned int numThreads = threadsFor( numRows, SORT_THREAD_ROWS, sortThreads.load( std::memory_order_relaxed ) );
+  size_t per = (numRows + numThreads - 1) / numThreads;
+  std::atomic<bool> down( false );
+  runThreads( numThreads, [&]( unsigned int t ) {
+    size_t beg = std::min( numRows, t * per ), end = std::min( numRows, beg + per );
+    if( beg < end && anyDecrease( keys, beg, end ) )
+      down.store( true, std::memory_order_relaxed );
+  } );
+  return !down.load();
+}
+
+void
+setSortThreads( const unsigned int &numThreads )
+{
+  sortThreads.store( numThreads, std::memory_order_relaxed );
+}
+
+bool
+testRowSort()
+{
+  // Keys of every sign and size, in either order
+  const double vals[] = { 3.5, -0.0, 1e300, -2.0, 0.0, -1e-300, 738000.25, -738000.25, 2.0, 3.5 };
+  for( size_t i = 1; i < sizeof(vals) / sizeof(vals[0]); i++ )
+    if( vals[i - 1] < vals[i] && !( sortKey( vals[i - 1] ) < sortKey( vals[i] ) ) ) return DRATS;
+  if( !( sortKey( -0.0 ) < sortKey( 0.0 ) ) || !( sortKey( 1e308 ) < sortKey( NAN ) ) ) return DRATS;
+
+  // Rows of a key and its original position, ties kept in order
+  size_t numRows = 3 * SORT_THREAD_ROWS + 7;
+  std::vector<double> rows( numRows * 2 );
+  uint64_t lcg = 12345;
+  for( size_t r = 0; r < numRows; r++ ) {
+    lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+    rows[2 * r] = 738000.0 + (double)( (lcg >> 40) % 5000 ) / 86400.0;
+    rows[2 * r + 1] = (double)r;
+  }
+  DataView view( (const char*)&rows[0], numRows, 2, sizeof(double), NUM_DBL, TimeObj() );
+  if( isSorted( view.column( 0 ) ) ) return DRATS;
+
+  std::vector<uint64_t> order;
+  if( !sortOrder( view.column( 0 ), order ) ) return DRATS;
+  std::vector<double> sorted( numRows * 2 );
+  gatherRows( view, &order[0], (char*)&sorted[0] );
+  DataView out( (const char*)&sorted[0], numRows, 2, sizeof(double), NUM_DBL, TimeObj() );
+  if( !isSorted( out.column( 0 ) ) ) return DRATS;
+  for( size_t r = 1; r < numRows; r++ )
+    if( sorted[2 * r] == sorted[2 * r - 2] && sorted[2 * r + 1] < sorted[2 * r - 1] ) return DRATS;
+
+  // Planar rows gather to planar
+  std::vector<double> planar( numRows * 2 ), back( numRows * 2 );
+  for( size_t r = 0; r < numRows; r++ ) {
+    planar[r] = rows[2 * r];
+    planar[numRows + r] = rows[2 * r + 1];
+  }
+  DataView pview( (const char*)&planar[0], numRows, 2, sizeof(double), NUM_DBL, TimeObj(), 0.0,
+                  sizeof(double), numRows * sizeof(double) );
+  gatherRows( pview, &order[0], (char*)&back[0] );
+  for( size_t r = 0; r < numRows; r++ )
+    if( back[r] != sorted[2 * r] || back[numRows + r] != sorted[2 * r + 1] ) return DRATS;
+
+  // Integer keys, either side of zero and at the ends of the range
+  const int64_t ints[] = { INT64_MIN, -5, -1, 0, 1, 7, 7, INT64_MAX };
+  for( size_t i = 1; i < sizeof(ints) / sizeof(ints[0]); i++ )
+    if( !( sortKey( ints[i - 1] ) <= sortKey( ints[i] ) ) ) return DRATS;
+  if( !isSorted( ints, sizeof(ints) / sizeof(ints[0]) ) ) return DRATS;
+  std::vector<int64_t> keys( numRows );
+  for( size_t r = 0; r < numRows; r++ )
+    keys[r] = llround( ( rows[2 * r] - 738000.0 ) * 86400.0 ) - 2500;
+  if( isSorted( &keys[0], numRows ) ) return DRATS;
+  std::vector<uint64_t> intOrder;
+  std::vector<int64_t> intSorted( numRows );
+  sortOrder( &keys[0], numRows, intOrder, &intSorted[0] );
+  if( intOrder != order || !isSorted( &intSorted[0], numRows ) ) return DRATS;
+  for( size_t r = 0; r < numRows; r++ )
+    if( intSorted[r] != keys[order[r]] ) return DRATS;
+  for( size_t r = 0; r < numRows; r++ )
+    keys[r] = (int64_t)sorted[2 * r + 1];
+  std::sort( keys.begin(), keys.end() );
+  if( !isSorted( &keys[0], numRows ) ) return DRATS;
+  keys[numRows / 2] = INT64_MIN;
+  if( isSorted( &keys[0], numRows ) ) return DRATS;
+
+  return VOILA;
+}
@@ -0,0 +1,101 @@
+#ifndef __ROWSORT_H__
+#define __ROWSORT_H__
+
+/**
+  * RowSort
+  * Copyright 2016, ShotSpotter
+  *
+  * Ordering whole rows by a column of doubles, the datenums of EventData
+  * say.  The column is turned into integer keys that sort the same way,
+  * which are radix sorted eight bits at a time along with their row
+  * numbers, skipping the bytes every key shares.  Rows are then gathered
+  * once, in order, from wherever they were.  Millions of rows are split
+  * across threads at every step.
+  */
+
+#include "libCore/libCore.h"
+#include "DataView.h"
+
+#include <stdint.h>
+
+/** Fewest rows worth a thread of their own */
+#define SORT_THREAD_ROWS (1 << 16)
+
+/**
+ * Integer key that orders as the double does, -0 before +0 and NaN last.
+ * @param val the double
+ * @return the key
+ */
+inline uint64_t
+sortKey( const double &val )
+{
+  uint64_t bits;
+  memcpy( &bits, &val, sizeof(bits) );
+  return ( bits >> 63 ) ? ~bits : ( bits | 0x8000000000000000ULL );
+}
+
+/**
+ * Integer key that orders as the int64_t does.
+ * @param val the integer
+ * @return the key
+ */
+inline uint64_t
+sortKey( const int64_t &val )
+{
+  return (uint64_t)val ^ 0x8000000000000000ULL;
+}
+
+/**
+ * The order that sorts the rows of a column, stable, by LSD radix sort.
+ * @param keys column of NUM_DBL, any stride
+ * @param order row numbers in sorted order, resized to the rows
+ * @return false if the column isn't doubles
+ */
+bool sortOrder( const DataView &keys, std::vector<uint64_t> &order );
+
+/**
+ * As sortOrder( const DataView&, ... ), for packed integer keys, time keys
+ * say.
+ * @param keys the keys
+ * @param numRows number of keys
+ * @param order row numbers in sorted order, resized to the rows
+ * @param sorted (optional) room for the keys in sorted order, saves gathering them
+ */
+void sortOrder( const int64_t* keys, const size_t &numRows, std::vector<uint64_t> &order, int64_t* sorted = NULL );
+
+/**
+ * Copy rows in a given order.
+ * @param view rows to copy, either layout
+ * @param order row of view for each row of dst, see sortOrder()
+ * @param dst room for the rows, packed, planar if the view is
+ */
+void gatherRows( const DataView &view, const uint64_t* order, char* dst );
+
+/**
+ * Check that a column never decreases.  NaNs are passed over.
+ * @param keys column of NUM_DBL, any stride
+ * @return true if it is sorted
+ */
+bool isSorted( const DataView &keys );
+
+/**
+ * Check that packed integer keys never decrease.
+ * @param keys the keys
+ * @param numRows number of keys
+ * @return true if they are sorted
+ */
+bool isSorted( const int64_t* keys, const size_t &numRows );
+
+/**
+ * Set the number of threads big sorts are split across.
+ * @param numThreads threads wanted, zero for one per core
+ */
+void setSortThreads( const unsigned int &numThreads );
+
+/**
+ * Run the regression test for row sorting.  Return 0 if good.
+ * @return bool
+ */
+bool testRowSort();
+
+#endif // __ROWSORT_H__
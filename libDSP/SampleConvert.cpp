@@ -0,0 +1,655 @@
+#include "SampleConvert.h"
+
+/**
+  * SampleConvert
+  * Copyright 2016, ShotSpotter
+  */
+
+#include <math.h>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CONVERT_X86 1
+#endif
+
+/** Samples per pass through the staging buffers, small enough to stay in L1 */
+#define CONVERT_CHUNK 512
+
+/** The stored formats */
+enum SampleKind
+{
+  KIND_NONE,
+  KIND_I16,
+  KIND_I24,
+  KIND_I32,
+  KIND_F32,
+  KIND_F64
+};
+
+static SampleKind
+sampleKind( const NumberFormats &fmt, const unsigned int &size )
+{
+  switch( fmt ) {
+  case NUM_INT:
+    if( size == 2 ) return KIND_I16;
+    if( size == 3 ) return KIND_I24;
+    if( size == 4 ) return KIND_I32;
+    break;
+  case NUM_FLT:
+    if( size == 4 ) return KIND_F32;
+    break;
+  case NUM_DBL:
+  case NUM_TIME:
+    if( size == 8 ) return KIND_F64;
+    break;
+  default:
+    break;
+  }
+  std::cerr << "No sample conversion for element size " << size << " format " << fmt << "!" << &std::endl;
+  return KIND_NONE;
+}
+
+/** One set of stage kernels per instruction set, conversions chain them */
+struct ConvertKernels
+{
+  ConvertISA isa;
+  void (*widen16)( const int16_t* src, int32_t* dst, size_t n );
+  void (*widen24)( const uint8_t* src, int32_t* dst, size_t n );
+  void (*i32ToF64)( const int32_t* src, double* dst, size_t n );
+  void (*i32ToF32)( const int32_t* src, float* dst, size_t n );
+  void (*f32ToF64)( const float* src, double* dst, size_t n );
+  void (*f64ToF32)( const double* src, float* dst, size_t n );
+  void (*f64ToI32)( const double* src, int32_t* dst, size_t n, double lo, double hi ); /** Clamped, rounded */
+  void (*narrow16)( const int32_t* src, int16_t* dst, size_t n );                      /** src in range */
+  void (*narrow24)( const int32_t* src, uint8_t* dst, size_t n );                      /** src in range */
+};
+
+
+//
+// Scalar, also the tails of the vector kernels
+//
+
+static void
+widen16Scalar( const int16_t* src, int32_t* dst, size_t n )
+{
+  for( size_t i = 0; i < n; i++ )
+    dst[i] = src[i];
+}
+
+static void
+widen24Scalar( const uint8_t* src, int32_t* dst, size_t n )
+{
+  for( size_t i = 0; i < n; i++, src += 3 )
+    dst[i] = (int32_t)((uint32_t)src[0] << 8 | (uint32_t)src[1] << 16 | (uint32_t)src[2] << 24) >> 8;
+}
+
+static void
+i32ToF64Scalar( const int32_t* src, double* dst, size_t n )
+{
+  for( size_t i = 0; i < n; i++ )
+    dst[i] = src[i];
+}
+
+static void
+i32ToF32Scalar( const int32_t* src, float* dst, size_t n )
+{
+  for( size_t i = 0; i < n; i++ )
+    dst[i] = (float)src[i];
+}
+
+static void
+f32ToF64Scalar( const float* src, double* dst, size_t n )
+{
+  for( size_t i = 0; i < n; i++ )
+    dst[i] = src[i];
+}
+
+static void
+f64ToF32Scalar( const double* src, float* dst, size_t n )
+{
+  for( size_t i = 0; i < n; i++ )
+    dst[i] = (float)src[i];
+}
+
+static void
+f64ToI32Scalar( const double* src, int32_t* dst, size_t n, double lo, double hi )
+{
+  for( size_t i = 0; i < n; i++ ) {
+    double x = src[i];
+    if( x != x )
+      x = 0.0;
+    else if( x < lo )
+      x = lo;
+    else if( x > hi )
+      x = hi;
+    dst[i] = (int32_t)nearbyint( x ); // Half to even, as the vector units do
+  }
+}
+
+static void
+narrow16Scalar( const int32_t* src, int16_t* dst, size_t n )
+{
+  for( size_t i = 0; i < n; i++ )
+    dst[i] = (int16_t)src[i];
+}
+
+static void
+narrow24Scalar( const int32_t* src, uint8_t* dst, size_t n )
+{
+  for( size_t i = 0; i < n; i++, dst += 3 ) {
+    uint32_t v = (uint32_t)src[i];
+    dst[0] = v;
+    dst[1] = v >> 8;
+    dst[2] = v >> 16;
+  }
+}
+
+static const ConvertKernels scalarKernels = {
+  CONVERT_SCALAR,
+  widen16Scalar, widen24Scalar, i32ToF64Scalar, i32ToF32Scalar,
+  f32ToF64Scalar, f64ToF32Scalar, f64ToI32Scalar, narrow16Scalar, narrow24Scalar
+};
+
+
+#ifdef CONVERT_X86
+
+//
+// SSE2, four lanes.  No byte shuffle, so 24 bit stays scalar.
+//
+
+__attribute__((target("sse2"))) static void
+widen16SSE2( const int16_t* src, int32_t* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 8 <= n; i += 8 ) {
+    __m128i v = _mm_loadu_si128( (const __m128i*)(src + i) );
+    _mm_storeu_si128( (__m128i*)(dst + i),     _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) );
+    _mm_storeu_si128( (__m128i*)(dst + i + 4), _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 ) );
+  }
+  widen16Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("sse2"))) static void
+i32ToF64SSE2( const int32_t* src, double* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 ) {
+    __m128i v = _mm_loadu_si128( (const __m128i*)(src + i) );
+    _mm_storeu_pd( dst + i,     _mm_cvtepi32_pd( v ) );
+    _mm_storeu_pd( dst + i + 2, _mm_cvtepi32_pd( _mm_unpackhi_epi64( v, v ) ) );
+  }
+  i32ToF64Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("sse2"))) static void
+i32ToF32SSE2( const int32_t* src, float* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 )
+    _mm_storeu_ps( dst + i, _mm_cvtepi32_ps( _mm_loadu_si128( (const __m128i*)(src + i) ) ) );
+  i32ToF32Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("sse2"))) static void
+f32ToF64SSE2( const float* src, double* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 ) {
+    __m128 v = _mm_loadu_ps( src + i );
+    _mm_storeu_pd( dst + i,     _mm_cvtps_pd( v ) );
+    _mm_storeu_pd( dst + i + 2, _mm_cvtps_pd( _mm_movehl_ps( v, v ) ) );
+  }
+  f32ToF64Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("sse2"))) static void
+f64ToF32SSE2( const double* src, float* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 ) {
+    __m128 lo = _mm_cvtpd_ps( _mm_loadu_pd( src + i ) );
+    __m128 hi = _mm_cvtpd_ps( _mm_loadu_pd( src + i + 2 ) );
+    _mm_storeu_ps( dst + i, _mm_movelh_ps( lo, hi ) );
+  }
+  f64ToF32Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("sse2"))) static void
+f64ToI32SSE2( const double* src, int32_t* dst, size_t n, double lo, double hi )
+{
+  __m128d vlo = _mm_set1_pd( lo ), vhi = _mm_set1_pd( hi );
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 ) {
+    __m128d a = _mm_loadu_pd( src + i );
+    __m128d b = _mm_loadu_pd( src + i + 2 );
+    a = _mm_and_pd( a, _mm_cmpord_pd( a, a ) ); // NaN to zero
+    b = _mm_and_pd( b, _mm_cmpord_pd( b, b ) );
+    a = _mm_min_pd( _mm_max_pd( a, vlo ), vhi );
+    b = _mm_min_pd( _mm_max_pd( b, vlo ), vhi );
+    _mm_storeu_si128( (__m128i*)(dst + i), _mm_unpacklo_epi64( _mm_cvtpd_epi32( a ), _mm_cvtpd_epi32( b ) ) );
+  }
+  f64ToI32Scalar( src + i, dst + i, n - i, lo, hi );
+}
+
+__attribute__((target("sse2"))) static void
+narrow16SSE2( const int32_t* src, int16_t* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 8 <= n; i += 8 ) {
+    __m128i a = _mm_loadu_si128( (const __m128i*)(src + i) );
+    __m128i b = _mm_loadu_si128( (const __m128i*)(src + i + 4) );
+    _mm_storeu_si128( (__m128i*)(dst + i), _mm_packs_epi32( a, b ) );
+  }
+  narrow16Scalar( src + i, dst + i, n - i );
+}
+
+static const ConvertKernels sse2Kernels = {
+  CONVERT_SSE2,
+  widen16SSE2, widen24Scalar, i32ToF64SSE2, i32ToF32SSE2,
+  f32ToF64SSE2, f64ToF32SSE2, f64ToI32SSE2, narrow16SSE2, narrow24Scalar
+};
+
+
+//
+// AVX2, eight lanes
+//
+
+__attribute__((target("avx2"))) static void
+widen16AVX2( const int16_t* src, int32_t* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 8 <= n; i += 8 )
+    _mm256_storeu_si256( (__m256i*)(dst + i), _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i*)(src + i) ) ) );
+  widen16Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("avx2"))) static void
+widen24AVX2( const uint8_t* src, int32_t* dst, size_t n )
+{
+  // Each lane takes four samples, into the top three bytes of each int32
+  const __m256i shuf = _mm256_setr_epi8( -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                         -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11 );
+  size_t i = 0;
+  for( ; i + 10 <= n; i += 8 ) { // The second load reads 4 bytes past the 8 samples
+    const uint8_t* s = src + 3 * i;
+    __m256i v = _mm256_inserti128_si256( _mm256_castsi128_si256( _mm_loadu_si128( (const __m128i*)s ) ),
+                                         _mm_loadu_si128( (const __m128i*)(s + 12) ), 1 );
+    _mm256_storeu_si256( (__m256i*)(dst + i), _mm256_srai_epi32( _mm256_shuffle_epi8( v, shuf ), 8 ) );
+  }
+  widen24Scalar( src + 3 * i, dst + i, n - i );
+}
+
+__attribute__((target("avx2"))) static void
+i32ToF64AVX2( const int32_t* src, double* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 )
+    _mm256_storeu_pd( dst + i, _mm256_cvtepi32_pd( _mm_loadu_si128( (const __m128i*)(src + i) ) ) );
+  i32ToF64Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("avx2"))) static void
+i32ToF32AVX2( const int32_t* src, float* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 8 <= n; i += 8 )
+    _mm256_storeu_ps( dst + i, _mm256_cvtepi32_ps( _mm256_loadu_si256( (const __m256i*)(src + i) ) ) );
+  i32ToF32Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("avx2"))) static void
+f32ToF64AVX2( const float* src, double* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 )
+    _mm256_storeu_pd( dst + i, _mm256_cvtps_pd( _mm_loadu_ps( src + i ) ) );
+  f32ToF64Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("avx2"))) static void
+f64ToF32AVX2( const double* src, float* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 )
+    _mm_storeu_ps( dst + i, _mm256_cvtpd_ps( _mm256_loadu_pd( src + i ) ) );
+  f64ToF32Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("avx2"))) static void
+f64ToI32AVX2( const double* src, int32_t* dst, size_t n, double lo, double hi )
+{
+  __m256d vlo = _mm256_set1_pd( lo ), vhi = _mm256_set1_pd( hi );
+  size_t i = 0;
+  for( ; i + 4 <= n; i += 4 ) {
+    __m256d a = _mm256_loadu_pd( src + i );
+    a = _mm256_and_pd( a, _mm256_cmp_pd( a, a, _CMP_ORD_Q ) ); // NaN to zero
+    a = _mm256_min_pd( _mm256_max_pd( a, vlo ), vhi );
+    _mm_storeu_si128( (__m128i*)(dst + i), _mm256_cvtpd_epi32( a ) );
+  }
+  f64ToI32Scalar( src + i, dst + i, n - i, lo, hi );
+}
+
+__attribute__((target("avx2"))) static void
+narrow16AVX2( const int32_t* src, int16_t* dst, size_t n )
+{
+  size_t i = 0;
+  for( ; i + 16 <= n; i += 16 ) {
+    __m256i a = _mm256_loadu_si256( (const __m256i*)(src + i) );
+    __m256i b = _mm256_loadu_si256( (const __m256i*)(src + i + 8) );
+    // packs works per lane, so put the quarters back in order
+    __m256i p = _mm256_permute4x64_epi64( _mm256_packs_epi32( a, b ), 0xD8 );
+    _mm256_storeu_si256( (__m256i*)(dst + i), p );
+  }
+  narrow16Scalar( src + i, dst + i, n - i );
+}
+
+__attribute__((target("avx2"))) static void
+narrow24AVX2( const int32_t* src, uint8_t* dst, size_t n )
+{
+  // Each lane packs its four samples into its low 12 bytes
+  const __m256i shuf = _mm256_setr_epi8( 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                         0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1 );
+  size_t i = 0;
+  for( ; i + 10 <= n; i += 8 ) { // The second store spills 4 bytes, rewritten next time round
+    uint8_t* d = dst + 3 * i;
+    __m256i v = _mm256_shuffle_epi8( _mm256_loadu_si256( (const __m256i*)(src + i) ), shuf );
+    _mm_storeu_si128( (__m128i*)d, _mm256_castsi256_si128( v ) );
+    _mm_storeu_si128( (__m128i*)(d + 12), _mm256_extracti128_si256( v, 1 ) );
+  }
+  narrow24Scalar( src + i, dst + 3 * i, n - i );
+}
+
+static const ConvertKernels avx2Kernels = {
+  CONVERT_AVX2,
+  widen16AVX2, widen24AVX2, i32ToF64AVX2, i32ToF32AVX2,
+  f32ToF64AVX2, f64ToF32AVX2, f64ToI32AVX2, narrow16AVX2, narrow24AVX2
+};
+
+#endif // CONVERT_X86
+
+
+//
+// Dispatch
+//
+
+static const ConvertKernels*
+kernelsFor( const ConvertISA &isa )
+{
+ #ifdef CONVERT_X86
+  __builtin_cpu_init();
+  if( isa == CONVERT_AVX2 && __builtin_cpu_supports( "avx2" ) )
+    return &avx2Kernels;
+  if( isa == CONVERT_SSE2 && __builtin_cpu_supports( "sse2" ) )
+    return &sse2Kernels;
+ #endif // CONVERT_X86
+  if( isa == CONVERT_SCALAR )
+    return &scalarKernels;
+  return NULL;
+}
+
+static std::atomic<const ConvertKernels*> activeKernels( NULL );
+
+static const ConvertKernels*
+kernels()
+{
+  const ConvertKernels* k = activeKernels.load( std::memory_order_acquire );
+  if( !k ) {
+    for( int isa = numConvertISAs - 1; !k; isa-- )
+      k = kernelsFor( (ConvertISA)isa );
+    activeKernels.store( k, std::memory_order_release );
+  }
+  return k;
+}
+
+ConvertISA
+getConvertISA()
+{
+  return kernels()->isa;
+}
+
+bool
+setConvertISA( const ConvertISA &isa )
+{
+  const ConvertKernels* k = kernelsFor( isa );
+  if( !k )
+    return false;
+  activeKernels.store( k, std::memory_order_release );
+  return true;
+}
+
+
+//
+// Conversions
+//
+
+/** Saturation limits of the integer kinds */
+static inline void
+intLimits( const SampleKind &kind, double &lo, double &hi )
+{
+  if( kind == KIND_I16 ) {
+    lo = -32768.0;
+    hi = 32767.0;
+  } else if( kind == KIND_I24 ) {
+    lo = -8388608.0;
+    hi = 8388607.0;
+  } else {
+    lo = -2147483648.0;
+    hi = 2147483647.0;
+  }
+}
+
+bool
+samplesToDouble( const char* src, const NumberFormats &fmt, const unsigned int &size, double* dst, const size_t &numSamps )
+{
+  SampleKind kind = sampleKind( fmt, size );
+  const ConvertKernels* k = kernels();
+  int32_t stage[CONVERT_CHUNK];
+
+  switch( kind ) {
+  case KIND_I16:
+  case KIND_I24:
+    for( size_t i = 0; i < numSamps; i += CONVERT_CHUNK ) {
+      size_t n = numSamps - i < CONVERT_CHUNK ? numSamps - i : CONVERT_CHUNK;
+      if( kind == KIND_I16 )
+        k->widen16( (const int16_t*)src + i, stage, n );
+      else
+        k->widen24( (const uint8_t*)src + 3 * i, stage, n );
+      k->i32ToF64( stage, dst + i, n );
+    }
+    return true;
+  case KIND_I32:
+    k->i32ToF64( (const int32_t*)src, dst, numSamps );
+    return true;
+  case KIND_F32:
+    k->f32ToF64( (const float*)src, dst, numSamps );
+    return true;
+  case KIND_F64:
+    memcpy( dst, src, numSamps * sizeof(double) );
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool
+samplesToFloat( const char* src, const NumberFormats &fmt, const unsigned int &size, float* dst, const size_t &numSamps )
+{
+  SampleKind kind = sampleKind( fmt, size );
+  const ConvertKernels* k = kernels();
+  int32_t stage[CONVERT_CHUNK];
+
+  switch( kind ) {
+  case KIND_I16:
+  case KIND_I24:
+    for( size_t i = 0; i < numSamps; i += CONVERT_CHUNK ) {
+      size_t n = numSamps - i < CONVERT_CHUNK ? numSamps - i : CONVERT_CHUNK;
+      if( kind == KIND_I16 )
+        k->widen16( (const int16_t*)src + i, stage, n );
+      else
+        k->widen24( (const uint8_t*)src + 3 * i, stage, n );
+      k->i32ToF32( stage, dst + i, n );
+    }
+    return true;
+  case KIND_I32:
+    k->i32ToF32( (const int32_t*)src, dst, numSamps );
+    return true;
+  case KIND_F32:
+    memcpy( dst, src, numSamps * sizeof(float) );
+    return true;
+  case KIND_F64:
+    k->f64ToF32( (const double*)src, dst, numSamps );
+    return true;
+  default:
+    return false;
+  }
+}
+
+/** Doubles to one of the integer kinds */
+static void
+doublesToInts( const ConvertKernels* k, const SampleKind &kind, const double* src, const size_t &numSamps, char* dst )
+{
+  double lo, hi;
+  intLimits( kind, lo, hi );
+
+  if( kind == KIND_I32 ) {
+    k->f64ToI32( src, (int32_t*)dst, numSamps, lo, hi );
+    return;
+  }
+
+  int32_t stage[CONVERT_CHUNK];
+  for( size_t i = 0; i < numSamps; i += CONVERT_CHUNK ) {
+    size_t n = numSamps - i < CONVERT_CHUNK ? numSamps - i : CONVERT_CHUNK;
+    k->f64ToI32( src + i, stage, n, lo, hi );
+    if( kind == KIND_I16 )
+      k->narrow16( stage, (int16_t*)dst + i, n );
+    else
+      k->narrow24( stage, (uint8_t*)dst + 3 * i, n );
+  }
+}
+
+bool
+samplesFromDouble( const double* src, const size_t &numSamps, char* dst, const NumberFormats &fmt, const unsigned int &size )
+{
+  SampleKind kind = sampleKind( fmt, size );
+  const ConvertKernels* k = kernels();
+
+  switch( kind ) {
+  case KIND_I16:
+  case KIND_I24:
+  case KIND_I32:
+    doublesToInts( k, kind, src, numSamps, dst );
+    return true;
+  case KIND_F32:
+    k->f64ToF32( src, (float*)dst, numSamps );
+    return true;
+  case KIND_F64:
+    memcpy( dst, src, numSamps * sizeof(double) );
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool
+samplesFromFloat( const float* src, const size_t &numSamps, char* dst, const NumberFormats &fmt, const unsigned int &size )
+{
+  SampleKind kind = sampleKind( fmt, size );
+  const ConvertKernels* k = kernels();
+  double stage[CONVERT_CHUNK];
+
+  switch( kind ) {
+  case KIND_I16:
+  case KIND_I24:
+  case KIND_I32:
+    // Through double, where every int32 limit is exact
+    for( size_t i = 0; i < numSamps; i += CONVERT_CHUNK ) {
+      size_t n = numSamps - i < CONVERT_CHUNK ? numSamps - i : CONVERT_CHUNK;
+      k->f32ToF64( src + i, stage, n );
+      doublesToInts( k, kind, stage, n, dst + i * size );
+    }
+    return true;
+  case KIND_F32:
+    memcpy( dst, src, numSamps * sizeof(float) );
+    return true;
+  case KIND_F64:
+    k->f32ToF64( src, (double*)dst, numSamps );
+    return true;
+  default:
+    return false;
+  }
+}
+
+
+bool
+testSampleConvert()
+{
+  const size_t n = 1037; // Leaves a tail for every vector width
+  bool failed = false;
+  ConvertISA keep = getConvertISA();
+
+  // Edge cases, through the scalar kernels
+  setConvertISA( CONVERT_SCALAR );
+  double edges[] = { 2.5, 3.5, -2.5, 1e10, -1e10, NAN, 40000.0, -9e6, -0.4 };
+  int32_t i32[9];
+  int16_t i16[9];
+  samplesFromDouble( edges, 9, (char*)i32, NUM_INT, 4 );
+  samplesFromDouble( edges, 9, (char*)i16, NUM_INT, 2 );
+  if( i32[0] != 2 || i32[1] != 4 || i32[2] != -2 || i32[3] != 2147483647 || i32[4] != (-2147483647 - 1) ||
+      i32[5] != 0 || i32[8] != 0 )
+    failed = true;
+  if( i16[3] != 32767 || i16[4] != -32768 || i16[6] != 32767 )
+    failed = true;
+  uint8_t i24[27];
+  double back[9];
+  samplesFromDouble( edges, 9, (char*)i24, NUM_INT, 3 );
+  samplesToDouble( (const char*)i24, NUM_INT, 3, back, 9 );
+  if( back[3] != 8388607.0 || back[7] != -8388608.0 || back[6] != 40000.0 || back[2] != -2.0 )
+    failed = true;
+
+  // Every instruction set must match scalar bit for bit
+  std::vector<double> vals( n ), ref( n ), got( n );
+  std::vector<float> fref( n ), fgot( n );
+  std::vector<char> sref( n * 8 ), sgot( n * 8 );
+  for( size_t i = 0; i < n; i++ )
+    vals[i] = ((double)rand() / RAND_MAX - 0.5) * (i % 3 ? 70000.0 : 5e9) + 0.5 * (i % 7);
+
+  struct { NumberFormats fmt; unsigned int size; } kinds[] = {
+    { NUM_INT, 2 }, { NUM_INT, 3 }, { NUM_INT, 4 }, { NUM_FLT, 4 }, { NUM_DBL, 8 }
+  };
+  for( int isa = CONVERT_SSE2; isa < numConvertISAs; isa++ ) {
+    if( !kernelsFor( (ConvertISA)isa ) )
+      continue;
+    for( size_t kk = 0; kk < sizeof(kinds) / sizeof(kinds[0]); kk++ ) {
+      NumberFormats fmt = kinds[kk].fmt;
+      unsigned int size = kinds[kk].size;
+
+      setConvertISA( CONVERT_SCALAR );
+      samplesFromDouble( &vals[0], n, &sref[0], fmt, size );
+      samplesToDouble( &sref[0], fmt, size, &ref[0], n );
+      samplesToFloat( &sref[0], fmt, size, &fref[0], n );
+      setConvertISA( (ConvertISA)isa );
+      samplesFromDouble( &vals[0], n, &sgot[0], fmt, size );
+      samplesToDouble( &sgot[0], fmt, size, &got[0], n );
+      samplesToFloat( &sgot[0], fmt, size, &fgot[0], n );
+      if( memcmp( &sref[0], &sgot[0], n * size ) || memcmp( &ref[0], &got[0], n * sizeof(double) ) ||
+          memcmp( &fref[0], &fgot[0], n * sizeof(float) ) ) {
+        std::cerr << "testSampleConvert() ISA " << isa << " differs from scalar for size " << size
+                  << " format " << fmt << "!" << &std::endl;
+        failed = true;
+      }
+
+      setConvertISA( CONVERT_SCALAR );
+      samplesFromFloat( &fref[0], n, &sref[0], fmt, size );
+      setConvertISA( (ConvertISA)isa );
+      samplesFromFloat( &fgot[0], n, &sgot[0], fmt, size );
+      if( memcmp( &sref[0], &sgot[0], n * size ) ) {
+        std::cerr << "testSampleConvert() ISA " << isa << " float stores differ for size " << size << "!" << &std::endl;
+        failed = true;
+      }
+    }
+  }
+
+  setConvertISA( keep );
+  return failed ? DRATS : VOILA;
+}
@@ -0,0 +1,91 @@
+#ifndef __SAMPLECONVERT_H__
+#define __SAMPLECONVERT_H__
+
+/**
+  * SampleConvert
+  * Copyright 2016, ShotSpotter
+  */
+
+#include "libCore/libCore.h"
+
+/**
+  * Sample format conversion.  Stored samples are int16, packed 24 bit,
+  * int32 (NUM_INT with size 2, 3 or 4), float or double, and processing
+  * wants double or float.  The kernels are vectorized for SSE2 and AVX2
+  * and the best the CPU runs is picked on first use.  Conversions back to
+  * integers round half to even and saturate at the limits of the stored
+  * type, NaN becomes zero.
+  */
+
+enum ConvertISA
+{
+  CONVERT_SCALAR,
+  CONVERT_SSE2,
+  CONVERT_AVX2,
+  numConvertISAs
+};
+
+/**
+ * Stored samples to double.
+ * @param src numSamps stored samples
+ * @param fmt number format of src
+ * @param size element size of src in bytes
+ * @param dst numSamps doubles
+ * @param numSamps number of samples
+ * @return false if fmt and size are not a stored format
+ */
+bool samplesToDouble( const char* src, const NumberFormats &fmt, const unsigned int &size, double* dst, const size_t &numSamps );
+
+/**
+ * Stored samples to float.
+ * @param src numSamps stored samples
+ * @param fmt number format of src
+ * @param size element size of src in bytes
+ * @param dst numSamps floats
+ * @param numSamps number of samples
+ * @return false if fmt and size are not a stored format
+ */
+bool samplesToFloat( const char* src, const NumberFormats &fmt, const unsigned int &size, float* dst, const size_t &numSamps );
+
+/**
+ * Doubles to stored samples, rounding and saturating integers.
+ * @param src numSamps doubles
+ * @param numSamps number of samples
+ * @param dst numSamps stored samples
+ * @param fmt number format of dst
+ * @param size element size of dst in bytes
+ * @return false if fmt and size are not a stored format
+ */
+bool samplesFromDouble( const double* src, const size_t &numSamps, char* dst, const NumberFormats &fmt, const unsigned int &size );
+
+/**
+ * Floats to stored samples, rounding and saturating integers.
+ * @param src numSamps floats
+ * @param numSamps number of samples
+ * @param dst numSamps stored samples
+ * @param fmt number format of dst
+ * @param size element size of dst in bytes
+ * @return false if fmt and size are not a stored format
+ */
+bool samplesFromFloat( const float* src, const size_t &numSamps, char* dst, const NumberFormats &fmt, const unsigned int &size );
+
+/**
+ * @return the instruction set the conversions are using
+ */
+ConvertISA getConvertISA();
+
+/**
+ * Force the instruction set, for testing and benchmarks.
+ * @param isa instruction set wanted
+ * @return false if this CPU can't run it, nothing changes
+ */
+bool setConvertISA( const ConvertISA &isa );
+
+/**
+ * Run the regression test for the conversions, every instruction set
+ * this CPU runs against the scalar one.  Return 0 if good.
+ * @return bool
+ */
+bool testSampleConvert();
+
+#endif // __SAMPLECONVERT_H__
@@ -0,0 +1,345 @@
+#include "SegmentedTimeData.h"
+
+#include <algorithm>
+#include <math.h>
+
+/**
+  * class SegmentedTimeData
+  * Copyright 2016, ShotSpotter
+  */
+
+/** Sample rates may differ by this fraction, as for TimeData::append() */
+static const double srGrace = 0.01;
+
+const size_t SegmentedTimeData::npos;
+
+
+// const_iterator
+//
+
+SegmentedTimeData::const_iterator::const_iterator( const SegmentedTimeData* st, const size_t &r, const bool &fillGaps )
+  : owner( st ), run( r ), done( 0 ), fill( fillGaps )
+{
+  skipGaps();
+}
+
+void
+SegmentedTimeData::const_iterator::skipGaps()
+{
+  if( fill )
+    return;
+  while( run < owner->runs.size() && owner->runs[run].seg == npos )
+    run++;
+}
+
+DataView
+SegmentedTimeData::const_iterator::operator*() const
+{
+  const SegmentRun &sr = owner->runs[run];
+  if( sr.seg != npos )
+    return owner->segs[sr.seg].getView().subView( sr.firstRow, sr.numRows );
+
+  const TimeData &like = owner->segs[0];
+  unsigned long long num = std::min( sr.numRows - done, (unsigned long long)SEGMENTED_ZERO_ROWS );
+  TimeObj start = nativeKeyTime( sr.key + llround( done * 1e6 / owner->sampleRate ) );
+  return DataView( &owner->zeros[0], num, like.getCols(), like.getEltSize(), like.getNumFmt(), start, owner->sampleRate );
+}
+
+SegmentedTimeData::const_iterator&
+SegmentedTimeData::const_iterator::operator++()
+{
+  if( owner->runs[run].seg == npos ) {
+    done += SEGMENTED_ZERO_ROWS;
+    if( done < owner->runs[run].numRows )
+      return *this;
+  }
+  run++;
+  done = 0;
+  skipGaps();
+  return *this;
+}
+
+bool
+SegmentedTimeData::const_iterator::isGap() const
+{
+  return owner->runs[run].seg == npos;
+}
+
+size_t
+SegmentedTimeData::const_iterator::segment() const
+{
+  return owner->runs[run].seg;
+}
+
+
+// Constructors/Destructors
+//
+
+SegmentedTimeData::SegmentedTimeData()
+{
+  sampleRate = 0.0;
+}
+
+SegmentedTimeData::~SegmentedTimeData()
+{
+}
+
+
+// Methods
+//
+
+bool
+SegmentedTimeData::add( const TimeData &seg )
+{
+  if( !suits( seg ) )
+    return false;
+
+  // Shares the buffer, copied only if either side writes to it
+  insert( TimeData( seg ) );
+  return true;
+}
+
+bool
+SegmentedTimeData::add( TimeData &&seg )
+{
+  if( !suits( seg ) )
+    return false;
+
+  insert( std::move( seg ) );
+  return true;
+}
+
+void
+SegmentedTimeData::clear()
+{
+  segs.clear();
+  runs.clear();
+  gaps.clear();
+  overlaps.clear();
+  zeros.clear();
+  sampleRate = 0.0;
+}
+
+bool
+SegmentedTimeData::suits( const TimeData &seg ) const
+{
+  if( seg.isEmpty() || seg.getSampleRate() <= 0.0 ) {
+    std::cerr << "SegmentedTimeData::add() segments must hold regularly sampled rows!" << &std::endl;
+    return false;
+  }
+  if( segs.empty() )
+    return true;
+
+  const TimeData &like = segs[0];
+  if( seg.getEltSize() != like.getEltSize() || seg.getNumFmt() != like.getNumFmt() || seg.getCols() != like.getCols() ) {
+    std::cerr << "SegmentedTimeData::add() mismatch on data pedigree!" << &std::endl;
+    return false;
+  }
+  if( fabs( seg.getSampleRate() - sampleRate ) > sampleRate * srGrace ) {
+    std::cerr << "SegmentedTimeData::add() sample rates differ too much!" << &std::endl;
+    return false;
+  }
+  return true;
+}
+
+void
+SegmentedTimeData::insert( TimeData &&seg )
+{
+  if( segs.empty() )
+    sampleRate = seg.getSampleRate();
+
+  // After any that start at the same time, so the first added wins overlaps
+  std::vector<TimeData>::iterator at = std::upper_bound( segs.begin(), segs.end(), seg.getUTC(),
+    []( const TimeObj &tt, const TimeData &td ) { return tt < td.getUTC(); } );
+  segs.insert( at, std::move( seg ) );
+  index();
+}
+
+void
+SegmentedTimeData::index()
+{
+  runs.clear();
+  gaps.clear();
+  overlaps.clear();
+  if( segs.empty() )
+    return;
+
+  // Rows are placed on the first segment's grid, at its sample rate
+  int64_t baseKey = nativeTimeKey( segs[0].getUTC() );
+  unsigned long long numRows = 0, maxGap = 0;
+  size_t last = 0;
+  for( size_t s = 0; s < segs.size(); s++ ) {
+    const TimeData &seg = segs[s];
+    SegmentRun sr;
+    sr.seg = s;
+    sr.firstRow = 0;
+    sr.numRows = seg.getRows();
+    long long at = llround( ( nativeTimeKey( seg.getUTC() ) - baseKey ) * sampleRate / 1e6 );
+
+    if( at < (long long)numRows ) { // Samples had already
+      SegmentOverlap ov;
+      ov.kept = last;
+      ov.dropped = s;
+      ov.numRows = std::min( numRows - at, sr.numRows );
+      ov.begT = seg.getUTC();
+      ov.finT = nativeKeyTime( nativeTimeKey( seg.getUTC() ) + llround( ov.numRows * 1e6 / seg.getSampleRate() ) );
+      overlaps.push_back( ov );
+      if( ov.numRows == sr.numRows )
+        continue;
+      sr.firstRow = ov.numRows;
+      sr.numRows -= ov.numRows;
+      at = numRows;
+    }
+    else if( at > (long long)numRows ) {
+      TimeGap gap;
+      gap.row = numRows;
+      gap.numRows = at - numRows;
+      gap.begT = nativeKeyTime( baseKey + llround( gap.row * 1e6 / sampleRate ) );
+      gap.finT = nativeKeyTime( baseKey + llround( at * 1e6 / sampleRate ) );
+      gaps.push_back( gap );
+
+      SegmentRun hole;
+      hole.seg = npos;
+      hole.firstRow = 0;
+      hole.numRows = gap.numRows;
+      hole.row = gap.row;
+      hole.key = nativeTimeKey( gap.begT );
+      runs.push_back( hole );
+      maxGap = std::max( maxGap, gap.numRows );
+    }
+
+    sr.row = at;
+    sr.key = baseKey + llround( at * 1e6 / sampleRate );
+    runs.push_back( sr );
+    numRows = at + sr.numRows;
+    last = s;
+  }
+
+  zeros.assign( std::min( maxGap, (unsigned long long)SEGMENTED_ZERO_ROWS ) * segs[0].getRowSize(), 0 );
+}
+
+size_t
+SegmentedTimeData::findRun( const TimeObj &tt ) const
+{
+  int64_t key = nativeTimeKey( tt );
+  if( runs.empty() || key < runs[0].key || tt >= getTimeEnd() )
+    return npos;
+
+  std::vector<SegmentRun>::const_iterator it = std::upper_bound( runs.begin(), runs.end(), key,
+    []( const int64_t &k, const SegmentRun &sr ) { return k < sr.key; } );
+  return ( it - runs.begin() ) - 1;
+}
+
+size_t
+SegmentedTimeData::findSegment( const TimeObj &tt ) const
+{
+  size_t r = findRun( tt );
+  return r == npos ? npos : runs[r].seg;
+}
+
+unsigned long long
+SegmentedTimeData::getSampleCount() const
+{
+  unsigned long long num = 0;
+  for( size_t r = 0; r < runs.size(); r++ )
+    if( runs[r].seg != npos )
+      num += runs[r].numRows;
+  return num;
+}
+
+TimeObj
+SegmentedTimeData::getTimeEnd() const
+{
+  if( runs.empty() )
+    return TimeObj();
+  return nativeKeyTime( runs[0].key + llround( getRows() * 1e6 / sampleRate ) );
+}
+
+bool
+SegmentedTimeData::coalesce( TimeData &out ) const
+{
+  out.clear();
+  if( segs.empty() )
+    return true;
+
+  const TimeData &like = segs[0];
+  out.setCols( like.getCols() );
+  out.setEltSize( like.getEltSize() );
+  out.setNumFmt( like.getNumFmt() );
+  out.setUTC( getUTC() );
+  out.setSampleRate( sampleRate );
+  if( !out.reserve( getRows() ) ) {
+    std::cerr << "SegmentedTimeData::coalesce() could not allocate " << getRows() << " rows!" << &std::endl;
+    return false;
+  }
+
+  // The gaps and overlaps are settled, so force past append()'s checks
+  for( const_iterator it = begin( true ); it != end(); ++it ) {
+    if( !out.append( *it, true ) ) {
+      out.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+SegmentedTimeData::coalesce()
+{
+  if( segs.size() < 2 && gaps.empty() )
+    return true;
+
+  TimeData one;
+  if( !coalesce( one ) )
+    return false;
+  clear();
+  return add( std::move( one ) );
+}
+
+bool
+SegmentedTimeData::testClass()
+{
+  // Three stretches of 100 Hz, a gap of 150 samples, then 50 repeated
+  std::vector<int16_t> samps( 1000 );
+  for( size_t i = 0; i < samps.size(); i++ )
+    samps[i] = (int16_t)( i + 1 );
+  TimeObj t0( (time_t)1300000000, 0 );
+
+  TimeData a, b, c;
+  a.materialize( DataView( (const char*)&samps[0], 300, 1, 2, NUM_INT, t0, 100.0 ) );
+  b.materialize( DataView( (const char*)&samps[450], 200, 1, 2, NUM_INT, t0 + TimeObj( 4.5 ), 100.0 ) );
+  c.materialize( DataView( (const char*)&samps[600], 400, 1, 2, NUM_INT, t0 + TimeObj( 6.0 ), 100.0 ) );
+
+  SegmentedTimeData st;
+  if( !st.add( c ) || !st.add( a ) || !st.add( std::move( b ) ) || !b.isEmpty() ) return DRATS;
+  if( st.getNumSegments() != 3 || st.getRows() != 1000 || st.getSampleCount() != 850 ) return DRATS;
+  if( st.getGaps().size() != 1 || st.getGaps()[0].row != 300 || st.getGaps()[0].numRows != 150 ) return DRATS;
+  if( st.getOverlaps().size() != 1 || st.getOverlaps()[0].numRows != 50 ) return DRATS;
+  if( st.findSegment( t0 + TimeObj( 2.0 ) ) != 0 || st.findSegment( t0 + TimeObj( 3.5 ) ) != npos ) return DRATS;
+  if( st.findSegment( t0 + TimeObj( 6.2 ) ) != 1 || st.findSegment( t0 + TimeObj( 6.7 ) ) != 2 || st.findSegment( t0 + TimeObj( 10.0 ) ) != npos ) return DRATS;
+
+  // Filled, every sample is where it was, zeros in the gap
+  TimeData one;
+  if( !st.coalesce( one ) || one.getRows() != 1000 || one.getUTC() != t0 ) return DRATS;
+  const int16_t* got = (const int16_t*)one.getData();
+  for( size_t i = 0; i < 1000; i++ )
+    if( got[i] != ( i >= 300 && i < 450 ? 0 : samps[i] ) ) return DRATS;
+
+  // Skipped, just the samples
+  unsigned long long seen = 0;
+  for( const_iterator it = st.begin(); it != st.end(); ++it ) {
+    if( it.isGap() ) return DRATS;
+    seen += (*it).getRows();
+  }
+  if( seen != 850 ) return DRATS;
+
+  // An empty segment, or one of another shape, is refused
+  TimeData d;
+  if( st.add( d ) ) return DRATS;
+  d.materialize( DataView( (const char*)&samps[0], 10, 2, 2, NUM_INT, t0, 100.0 ) );
+  if( st.add( d ) ) return DRATS;
+
+  if( !st.coalesce() || st.getNumSegments() != 1 || !st.getGaps().empty() || st.getRows() != 1000 ) return DRATS;
+
+  return VOILA;
+}
@@ -0,0 +1,273 @@
+#ifndef __SEGMENTEDTIMEDATA_H__
+#define __SEGMENTEDTIMEDATA_H__
+
+/**
+  * class SegmentedTimeData
+  * Copyright 2016, ShotSpotter
+  */
+
+#include "TimeData.h"
+
+#include <stdint.h>
+
+/** Most rows of zeros handed out at a time for a gap */
+#define SEGMENTED_ZERO_ROWS 65536
+
+/**
+  * struct SegmentRun
+  * A stretch of the timeline, rows of one segment or a gap between them.
+  */
+struct SegmentRun
+{
+  size_t seg;                   /** Segment index, SegmentedTimeData::npos for a gap */
+  unsigned long long firstRow;  /** First row of the segment used, zero for a gap */
+  unsigned long long numRows;
+  unsigned long long row;       /** Index of the first row on the timeline */
+  int64_t key;                  /** Time of the first row, see nativeTimeKey() */
+};
+
+/**
+  * struct SegmentOverlap
+  * Samples of a segment that an earlier one already covers, dropped from
+  * the timeline.
+  */
+struct SegmentOverlap
+{
+  TimeObj begT;                 /** Time of the first sample dropped */
+  TimeObj finT;                 /** Time of the sample after the last dropped */
+  size_t kept;                  /** Segment whose samples are used */
+  size_t dropped;               /** Segment whose samples are not */
+  unsigned long long numRows;   /** Samples dropped */
+};
+
+/**
+  * class SegmentedTimeData
+  * A time series with dropouts, held as contiguous TimeData segments of one
+  * shape and sample rate.  Segments are shared, or moved, in as they are,
+  * nothing is copied until coalesce() is asked for.  The segments are kept
+  * in time order along with a timeline of runs, so finding the segment
+  * holding a time is a binary search, and the gaps and overlaps between
+  * segments are at hand:
+  *
+  *   SegmentedTimeData st;
+  *   st.add( morning );
+  *   st.add( afternoon );
+  *   for( SegmentedTimeData::const_iterator it = st.begin( true ); it != st.end(); ++it )
+  *     process( *it );           // a DataView, zeros where it.isGap()
+  */
+class SegmentedTimeData
+{
+public:
+
+  /** Index of no segment */
+  static const size_t npos = (size_t)-1;
+
+  /**
+    * class const_iterator
+    * Steps along the timeline a DataView at a time, a run of a segment, or
+    * when filling gaps, up to SEGMENTED_ZERO_ROWS rows of zeros.
+    */
+  class const_iterator
+  {
+  public:
+
+    const_iterator() : owner( NULL ), run( 0 ), done( 0 ), fill( false ) {}
+
+    /**
+     * @return the rows here, valid while the segment is neither destroyed nor written to
+     */
+    DataView operator*() const;
+
+    const_iterator& operator++();
+
+    bool operator==( const const_iterator &other ) const { return run == other.run && done == other.done; }
+    bool operator!=( const const_iterator &other ) const { return !( *this == other ); }
+
+    /**
+     * @return true if the rows here are zeros standing in for a gap
+     */
+    bool isGap() const;
+
+    /**
+     * @return index of the segment the rows are from, npos for a gap
+     */
+    size_t segment() const;
+
+  private:
+
+    friend class SegmentedTimeData;
+
+    const_iterator( const SegmentedTimeData* st, const size_t &r, const bool &fillGaps );
+    void skipGaps();
+
+    const SegmentedTimeData* owner;
+    size_t run;
+    unsigned long long done;    /** Rows of a gap run already handed out */
+    bool fill;
+
+  };
+
+  // Constructors/Destructors
+
+  /**
+   * Empty Constructor
+   */
+  SegmentedTimeData();
+
+  /**
+   * Empty Destructor
+   */
+  virtual ~SegmentedTimeData();
+
+  // Methods
+
+  /**
+   * Add a segment, sharing its samples.  The first sets the shape and
+   * sample rate the others must have.
+   * @param seg regularly sampled rows, either layout
+   * @return true if added
+   */
+  bool add( const TimeData &seg );
+
+  /**
+   * Add a segment, taking its samples and leaving it empty.
+   * @param seg regularly sampled rows, either layout
+   * @return true if added
+   */
+  bool add( TimeData &&seg );
+
+  /**
+   * Drop all segments.
+   */
+  void clear();
+
+  /**
+   * Index of the segment whose samples cover a time, O(log n).
+   * @param tt time sought
+   * @return segment index, npos if tt falls in a gap or outside the timeline
+   */
+  size_t findSegment( const TimeObj &tt ) const;
+
+  /**
+   * Index of the run covering a time, O(log n).
+   * @param tt time sought
+   * @return run index, npos if tt is outside the timeline
+   */
+  size_t findRun( const TimeObj &tt ) const;
+
+  /**
+   * Walk the timeline.
+   * @param fillGaps hand out zeros for the gaps rather than skipping them
+   * @return iterator at the first rows
+   */
+  const_iterator begin( const bool &fillGaps = false ) const { return const_iterator( this, 0, fillGaps ); }
+
+  /**
+   * @return iterator past the last rows
+   */
+  const_iterator end() const { return const_iterator( this, runs.size(), false ); }
+
+  /**
+   * Copy the timeline into one interleaved buffer, gaps zero filled.
+   * @param out object to fill, cleared first
+   * @return true if successful
+   */
+  bool coalesce( TimeData &out ) const;
+
+  /**
+   * Replace the segments with the one coalesce() makes.  The gaps and
+   * overlaps are forgotten, the zeros that fill them are not.
+   * @return true if successful
+   */
+  bool coalesce();
+
+  /**
+   * Run the regression test for this class.  Return 0 if good.
+   * @return bool
+   */
+  static bool testClass();
+
+  // Accessor methods
+
+  /**
+   * @return number of segments
+   */
+  size_t getNumSegments() const { return segs.size(); }
+
+  /**
+   * Get a segment, in time order.
+   * @param idx index of the segment
+   * @return the segment
+   */
+  const TimeData& getSegment( const size_t &idx ) const { return segs[idx]; }
+
+  /**
+   * @return the runs of the timeline, in time order
+   */
+  const std::vector<SegmentRun>& getRuns() const { return runs; }
+
+  /**
+   * @return the gaps between segments, rows of the timeline no segment has
+   */
+  const std::vector<TimeGap>& getGaps() const { return gaps; }
+
+  /**
+   * @return samples of segments dropped as repeats of earlier ones
+   */
+  const std::vector<SegmentOverlap>& getOverlaps() const { return overlaps; }
+
+  /**
+   * @return rows of the timeline, gaps included
+   */
+  unsigned long long getRows() const { return runs.empty() ? 0 : runs.back().row + runs.back().numRows; }
+
+  /**
+   * @return samples on the timeline, gaps not included
+   */
+  unsigned long long getSampleCount() const;
+
+  /**
+   * @return time of the first sample
+   */
+  TimeObj getUTC() const { return runs.empty() ? TimeObj() : nativeKeyTime( runs[0].key ); }
+
+  /**
+   * @return time of the sample after the last
+   */
+  TimeObj getTimeEnd() const;
+
+  /**
+   * @return sample rate of the segments
+   */
+  double getSampleRate() const { return sampleRate; }
+
+private:
+
+  /**
+   * Put a segment in time order and rebuild the timeline.
+   * @param seg segment, already checked
+   */
+  void insert( TimeData &&seg );
+
+  /**
+   * Check that a segment can join the others.
+   * @param seg segment
+   * @return true if it can
+   */
+  bool suits( const TimeData &seg ) const;
+
+  /**
+   * Rebuild runs, gaps and overlaps from the segments.
+   */
+  void index();
+
+  std::vector<TimeData> segs;
+  std::vector<SegmentRun> runs;
+  std::vector<TimeGap> gaps;
+  std::vector<SegmentOverlap> overlaps;
+  std::vector<char> zeros;              /** Rows of zeros handed out for gaps */
+  double sampleRate;
+
+};
+
+#endif // __SEGMENTEDTIMEDATA_H__
@@ -0,0 +1,57 @@
+#ifndef __THREADSPLIT_H__
+#define __THREADSPLIT_H__
+
+/**
+  * ThreadSplit
+  * Copyright 2016, ShotSpotter
+  *
+  * Splitting work across threads, as the parsers, sorts, diffs and loaders
+  * of libDSP all do.  Internal to the library, it isn't published.
+  */
+
+#include <stddef.h>
+#include <thread>
+#include <vector>
+#include <system_error>
+
+/**
+ * Threads for work of num units, none with less than minUnits.
+ * @param num units of work
+ * @param minUnits fewest units worth a thread
+ * @param configured threads wanted, zero for one per core
+ * @return threads to use, at least one
+ */
+inline unsigned int
+threadsFor( const size_t &num, const size_t &minUnits, const unsigned int &configured )
+{
+  unsigned int numThreads = configured ? configured : std::thread::hardware_concurrency();
+  size_t most = (num + minUnits - 1) / minUnits;
+  if( numThreads > most )
+    numThreads = most;
+  return numThreads ? numThreads : 1;
+}
+
+/**
+ * Run fn( t ) for t up to numThreads, each on its own thread where one can
+ * be had, on this one where not, and wait for them all.
+ * @param numThreads calls to make
+ * @param fn called with the thread number
+ */
+template<typename F>
+inline void
+runThreads( const unsigned int &numThreads, const F &fn )
+{
+  std::vector<std::thread> workers;
+  for( unsigned int t = 1; t < numThreads; t++ ) {
+    try {
+      workers.emplace_back( fn, t );
+    } catch( const std::system_error &err ) {
+      fn( t );
+    }
+  }
+  fn( 0 );
+  for( size_t w = 0; w < workers.size(); w++ )
+    workers[w].join();
+}
+
+#endif // __THREADSPLIT_H__
@@ -1,4 +1,13 @@
 #include "TimeData.h"
+#include "ThreadSplit.h"
+
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /**
   * class FrequencyTimeData
@@ -22,21 +31,48 @@ TimeData::TimeData( const TimeObj &startUTC ) : DataCommon( startUTC )
 
 TimeData::TimeData( const TimeData &src, const bool &skipData ) : DataCommon( src, skipData )
 {
-  initAttributes();
-
+  // The base has copied the shape, initAttributes() would undo it
   sampleRate  = src.sampleRate;
 
   if( skipData ) return;
 
-  rows = src.rows;
-  if( src.data ) {
-    size_t malBytes = rows * cols * size;
-    data = (char*)malloc( malBytes );
-    if( !data )
-      std::cerr << "Could malloc() " << malBytes << " bytes!" << &std::endl;
-    else
-      memcpy( data, src.data, malBytes );
+  // O(1), the samples are copied on the first write to either object
+  shareData( src );
+}
+
+
+TimeData::TimeData( TimeData &&src ) noexcept : DataCommon( std::move( src ) )
+{
+  sampleRate = src.sampleRate;
+  src.type = TIME_DATA;
+  src.sampleRate = 0.0;
+}
+
+TimeData&
+TimeData::operator=( const TimeData &src )
+{
+  if( this != &src ) {
+    TimeData tmp( src );
+    swap( tmp );
+  }
+  return *this;
+}
+
+TimeData&
+TimeData::operator=( TimeData &&src ) noexcept
+{
+  if( this != &src ) {
+    TimeData tmp( std::move( src ) );
+    swap( tmp );
   }
+  return *this;
+}
+
+void
+TimeData::swap( TimeData &other ) noexcept
+{
+  swapCommon( other );
+  std::swap( sampleRate, other.sampleRate );
 }
 
 
@@ -62,6 +98,7 @@ TimeData::~TimeData()
 void TimeData::initAttributes() 
 {
   DataCommon::initAttributes();
+  type = TIME_DATA;
   sampleRate = 0.0;
 }
 
@@ -89,23 +126,439 @@ TimeData::load()
   return false;
 }
 
+const double epsGrace = 1.1;
+const double srGrace = 0.01;
+
+/** Threads loadDays() reads on, zero for one per core */
+static std::atomic<unsigned int> loadThreads( 0 );
+
+/** A day file found by loadDays(), and the rows taken from it */
+struct DayFile
+{
+  std::string name;
+  NativeHeader hdr;
+  std::vector<NativeBlockEntry> index;
+  int64_t key;                  /** Time of firstRow, see nativeTimeKey() */
+  unsigned long long firstRow;  /** First row taken */
+  unsigned long long lastRow;   /** Past the last row taken */
+  unsigned long long dstRow;    /** Where firstRow is loaded to */
+};
+
+void
+TimeData::setLoadThreads( const unsigned int &numThreads )
+{
+  loadThreads.store( numThreads, std::memory_order_relaxed );
+}
+
+bool
+TimeData::makeDayFileName( const std::string &pathFormat, const std::string &station, const std::string &channel,
+                           const int &day, std::string &fileName )
+{
+  char dayStr[16];
+  snprintf( dayStr, sizeof(dayStr), "%08d", day );
+  fileName.clear();
+  for( size_t i = 0; i < pathFormat.size(); i++ ) {
+    if( pathFormat[i] != '%' ) {
+      fileName += pathFormat[i];
+      continue;
+    }
+    char spec = i + 1 < pathFormat.size() ? pathFormat[++i] : 0;
+    switch( spec ) {
+      case 'S': fileName += station; break;
+      case 'C': fileName += channel; break;
+      case 'D': fileName += dayStr; break;
+      case '%': fileName += '%'; break;
+      default:
+        std::cerr << "TimeData::makeDayFileName() bad path format: " << pathFormat << &std::endl;
+        fileName.clear();
+        return false;
+    }
+  }
+  return true;
+}
+
+size_t
+TimeData::loadDays( const std::string &station, const std::string &channel, const TimeObj &begT, const TimeObj &finT,
+                    std::vector<TimeGap>* gaps, const std::string &pathFormat )
+{
+  if( gaps )
+    gaps->clear();
+  if( data ) {
+    std::cerr << "Attempt to load data without clear()ing first was shot down!" << &std::endl;
+    return 0;
+  }
+  if( finT <= begT ) {
+    std::cerr << "TimeData::loadDays() finT not after begT!" << &std::endl;
+    return 0;
+  }
+
+  // Every day touched, stepping a day at a time in case days aren't all 86400 s
+  std::vector<int> days;
+  int lastDay = ( finT - TimeObj( (time_t)0, 1 ) ).getDayMoniker();
+  for( TimeObj tt = begT; ; tt += TimeObj( (time_t)86400, 0 ) ) {
+    int day = std::min( tt.getDayMoniker(), lastDay );
+    if( days.empty() || day != days.back() )
+      days.push_back( day );
+    if( day == lastDay )
+      break;
+  }
+
+  // Headers and indexes, serially, the shape is taken from the first file
+  std::vector<DayFile> files;
+  for( size_t d = 0; d < days.size(); d++ ) {
+    DayFile df;
+    if( !makeDayFileName( pathFormat, station, channel, days[d], df.name ) )
+      return 0;
+    FILE* fid = fopen( df.name.c_str(), "r" );
+    if( !fid ) // Missing days are gaps
+      continue;
+    TimeData probe;
+    NativeBlockEntry* index = probe.readNativeIndex( fid, df.hdr );
+    fclose( fid );
+    if( !index ) {
+      std::cerr << "TimeData::loadDays() passing over unreadable " << df.name << &std::endl;
+      continue;
+    }
+    df.index.assign( index, index + df.hdr.numBlocks );
+    free( index );
+
+    if( probe.sampleRate <= 0.0 ) {
+      std::cerr << "TimeData::loadDays() passing over irregular " << df.name << &std::endl;
+      continue;
+    }
+    if( files.empty() ) {
+      size = probe.size;
+      numFmt = probe.numFmt;
+      cols = probe.cols;
+      sampleRate = probe.sampleRate;
+      timeOffset = probe.timeOffset;
+    }
+    else if( probe.size != size || probe.numFmt != numFmt || probe.cols != cols ) {
+      std::cerr << "TimeData::loadDays() passing over " << df.name << ", mismatch on data pedigree!" << &std::endl;
+      continue;
+    }
+    else if( fabs( probe.sampleRate - sampleRate ) > sampleRate * srGrace ) {
+      std::cerr << "TimeData::loadDays() passing over " << df.name << ", sample rates differ too much!" << &std::endl;
+      continue;
+    }
+
+    df.firstRow = probe.firstRowAt( begT );
+    df.lastRow = probe.firstRowAt( finT );
+    if( df.lastRow <= df.firstRow )
+      continue;
+    df.key = nativeTimeKey( probe.utc ) + llround( df.firstRow * 1e6 / probe.sampleRate );
+    files.push_back( df );
+  }
+  if( files.empty() ) {
+    std::cerr << "TimeData::loadDays() found no samples of " << station << " " << channel << "!" << &std::endl;
+    rows = 0;
+    return 0;
+  }
+  std::stable_sort( files.begin(), files.end(), []( const DayFile &a, const DayFile &b ) { return a.key < b.key; } );
+
+  // Where each file goes, the first file's first row at zero
+  int64_t baseKey = files[0].key;
+  unsigned long long numRows = 0;
+  std::vector<TimeGap> found;
+  for( size_t f = 0; f < files.size(); f++ ) {
+    DayFile &df = files[f];
+    long long at = llround( ( df.key - baseKey ) * sampleRate / 1e6 );
+    if( at < (long long)numRows ) { // Rows had already
+      unsigned long long repeats = numRows - at;
+      if( repeats >= df.lastRow - df.firstRow ) {
+        df.lastRow = df.firstRow;
+        continue;
+      }
+      df.firstRow += repeats;
+      at = numRows;
+    }
+    else if( at > (long long)numRows ) {
+      TimeGap gap;
+      gap.row = numRows;
+      gap.numRows = at - numRows;
+      gap.begT = nativeKeyTime( baseKey + llround( gap.row * 1e6 / sampleRate ) );
+      gap.finT = nativeKeyTime( baseKey + llround( at * 1e6 / sampleRate ) );
+      found.push_back( gap );
+    }
+    df.dstRow = at;
+    numRows = at + ( df.lastRow - df.firstRow );
+  }
+
+  size_t rowBytes = getRowSize();
+  if( !allocData( numRows * rowBytes ) ) {
+    std::cerr << "Could not allocate memory to load " << numRows * rowBytes << " of data!" << &std::endl;
+    rows = 0;
+    return 0;
+  }
+  interleaved = true;
+  for( size_t g = 0; g < found.size(); g++ )
+    memset( data + found[g].row * rowBytes, 0, found[g].numRows * rowBytes );
+
+  // A piece of work per block, so threads share out big files and small alike
+  std::vector<std::pair<size_t, uint64_t>> pieces;
+  for( size_t f = 0; f < files.size(); f++ ) {
+    const DayFile &df = files[f];
+    for( uint64_t blk = 0; blk < df.hdr.numBlocks; blk++ ) {
+      uint64_t blkEnd = blk + 1 < df.hdr.numBlocks ? df.index[blk+1].firstRow : df.hdr.rows;
+      if( df.index[blk].firstRow < df.lastRow && blkEnd > df.firstRow )
+        pieces.push_back( std::make_pair( f, blk ) );
+    }
+  }
+
+  std::atomic<size_t> next( 0 );
+  std::atomic<bool> failed( false );
+  auto reader = [&]( unsigned int ) {
+    std::vector<FILE*> fids( files.size(), (FILE*)NULL );
+    std::vector<char> scratch;
+    size_t p;
+    while( !failed.load( std::memory_order_relaxed ) && ( p = next.fetch_add( 1 ) ) < pieces.size() ) {
+      const DayFile &df = files[pieces[p].first];
+      uint64_t blk = pieces[p].second;
+      uint64_t blkBeg = df.index[blk].firstRow;
+      uint64_t blkEnd = blk + 1 < df.hdr.numBlocks ? df.index[blk+1].firstRow : df.hdr.rows;
+      uint64_t beg = std::max( blkBeg, (uint64_t)df.firstRow ), fin = std::min( blkEnd, (uint64_t)df.lastRow );
+      char* dst = data + ( df.dstRow + beg - df.firstRow ) * rowBytes;
+
+      FILE* &fid = fids[pieces[p].first];
+      if( !fid && !( fid = fopen( df.name.c_str(), "r" ) ) ) {
+        std::cerr << "File: " << df.name << " was not opened!" << &std::endl;
+        failed = true;
+        break;
+      }
+      bool ok;
+      if( df.hdr.codec == NATIVE_CODEC_RAW ) { // Straight into place
+        size_t numBytes = ( fin - beg ) * rowBytes;
+        ok = pread( fileno( fid ), dst, numBytes, df.index[blk].offset + ( beg - blkBeg ) * rowBytes ) == (ssize_t)numBytes;
+        if( !ok )
+          std::cerr << "Could not read native block " << blk << " of " << df.name << "!" << &std::endl;
+      }
+      else {
+        scratch.resize( ( blkEnd - blkBeg ) * rowBytes );
+        ok = readNativeBlocks( fid, df.hdr, &df.index[0], blk, blk, &scratch[0] );
+        if( ok )
+          memcpy( dst, &scratch[( beg - blkBeg ) * rowBytes], ( fin - beg ) * rowBytes );
+      }
+      if( !ok )
+        failed = true;
+    }
+    for( size_t f = 0; f < fids.size(); f++ )
+      if( fids[f] )
+        fclose( fids[f] );
+  };
+
+  runThreads( threadsFor( pieces.size(), 1, loadThreads.load( std::memory_order_relaxed ) ), reader );
+
+  if( failed ) {
+    clear();
+    return 0;
+  }
+
+  rows = numRows;
+  utc = nativeKeyTime( baseKey );
+  setTimeEnd();
+  if( gaps )
+    gaps->swap( found );
+  return rows;
+}
+
+// Typed kernels
+
+template<typename T>
+static double
+sumSamples( const TypedView<const T> &tv )
+{
+  double total = 0.0;
+  for( unsigned int c = 0; c < tv.getCols(); c++ ) {
+    const TypedView<const T> chan = tv.column( c );
+    for( unsigned long long r = 0; r < chan.getRows(); r++ )
+      total += *chan.getRow( r );
+  }
+  return total;
+}
+
 bool
 TimeData::write( char* fileName ) const {
-  FILE* fid = fopen( fileName, "w" );
+  // One row per line
+  return writeFile( fileName, FORMAT_ASCII );
+}
+
+bool
+TimeData::write( FILE* fid, const int &format ) const
+{
+  if( format == FORMAT_ASCII )
+    return writeAscii( fid );
+  if( format != FORMAT_WAV )
+    return DataCommon::write( fid, format );
+
+  WavInfo hdr;
+  WavWriter wr;
+  if( !wavInfoFor( numFmt, size, cols, sampleRate, hdr ) || !wr.open( fid, hdr ) )
+    return false;
+  bool ok = wr.write( getView() );
+  return wr.close() && ok;
+}
+
+size_t
+TimeData::readWav( const char* fileName, const bool &useMap )
+{
+  if( data ) {
+    std::cerr << "Attempt to load data without clear()ing first was shot down!" << &std::endl;
+    return 0;
+  }
+
+  FILE* fid = fopen( fileName, "r" );
   if( !fid ) {
-    std::cerr << "File: " << fileName << &std::endl;
+    std::cerr << "File: " << fileName << " was not opened!" << &std::endl;
+    return 0;
+  }
+
+  WavInfo info;
+  struct stat st;
+  if( !wavReadHeader( fid, info ) || !useWavInfo( info ) || fstat( fileno(fid), &st ) ) {
+    std::cerr << "Could not read WAV header of: " << fileName << "!" << &std::endl;
+    fclose( fid );
+    rows = 0;
+    return 0;
+  }
+
+  // The data chunk is cut short by a writer that never closed
+  size_t numBytes = (uint64_t)st.st_size > info.dataOffset ? st.st_size - info.dataOffset : 0;
+  if( info.dataBytes > numBytes )
+    std::cerr << "File: " << fileName << " is missing " << info.dataBytes - numBytes << " bytes of rows." << &std::endl;
+  else if( info.dataBytes )
+    numBytes = info.dataBytes;
+  size_t numRows = numBytes / getRowSize();
+  rows = 0;
+  if( !numRows ) {
+    std::cerr << "No rows in WAV file: " << fileName << "!" << &std::endl;
+    fclose( fid );
+    return 0;
+  }
+
+  // Samples in place must be aligned for their type, 24 bit ones never are
+  bool aligned = (size & (size - 1)) || !(info.dataOffset % size);
+  if( useMap && aligned ) {
+    fclose( fid );
+    numRows = mapFile( fileName, info.dataOffset, numRows * getRowSize() );
+  } else {
+    if( !allocData( numRows * getRowSize() ) || fread( data, getRowSize(), numRows, fid ) != numRows ) {
+      std::cerr << "Load of: " << fileName << " failed!" << &std::endl;
+      if( data )
+        freeData();
+      numRows = 0;
+    }
+    fclose( fid );
+    rows = numRows;
+  }
+
+  setTimeEnd();
+  return numRows;
+}
+
+bool
+TimeData::writeAscii( FILE* fid, const bool &timeCol ) const
+{
+  return asciiWrite( fid, getView(), timeCol );
+}
+
+size_t
+TimeData::readAscii( const char* fileName, const bool &timeCol )
+{
+  if( data ) {
+    std::cerr << "Attempt to load data without clear()ing first was shot down!" << &std::endl;
+    return 0;
+  }
+
+  int fd = open( fileName, O_RDONLY );
+  struct stat st;
+  if( fd < 0 || fstat( fd, &st ) || !st.st_size ) {
+    std::cerr << "File: " << fileName << " was not opened, or is empty!" << &std::endl;
+    if( fd >= 0 )
+      close( fd );
+    return 0;
+  }
+  void* text = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if( text == MAP_FAILED ) {
+    std::cerr << "Could not mmap() " << fileName << ": " << strerror(errno) << &std::endl;
+    return 0;
+  }
+  madvise( text, st.st_size, MADV_SEQUENTIAL );
+
+  // Columns from the first line, room for a row on every line
+  unsigned long long maxRows = 0, numRows = 0;
+  unsigned int numFields = 0;
+  std::vector<int64_t> times;
+  bool ok = asciiScan( (const char*)text, st.st_size, maxRows, numFields ) && numFields > timeCol;
+  if( ok ) {
+    cols = numFields - timeCol;
+    if( timeCol )
+      times.resize( maxRows );
+    ok = allocData( maxRows * getRowSize() ) &&
+         asciiParse( (const char*)text, st.st_size, numFmt, size, cols, data, timeCol ? &times[0] : NULL, numRows ) &&
+         numRows && resizeData( numRows * getRowSize() );
+  }
+  munmap( text, st.st_size );
+  if( !ok ) {
+    std::cerr << "Load of: " << fileName << " failed!" << &std::endl;
+    if( data )
+      freeData();
+    return 0;
+  }
+
+  rows = numRows;
+  interleaved = true;
+  codec = NATIVE_CODEC_RAW;
+  if( timeCol ) {
+    // Microseconds since the epoch, floor to seconds
+    int64_t sec = times[0] / 1000000, usec = times[0] % 1000000;
+    if( usec < 0 ) {
+      sec--;
+      usec += 1000000;
+    }
+    utc.set( sec, usec );
+    if( rows > 1 && times[rows - 1] > times[0] )
+      sampleRate = (rows - 1) * 1e6 / (times[rows - 1] - times[0]);
+  }
+  setTimeEnd();
+  return rows;
+}
+
+bool
+TimeData::readHeader( FILE* fid )
+{
+  char magic[WAV_MAGIC_BYTES];
+  off_t base = ftello( fid );
+  size_t got = fread( magic, 1, WAV_MAGIC_BYTES, fid );
+  if( fseeko( fid, base, SEEK_SET ) ) {
+    std::cerr << "TimeData::readHeader() could not rewind file!" << &std::endl;
     return false;
   }
+  if( got != WAV_MAGIC_BYTES || memcmp( magic, WAV_RIFF_MAGIC, WAV_MAGIC_BYTES ) )
+    return DataCommon::readHeader( fid );
 
-  int* samps = (int*)getData();
-  for( size_t s = 0; s < getSampleCount(); s++ )
-    fprintf( fid, "%d\n", samps[s] );
+  WavInfo info;
+  return wavReadHeader( fid, info ) && useWavInfo( info );
+}
 
+bool
+TimeData::useWavInfo( const WavInfo &info )
+{
+  NumberFormats fmt;
+  unsigned int eltSize;
+  if( !wavSampleFormat( info, fmt, eltSize ) )
+    return false;
+  sampleRate = info.sampleRate;
+  cols = info.channels;
+  size = eltSize;
+  numFmt = fmt;
+  rows = info.dataBytes / info.blockAlign;
+  interleaved = true;
+  codec = NATIVE_CODEC_RAW;
   return true;
 }
 
 
-
 bool
 TimeData::setTimeEnd()
 {
@@ -117,30 +570,79 @@ TimeData::setTimeEnd()
   return true;
 }
 
+void
+TimeData::getRowTime( const char* row, const unsigned long long &rowIdx, TimeObj &tt ) const
+{
+  if( sampleRate > 0.0 )
+    tt = utc + TimeObj( rowIdx / sampleRate );
+  else
+    tt = utc;
+}
+
+void
+TimeData::fillNativeHeader( NativeHeader &hdr ) const
+{
+  DataCommon::fillNativeHeader( hdr );
+  hdr.sampleRate = sampleRate;
+}
+
+bool
+TimeData::useNativeHeader( const NativeHeader &hdr )
+{
+  if( !DataCommon::useNativeHeader( hdr ) )
+    return false;
+  sampleRate = hdr.sampleRate;
+  return true;
+}
+
 double
 TimeData::getLengthSecs() const 
 {
   return ((double)(getSampleCount() - 1)) / getSampleRate();
 }
 
-const double epsGrace = 1.1;
-const double srGrace = 0.01;
-
 bool
 TimeData::append( const DataCommon &apendee, const bool &force )
 {
-
-  const TimeData *tDat = (const TimeData *)&apendee;
-
  /* Will append if times match */
   if( apendee.isEmpty() ) {
     std::cerr << "TimeData::append() specified object to append is empty!" << &std::endl;
     return false;
   }
 
-  if( !force ) 
+  // The basis stays a time series, even when empty
+  if( !force && apendee.getType() != TIME_DATA ) {
+    std::cerr << "TimeData::append() mismatch on data pedigree!" << &std::endl;
+    return false;
+  }
+
+  return append( apendee.getView(), force );
+}
+
+bool
+TimeData::append( const DataView &view, const bool &force )
+{
+  if( view.isEmpty() ) {
+    std::cerr << "TimeData::append() specified view to append is empty!" << &std::endl;
+    return false;
+  }
+  if( rows && !interleaved ) {
+    std::cerr << "TimeData::append() basis is planar, interleave it first!" << &std::endl;
+    return false;
+  }
+
+  // An empty basis simply takes on the appendee
+  if( !rows ) {
+    interleaved = true;
+    size = view.getEltSize();
+    numFmt = view.getNumFmt();
+    cols = view.getCols();
+    utc = view.getUTC();
+    sampleRate = view.getSampleRate();
+  }
+  else if( !force ) 
   {
-    if( !pedigreeCheck( apendee ) ) {
+    if( getEltSize() != view.getEltSize() || getNumFmt() != view.getNumFmt() || getCols() != view.getCols() ) {
       std::cerr << "TimeData::append() mismatch on data pedigree!" << &std::endl;
       return false;
     }
@@ -149,7 +651,7 @@ TimeData::append( const DataCommon &apendee, const bool &force )
     setTimeEnd();
 
     double srEps = getSampleRate() * srGrace;
-    double srDiff = fabs( sampleRate - tDat->sampleRate );
+    double srDiff = fabs( sampleRate - view.getSampleRate() );
     if( srDiff > srEps ) {
       std::cerr << "TimeData::append() sample rates differ too much!" << &std::endl;
       return false;
@@ -157,7 +659,7 @@ TimeData::append( const DataCommon &apendee, const bool &force )
 
     double samplePeriod = 1.0 / getSampleRate();
     double timeEps = epsGrace * samplePeriod;
-    double tDiff = apendee.getUTC().get() - getTimeEnd().get();
+    double tDiff = view.getUTC().get() - getTimeEnd().get();
     if( tDiff < 0 ) {
       std::cerr << "TimeData::append() apendee starts before end of basis!" << &std::endl;
       return false;
@@ -168,25 +670,117 @@ TimeData::append( const DataCommon &apendee, const bool &force )
     }
   } // end of checks
 
-  size_t oldSize = getByteSize();
-  size_t addSize = apendee.getByteSize();
-  char* newArr = (char*)realloc( getData(), oldSize+addSize );
-  if( !newArr ) {
-    std::cerr << "TimeData::append() realloc() failed!" << &std::endl;
+  if( view.getRowSize() != getRowSize() ) {
+    std::cerr << "TimeData::append() row sizes differ, can't append!" << &std::endl;
+    return false;
+  }
+
+  // Views of our own rows must be found again once the buffer grows
+  const char* src = view.getData();
+  bool selfView = data && src >= data && src < data + getCapacity() * getRowSize();
+  size_t selfOff = selfView ? src - data : 0;
+
+  unsigned long long oldRows = rows;
+  unsigned long long addRows = view.getRows();
+  if( !growCapacity( oldRows + addRows ) ) {
+    std::cerr << "TimeData::append() could not grow buffer!" << &std::endl;
     return false;
   }
 
  /* Glory be! */  
-  memcpy( newArr+oldSize, apendee.getData(), addSize );
+  if( selfView )
+    src = data + selfOff;
+  DataView from( src, addRows, view.getCols(), view.getEltSize(), view.getNumFmt(), view.getUTC(), view.getSampleRate(),
+                 view.getStride(), view.getColStride() );
+  from.copyTo( data + oldRows*getRowSize() );
+  rows = oldRows + addRows;
+  setTimeEnd();
+
+  return true;
+
+}
+
+/**
+ * Samples in a span at a sample rate, rounded down or up.  The span is in
+ * half microseconds so that callers can split the difference.  Whole rates
+ * are done in integers, exact for any span a TimeObj can hold.
+ */
+static long long
+samplesIn( const int64_t &halfUsec, const double &rate, const bool &roundUp )
+{
+  if( rate == floor( rate ) && rate < 4e9 ) {
+    __int128 num = (__int128)halfUsec * (int64_t)rate, den = 2000000;
+    __int128 q = num / den;
+    if( num % den ) {
+      if( roundUp && num > 0 ) q++;
+      if( !roundUp && num < 0 ) q--;
+    }
+    return (long long)q;
+  }
+  double pos = halfUsec * rate / 2e6;
+  return (long long)( roundUp ? ceil( pos ) : floor( pos ) );
+}
+
+unsigned long long
+TimeData::indexAt( const TimeObj &tt ) const
+{
+  if( sampleRate <= 0.0 )
+    return rows;
+
+  // Sample times are only good to the microsecond, so half of one is grace
+  int64_t usec = nativeTimeKey( tt ) - nativeTimeKey( utc );
+  if( usec < 0 )
+    return rows;
+  long long pos = samplesIn( 2 * usec + 1, sampleRate, false );
+  return (unsigned long long)pos < rows ? pos : rows;
+}
+
+unsigned long long
+TimeData::firstRowAt( const TimeObj &tt ) const
+{
+  if( sampleRate <= 0.0 )
+    return 0;
+
+  int64_t usec = nativeTimeKey( tt ) - nativeTimeKey( utc );
+  if( usec <= 0 )
+    return 0;
+  long long pos = samplesIn( 2 * usec - 1, sampleRate, true );
+  return (unsigned long long)pos < rows ? pos : rows;
+}
+
+bool
+TimeData::slice( const TimeObj &begT, const TimeObj &finT, DataView &view ) const
+{
+  view = DataView();
+  if( !rows || sampleRate <= 0.0 )
+    return false;
+
+  unsigned long long begIdx = firstRowAt( begT );
+  unsigned long long endIdx = firstRowAt( finT );
+  if( endIdx <= begIdx )
+    return false;
 
+  view = getView().subView( begIdx, endIdx - begIdx );
   return true;
+}
 
+bool
+TimeData::materialize( const DataView &view )
+{
+  if( !DataCommon::materialize( view ) )
+    return false;
+  if( view.getSampleRate() > 0.0 )
+    sampleRate = view.getSampleRate();
+  setTimeEnd();
+  return true;
 }
 
 double
 TimeData::sum() const 
 {
-  return false;
+  double total = 0.0;
+  dispatchTyped( getView(), [&total]( const auto &tv ) { total = sumSamples( tv ); } );
+  return total;
 }
 
 double
@@ -195,3 +789,412 @@ TimeData::removeDC() const
   return sum() / rows;
 }
 
+
+
+// Regression tests
+//
+
+/** Is the page holding addr still mapped? */
+static bool
+isPageMapped( const char* addr )
+{
+  size_t pageBytes = sysconf( _SC_PAGESIZE );
+  unsigned char vec;
+  return !mincore( (void*)( addr - (uintptr_t)addr % pageBytes ), 1, &vec ) || errno != ENOMEM;
+}
+
+/** loadMapped() and mapFile(): rows in place, writes kept private, munmap()'d by the last holder */
+static bool
+testMapped()
+{
+  // Two columns of ints, then half a row that is dropped
+  char fileName[] = "/tmp/TimeDataXXXXXX";
+  int fd = mkstemp( fileName );
+  if( fd < 0 )
+    return DRATS;
+  std::vector<int32_t> samps( 3000 );
+  for( size_t i = 0; i < samps.size(); i++ )
+    samps[i] = (int32_t)( i * 7 );
+  size_t numBytes = samps.size() * sizeof(int32_t);
+  bool ok = write( fd, &samps[0], numBytes ) == (ssize_t)numBytes && write( fd, &samps[0], 4 ) == 4;
+  close( fd );
+
+  TimeData td;
+  td.setCols( 2 );
+  ok = ok && td.loadMapped( fileName ) == 1500 && td.isMapped() && td.getRows() == 1500 &&
+       !memcmp( td.getData(), &samps[0], numBytes ) && !td.loadMapped( fileName );
+
+  // Written in place, the mapping is private, so the file never sees it
+  const char* at = td.getData();
+  int32_t* w = (int32_t*)td.getWritableData();
+  std::vector<int32_t> back( samps.size() );
+  FILE* fid = fopen( fileName, "r" );
+  ok = ok && (const char*)w == at && ( w[0] = -1, w[2999] = -1, true ) && fid &&
+       fread( &back[0], numBytes, 1, fid ) == 1 && back == samps;
+  if( fid )
+    fclose( fid );
+
+  // A copy holds the mapping after the original lets go, then unmaps it
+  if( ok ) {
+    TimeData cp( td );
+    td.clear();
+    ok = !td.getData() && !td.isMapped() && cp.isMapped() && cp.getData() == at && ((const int32_t*)at)[0] == -1 &&
+         isPageMapped( at );
+  }
+  ok = ok && !isPageMapped( at );
+
+  // Rows behind a header are mapped from the top of the file, and unmapped whole
+  TimeData wav;
+  wav.setCols( 2 );
+  wav.setSampleRate( 1000.0 );
+  ok = ok && wav.materialize( DataView( (const char*)&samps[0], 1500, 2, sizeof(int32_t), NUM_INT, TimeObj(), 1000.0 ) ) &&
+       wav.writeFile( fileName, FORMAT_WAV );
+  wav.clear();
+  ok = ok && wav.readWav( fileName ) == 1500 && wav.isMapped() && wav.getData() != NULL &&
+       !memcmp( wav.getData(), &samps[0], numBytes );
+  at = wav.getData();
+  wav.clear();
+  ok = ok && !isPageMapped( at ) && !isPageMapped( at + numBytes - 1 );
+
+  unlink( fileName );
+  return ok ? VOILA : DRATS;
+}
+
+/** reserve(), shrinkToFit(), setAllocator() and the geometric growth of append() */
+static bool
+testCapacity()
+{
+  // The pool outlives the object, whose buffer it may hold
+  PoolAllocator pool;
+  TimeObj t0( (time_t)1300000000, 0 );
+  TimeData td( t0 );
+  td.setSampleRate( 100.0 );
+  if( !td.reserve( 1000 ) || td.getCapacity() != 1000 || td.getRows() ) return DRATS;
+
+  // Row at a time, the capacity at least doubles each time it runs out
+  const unsigned long long numRows = 20000;
+  unsigned long long cap = td.getCapacity(), grows = 0;
+  for( int32_t r = 0; r < (int32_t)numRows; r++ ) {
+    if( !td.append( DataView( (const char*)&r, 1, 1, sizeof(int32_t), NUM_INT, t0 + TimeObj( r / 100.0 ), 100.0 ) ) ) return DRATS;
+    if( td.getCapacity() == cap )
+      continue;
+    if( td.getCapacity() < 2 * cap ) return DRATS;
+    cap = td.getCapacity();
+    grows++;
+  }
+  if( td.getRows() != numRows || grows > 5 ) return DRATS;
+  const int32_t* got = (const int32_t*)td.getData();
+  for( unsigned long long r = 0; r < numRows; r++ )
+    if( got[r] != (int32_t)r ) return DRATS;
+
+  // A switch of allocator keeps the rows and the room reserved
+  if( !td.reserve( 50000 ) || !td.setAllocator( &pool ) || td.getAllocator() != &pool || td.getCapacity() != 50000 ) return DRATS;
+  got = (const int32_t*)td.getData();
+  for( unsigned long long r = 0; r < numRows; r++ )
+    if( got[r] != (int32_t)r ) return DRATS;
+  if( !td.setAllocator( NULL ) || td.getAllocator() != DataAllocator::getDefault() || td.getCapacity() != 50000 ) return DRATS;
+
+  // Room is given back, and reserving less than there is does nothing
+  if( !td.shrinkToFit() || td.getCapacity() != numRows || !td.reserve( 10 ) || td.getCapacity() != numRows ) return DRATS;
+  got = (const int32_t*)td.getData();
+  return got[numRows - 1] == (int32_t)( numRows - 1 ) ? VOILA : DRATS;
+}
+
+/** Moves, swap(), release() and adopt() hand buffers over without copying */
+static bool
+testMove()
+{
+  PoolAllocator pool;
+  std::vector<int16_t> samps( 2000 );
+  for( size_t i = 0; i < samps.size(); i++ )
+    samps[i] = (int16_t)( i * 3 );
+  TimeObj t0( (time_t)1300000000, 0 );
+  TimeData a;
+  a.setAllocator( &pool );
+  if( !a.materialize( DataView( (const char*)&samps[0], 1000, 2, sizeof(int16_t), NUM_INT, t0, 100.0 ) ) ) return DRATS;
+  const char* at = a.getData();
+
+  // Moved from objects are left empty
+  TimeData b( std::move( a ) );
+  if( b.getData() != at || b.getRows() != 1000 || b.getSampleRate() != 100.0 || b.getUTC() != t0 ) return DRATS;
+  if( a.getData() || a.getRows() || !a.isEmpty() || a.getSampleRate() != 0.0 ) return DRATS;
+  TimeData c;
+  c = std::move( b );
+  if( c.getData() != at || c.getRows() != 1000 || c.getAllocator() != &pool || b.getData() || b.getRows() ) return DRATS;
+
+  // Swapped whole, buffers and attributes
+  TimeData d;
+  if( !d.materialize( DataView( (const char*)&samps[0], 10, 1, sizeof(int16_t), NUM_INT, t0 + TimeObj( 60.0 ), 8.0 ) ) ) return DRATS;
+  const char* dat = d.getData();
+  c.swap( d );
+  if( c.getData() != dat || c.getRows() != 10 || c.getCols() != 1 || c.getSampleRate() != 8.0 ) return DRATS;
+  if( d.getData() != at || d.getRows() != 1000 || d.getCols() != 2 || d.getAllocator() != &pool ) return DRATS;
+
+  // Released, the buffer is the caller's, and goes back to the pool it came from
+  size_t numBytes = 0;
+  char* buf = d.release( &numBytes );
+  if( buf != at || numBytes < 4000 || d.getData() || d.getRows() || memcmp( buf, &samps[0], 4000 ) ) return DRATS;
+  size_t retained = pool.getRetainedBytes();
+  pool.deallocate( buf );
+  if( pool.getRetainedBytes() <= retained ) return DRATS;
+
+  // A shared buffer is copied out, the other holder keeps it
+  TimeData e;
+  e.setAllocator( &pool );
+  if( !e.materialize( DataView( (const char*)&samps[0], 1000, 2, sizeof(int16_t), NUM_INT, t0, 100.0 ) ) ) return DRATS;
+  TimeData f( e );
+  buf = f.release( &numBytes );
+  if( !buf || buf == e.getData() || !e.isUnique() || memcmp( buf, e.getData(), 4000 ) ) return DRATS;
+  pool.deallocate( buf );
+
+  // Adopted, with room to spare, and freed to the pool named
+  buf = (char*)pool.allocate( 8000 );
+  if( !buf ) return DRATS;
+  memcpy( buf, &samps[0], 4000 );
+  f.setCols( 2 );
+  f.setEltSize( sizeof(int16_t) );
+  f.adopt( buf, 1000, &pool, 8000 );
+  if( f.getData() != buf || f.getRows() != 1000 || f.getCapacity() != 2000 || f.getAllocator() != &pool || f.diff( e ) ) return DRATS;
+  retained = pool.getRetainedBytes();
+  f.clear();
+  return pool.getRetainedBytes() > retained ? VOILA : DRATS;
+}
+
+/** Copies share the buffer until one writes, then the writer gets its own */
+static bool
+testShare()
+{
+  std::vector<int32_t> samps( 1000 );
+  for( size_t i = 0; i < samps.size(); i++ )
+    samps[i] = (int32_t)i;
+  TimeData a;
+  if( !a.materialize( DataView( (const char*)&samps[0], 1000, 1, sizeof(int32_t), NUM_INT, TimeObj(), 100.0 ) ) ) return DRATS;
+  const char* at = a.getData();
+
+  // Copied and assigned, all three hold the one buffer
+  TimeData b( a ), c;
+  c = b;
+  if( b.getData() != at || c.getData() != at || a.isUnique() || b.isUnique() ) return DRATS;
+
+  // The writer moves off, the others keep the buffer untouched
+  int32_t* w = (int32_t*)b.getWritableData();
+  if( !w || (const char*)w == at || b.getData() != (const char*)w || !b.isUnique() ) return DRATS;
+  w[0] = -1;
+  if( a.getData() != at || c.getData() != at || ((const int32_t*)at)[0] != 0 || a.isUnique() ) return DRATS;
+  if( a.diff( c ) || !a.diff( b ) ) return DRATS;
+
+  // Others hold a's buffer, so it isn't a's to hand over
+  int32_t* mine = (int32_t*)DataAllocator::getDefault()->allocate( 1000 * sizeof(int32_t) );
+  if( !mine || a.setData( (char*)mine ) || a.getData() != at ) return DRATS;
+  c.clear();
+  if( !a.isUnique() || !a.setData( (char*)mine ) || a.getData() != (const char*)mine ) return DRATS;
+  DataAllocator::getDefault()->deallocate( (void*)at );
+  return VOILA;
+}
+
+/** append() onto an empty basis, and of other kinds of object */
+static bool
+testAppend()
+{
+  std::vector<int16_t> samps( 200 );
+  for( size_t i = 0; i < samps.size(); i++ )
+    samps[i] = (int16_t)i;
+  TimeObj t0( (time_t)1300000000, 0 );
+  TimeData a, b, c;
+  if( !b.materialize( DataView( (const char*)&samps[0], 100, 1, sizeof(int16_t), NUM_INT, t0, 100.0 ) ) ) return DRATS;
+  if( !c.materialize( DataView( (const char*)&samps[100], 100, 1, sizeof(int16_t), NUM_INT, t0 + TimeObj( 1.0 ), 100.0 ) ) ) return DRATS;
+
+  // An empty basis takes the rows, and stays a time series
+  if( !a.append( b ) || a.getType() != TIME_DATA || a.getRows() != 100 || a.getUTC() != t0 ) return DRATS;
+
+  // Rows of another kind of object only go on by force
+  c.setType( FREQUENCY_DATA );
+  if( a.append( c ) || a.getRows() != 100 ) return DRATS;
+  if( !a.append( c, true ) || a.getType() != TIME_DATA || a.getRows() != 200 ) return DRATS;
+  if( memcmp( a.getData(), &samps[0], samps.size() * sizeof(int16_t) ) ) return DRATS;
+
+  a.reset();
+  return a.getType() == TIME_DATA && !a.getRows() ? VOILA : DRATS;
+}
+
+/** An empty basis takes the number format of a view, others must match it */
+static bool
+testAppendView()
+{
+  std::vector<float> flts( 20, 1.5f );
+  std::vector<int32_t> ints( 10, 7 );
+  TimeObj t0( (time_t)1300000000, 0 );
+  TimeData a;
+  if( !a.append( DataView( (const char*)&flts[0], 10, 1, sizeof(float), NUM_FLT, t0, 100.0 ) ) ) return DRATS;
+  if( a.getNumFmt() != NUM_FLT || a.getEltSize() != sizeof(float) ) return DRATS;
+
+  // Integers of the same size are not floats
+  DataView next( (const char*)&ints[0], 10, 1, sizeof(int32_t), NUM_INT, t0 + TimeObj( 0.1 ), 100.0 );
+  if( a.append( next ) || a.getRows() != 10 ) return DRATS;
+  if( !a.append( DataView( (const char*)&flts[10], 10, 1, sizeof(float), NUM_FLT, t0 + TimeObj( 0.1 ), 100.0 ) ) ) return DRATS;
+  return a.getRows() == 20 && !memcmp( a.getData(), &flts[0], flts.size() * sizeof(float) ) ? VOILA : DRATS;
+}
+
+/** Write a day file of numRows samples, first, first + 1, ..., from utc at 10 Hz */
+static bool
+writeDay( const std::string &pathFormat, const int &day, const TimeObj &utc, const int16_t &first,
+          const size_t &numRows, const NativeCodecs codec, std::string &fileName )
+{
+  std::vector<int16_t> samps( numRows );
+  for( size_t i = 0; i < numRows; i++ )
+    samps[i] = (int16_t)( first + i );
+  TimeData td;
+  if( !TimeData::makeDayFileName( pathFormat, "ST", "CH", day, fileName ) ||
+      !td.materialize( DataView( (const char*)&samps[0], numRows, 1, sizeof(int16_t), NUM_INT, utc, 10.0 ) ) )
+    return false;
+  td.setCodec( codec );
+  return td.writeFile( fileName.c_str() );
+}
+
+/** Days overlapping, a day missing, a gap zero filled */
+static bool
+testLoadDays()
+{
+  char dirName[] = "/tmp/TimeDataXXXXXX";
+  if( !mkdtemp( dirName ) )
+    return DRATS;
+  std::string pathFormat = std::string( dirName ) + "/%S.%C.%D.dsp";
+
+  // 20 s into the 14th, 10 s of the 14th with the first 5 repeated, none
+  // of the 15th, then the 16th from midnight
+  TimeObj midnight( (time_t)1300060800, 0 ), day( (time_t)86400, 0 );
+  TimeObj begT = midnight - TimeObj( 10.0 ), finT = midnight + day + day + TimeObj( 5.0 );
+  std::string names[3];
+  bool ok = writeDay( pathFormat, 20110313, begT, 0, 200, NATIVE_CODEC_RAW, names[0] ) &&
+            writeDay( pathFormat, 20110314, midnight + TimeObj( 5.0 ), 1000, 100, NATIVE_CODEC_DELTA, names[1] ) &&
+            writeDay( pathFormat, 20110316, midnight + day + day, 2000, 100, NATIVE_CODEC_RAW, names[2] );
+
+  TimeData td;
+  std::vector<TimeGap> gaps;
+  unsigned long long gapRows = ( 2 * 86400 - 15 ) * 10, numRows = 200 + 50 + gapRows + 50;
+  ok = ok && td.loadDays( "ST", "CH", begT, finT, &gaps ) == 0 &&
+       td.loadDays( "ST", "CH", begT, finT, &gaps, pathFormat ) == numRows && td.getRows() == numRows;
+  ok = ok && td.getUTC() == begT && td.getSampleRate() == 10.0 && gaps.size() == 1 &&
+       gaps[0].row == 250 && gaps[0].numRows == gapRows &&
+       gaps[0].begT == midnight + TimeObj( 15.0 ) && gaps[0].finT == midnight + day + day;
+
+  // The repeats of the 14th are dropped, the rest run on
+  const int16_t* samps = (const int16_t*)td.getData();
+  for( unsigned long long i = 0; ok && i < numRows; i++ ) {
+    int16_t want = i < 200 ? (int16_t)i : i < 250 ? (int16_t)( 1050 + i - 200 ) : i < 250 + gapRows ? 0 : (int16_t)( 2000 + i - 250 - gapRows );
+    ok = samps[i] == want;
+  }
+
+  for( int f = 0; f < 3; f++ )
+    if( !names[f].empty() )
+      unlink( names[f].c_str() );
+  rmdir( dirName );
+  return ok ? VOILA : DRATS;
+}
+
+/** typedView(), getTyped(), getWritableTyped() and dispatchTyped(), and the sums done through them */
+static bool
+testTyped()
+{
+  TimeObj t0( (time_t)1300000000, 0 );
+  std::vector<int16_t> s16( 2000 );
+  std::vector<int32_t> s32( 2000 );
+  std::vector<float> sflt( 2000 );
+  std::vector<double> sdbl( 2001 );
+  for( int i = 0; i < 2000; i++ ) {
+    s16[i] = (int16_t)( i * 3 );
+    s32[i] = i * 3;
+    sflt[i] = (float)( i * 3 );
+    sdbl[i] = i * 3.0;
+  }
+
+  // Each format at its own type, and at no other
+  TypedView<const int16_t> tv16;
+  TypedView<const int32_t> tv32;
+  TypedView<const float> tvflt;
+  TypedView<const double> tvdbl;
+  DataView v16( (const char*)&s16[0], 1000, 2, sizeof(int16_t), NUM_INT, t0, 100.0 );
+  DataView v32( (const char*)&s32[0], 1000, 2, sizeof(int32_t), NUM_INT, t0, 100.0 );
+  DataView vflt( (const char*)&sflt[0], 1000, 2, sizeof(float), NUM_FLT, t0, 100.0 );
+  DataView vdbl( (const char*)&sdbl[0], 1000, 2, sizeof(double), NUM_DBL, t0, 100.0 );
+  if( !typedView( v16, tv16 ) || tv16.getRows() != 1000 || tv16.getCols() != 2 || tv16.getStride() != 2 ||
+      tv16( 999, 1 ) != 5997 || !tv16.isContiguous() ) return DRATS;
+  if( !typedView( v32, tv32 ) || tv32( 500, 0 ) != 3000 ) return DRATS;
+  if( !typedView( vflt, tvflt ) || tvflt( 1, 1 ) != 9.0f ) return DRATS;
+  if( !typedView( vdbl, tvdbl ) || tvdbl( 2, 0 ) != 12.0 ) return DRATS;
+  if( typedView( v16, tv32 ) || tv32.getData() || typedView( v32, tvflt ) || typedView( vflt, tv32 ) ||
+      typedView( vdbl, tvflt ) || typedView( v32, tv16 ) ) return DRATS;
+
+  // Planar, each column is contiguous
+  DataView planar( (const char*)&s32[0], 1000, 2, sizeof(int32_t), NUM_INT, t0, 100.0, sizeof(int32_t), 1000 * sizeof(int32_t) );
+  if( !typedView( planar, tv32 ) || tv32.getStride() != 1 || tv32.getColStride() != 1000 || tv32.isContiguous() ||
+      tv32( 1, 1 ) != 3003 || !tv32.column( 1 ).isContiguous() || *tv32.column( 1 ).getRow( 2 ) != 3006 ) return DRATS;
+
+  // Rows not on a sample boundary, or the first not aligned, are refused
+  DataView odd( (const char*)&s32[0], 500, 1, sizeof(int32_t), NUM_INT, t0, 100.0, 6 );
+  DataView shifted( (const char*)&sdbl[0] + 1, 1000, 2, sizeof(double), NUM_DBL, t0, 100.0 );
+  if( typedView( odd, tv32 ) || typedView( shifted, tvdbl ) || tvdbl.getData() ) return DRATS;
+
+  // Read through the object, sums at each type
+  TimeData td;
+  if( !td.materialize( v16 ) || !td.getTyped( tv16 ) || tv16.getData() != (const int16_t*)td.getData() ) return DRATS;
+  if( td.getTyped( tv32 ) || td.sum() != 5997000.0 || td.removeDC() != 5997.0 ) return DRATS;
+  TimeData tdflt, tddbl;
+  if( !tdflt.materialize( vflt ) || tdflt.sum() != 5997000.0 || tdflt.removeDC() != 5997.0 ) return DRATS;
+  if( !tddbl.materialize( vdbl ) || tddbl.sum() != 5997000.0 ) return DRATS;
+
+  // Written through a shared copy, the other holder keeps its rows
+  TimeData cp( td );
+  TypedView<int16_t> w16;
+  if( cp.getData() != td.getData() || !cp.getWritableTyped( w16 ) || w16.getData() == (const int16_t*)td.getData() ||
+      w16.getData() != (const int16_t*)cp.getData() || w16( 0, 0 ) != 0 ) return DRATS;
+  w16( 0, 0 ) = 100;
+  TypedView<int32_t> w32;
+  if( cp.getWritableTyped( w32 ) || ((const int16_t*)td.getData())[0] != 0 || cp.sum() != 5997100.0 || td.sum() != 5997000.0 ) return DRATS;
+
+  // One call per view, at the type it holds
+  int calls = 0;
+  size_t eltSize = 0;
+  bool ok = dispatchTyped( v32, [&]( const auto &tv ) { calls++; eltSize = sizeof( *tv.getData() ); } ) &&
+            dispatchTyped( vdbl, [&]( const auto &tv ) { calls++; eltSize += sizeof( *tv.getData() ); } );
+  DataView bytes( (const char*)&s16[0], 1000, 1, 3, NUM_INT, t0, 100.0 );
+  ok = ok && !dispatchTyped( bytes, [&]( const auto &tv ) { calls++; } ) &&
+       !dispatchTyped( shifted, [&]( const auto &tv ) { calls++; } );
+  return ok && calls == 2 && eltSize == 12 ? VOILA : DRATS;
+}
+
+bool
+TimeData::testClass()
+{
+  if( testMapped() ) return DRATS;
+  if( testCapacity() ) return DRATS;
+  if( testMove() ) return DRATS;
+  if( testShare() ) return DRATS;
+  if( testAppend() ) return DRATS;
+  if( testAppendView() ) return DRATS;
+  if( testLoadDays() ) return DRATS;
+  if( testTyped() ) return DRATS;
+
+  // Years from utc, rows only counted, no samples needed.  A whole rate is
+  // done exactly, in integers
+  TimeData far;
+  TimeObj t0( (time_t)1300000000, 0 );
+  far.setUTC( t0 );
+  far.setSampleRate( 1000.0 );
+  far.setRows( 1000000000000ULL );
+  TimeObj tt = t0 + TimeObj( (time_t)100000000, 1000 );
+  if( far.indexAt( tt ) != 100000000001ULL || far.firstRowAt( tt ) != 100000000001ULL ) return DRATS;
+  tt = tt + TimeObj( (time_t)0, 123 );
+  if( far.indexAt( tt ) != 100000000001ULL || far.firstRowAt( tt ) != 100000000002ULL ) return DRATS;
+
+  // Any other rate in doubles, a microsecond either side of a sample
+  far.setSampleRate( 1000.0 / 3.0 );
+  tt = t0 + TimeObj( (time_t)900000, 0 );
+  if( far.indexAt( tt ) != 300000000ULL || far.firstRowAt( tt ) != 300000000ULL ) return DRATS;
+  if( far.indexAt( tt + TimeObj( (time_t)0, 1 ) ) != 300000000ULL || far.firstRowAt( tt + TimeObj( (time_t)0, 1 ) ) != 300000001ULL ) return DRATS;
+  if( far.indexAt( tt - TimeObj( (time_t)0, 1 ) ) != 299999999ULL || far.firstRowAt( tt - TimeObj( (time_t)0, 1 ) ) != 300000000ULL ) return DRATS;
+  if( far.indexAt( t0 - TimeObj( (time_t)0, 1 ) ) != far.getRows() || far.firstRowAt( t0 - TimeObj( (time_t)0, 1 ) ) ) return DRATS;
+  far.setRows( 0 );
+
+  return VOILA;
+}
@@ -7,6 +7,23 @@
   */
 
 #include "DataCommon.h"
+#include "WavFormat.h"
+#include "AsciiFormat.h"
+
+/** Day file path for loadDays(), %S station, %C channel, %D day moniker YYYYMMDD */
+#define TIME_DATA_DAY_PATH "%S/%C/%D.dsp"
+
+/**
+  * struct TimeGap
+  * Samples missing between the files of a loadDays(), zero filled.
+  */
+struct TimeGap
+{
+  TimeObj begT;                 /** Time of the first missing sample */
+  TimeObj finT;                 /** Time of the sample after the last one missing */
+  unsigned long long row;       /** Index of the first missing sample */
+  unsigned long long numRows;   /** Samples missing */
+};
 
 /**
   * class TimeData
@@ -36,12 +53,38 @@ public:
   TimeData( const TimeObj &startUTC );
 
   /**
-   * Copy Constructor
+   * Copy Constructor.  The buffer is shared, not copied, until either
+   * object writes to it.
    * @param src Object to be copied.
-   * @param skipData (optional) Skip copy of the data, for speed
+   * @param skipData (optional) Skip the data altogether
    */
   TimeData( const TimeData &src, const bool &skipData = false );
 
+  /**
+   * Move Constructor, takes the buffer and leaves src empty.
+   * @param src Object to be moved from.
+   */
+  TimeData( TimeData &&src ) noexcept;
+
+  /**
+   * Copy Assignment.  As the copy constructor, the buffer is shared, not
+   * copied, until either object writes to it.
+   * @param src Object to be copied.
+   */
+  TimeData& operator=( const TimeData &src );
+
+  /**
+   * Move Assignment, takes the buffer and frees the old one.
+   * @param src Object to be moved from.
+   */
+  TimeData& operator=( TimeData &&src ) noexcept;
+
+  /**
+   * Exchange contents with other, no samples are copied.
+   * @param other Object to exchange with.
+   */
+  void swap( TimeData &other ) noexcept;
+
   /**
    * Empty Destructor
    */
@@ -62,11 +105,93 @@ public:
   bool load();
 
   /**
+   * Compute the file name of a day of a station and channel.
+   * @return bool True if the name is complete
+   * @param pathFormat path with %S, %C and %D, see TIME_DATA_DAY_PATH, %% for %
+   * @param station station name
+   * @param channel channel name
+   * @param day day moniker, YYYYMMDD
+   * @param fileName the name
+   */
+  static bool makeDayFileName( const std::string &pathFormat, const std::string &station, const std::string &channel,
+                               const int &day, std::string &fileName );
+
+  /**
+   * Load the native day files of a station and channel from begT up to, not
+   * including, finT.  The headers are read first to size one buffer, then
+   * the files are read into it, at the offset their start times call for,
+   * on several threads.  Missing files and samples between files are zero
+   * filled and reported as gaps; samples a file repeats are dropped.  Files
+   * of a different shape or sample rate are passed over with a warning.
+   * @return size_t Number of rows loaded, zero on failure
+   * @param station station name
+   * @param channel channel name
+   * @param begT time of the first sample wanted
+   * @param finT time past the last sample wanted
+   * @param gaps (optional) the gaps, in row order
+   * @param pathFormat (optional) day file path, see makeDayFileName()
+   */
+  size_t loadDays( const std::string &station, const std::string &channel, const TimeObj &begT, const TimeObj &finT,
+                   std::vector<TimeGap>* gaps = NULL, const std::string &pathFormat = TIME_DATA_DAY_PATH );
+
+  /**
+   * Set the number of threads loadDays() reads on.
+   * @param numThreads threads wanted, zero for one per core
+   */
+  static void setLoadThreads( const unsigned int &numThreads );
+
+  /**
+   * Write the samples as text, one row per line, see writeAscii().
    * @return bool True if write was successful
    * @param fileName Name or Path of file to write
    */
   bool write( char* fileName ) const;
 
+  /**
+   * Write the samples as text, FORMAT_ASCII.
+   * @return bool True if write was successful
+   * @param fid The open file ID
+   * @param timeCol lead each row with its time in seconds since the epoch
+   */
+  bool writeAscii( FILE* fid, const bool &timeCol = false ) const;
+
+  /**
+   * Load a text file of the numFmt and size already set, one row per
+   * line, taking cols from the first line.  Big files are parsed on
+   * several threads.
+   * @return size_t Number of rows read, zero on failure
+   * @param fileName Name of file to read
+   * @param timeCol lines lead with a time, utc and sampleRate are taken
+   * from the first and last
+   */
+  size_t readAscii( const char* fileName, const bool &timeCol = false );
+
+  /**
+   * Write to an open file.  FORMAT_ASCII writes text, FORMAT_WAV streams a
+   * WAV file at the sample rate rounded, anything else is up to DataCommon.
+   * @return bool True if write was successful
+   * @param fid The open file ID
+   * @param format file format, see FileFormatOptions
+   */
+  bool write( FILE* fid, const int &format = FORMAT_NATIVE ) const;
+
+  /**
+   * Load a WAV file, taking sampleRate, cols, size and numFmt from its
+   * header.  utc is left as is, WAV has no start time.
+   * @return size_t Number of rows read, zero on failure
+   * @param fileName Name of file to read
+   * @param useMap mmap() the rows rather than read them, when they are aligned
+   */
+  size_t readWav( const char* fileName, const bool &useMap = true );
+
+  /**
+   * Read the header of a WAV or native file, see DataCommon::readHeader().
+   * A WAV file of unknown length leaves rows zero, to be read to its end.
+   * @return bool True if the header was understood
+   * @param fid The open file, left positioned at the first row
+   */
+  bool readHeader( FILE* fid );
+
   /**
    * @return bool True if write was successful
    * @param fileName Name or Path of file to write
@@ -86,21 +211,75 @@ public:
    */
   bool append( const DataCommon &apendee, const bool &force = false );
 
+  /**
+   * Concatenate a view onto this time series, with the same checks.  The
+   * view may be of this very object.
+   * @param  view rows to be appended.
+   * @param  force Append regardless of any validation checks.
+   */
+  bool append( const DataView &view, const bool &force = false );
+
+  /**
+   * View all samples, with the sample rate, in either layout.
+   * @return a view of data, valid until this object is written to
+   */
+  DataView getView() const { return layoutView( sampleRate ); }
+
+  /**
+   * Zero-copy trim, from the first sample at or after begT up to, not
+   * including, the first at or after finT.  Indexed straight from the
+   * sample rate, no search.
+   * @param begT beginning time of slice window.
+   * @param finT ending time of slice window.
+   * @param view the samples found, empty if none.
+   * @return true if any samples were found
+   */
+  bool slice( const TimeObj &begT, const TimeObj &finT, DataView &view ) const;
+
+  /**
+   * Index of the sample at, or last before, a time, straight from utc and
+   * the sample rate.  Exact to the microsecond for whole sample rates.
+   * @param tt time sought
+   * @return index of the sample, rows if tt is before utc or past the last
+   */
+  unsigned long long indexAt( const TimeObj &tt ) const;
+
+  /**
+   * Copy a view in, taking its sample rate as well.
+   * @param view samples to copy
+   * @return true if successful
+   */
+  bool materialize( const DataView &view );
+
+  /**
+   * Time of a row, from utc and sampleRate.
+   * @param row Pointer to the row (unused)
+   * @param rowIdx Index of the row from utc
+   * @param tt The time of the row
+   */
+  void getRowTime( const char* row, const unsigned long long &rowIdx, TimeObj &tt ) const;
+
+  /**
+   * Run the regression test for this class.  Return 0 if good.
+   * @return bool
+   */
+  static bool testClass();
+
 protected:
 
   /** Sample rate in samples per second */ 
   double sampleRate;
 
+public:
+
+  // Protected attribute accessor methods
+
   /**
    * Set the value of sampleRate
    * @param new_var the new value of sampleRate
    */
   void setSampleRate ( const double &new_var ) { sampleRate = new_var; }
 
-public:
-
-  // Protected attribute accessor methods
-
   /**
    * Get the value of sampleRate
    * @return the value of sampleRate
@@ -137,6 +316,35 @@ public:
    */
   void display( std::ostream &outr = std::cout ) const;
 
+protected:
+
+  /**
+   * Adds sampleRate to the native header.
+   * @param hdr header to fill
+   */
+  void fillNativeHeader( NativeHeader &hdr ) const;
+
+  /**
+   * Takes sampleRate from the native header.
+   * @param hdr header read from file
+   * @return true if the header suits this object
+   */
+  bool useNativeHeader( const NativeHeader &hdr );
+
+  /**
+   * Take the shape of the rows from a WAV header.
+   * @param info header read from file
+   * @return true if the header suits this object
+   */
+  bool useWavInfo( const WavInfo &info );
+
+  /**
+   * Index of the first sample at or after a time, to the microsecond.
+   * @param tt time sought
+   * @return index of the sample, rows if past the end
+   */
+  unsigned long long firstRowAt( const TimeObj &tt ) const;
+
 private:
 
   void initAttributes ( ) ;
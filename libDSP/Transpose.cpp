@@ -0,0 +1,159 @@
+#include "Transpose.h"
+
+/**
+  * Transpose
+  * Copyright 2016, ShotSpotter
+  */
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** Any element size, one element at a time */
+static void
+transposeTileScalar( const char* src, const size_t &srcStride, char* dst, const size_t &dstStride,
+                     const size_t &numRows, const size_t &numCols, const unsigned int &eltSize )
+{
+  for( size_t r = 0; r < numRows; r++ ) {
+    const char* s = src + r * srcStride;
+    char* d = dst + r * eltSize;
+    for( size_t c = 0; c < numCols; c++ )
+      memcpy( d + c * dstStride, s + c * eltSize, eltSize );
+  }
+}
+
+#ifdef __SSE2__
+
+static inline void
+transpose4x4( const char* src, const size_t &srcStride, char* dst, const size_t &dstStride )
+{
+  __m128 r0 = _mm_loadu_ps( (const float*)src );
+  __m128 r1 = _mm_loadu_ps( (const float*)(src + srcStride) );
+  __m128 r2 = _mm_loadu_ps( (const float*)(src + 2 * srcStride) );
+  __m128 r3 = _mm_loadu_ps( (const float*)(src + 3 * srcStride) );
+  _MM_TRANSPOSE4_PS( r0, r1, r2, r3 );
+  _mm_storeu_ps( (float*)dst, r0 );
+  _mm_storeu_ps( (float*)(dst + dstStride), r1 );
+  _mm_storeu_ps( (float*)(dst + 2 * dstStride), r2 );
+  _mm_storeu_ps( (float*)(dst + 3 * dstStride), r3 );
+}
+
+static inline void
+transpose2x2( const char* src, const size_t &srcStride, char* dst, const size_t &dstStride )
+{
+  __m128i r0 = _mm_loadu_si128( (const __m128i*)src );
+  __m128i r1 = _mm_loadu_si128( (const __m128i*)(src + srcStride) );
+  _mm_storeu_si128( (__m128i*)dst, _mm_unpacklo_epi64( r0, r1 ) );
+  _mm_storeu_si128( (__m128i*)(dst + dstStride), _mm_unpackhi_epi64( r0, r1 ) );
+}
+
+static inline void
+transpose8x8( const char* src, const size_t &srcStride, char* dst, const size_t &dstStride )
+{
+  __m128i r[8], t[8];
+  for( int i = 0; i < 8; i++ )
+    r[i] = _mm_loadu_si128( (const __m128i*)(src + i * srcStride) );
+  // Pairs of 16, then of 32, then of 64 bits
+  for( int i = 0; i < 4; i++ ) {
+    t[2*i]   = _mm_unpacklo_epi16( r[2*i], r[2*i+1] );
+    t[2*i+1] = _mm_unpackhi_epi16( r[2*i], r[2*i+1] );
+  }
+  for( int i = 0; i < 2; i++ ) {
+    r[4*i]   = _mm_unpacklo_epi32( t[4*i],   t[4*i+2] );
+    r[4*i+1] = _mm_unpackhi_epi32( t[4*i],   t[4*i+2] );
+    r[4*i+2] = _mm_unpacklo_epi32( t[4*i+1], t[4*i+3] );
+    r[4*i+3] = _mm_unpackhi_epi32( t[4*i+1], t[4*i+3] );
+  }
+  for( int i = 0; i < 4; i++ ) {
+    _mm_storeu_si128( (__m128i*)(dst + (2*i)   * dstStride), _mm_unpacklo_epi64( r[i], r[i+4] ) );
+    _mm_storeu_si128( (__m128i*)(dst + (2*i+1) * dstStride), _mm_unpackhi_epi64( r[i], r[i+4] ) );
+  }
+}
+
+#endif // __SSE2__
+
+/** One tile, in register sized blocks where the element size has them */
+static void
+transposeTile( const char* src, const size_t &srcStride, char* dst, const size_t &dstStride,
+               const size_t &numRows, const size_t &numCols, const unsigned int &eltSize )
+{
+  size_t blk = 0;
+ #ifdef __SSE2__
+  if( eltSize == 2 ) blk = 8;
+  else if( eltSize == 4 ) blk = 4;
+  else if( eltSize == 8 ) blk = 2;
+ #endif // __SSE2__
+  if( !blk || numRows < blk || numCols < blk ) {
+    transposeTileScalar( src, srcStride, dst, dstStride, numRows, numCols, eltSize );
+    return;
+  }
+
+  size_t fullRows = numRows - numRows % blk;
+  size_t fullCols = numCols - numCols % blk;
+ #ifdef __SSE2__
+  for( size_t r = 0; r < fullRows; r += blk ) {
+    for( size_t c = 0; c < fullCols; c += blk ) {
+      const char* s = src + r * srcStride + c * eltSize;
+      char* d = dst + c * dstStride + r * eltSize;
+      if( blk == 8 )
+        transpose8x8( s, srcStride, d, dstStride );
+      else if( blk == 4 )
+        transpose4x4( s, srcStride, d, dstStride );
+      else
+        transpose2x2( s, srcStride, d, dstStride );
+    }
+  }
+ #endif // __SSE2__
+
+  // Ragged right and bottom edges
+  if( fullCols < numCols )
+    transposeTileScalar( src + fullCols * eltSize, srcStride, dst + fullCols * dstStride, dstStride,
+                         fullRows, numCols - fullCols, eltSize );
+  if( fullRows < numRows )
+    transposeTileScalar( src + fullRows * srcStride, srcStride, dst + fullRows * eltSize, dstStride,
+                         numRows - fullRows, numCols, eltSize );
+}
+
+void
+transposeBlocked( const char* src, const size_t &srcStride, char* dst, const size_t &dstStride,
+                  const size_t &numRows, const size_t &numCols, const unsigned int &eltSize )
+{
+  for( size_t r = 0; r < numRows; r += TRANSPOSE_TILE ) {
+    size_t tileRows = numRows - r < TRANSPOSE_TILE ? numRows - r : TRANSPOSE_TILE;
+    for( size_t c = 0; c < numCols; c += TRANSPOSE_TILE ) {
+      size_t tileCols = numCols - c < TRANSPOSE_TILE ? numCols - c : TRANSPOSE_TILE;
+      transposeTile( src + r * srcStride + c * eltSize, srcStride,
+                     dst + c * dstStride + r * eltSize, dstStride,
+                     tileRows, tileCols, eltSize );
+    }
+  }
+}
+
+bool
+testTranspose()
+{
+  // Shapes with ragged tiles and blocks, every element size
+  const size_t shapes[][2] = { { 1, 1 }, { 3, 5 }, { 37, 8 }, { 100, 16 }, { 7, 71 } };
+  const unsigned int sizes[] = { 1, 2, 3, 4, 8 };
+
+  for( size_t sh = 0; sh < sizeof(shapes) / sizeof(shapes[0]); sh++ ) {
+    size_t nr = shapes[sh][0], nc = shapes[sh][1];
+    for( size_t sz = 0; sz < sizeof(sizes) / sizeof(sizes[0]); sz++ ) {
+      unsigned int es = sizes[sz];
+      std::vector<char> a( nr * nc * es ), b( nr * nc * es ), c( nr * nc * es );
+      for( size_t i = 0; i < a.size(); i++ )
+        a[i] = (char)(i * 131 + 7);
+
+      transposeBlocked( &a[0], nc * es, &b[0], nr * es, nr, nc, es );
+      for( size_t r = 0; r < nr; r++ )
+        for( size_t col = 0; col < nc; col++ )
+          if( memcmp( &a[(r * nc + col) * es], &b[(col * nr + r) * es], es ) )
+            return DRATS;
+
+      transposeBlocked( &b[0], nr * es, &c[0], nc * es, nc, nr, es );
+      if( a != c )
+        return DRATS;
+    }
+  }
+  return VOILA;
+}
@@ -0,0 +1,37 @@
+#ifndef __TRANSPOSE_H__
+#define __TRANSPOSE_H__
+
+/**
+  * Transpose
+  * Copyright 2016, ShotSpotter
+  */
+
+#include "libCore/libCore.h"
+
+/** Tile edge in elements, a tile of doubles in and out fits in L1 */
+#define TRANSPOSE_TILE 32
+
+/**
+ * Out of place matrix transpose, for switching multi-column data between
+ * interleaved and planar.  The matrix is walked in TRANSPOSE_TILE square
+ * tiles so that neither side strides across more cache lines than L1
+ * holds, and tiles of 2, 4 and 8 byte elements are shuffled in SSE2
+ * registers 8x8, 4x4 and 2x2 at a time.  Elements are moved bit for bit.
+ * @param src first element of the numRows x numCols source
+ * @param srcStride bytes from one source row to the next
+ * @param dst first element of the numCols x numRows destination
+ * @param dstStride bytes from one destination row to the next
+ * @param numRows rows of src
+ * @param numCols columns of src
+ * @param eltSize element size in bytes
+ */
+void transposeBlocked( const char* src, const size_t &srcStride, char* dst, const size_t &dstStride,
+                       const size_t &numRows, const size_t &numCols, const unsigned int &eltSize );
+
+/**
+ * Run the regression test for the transposer.  Return 0 if good.
+ * @return bool
+ */
+bool testTranspose();
+
+#endif // __TRANSPOSE_H__
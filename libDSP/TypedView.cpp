@@ -0,0 +1,16 @@
+#include "TypedView.h"
+
+/**
+  * class TypedView
+  * Copyright 2016, ShotSpotter
+  */
+
+// The sample types, built once here rather than in every user
+template class TypedView<int16_t>;
+template class TypedView<const int16_t>;
+template class TypedView<int32_t>;
+template class TypedView<const int32_t>;
+template class TypedView<float>;
+template class TypedView<const float>;
+template class TypedView<double>;
+template class TypedView<const double>;
@@ -0,0 +1,231 @@
+#ifndef __TYPEDVIEW_H__
+#define __TYPEDVIEW_H__
+
+/**
+  * class TypedView
+  * Copyright 2016, ShotSpotter
+  */
+
+#include "DataView.h"
+
+#include <type_traits>
+
+/**
+  * struct SampleTraits
+  * The NumberFormats that goes with each sample type.  Only these four
+  * types have typed views.
+  */
+template<typename T> struct SampleTraits;
+
+template<> struct SampleTraits<int16_t> { static const NumberFormats fmt = NUM_INT; };
+template<> struct SampleTraits<int32_t> { static const NumberFormats fmt = NUM_INT; };
+template<> struct SampleTraits<float>   { static const NumberFormats fmt = NUM_FLT; };
+template<> struct SampleTraits<double>  { static const NumberFormats fmt = NUM_DBL; };
+
+
+/**
+  * class TypedView
+  * Rows of samples of type T, fixed at compile time, so kernels written
+  * against it are instantiated per type and index with no size arithmetic
+  * or conversion.  T is const for read-only views.  Non-owning, like
+  * DataView, and got from one by the checked downcast typedView().
+  */
+template<typename T>
+class TypedView
+{
+public:
+
+  typedef typename std::remove_const<T>::type value_type;
+
+  /**
+   * Empty Constructor
+   */
+  TypedView() : data( NULL ), rows( 0 ), cols( 0 ), stride( 0 ), colStride( 1 ) {}
+
+  /**
+   * Full Constructor
+   * @param ptr First sample
+   * @param numRows Number of rows
+   * @param numCols Samples per row
+   * @param rowStride Samples from one row to the next
+   * @param columnStride (optional) Samples from one column to the next
+   */
+  TypedView( T* ptr, const unsigned long long &numRows, const unsigned int &numCols, const size_t &rowStride,
+             const size_t &columnStride = 1 )
+    : data( ptr ), rows( numRows ), cols( numCols ), stride( rowStride ), colStride( columnStride ) {}
+
+  /**
+   * @return a read only version of this view
+   */
+  TypedView<const value_type> asConst() const { return TypedView<const value_type>( data, rows, cols, stride, colStride ); }
+
+  /**
+   * @return the first sample
+   */
+  T* getData() const { return data; }
+
+  /**
+   * @param r Row index
+   * @return the first sample of row r, whose columns are getColStride() apart
+   */
+  T* getRow( const unsigned long long &r ) const { return data + r * stride; }
+
+  /**
+   * @param r Row index
+   * @param c Column index
+   * @return the sample at r, c
+   */
+  T& operator()( const unsigned long long &r, const unsigned int &c ) const { return data[r * stride + c * colStride]; }
+
+  /**
+   * @return the number of rows
+   */
+  unsigned long long getRows() const { return rows; }
+
+  /**
+   * @return samples per row
+   */
+  unsigned int getCols() const { return cols; }
+
+  /**
+   * @return samples from one row to the next
+   */
+  size_t getStride() const { return stride; }
+
+  /**
+   * @return samples from one column to the next, 1 if interleaved
+   */
+  size_t getColStride() const { return colStride; }
+
+  /**
+   * Narrow to one column.  Contiguous if the view is planar.
+   * @param c Column wanted, not range checked
+   * @return the single column view
+   */
+  TypedView<T> column( const unsigned int &c ) const { return TypedView<T>( data + c * colStride, rows, 1, stride ); }
+
+  /**
+   * @return the number of samples, rows * cols
+   */
+  unsigned long long getCount() const { return rows * cols; }
+
+  /**
+   * @return true if the samples follow each other with no gaps, so that
+   * getData() can be walked as a flat array of getCount() samples
+   */
+  bool isContiguous() const { return stride == cols && (colStride == 1 || cols == 1); }
+
+private:
+
+  T* data;
+  unsigned long long rows;
+  unsigned int cols;
+  size_t stride;
+  size_t colStride;
+
+};
+
+
+/**
+ * Does a runtime size and format describe T?  NUM_TIME is a double datenum.
+ * @param fmt number format
+ * @param size element size in bytes
+ * @return true if T is the sample type
+ */
+template<typename T>
+bool isSampleType( const NumberFormats &fmt, const unsigned int &size )
+{
+  typedef typename std::remove_const<T>::type U;
+  if( size != sizeof(U) )
+    return false;
+  return fmt == SampleTraits<U>::fmt || (fmt == NUM_TIME && std::is_same<U, double>::value);
+}
+
+
+/**
+ * Checked downcast of a view to its sample type.
+ * @param view the untyped view
+ * @param tv the typed view, empty on failure
+ * @return true if T is the sample type of view and its rows are aligned for T
+ */
+template<typename T>
+bool typedView( const DataView &view, TypedView<const T> &tv )
+{
+  tv = TypedView<const T>();
+  if( !isSampleType<T>( view.getNumFmt(), view.getEltSize() ) ) {
+    std::cerr << "typedView() element size " << view.getEltSize() << " format " << view.getNumFmt()
+              << " is not the type asked for!" << &std::endl;
+    return false;
+  }
+  if( view.getStride() % sizeof(T) || view.getColStride() % sizeof(T) || (size_t)view.getData() % alignof(T) ) {
+    std::cerr << "typedView() rows are not aligned for the type asked for!" << &std::endl;
+    return false;
+  }
+  tv = TypedView<const T>( (const T*)view.getData(), view.getRows(), view.getCols(),
+                          view.getStride() / sizeof(T), view.getColStride() / sizeof(T) );
+  return true;
+}
+
+
+/**
+ * Run a kernel on a view at its own sample type.  The type is looked up
+ * once per call, so fn runs with no per-sample dispatch.  fn is a generic
+ * callable taking any TypedView<const T>.
+ * @param view the untyped view
+ * @param fn kernel, called once
+ * @return false if the view has no typed form
+ */
+template<typename Fn>
+bool dispatchTyped( const DataView &view, Fn &&fn )
+{
+  switch( view.getNumFmt() ) {
+  case NUM_INT:
+    if( view.getEltSize() == sizeof(int16_t) ) {
+      TypedView<const int16_t> tv;
+      if( !typedView( view, tv ) ) return false;
+      fn( tv );
+      return true;
+    }
+    if( view.getEltSize() == sizeof(int32_t) ) {
+      TypedView<const int32_t> tv;
+      if( !typedView( view, tv ) ) return false;
+      fn( tv );
+      return true;
+    }
+    break;
+  case NUM_FLT:
+    if( view.getEltSize() == sizeof(float) ) {
+      TypedView<const float> tv;
+      if( !typedView( view, tv ) ) return false;
+      fn( tv );
+      return true;
+    }
+    break;
+  case NUM_DBL:
+  case NUM_TIME:
+    if( view.getEltSize() == sizeof(double) ) {
+      TypedView<const double> tv;
+      if( !typedView( view, tv ) ) return false;
+      fn( tv );
+      return true;
+    }
+    break;
+  default:
+    break;
+  }
+  std::cerr << "dispatchTyped() no sample type of size " << view.getEltSize()
+            << " format " << view.getNumFmt() << "!" << &std::endl;
+  return false;
+}
+
+// The sample types are built once, in TypedView.cpp
+extern template class TypedView<int16_t>;
+extern template class TypedView<const int16_t>;
+extern template class TypedView<int32_t>;
+extern template class TypedView<const int32_t>;
+extern template class TypedView<float>;
+extern template class TypedView<const float>;
+extern template class TypedView<double>;
+extern template class TypedView<const double>;
+
+#endif // __TYPEDVIEW_H__
@@ -0,0 +1,377 @@
+#include "WavFormat.h"
+
+/**
+  * WavFormat
+  * Copyright 2016, ShotSpotter
+  */
+
+/** Plain PCM header, and the WAVE_FORMAT_EXTENSIBLE one */
+#define WAV_PLAIN_BYTES 44
+#define WAV_EXTENSIBLE_BYTES 68
+
+/** Rows interleaved per write when a view isn't packed */
+#define WAV_WRITE_ROWS 65536
+
+/** KSDATAFORMAT_SUBTYPE GUID, less its leading format tag */
+static const unsigned char wavGuidTail[14] =
+  { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71 };
+
+static inline uint16_t get16( const unsigned char* p ) { return p[0] | p[1] << 8; }
+static inline uint32_t get32( const unsigned char* p ) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+static inline void put16( unsigned char* p, const uint32_t &v ) { p[0] = v; p[1] = v >> 8; }
+static inline void put32( unsigned char* p, const uint32_t &v ) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+
+/** Skip bytes, reading through them if the file can't seek */
+static bool
+skipBytes( FILE* fid, uint64_t numBytes )
+{
+  if( !numBytes || !fseeko( fid, numBytes, SEEK_CUR ) )
+    return true;
+  char junk[4096];
+  while( numBytes ) {
+    size_t want = numBytes < sizeof(junk) ? numBytes : sizeof(junk);
+    if( fread( junk, 1, want, fid ) != want )
+      return false;
+    numBytes -= want;
+  }
+  return true;
+}
+
+bool
+wavReadHeader( FILE* fid, WavInfo &info )
+{
+  memset( &info, 0, sizeof(WavInfo) );
+  unsigned char buf[40];
+  if( fread( buf, 12, 1, fid ) != 1 || memcmp( buf, WAV_RIFF_MAGIC, WAV_MAGIC_BYTES ) || memcmp( buf + 8, "WAVE", 4 ) ) {
+    std::cerr << "wavReadHeader() not a RIFF WAVE file!" << &std::endl;
+    return false;
+  }
+
+  // Position kept by hand, pipes have none
+  uint64_t pos = 12;
+  bool haveFmt = false;
+  while( true ) {
+    if( fread( buf, 8, 1, fid ) != 1 ) {
+      std::cerr << "wavReadHeader() no data chunk!" << &std::endl;
+      return false;
+    }
+    pos += 8;
+    uint32_t chunkBytes = get32( buf + 4 );
+
+    if( !memcmp( buf, "data", 4 ) ) {
+      if( !haveFmt ) {
+        std::cerr << "wavReadHeader() data chunk before fmt chunk!" << &std::endl;
+        return false;
+      }
+      info.dataOffset = pos;
+      info.dataBytes = chunkBytes == WAV_SIZE_UNKNOWN ? 0 : chunkBytes;
+      break;
+    }
+
+    uint64_t skip = chunkBytes + (chunkBytes & 1); // Chunks are padded to even
+    pos += skip;
+    if( !memcmp( buf, "fmt ", 4 ) ) {
+      if( chunkBytes < 16 ) {
+        std::cerr << "wavReadHeader() fmt chunk is short!" << &std::endl;
+        return false;
+      }
+      size_t want = chunkBytes < sizeof(buf) ? chunkBytes : sizeof(buf);
+      if( fread( buf, want, 1, fid ) != 1 ) {
+        std::cerr << "wavReadHeader() fmt chunk is truncated!" << &std::endl;
+        return false;
+      }
+      skip -= want;
+      info.format = get16( buf );
+      info.channels = get16( buf + 2 );
+      info.sampleRate = get32( buf + 4 );
+      info.blockAlign = get16( buf + 12 );
+      info.bitsPerSample = get16( buf + 14 );
+      if( info.format == WAVE_FORMAT_EXTENSIBLE ) {
+        if( want < 40 || memcmp( buf + 26, wavGuidTail, sizeof(wavGuidTail) ) ) {
+          std::cerr << "wavReadHeader() extensible fmt chunk has an unknown subformat!" << &std::endl;
+          return false;
+        }
+        info.format = get16( buf + 24 );
+      }
+      haveFmt = true;
+    }
+
+    if( !skipBytes( fid, skip ) ) {
+      std::cerr << "wavReadHeader() chunk is truncated!" << &std::endl;
+      return false;
+    }
+  }
+
+  NumberFormats fmt;
+  unsigned int size;
+  if( !wavSampleFormat( info, fmt, size ) ) {
+    std::cerr << "wavReadHeader() format " << info.format << " of " << info.bitsPerSample << " bits is not supported!" << &std::endl;
+    return false;
+  }
+  if( !info.channels || info.blockAlign != info.channels * size ) {
+    std::cerr << "wavReadHeader() block align " << info.blockAlign << " does not fit " << info.channels << " channels!" << &std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool
+wavSampleFormat( const WavInfo &info, NumberFormats &fmt, unsigned int &size )
+{
+  size = info.bitsPerSample / 8;
+  if( info.format == WAVE_FORMAT_PCM ) {
+    fmt = NUM_INT;
+    return info.bitsPerSample == 16 || info.bitsPerSample == 24 || info.bitsPerSample == 32;
+  }
+  if( info.format == WAVE_FORMAT_IEEE_FLOAT ) {
+    fmt = info.bitsPerSample == 64 ? NUM_DBL : NUM_FLT;
+    return info.bitsPerSample == 32 || info.bitsPerSample == 64;
+  }
+  return false;
+}
+
+bool
+wavInfoFor( const NumberFormats &fmt, const unsigned int &size, const unsigned int &numCols,
+            const double &sampleRate, WavInfo &info )
+{
+  memset( &info, 0, sizeof(WavInfo) );
+  if( fmt == NUM_INT && size >= 2 && size <= 4 )
+    info.format = WAVE_FORMAT_PCM;
+  else if( (fmt == NUM_FLT && size == sizeof(float)) || (fmt == NUM_DBL && size == sizeof(double)) )
+    info.format = WAVE_FORMAT_IEEE_FLOAT;
+  else {
+    std::cerr << "wavInfoFor() WAV has no samples of size " << size << " format " << fmt << "!" << &std::endl;
+    return false;
+  }
+  if( !numCols || numCols * size > UINT16_MAX ) {
+    std::cerr << "wavInfoFor() WAV can't hold " << numCols << " channels!" << &std::endl;
+    return false;
+  }
+  if( !(sampleRate >= 0.5 && sampleRate < UINT32_MAX) ) {
+    std::cerr << "wavInfoFor() WAV can't hold a sample rate of " << sampleRate << "!" << &std::endl;
+    return false;
+  }
+  info.channels = numCols;
+  info.sampleRate = (uint32_t)(sampleRate + 0.5);
+  info.bitsPerSample = 8 * size;
+  info.blockAlign = numCols * size;
+  return true;
+}
+
+/**
+ * Lay out a header.
+ * @param info what to describe
+ * @param dataBytes data chunk size, WAV_SIZE_UNKNOWN if streaming
+ * @param buf room for WAV_EXTENSIBLE_BYTES
+ * @return header bytes
+ */
+static size_t
+wavLayHeader( const WavInfo &info, const uint32_t &dataBytes, unsigned char* buf )
+{
+  // Extensible is required past 16 bits or two channels, and is the simpler float
+  bool plain = info.format == WAVE_FORMAT_PCM && info.bitsPerSample == 16 && info.channels <= 2;
+  size_t hdrBytes = plain ? WAV_PLAIN_BYTES : WAV_EXTENSIBLE_BYTES;
+  uint32_t pad = dataBytes & 1;
+  uint64_t riffBytes = hdrBytes - 8 + (uint64_t)dataBytes + pad;
+
+  memcpy( buf, WAV_RIFF_MAGIC, 4 );
+  put32( buf + 4, dataBytes == WAV_SIZE_UNKNOWN || riffBytes > UINT32_MAX ? WAV_SIZE_UNKNOWN : riffBytes );
+  memcpy( buf + 8, "WAVE", 4 );
+  memcpy( buf + 12, "fmt ", 4 );
+  put32( buf + 16, plain ? 16 : 40 );
+  put16( buf + 20, plain ? info.format : WAVE_FORMAT_EXTENSIBLE );
+  put16( buf + 22, info.channels );
+  put32( buf + 24, info.sampleRate );
+  put32( buf + 28, info.sampleRate * info.blockAlign );
+  put16( buf + 32, info.blockAlign );
+  put16( buf + 34, info.bitsPerSample );
+  unsigned char* p = buf + 36;
+  if( !plain ) {
+    put16( p, 22 );                      // Extension bytes
+    put16( p + 2, info.bitsPerSample );  // Valid bits
+    put32( p + 4, 0 );                   // Channel mask, none assigned
+    put16( p + 8, info.format );
+    memcpy( p + 10, wavGuidTail, sizeof(wavGuidTail) );
+    p += 24;
+  }
+  memcpy( p, "data", 4 );
+  put32( p + 4, dataBytes );
+  return hdrBytes;
+}
+
+
+// Constructors/Destructors
+//
+
+WavWriter::WavWriter()
+{
+  fid = NULL;
+  owned = false;
+  base = 0;
+  memset( &info, 0, sizeof(WavInfo) );
+  rows = 0;
+}
+
+WavWriter::~WavWriter()
+{
+  close();
+}
+
+//
+// Methods
+//
+
+bool
+WavWriter::open( const char* fileName, const WavInfo &hdr )
+{
+  close();
+  FILE* out = fopen( fileName, "w" );
+  if( !out ) {
+    std::cerr << "File: " << fileName << " was not opened for write!" << &std::endl;
+    return false;
+  }
+  if( !open( out, hdr ) ) {
+    fclose( out );
+    return false;
+  }
+  owned = true;
+  return true;
+}
+
+bool
+WavWriter::open( FILE* out, const WavInfo &hdr )
+{
+  close();
+  unsigned char buf[WAV_EXTENSIBLE_BYTES];
+  base = ftello( out ); // -1 for a pipe, the sizes then stay unknown
+  size_t hdrBytes = wavLayHeader( hdr, WAV_SIZE_UNKNOWN, buf );
+  if( fwrite( buf, hdrBytes, 1, out ) != 1 ) {
+    std::cerr << "WavWriter::open() could not write header!" << &std::endl;
+    return false;
+  }
+  fid = out;
+  owned = false;
+  info = hdr;
+  info.dataOffset = hdrBytes;
+  info.dataBytes = 0;
+  rows = 0;
+  return true;
+}
+
+bool
+WavWriter::write( const char* src, const unsigned long long &numRows )
+{
+  if( !fid ) {
+    std::cerr << "WavWriter::write() no file is open!" << &std::endl;
+    return false;
+  }
+  if( numRows && fwrite( src, info.blockAlign, numRows, fid ) != numRows ) {
+    std::cerr << "WavWriter::write() short write of rows!" << &std::endl;
+    return false;
+  }
+  rows += numRows;
+  info.dataBytes += numRows * info.blockAlign;
+  return true;
+}
+
+bool
+WavWriter::write( const DataView &view )
+{
+  if( view.getRowSize() != info.blockAlign || view.getEltSize() * 8 != info.bitsPerSample ) {
+    std::cerr << "WavWriter::write() view rows don't match the header!" << &std::endl;
+    return false;
+  }
+  if( view.isContiguous() )
+    return write( view.getData(), view.getRows() );
+
+  scratch.resize( WAV_WRITE_ROWS * view.getRowSize() );
+  for( unsigned long long beg = 0; beg < view.getRows(); beg += WAV_WRITE_ROWS ) {
+    unsigned long long num = view.getRows() - beg < WAV_WRITE_ROWS ? view.getRows() - beg : WAV_WRITE_ROWS;
+    view.subView( beg, num ).copyTo( &scratch[0] );
+    if( !write( &scratch[0], num ) )
+      return false;
+  }
+  return true;
+}
+
+bool
+WavWriter::close()
+{
+  if( !fid )
+    return true;
+
+  bool ok = true;
+  if( info.dataBytes & 1 && fputc( 0, fid ) == EOF ) {
+    std::cerr << "WavWriter::close() could not pad the data chunk!" << &std::endl;
+    ok = false;
+  }
+
+  // Seekable files get their sizes, anything past 4GB keeps them unknown
+  if( base >= 0 ) {
+    uint32_t dataBytes = WAV_SIZE_UNKNOWN;
+    if( info.dataBytes < WAV_SIZE_UNKNOWN )
+      dataBytes = info.dataBytes;
+    else
+      std::cerr << "WavWriter::close() " << info.dataBytes << " bytes of rows are too many for WAV sizes, left unknown." << &std::endl;
+    unsigned char buf[WAV_EXTENSIBLE_BYTES];
+    size_t hdrBytes = wavLayHeader( info, dataBytes, buf );
+    off_t end = ftello( fid );
+    if( fseeko( fid, base, SEEK_SET ) || fwrite( buf, hdrBytes, 1, fid ) != 1 || fseeko( fid, end, SEEK_SET ) ) {
+      std::cerr << "WavWriter::close() could not patch the header!" << &std::endl;
+      ok = false;
+    }
+  }
+
+  if( owned && fclose( fid ) ) {
+    std::cerr << "WavWriter::close() close failed!" << &std::endl;
+    ok = false;
+  }
+  fid = NULL;
+  owned = false;
+  return ok;
+}
+
+bool
+testWav()
+{
+  // 24 bit PCM, three channels, an odd count so the data chunk is padded
+  const unsigned long long numRows = 1001;
+  const unsigned int numCols = 3, size = 3;
+  std::vector<char> rows( numRows * numCols * size ), back( rows.size() );
+  for( size_t i = 0; i < rows.size(); i++ )
+    rows[i] = (char)(i * 7919);
+
+  FILE* fid = tmpfile();
+  if( !fid )
+    return DRATS;
+  WavInfo hdr, got;
+  WavWriter wr;
+  bool ok = wavInfoFor( NUM_INT, size, numCols, 8000.0, hdr ) && wr.open( fid, hdr ) &&
+            wr.write( &rows[0], 500 ) && wr.write( &rows[500 * numCols * size], numRows - 500 ) &&
+            wr.getRows() == numRows && wr.close();
+  rewind( fid );
+  ok = ok && wavReadHeader( fid, got ) && got.format == WAVE_FORMAT_PCM && got.channels == numCols &&
+       got.sampleRate == 8000 && got.bitsPerSample == 24 && got.dataOffset == WAV_EXTENSIBLE_BYTES &&
+       got.dataBytes == rows.size() && fread( &back[0], back.size(), 1, fid ) == 1 && rows == back &&
+       fgetc( fid ) == 0 && fgetc( fid ) == EOF;
+  fclose( fid );
+  if( !ok )
+    return DRATS;
+
+  // Stereo 16 bit takes the plain header, with a chunk to skip before data
+  unsigned char buf[WAV_EXTENSIBLE_BYTES];
+  wavInfoFor( NUM_INT, 2, 2, 44100.0, hdr );
+  size_t hdrBytes = wavLayHeader( hdr, 8, buf );
+  fid = tmpfile();
+  if( !fid || hdrBytes != WAV_PLAIN_BYTES )
+    return DRATS;
+  fwrite( buf, 36, 1, fid );
+  fwrite( "LIST\3\0\0\0abc\0", 12, 1, fid );
+  fwrite( buf + 36, 8, 1, fid );
+  fwrite( &rows[0], 8, 1, fid );
+  rewind( fid );
+  ok = wavReadHeader( fid, got ) && got.dataOffset == WAV_PLAIN_BYTES + 12 && got.dataBytes == 8 &&
+       got.blockAlign == 4 && fread( &back[0], 8, 1, fid ) == 1 && !memcmp( &back[0], &rows[0], 8 );
+  fclose( fid );
+  return ok ? VOILA : DRATS;
+}
@@ -0,0 +1,174 @@
+#ifndef __WAVFORMAT_H__
+#define __WAVFORMAT_H__
+
+/**
+  * WAV format, FORMAT_WAV
+  * Copyright 2016, ShotSpotter
+  *
+  * RIFF WAVE files of interleaved PCM or IEEE float samples:
+  *
+  *   "RIFF" size "WAVE"
+  *   "fmt " chunk      format, channels, rate, block align, bits
+  *   other chunks      skipped on read
+  *   "data" chunk      the rows
+  *
+  * 16, 24 and 32 bit PCM map to NUM_INT of 2, 3 and 4 bytes, 32 and 64
+  * bit float to NUM_FLT and NUM_DBL.  WAVE_FORMAT_EXTENSIBLE is read, and
+  * written whenever plain PCM is not enough.  WAV holds no start time.
+  */
+
+#include "libCore/libCore.h"
+#include "DataView.h"
+
+#include <stdint.h>
+
+#define WAV_RIFF_MAGIC "RIFF"
+#define WAV_MAGIC_BYTES 4
+
+/** A data chunk size unknown to a streaming writer */
+#define WAV_SIZE_UNKNOWN 0xffffffffu
+
+enum WavFormatTags
+{
+  WAVE_FORMAT_PCM = 1,
+  WAVE_FORMAT_IEEE_FLOAT = 3,
+  WAVE_FORMAT_EXTENSIBLE = 0xfffe
+};
+
+/**
+  * struct WavInfo
+  * What a WAV header says about the rows.
+  */
+struct WavInfo
+{
+  uint16_t format;        /** WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT, extensible resolved */
+  uint16_t channels;
+  uint32_t sampleRate;    /** Rows per second */
+  uint16_t blockAlign;    /** Bytes per row */
+  uint16_t bitsPerSample;
+  uint64_t dataOffset;    /** Offset of the first row from the RIFF header */
+  uint64_t dataBytes;     /** Bytes of rows, zero if unknown, up to end of file */
+};
+
+/**
+ * Read a WAV header up to the first row.
+ * @param fid The open file, at "RIFF", left at the first row
+ * @param info what the header says
+ * @return false if the file isn't WAV or its samples have no NumberFormats
+ */
+bool wavReadHeader( FILE* fid, WavInfo &info );
+
+/**
+ * The sample format of a WAV file.
+ * @param info header read
+ * @param fmt number format of the samples
+ * @param size element size in bytes
+ * @return false if there is none
+ */
+bool wavSampleFormat( const WavInfo &info, NumberFormats &fmt, unsigned int &size );
+
+/**
+ * The WAV header for rows of samples.
+ * @param fmt number format of the samples
+ * @param size element size in bytes
+ * @param numCols number of columns
+ * @param sampleRate rows per second, rounded
+ * @param info header to write, dataBytes zero
+ * @return false if WAV can't hold the samples
+ */
+bool wavInfoFor( const NumberFormats &fmt, const unsigned int &size, const unsigned int &numCols,
+                 const double &sampleRate, WavInfo &info );
+
+
+/**
+  * class WavWriter
+  * Streams rows out to a WAV file.  The header goes out first with the
+  * sizes unknown and is patched by close(), so a file cut short, or
+  * written down a pipe, is still readable.
+  *
+  *   WavWriter wr;
+  *   if( wr.open( fileName, info ) )
+  *     while( more )
+  *       wr.write( view );
+  *   wr.close();
+  */
+class WavWriter
+{
+public:
+
+  /**
+   * Empty Constructor
+   */
+  WavWriter();
+
+  /**
+   * Destructor, closes any file.
+   */
+  virtual ~WavWriter();
+
+  /**
+   * Create a file and write its header.
+   * @param fileName Name of file to write
+   * @param hdr header, see wavInfoFor()
+   * @return true if the file is ready for rows
+   */
+  bool open( const char* fileName, const WavInfo &hdr );
+
+  /**
+   * Write a header to a file already open, at its current position.  The
+   * file is not closed by close().
+   * @param fid The open file
+   * @param hdr header, see wavInfoFor()
+   * @return true if the file is ready for rows
+   */
+  bool open( FILE* fid, const WavInfo &hdr );
+
+  /**
+   * Append packed interleaved rows.
+   * @param rows first row
+   * @param numRows number of rows
+   * @return true if successful
+   */
+  bool write( const char* rows, const unsigned long long &numRows );
+
+  /**
+   * Append the rows of a view, interleaving planar ones.
+   * @param view rows of the shape given to open()
+   * @return true if successful
+   */
+  bool write( const DataView &view );
+
+  /**
+   * Pad, patch the header sizes and close the file if open() opened it.
+   * @return false if any of that failed, the rows are out regardless
+   */
+  bool close();
+
+  /**
+   * @return true if a file is open
+   */
+  bool isOpen() const { return fid != NULL; }
+
+  /**
+   * @return the number of rows written since open()
+   */
+  unsigned long long getRows() const { return rows; }
+
+private:
+
+  FILE* fid;
+  bool owned;
+  off_t base;
+  WavInfo info;
+  unsigned long long rows;
+  std::vector<char> scratch;
+
+};
+
+/**
+ * Run the regression test for WAV headers.  Return 0 if good.
+ * @return bool
+ */
+bool testWav();
+
+#endif // __WAVFORMAT_H__
@@ -1,6 +1,23 @@
+#include "libDSP/NativeFormat.h"
+#include "libDSP/DataAllocator.h"
+#include "libDSP/Transpose.h"
+#include "libDSP/DataView.h"
+#include "libDSP/TypedView.h"
+#include "libDSP/SampleConvert.h"
+#include "libDSP/DataDiff.h"
+#include "libDSP/DeltaCodec.h"
+#include "libDSP/WavFormat.h"
+#include "libDSP/AsciiFormat.h"
+#include "libDSP/RowSort.h"
+#include "libDSP/EventFlatten.h"
 #include "libDSP/DataCommon.h"
 #include "libDSP/TimeData.h"
+#include "libDSP/SegmentedTimeData.h"
 #include "libDSP/FreqData.h"
 #include "libDSP/SpecData.h"
 #include "libDSP/DiscData.h"
 #include "libDSP/EventData.h"
+#include "libDSP/EventIndex.h"
+#include "libDSP/EventColumns.h"
+#include "libDSP/DataChunkReader.h"
+#include "libDSP/EventMerge.h"
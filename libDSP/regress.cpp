@@ -1,15 +1,45 @@
-#include "libSVG.h"
+#include "libDSP.h"
+
+/** Run one regression, saying which failed */
+static bool
+failed( const char* name, bool (*test)() )
+{
+  fprintf( stderr, "Testing %s ...\n", name );
+  if( !test() )
+    return false;
+  fprintf( stderr, "XXX %s regression failed!\n", name );
+  return true;
+}
 
 int
 main( int argc, char* argv[] ) 
 {
-  Plot ts;
-   
-  if( !ts.write("TestSVG") )
-  	goto BOGUS;
-  else
-  	goto BLAM;
+  TimeObj::initClass();
+  LogObj::initClass();
+  LockObj::initClass();
 
+  // Building blocks first, then the containers made of them
+  if( failed( "PoolAllocator", PoolAllocator::testClass ) ) goto BOGUS;
+  if( failed( "ArenaAllocator", ArenaAllocator::testClass ) ) goto BOGUS;
+  if( failed( "Transpose", testTranspose ) ) goto BOGUS;
+  if( failed( "DataView", DataView::testClass ) ) goto BOGUS;
+  if( failed( "SampleConvert", testSampleConvert ) ) goto BOGUS;
+  if( failed( "DataDiff", testDataDiff ) ) goto BOGUS;
+  if( failed( "DeltaCodec", testDeltaCodec ) ) goto BOGUS;
+  if( failed( "WavFormat", testWav ) ) goto BOGUS;
+  if( failed( "AsciiFormat", testAscii ) ) goto BOGUS;
+  if( failed( "RowSort", testRowSort ) ) goto BOGUS;
+  if( failed( "EventFlatten", testEventFlatten ) ) goto BOGUS;
+  if( failed( "NativeFormat", testNative ) ) goto BOGUS;
+  if( failed( "DataCommon", DataCommon::testClass ) ) goto BOGUS;
+  if( failed( "TimeData", TimeData::testClass ) ) goto BOGUS;
+  if( failed( "SegmentedTimeData", SegmentedTimeData::testClass ) ) goto BOGUS;
+  if( failed( "DiscData", DiscData::testClass ) ) goto BOGUS;
+  if( failed( "DataChunkReader", DataChunkReader::testClass ) ) goto BOGUS;
+  if( failed( "EventData", EventData::testClass ) ) goto BOGUS;
+  if( failed( "EventIndex", EventIndex::testClass ) ) goto BOGUS;
+  if( failed( "EventColumns", EventColumns::testClass ) ) goto BOGUS;
+  if( failed( "EventMerge", testEventMerge ) ) goto BOGUS;
 
 BLAM :
   printf( "VOILA!\n" );
@@ -18,4 +48,4 @@ BLAM :
 BOGUS :
   printf( "FUPDUCK!\n" );
   return DRATS;
-}
\ No newline at end of file
+}
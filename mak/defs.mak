@@ -18,4 +18,4 @@ OBJ_FILES := $(HDR_FILES:%.h=$(LIB_OBJ_DIR)/%.o)
 
 STATIC_LIB := $(ROOT_OUTPUT_DIR)/$(LIB_NAME).a
 
-G++_OPTS := -O2 -Wall -g
+G++_OPTS := -O2 -Wall -g -pthread